@@ -0,0 +1,170 @@
+#define SDL_MAIN_HANDLED
+#include "cpu_culling.h"
+#include "bvh.h"
+
+#include <stdio.h>
+
+#define BENCH_OBJECTS_COUNT 100000
+#define BENCH_WARMUP_RUNS 20
+#define BENCH_RUNS 500
+#define BENCH_SCENE_SIZE 100.0f
+
+static const char* path_names[] = {"scalar", "sse", "avx2"};
+
+static int compare_indices(const void* a, const void* b)
+{
+    uint32_t index_a = *(const uint32_t*)a;
+    uint32_t index_b = *(const uint32_t*)b;
+    return index_a < index_b ? -1 : (index_a > index_b ? 1 : 0);
+}
+
+static double elapsed_ms(uint64_t start, uint64_t end)
+{
+    return (double)(end - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+static uint32_t random_state = 0x12345678u;
+
+static float random_float(float min, float max)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return min + (max - min) * (float)(random_state & 0xffffff) / (float)0xffffff;
+}
+
+// a scene about as large as the camera's far plane, so under a tenth of it is visible.
+// the optional argument is the worker count for the bvh build, 0 or nothing picks one per core
+int main(int argc, char** argv)
+{
+    uint32_t threads_count = argc > 1 ? (uint32_t)atoi(argv[1]) : 0;
+
+    agfx_cull_bounds_t bounds;
+    if (AGFX_SUCCESS != agfx_create_cull_bounds(BENCH_OBJECTS_COUNT, &bounds))
+    {
+        printf("failed to allocate bounds\n");
+        return 1;
+    }
+
+    agfx_cull_bounds_set_count(&bounds, BENCH_OBJECTS_COUNT);
+    for (size_t i = 0; i < BENCH_OBJECTS_COUNT; ++i)
+    {
+        agfx_vector3_t position = {
+            random_float(-BENCH_SCENE_SIZE, BENCH_SCENE_SIZE),
+            random_float(-BENCH_SCENE_SIZE, BENCH_SCENE_SIZE),
+            random_float(-BENCH_SCENE_SIZE, BENCH_SCENE_SIZE)
+        };
+        agfx_vector3_t extent = {random_float(0.1f, 2.0f), random_float(0.1f, 2.0f), random_float(0.1f, 2.0f)};
+        agfx_cull_bounds_set_transformed(&bounds, i, agfx_mat4x4_translation(position), (agfx_vector4_t) {0.0f, 0.0f, 0.0f, agfx_vector3_magnitude(extent)},
+            (agfx_vector3_t) {-extent.x, -extent.y, -extent.z}, extent);
+    }
+
+    agfx_mat4x4_t view_projection = agfx_mat4x4_multiplied_by_mat4x4(
+        agfx_mat4x4_perspective(60.0f * M_PI / 180.0f, 16.0f / 9.0f, 0.1f, BENCH_SCENE_SIZE),
+        agfx_mat4x4_look_at((agfx_vector3_t) {0.0f, 0.0f, 0.0f}, (agfx_vector3_t) {1.0f, 0.5f, 0.2f}, (agfx_vector3_t) {0.0f, 0.0f, 1.0f})
+    );
+    agfx_frustum_t frustum = agfx_frustum_from_view_projection(view_projection);
+
+    uint32_t* reference_indices = calloc(bounds.capacity, sizeof(uint32_t));
+    uint32_t* visible_indices = calloc(bounds.capacity, sizeof(uint32_t));
+    if (NULL == reference_indices || NULL == visible_indices)
+    {
+        printf("failed to allocate index lists\n");
+        return 1;
+    }
+
+    size_t reference_count = agfx_cull_frustum(&bounds, &frustum, AGFX_CULL_PATH_SCALAR, reference_indices);
+    agfx_cull_path_t best_path = agfx_cull_best_path();
+    int failed = 0;
+
+    printf("%d objects, %zu visible, best path %s\n", BENCH_OBJECTS_COUNT, reference_count, path_names[best_path]);
+
+    for (int path = AGFX_CULL_PATH_SCALAR; path <= (int)best_path; ++path)
+    {
+        size_t visible_count = 0;
+        for (int run = 0; run < BENCH_WARMUP_RUNS; ++run)
+        {
+            visible_count = agfx_cull_frustum(&bounds, &frustum, (agfx_cull_path_t)path, visible_indices);
+        }
+
+        double best_ms = 1e9;
+        double total_ms = 0.0;
+        for (int run = 0; run < BENCH_RUNS; ++run)
+        {
+            uint64_t start = SDL_GetPerformanceCounter();
+            visible_count = agfx_cull_frustum(&bounds, &frustum, (agfx_cull_path_t)path, visible_indices);
+            uint64_t end = SDL_GetPerformanceCounter();
+
+            double ms = elapsed_ms(start, end);
+            best_ms = ms < best_ms ? ms : best_ms;
+            total_ms += ms;
+        }
+
+        // every path has to agree with the scalar one, lane for lane
+        int matches = visible_count == reference_count && 0 == memcmp(visible_indices, reference_indices, sizeof(uint32_t) * visible_count);
+        failed |= !matches;
+
+        printf("%-6s best %.3f ms, average %.3f ms, %zu visible%s\n", path_names[path], best_ms, total_ms / BENCH_RUNS, visible_count, matches ? "" : " MISMATCH");
+    }
+
+    agfx_job_system_t job_system;
+    agfx_bvh_t bvh;
+    if (AGFX_SUCCESS != agfx_create_job_system(threads_count, &job_system) || AGFX_SUCCESS != agfx_create_bvh(BENCH_OBJECTS_COUNT, &bvh))
+    {
+        printf("failed to create the job system or the bvh\n");
+        return 1;
+    }
+
+    for (size_t i = 0; i < BENCH_OBJECTS_COUNT; ++i)
+    {
+        agfx_aabb_t aabb = {
+            .min = {bounds.box_center_x[i] - bounds.box_extent_x[i], bounds.box_center_y[i] - bounds.box_extent_y[i], bounds.box_center_z[i] - bounds.box_extent_z[i]},
+            .max = {bounds.box_center_x[i] + bounds.box_extent_x[i], bounds.box_center_y[i] + bounds.box_extent_y[i], bounds.box_center_z[i] + bounds.box_extent_z[i]}
+        };
+        agfx_bvh_set_primitive(&bvh, i, aabb);
+    }
+
+    double build_ms = 1e9;
+    for (int run = 0; run < 10; ++run)
+    {
+        uint64_t start = SDL_GetPerformanceCounter();
+        agfx_bvh_build(&bvh, &job_system, BENCH_OBJECTS_COUNT);
+        uint64_t end = SDL_GetPerformanceCounter();
+        build_ms = elapsed_ms(start, end) < build_ms ? elapsed_ms(start, end) : build_ms;
+    }
+
+    double refit_ms = 1e9;
+    for (int run = 0; run < 10; ++run)
+    {
+        uint64_t start = SDL_GetPerformanceCounter();
+        agfx_bvh_refit(&bvh);
+        uint64_t end = SDL_GetPerformanceCounter();
+        refit_ms = elapsed_ms(start, end) < refit_ms ? elapsed_ms(start, end) : refit_ms;
+    }
+
+    size_t bvh_visible_count = 0;
+    double bvh_cull_ms = 1e9;
+    for (int run = 0; run < BENCH_RUNS; ++run)
+    {
+        uint64_t start = SDL_GetPerformanceCounter();
+        bvh_visible_count = agfx_bvh_cull_frustum(&bvh, &frustum, visible_indices);
+        uint64_t end = SDL_GetPerformanceCounter();
+        bvh_cull_ms = elapsed_ms(start, end) < bvh_cull_ms ? elapsed_ms(start, end) : bvh_cull_ms;
+    }
+
+    // the spheres enclose the boxes, so the box only tree walk has to find the same set
+    qsort(visible_indices, bvh_visible_count, sizeof(uint32_t), compare_indices);
+    int bvh_matches = bvh_visible_count == reference_count && 0 == memcmp(visible_indices, reference_indices, sizeof(uint32_t) * bvh_visible_count);
+    failed |= !bvh_matches;
+
+    printf("bvh    %u workers, %d nodes, build %.3f ms, refit %.3f ms, sah cost %.2f\n", job_system.threads_count, SDL_AtomicGet(&bvh.nodes_count), build_ms, refit_ms, bvh.cost);
+    printf("bvh    best %.3f ms, %zu visible%s\n", bvh_cull_ms, bvh_visible_count, bvh_matches ? "" : " MISMATCH");
+
+    agfx_free_bvh(&bvh);
+    agfx_free_job_system(&job_system);
+    free(visible_indices);
+    free(reference_indices);
+    agfx_free_cull_bounds(&bounds);
+
+    return failed;
+}
\ No newline at end of file
@@ -0,0 +1,198 @@
+#define SDL_MAIN_HANDLED
+#include "mesh_lod.h"
+
+#include <stdio.h>
+
+// a rolling heightfield, welded like a loaded mesh, placed many times along a line away from a 1080p camera
+#define BENCH_GRID_SIZE 256
+#define BENCH_MESHES_COUNT 16
+#define BENCH_SMALL_GRID_SIZE 64
+#define BENCH_INSTANCES_COUNT 1000
+#define BENCH_NEAREST_DISTANCE 2.0f
+#define BENCH_INSTANCE_SPACING 0.5f
+#define BENCH_SCREEN_HEIGHT 1080.0f
+#define BENCH_FOV_DEGREES 45.0f
+#define BENCH_SWITCH_FRAMES 1000
+
+static double elapsed_ms(uint64_t start, uint64_t end)
+{
+    return (double)(end - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+static agfx_result_t create_grid_mesh(uint32_t grid_size, agfx_mesh_t* out_mesh)
+{
+    agfx_mesh_t mesh = {0};
+    mesh.vertices_count = (size_t)(grid_size + 1) * (grid_size + 1);
+    mesh.indices_count = (size_t)grid_size * grid_size * 6;
+    mesh.vertices = malloc(sizeof(agfx_vertex_t) * mesh.vertices_count);
+    mesh.indices = malloc(sizeof(uint32_t) * mesh.indices_count);
+    if (NULL == mesh.vertices || NULL == mesh.indices)
+    {
+        free(mesh.vertices);
+        free(mesh.indices);
+        return AGFX_BUFFER_ERROR;
+    }
+
+    // one unit across whatever the resolution, so the errors compare between meshes
+    for (uint32_t y = 0; y <= grid_size; ++y)
+    {
+        for (uint32_t x = 0; x <= grid_size; ++x)
+        {
+            float u = (float)x / (float)grid_size;
+            float v = (float)y / (float)grid_size;
+            mesh.vertices[y * (grid_size + 1) + x] = (agfx_vertex_t) {
+                .position = {u - 0.5f, 0.05f * sinf(u * 12.0f) * cosf(v * 9.0f), v - 0.5f},
+                .color = {1.0f, 1.0f, 1.0f, 1.0f},
+                .texture_coordinate = {u, v}
+            };
+        }
+    }
+
+    size_t index = 0;
+    for (uint32_t y = 0; y < grid_size; ++y)
+    {
+        for (uint32_t x = 0; x < grid_size; ++x)
+        {
+            uint32_t corner = y * (grid_size + 1) + x;
+            mesh.indices[index++] = corner;
+            mesh.indices[index++] = corner + grid_size + 1;
+            mesh.indices[index++] = corner + 1;
+            mesh.indices[index++] = corner + 1;
+            mesh.indices[index++] = corner + grid_size + 1;
+            mesh.indices[index++] = corner + grid_size + 2;
+        }
+    }
+
+    mesh.bounding_sphere = (agfx_vector4_t) {0.0f, 0.0f, 0.0f, sqrtf(0.5f)};
+    *out_mesh = mesh;
+    return AGFX_SUCCESS;
+}
+
+// what the selection would be without the band, for counting how often it flips
+static uint32_t select_lod_without_hysteresis(const agfx_mesh_lod_t* lods, uint32_t lods_count, float distance, float error_scale)
+{
+    uint32_t selected_lod = 0;
+    for (uint32_t lod = 1; lod < lods_count; ++lod)
+    {
+        if (lods[lod].error * error_scale <= distance) selected_lod = lod;
+    }
+    return selected_lod;
+}
+
+// the optional argument is the worker count, 0 or nothing picks one per core
+int main(int argc, char** argv)
+{
+    uint32_t threads_count = argc > 1 ? (uint32_t)atoi(argv[1]) : 0;
+
+    agfx_job_system_t job_system;
+    if (AGFX_SUCCESS != agfx_create_job_system(threads_count, &job_system))
+    {
+        printf("failed to create the job system\n");
+        return 1;
+    }
+
+    // the chain of one large mesh
+    agfx_mesh_t mesh;
+    if (AGFX_SUCCESS != create_grid_mesh(BENCH_GRID_SIZE, &mesh))
+    {
+        printf("failed to create the mesh\n");
+        return 1;
+    }
+
+    uint64_t build_start = SDL_GetPerformanceCounter();
+    agfx_result_t result = agfx_build_mesh_lods(&mesh);
+    double build_ms = elapsed_ms(build_start, SDL_GetPerformanceCounter());
+    if (AGFX_SUCCESS != result)
+    {
+        printf("lod generation failed\n");
+        return 1;
+    }
+
+    printf("%zu triangles, %u levels in %.3f ms\n", mesh.indices_count / 3, mesh.lods_count, build_ms);
+    uint32_t errors_grow = 1;
+    for (uint32_t lod = 0; lod < mesh.lods_count; ++lod)
+    {
+        printf("lod %u: %u triangles, error %.6f\n", lod, mesh.lods[lod].indices_count / 3, mesh.lods[lod].error);
+        if (lod > 0 && mesh.lods[lod].error < mesh.lods[lod - 1].error) errors_grow = 0;
+    }
+
+    // every instance picks its level as the renderer does, one pixel of error allowed
+    float lod_scale = BENCH_SCREEN_HEIGHT * 0.5f / tanf(BENCH_FOV_DEGREES * 0.5f * (float)M_PI / 180.0f) / AGFX_LOD_PIXEL_ERROR;
+    uint64_t full_triangles_count = 0;
+    uint64_t drawn_triangles_count = 0;
+    uint64_t far_full_triangles_count = 0;
+    uint64_t far_drawn_triangles_count = 0;
+    uint64_t select_start = SDL_GetPerformanceCounter();
+    for (uint32_t instance = 0; instance < BENCH_INSTANCES_COUNT; ++instance)
+    {
+        float distance = fmaxf(BENCH_NEAREST_DISTANCE + instance * BENCH_INSTANCE_SPACING - mesh.bounding_sphere.w, 0.0f);
+        uint32_t lod = agfx_select_lod(mesh.lods, mesh.lods_count, 0, distance, lod_scale);
+        full_triangles_count += mesh.indices_count / 3;
+        drawn_triangles_count += mesh.lods[lod].indices_count / 3;
+        if (instance >= BENCH_INSTANCES_COUNT / 2)
+        {
+            far_full_triangles_count += mesh.indices_count / 3;
+            far_drawn_triangles_count += mesh.lods[lod].indices_count / 3;
+        }
+    }
+    double select_ms = elapsed_ms(select_start, SDL_GetPerformanceCounter());
+    printf("%d instances from %.1f to %.1f units: %llu of %llu triangles (%.1fx), far half %.1fx, select %.3f ms\n",
+        BENCH_INSTANCES_COUNT, BENCH_NEAREST_DISTANCE, BENCH_NEAREST_DISTANCE + (BENCH_INSTANCES_COUNT - 1) * BENCH_INSTANCE_SPACING,
+        (unsigned long long)drawn_triangles_count, (unsigned long long)full_triangles_count, (double)full_triangles_count / (double)drawn_triangles_count,
+        (double)far_full_triangles_count / (double)far_drawn_triangles_count, select_ms);
+
+    // an object drifting back and forth across the first switch distance
+    uint32_t switches_count = 0;
+    uint32_t switches_without_band_count = 0;
+    if (mesh.lods_count > 1)
+    {
+        float switch_distance = mesh.lods[1].error * lod_scale;
+        uint32_t current_lod = 0;
+        uint32_t current_lod_without_band = 0;
+        for (uint32_t frame = 0; frame < BENCH_SWITCH_FRAMES; ++frame)
+        {
+            float distance = switch_distance * (1.0f + 0.05f * sinf((float)frame * 0.3f));
+            uint32_t lod = agfx_select_lod(mesh.lods, mesh.lods_count, current_lod, distance, lod_scale);
+            uint32_t lod_without_band = select_lod_without_hysteresis(mesh.lods, mesh.lods_count, distance, lod_scale);
+            switches_count += lod != current_lod;
+            switches_without_band_count += lod_without_band != current_lod_without_band;
+            current_lod = lod;
+            current_lod_without_band = lod_without_band;
+        }
+    }
+    printf("%d frames around the first switch: %u switches with the band, %u without\n", BENCH_SWITCH_FRAMES, switches_count, switches_without_band_count);
+
+    // many meshes the way load_model builds them
+    agfx_mesh_t* meshes = malloc(sizeof(agfx_mesh_t) * BENCH_MESHES_COUNT);
+    if (NULL == meshes)
+    {
+        printf("failed to allocate the meshes\n");
+        return 1;
+    }
+    for (int i = 0; i < BENCH_MESHES_COUNT; ++i)
+    {
+        if (AGFX_SUCCESS != create_grid_mesh(BENCH_SMALL_GRID_SIZE, &meshes[i]))
+        {
+            printf("failed to create the meshes\n");
+            return 1;
+        }
+    }
+
+    agfx_lod_stats_t stats;
+    agfx_build_lods(&job_system, meshes, BENCH_MESHES_COUNT, &stats);
+    printf("%d meshes on %u workers: %u with chains, %u levels in %.3f ms\n", BENCH_MESHES_COUNT, job_system.threads_count, stats.meshes_count, stats.lods_count, stats.build_ms);
+
+    for (int i = 0; i < BENCH_MESHES_COUNT; ++i)
+    {
+        free(meshes[i].vertices);
+        free(meshes[i].indices);
+        free(meshes[i].lod_indices);
+    }
+    free(meshes);
+    free(mesh.vertices);
+    free(mesh.indices);
+    free(mesh.lod_indices);
+    agfx_free_job_system(&job_system);
+
+    return !errors_grow || mesh.lods_count < 4 || switches_count >= switches_without_band_count || stats.meshes_count != BENCH_MESHES_COUNT;
+}
\ No newline at end of file
@@ -0,0 +1,193 @@
+#define SDL_MAIN_HANDLED
+#include "mesh_optimizer.h"
+
+#include <stdio.h>
+
+// a grid of quads, exported the way a bad exporter would: three vertices per triangle and the triangles shuffled
+#define BENCH_GRID_SIZE 512
+#define BENCH_MESHES_COUNT 64
+#define BENCH_SMALL_GRID_SIZE 64
+
+static uint32_t random_state = 0x2545f491u;
+
+static uint32_t random_uint(uint32_t max)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state % max;
+}
+
+static double elapsed_ms(uint64_t start, uint64_t end)
+{
+    return (double)(end - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+static agfx_vertex_t grid_vertex(uint32_t x, uint32_t y, uint32_t grid_size)
+{
+    return (agfx_vertex_t) {
+        .position = {(float)x, sinf((float)x * 0.1f) * cosf((float)y * 0.1f), (float)y},
+        .color = {1.0f, 1.0f, 1.0f, 1.0f},
+        .texture_coordinate = {(float)x / (float)grid_size, (float)y / (float)grid_size}
+    };
+}
+
+static agfx_result_t create_grid_mesh(uint32_t grid_size, agfx_mesh_t* out_mesh)
+{
+    agfx_mesh_t mesh = {0};
+    size_t triangles_count = (size_t)grid_size * grid_size * 2;
+    mesh.vertices_count = triangles_count * 3;
+    mesh.indices_count = triangles_count * 3;
+    mesh.vertices = malloc(sizeof(agfx_vertex_t) * mesh.vertices_count);
+    mesh.indices = malloc(sizeof(uint32_t) * mesh.indices_count);
+    uint32_t* order = malloc(sizeof(uint32_t) * triangles_count);
+    if (NULL == mesh.vertices || NULL == mesh.indices || NULL == order)
+    {
+        free(mesh.vertices);
+        free(mesh.indices);
+        free(order);
+        return AGFX_BUFFER_ERROR;
+    }
+
+    for (size_t i = 0; i < triangles_count; ++i)
+    {
+        order[i] = (uint32_t)i;
+    }
+    for (size_t i = triangles_count - 1; i > 0; --i)
+    {
+        uint32_t j = random_uint((uint32_t)i + 1);
+        uint32_t swapped = order[i];
+        order[i] = order[j];
+        order[j] = swapped;
+    }
+
+    for (size_t i = 0; i < triangles_count; ++i)
+    {
+        uint32_t quad = order[i] / 2;
+        uint32_t x = quad % grid_size;
+        uint32_t y = quad / grid_size;
+        agfx_vertex_t corners[4] = {grid_vertex(x, y, grid_size), grid_vertex(x + 1, y, grid_size), grid_vertex(x + 1, y + 1, grid_size), grid_vertex(x, y + 1, grid_size)};
+        uint32_t first_corner = order[i] % 2 == 0 ? 0 : 2;
+        mesh.vertices[i * 3] = corners[first_corner];
+        mesh.vertices[i * 3 + 1] = corners[first_corner + 1];
+        mesh.vertices[i * 3 + 2] = corners[(first_corner + 2) % 4];
+        for (uint32_t corner = 0; corner < 3; ++corner)
+        {
+            mesh.indices[i * 3 + corner] = (uint32_t)(i * 3 + corner);
+        }
+    }
+
+    free(order);
+    *out_mesh = mesh;
+    return AGFX_SUCCESS;
+}
+
+static void print_cache_stats(const char* label, const agfx_vertex_cache_stats_t* stats)
+{
+    printf("%s: %zu vertices, acmr %.3f, atvr %.3f\n", label, stats->vertices_count, agfx_vertex_cache_acmr(stats), agfx_vertex_cache_atvr(stats));
+}
+
+// the optional argument is the worker count, 0 or nothing picks one per core
+int main(int argc, char** argv)
+{
+    uint32_t threads_count = argc > 1 ? (uint32_t)atoi(argv[1]) : 0;
+
+    agfx_job_system_t job_system;
+    if (AGFX_SUCCESS != agfx_create_job_system(threads_count, &job_system))
+    {
+        printf("failed to create the job system\n");
+        return 1;
+    }
+
+    // the stages one by one on a single large mesh
+    agfx_mesh_t mesh;
+    if (AGFX_SUCCESS != create_grid_mesh(BENCH_GRID_SIZE, &mesh))
+    {
+        printf("failed to create the mesh\n");
+        return 1;
+    }
+    size_t triangles_count = mesh.indices_count / 3;
+    uint32_t* cluster_starts = malloc(sizeof(uint32_t) * triangles_count);
+    if (NULL == cluster_starts)
+    {
+        printf("failed to allocate the clusters\n");
+        return 1;
+    }
+
+    agfx_vertex_cache_stats_t before = agfx_analyze_vertex_cache(mesh.indices, mesh.indices_count, mesh.vertices_count);
+
+    uint64_t weld_start = SDL_GetPerformanceCounter();
+    agfx_result_t result = agfx_weld_vertices(mesh.vertices, mesh.vertices_count, mesh.indices, mesh.indices_count, &mesh.vertices_count);
+    double weld_ms = elapsed_ms(weld_start, SDL_GetPerformanceCounter());
+    agfx_vertex_cache_stats_t welded = agfx_analyze_vertex_cache(mesh.indices, mesh.indices_count, mesh.vertices_count);
+
+    size_t clusters_count = 0;
+    uint64_t cache_start = SDL_GetPerformanceCounter();
+    if (AGFX_SUCCESS == result) result = agfx_optimize_vertex_cache(mesh.indices, mesh.indices_count, mesh.vertices_count, cluster_starts, &clusters_count);
+    double cache_ms = elapsed_ms(cache_start, SDL_GetPerformanceCounter());
+    agfx_vertex_cache_stats_t cache_ordered = agfx_analyze_vertex_cache(mesh.indices, mesh.indices_count, mesh.vertices_count);
+
+    uint64_t overdraw_start = SDL_GetPerformanceCounter();
+    if (AGFX_SUCCESS == result) result = agfx_optimize_overdraw(mesh.vertices, mesh.indices, mesh.indices_count, mesh.vertices_count, cluster_starts, clusters_count);
+    double overdraw_ms = elapsed_ms(overdraw_start, SDL_GetPerformanceCounter());
+    agfx_vertex_cache_stats_t overdraw_ordered = agfx_analyze_vertex_cache(mesh.indices, mesh.indices_count, mesh.vertices_count);
+
+    uint64_t fetch_start = SDL_GetPerformanceCounter();
+    if (AGFX_SUCCESS == result) result = agfx_optimize_vertex_fetch(mesh.vertices, mesh.vertices_count, mesh.indices, mesh.indices_count, &mesh.vertices_count);
+    double fetch_ms = elapsed_ms(fetch_start, SDL_GetPerformanceCounter());
+    agfx_vertex_cache_stats_t after = agfx_analyze_vertex_cache(mesh.indices, mesh.indices_count, mesh.vertices_count);
+
+    if (AGFX_SUCCESS != result)
+    {
+        printf("optimization failed\n");
+        return 1;
+    }
+
+    double total_ms = weld_ms + cache_ms + overdraw_ms + fetch_ms;
+    printf("%zu triangles, cache size %d\n", triangles_count, AGFX_VERTEX_CACHE_SIZE);
+    print_cache_stats("exported", &before);
+    print_cache_stats("welded", &welded);
+    print_cache_stats("cache order", &cache_ordered);
+    print_cache_stats("overdraw order", &overdraw_ordered);
+    print_cache_stats("fetch order", &after);
+    printf("weld %.3f ms, tipsify %.3f ms (%zu clusters), overdraw %.3f ms, fetch %.3f ms, %.2f Mtriangles/s\n",
+        weld_ms, cache_ms, clusters_count, overdraw_ms, fetch_ms, (double)triangles_count / (total_ms * 1000.0));
+
+    uint32_t welded_correctly = mesh.vertices_count == (size_t)(BENCH_GRID_SIZE + 1) * (BENCH_GRID_SIZE + 1);
+    uint32_t improved = agfx_vertex_cache_acmr(&after) < agfx_vertex_cache_acmr(&welded);
+
+    // the full pipeline over many meshes, the way load_model runs it
+    agfx_mesh_t* meshes = malloc(sizeof(agfx_mesh_t) * BENCH_MESHES_COUNT);
+    if (NULL == meshes)
+    {
+        printf("failed to allocate the meshes\n");
+        return 1;
+    }
+    for (int i = 0; i < BENCH_MESHES_COUNT; ++i)
+    {
+        if (AGFX_SUCCESS != create_grid_mesh(BENCH_SMALL_GRID_SIZE, &meshes[i]))
+        {
+            printf("failed to create the meshes\n");
+            return 1;
+        }
+    }
+
+    agfx_mesh_optimizer_stats_t stats;
+    agfx_optimize_meshes(&job_system, meshes, BENCH_MESHES_COUNT, &stats);
+    printf("%d meshes on %u workers: %u optimized in %.3f ms, acmr %.3f -> %.3f, atvr %.3f -> %.3f\n",
+        BENCH_MESHES_COUNT, job_system.threads_count, stats.optimized_meshes_count, stats.optimize_ms,
+        agfx_vertex_cache_acmr(&stats.before), agfx_vertex_cache_acmr(&stats.after), agfx_vertex_cache_atvr(&stats.before), agfx_vertex_cache_atvr(&stats.after));
+
+    for (int i = 0; i < BENCH_MESHES_COUNT; ++i)
+    {
+        free(meshes[i].vertices);
+        free(meshes[i].indices);
+    }
+    free(meshes);
+    free(cluster_starts);
+    free(mesh.vertices);
+    free(mesh.indices);
+    agfx_free_job_system(&job_system);
+
+    return !welded_correctly || !improved || stats.optimized_meshes_count != BENCH_MESHES_COUNT;
+}
\ No newline at end of file
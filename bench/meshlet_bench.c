@@ -0,0 +1,316 @@
+#define SDL_MAIN_HANDLED
+#include "meshlet.h"
+#include "mesh_lod.h"
+#include "mesh_optimizer.h"
+
+#include <stdio.h>
+
+// a closed bumpy sphere, welded like a loaded mesh, looked at from a ring of cameras around it
+#define BENCH_SPHERE_RINGS 256
+#define BENCH_SPHERE_SEGMENTS 512
+#define BENCH_MESHES_COUNT 16
+#define BENCH_SMALL_SPHERE_RINGS 48
+#define BENCH_SMALL_SPHERE_SEGMENTS 96
+#define BENCH_CAMERAS_COUNT 16
+#define BENCH_CAMERA_DISTANCE 3.0f
+
+static double elapsed_ms(uint64_t start, uint64_t end)
+{
+    return (double)(end - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+// counter clockwise seen from outside, the same front face a gltf file has
+static agfx_result_t create_sphere_mesh(uint32_t rings, uint32_t segments, agfx_mesh_t* out_mesh)
+{
+    agfx_mesh_t mesh = {0};
+    mesh.vertices_count = (size_t)(rings - 1) * segments + 2;
+    mesh.indices_count = (size_t)segments * (rings - 1) * 6;
+    mesh.vertices = malloc(sizeof(agfx_vertex_t) * mesh.vertices_count);
+    mesh.indices = malloc(sizeof(uint32_t) * mesh.indices_count);
+    if (NULL == mesh.vertices || NULL == mesh.indices)
+    {
+        free(mesh.vertices);
+        free(mesh.indices);
+        return AGFX_BUFFER_ERROR;
+    }
+
+    uint32_t south_pole = (uint32_t)mesh.vertices_count - 2;
+    uint32_t north_pole = (uint32_t)mesh.vertices_count - 1;
+    for (uint32_t ring = 1; ring < rings; ++ring)
+    {
+        float theta = (float)M_PI * (float)ring / (float)rings;
+        for (uint32_t segment = 0; segment < segments; ++segment)
+        {
+            float phi = 2.0f * (float)M_PI * (float)segment / (float)segments;
+            float radius = 1.0f + 0.02f * sinf(theta * 9.0f) * cosf(phi * 7.0f);
+            mesh.vertices[(ring - 1) * segments + segment] = (agfx_vertex_t) {
+                .position = {radius * sinf(theta) * cosf(phi), -radius * cosf(theta), radius * sinf(theta) * sinf(phi)},
+                .color = {1.0f, 1.0f, 1.0f, 1.0f},
+                .texture_coordinate = {(float)segment / (float)segments, (float)ring / (float)rings}
+            };
+        }
+    }
+    mesh.vertices[south_pole] = (agfx_vertex_t) {.position = {0.0f, -1.0f, 0.0f}, .color = {1.0f, 1.0f, 1.0f, 1.0f}};
+    mesh.vertices[north_pole] = (agfx_vertex_t) {.position = {0.0f, 1.0f, 0.0f}, .color = {1.0f, 1.0f, 1.0f, 1.0f}};
+
+    size_t index = 0;
+    for (uint32_t segment = 0; segment < segments; ++segment)
+    {
+        uint32_t next = (segment + 1) % segments;
+        mesh.indices[index++] = south_pole;
+        mesh.indices[index++] = segment;
+        mesh.indices[index++] = next;
+        mesh.indices[index++] = north_pole;
+        mesh.indices[index++] = (rings - 2) * segments + next;
+        mesh.indices[index++] = (rings - 2) * segments + segment;
+    }
+    for (uint32_t ring = 0; ring + 2 < rings; ++ring)
+    {
+        for (uint32_t segment = 0; segment < segments; ++segment)
+        {
+            uint32_t next = (segment + 1) % segments;
+            uint32_t a = ring * segments + segment;
+            uint32_t b = ring * segments + next;
+            uint32_t c = (ring + 1) * segments + segment;
+            uint32_t d = (ring + 1) * segments + next;
+            mesh.indices[index++] = a;
+            mesh.indices[index++] = c;
+            mesh.indices[index++] = b;
+            mesh.indices[index++] = b;
+            mesh.indices[index++] = c;
+            mesh.indices[index++] = d;
+        }
+    }
+
+    mesh.bounding_sphere = (agfx_vector4_t) {0.0f, 0.0f, 0.0f, 1.02f};
+    *out_mesh = mesh;
+    return AGFX_SUCCESS;
+}
+
+static int compare_triangles(const void* a, const void* b)
+{
+    const uint32_t* triangle_a = (const uint32_t*)a;
+    const uint32_t* triangle_b = (const uint32_t*)b;
+    for (uint32_t corner = 0; corner < 3; ++corner)
+    {
+        if (triangle_a[corner] != triangle_b[corner]) return triangle_a[corner] < triangle_b[corner] ? -1 : 1;
+    }
+    return 0;
+}
+
+// the meshlets of a level cover exactly the triangles it had, and the packed local triangles name the same vertices
+static uint32_t check_level(const agfx_mesh_t* mesh, const uint32_t* original, const uint32_t* indices, size_t indices_count, const agfx_mesh_lod_t* lod)
+{
+    size_t covered_count = 0;
+    for (uint32_t i = 0; i < lod->meshlets_count; ++i)
+    {
+        const agfx_meshlet_t* meshlet = &mesh->meshlets[lod->first_meshlet + i];
+        if (meshlet->vertices_count > AGFX_MESHLET_MAX_VERTICES || meshlet->triangles_count > AGFX_MESHLET_MAX_TRIANGLES) return 0;
+        if (meshlet->first_index != covered_count) return 0;
+
+        for (uint32_t triangle = 0; triangle < meshlet->triangles_count; ++triangle)
+        {
+            uint32_t packed = mesh->meshlet_triangles[meshlet->first_triangle + triangle];
+            for (uint32_t corner = 0; corner < 3; ++corner)
+            {
+                uint32_t slot = (packed >> (corner * 8)) & 0xff;
+                if (slot >= meshlet->vertices_count) return 0;
+                if (mesh->meshlet_vertices[meshlet->first_vertex + slot] != indices[meshlet->first_index + triangle * 3 + corner]) return 0;
+            }
+        }
+        covered_count += meshlet->triangles_count * 3;
+    }
+    if (covered_count != indices_count) return 0;
+
+    uint32_t* sorted_original = malloc(sizeof(uint32_t) * indices_count);
+    uint32_t* sorted = malloc(sizeof(uint32_t) * indices_count);
+    if (NULL == sorted_original || NULL == sorted)
+    {
+        free(sorted_original);
+        free(sorted);
+        return 0;
+    }
+    memcpy(sorted_original, original, sizeof(uint32_t) * indices_count);
+    memcpy(sorted, indices, sizeof(uint32_t) * indices_count);
+    qsort(sorted_original, indices_count / 3, sizeof(uint32_t) * 3, compare_triangles);
+    qsort(sorted, indices_count / 3, sizeof(uint32_t) * 3, compare_triangles);
+    uint32_t same = 0 == memcmp(sorted_original, sorted, sizeof(uint32_t) * indices_count);
+    free(sorted_original);
+    free(sorted);
+    return same;
+}
+
+// the optional argument is the worker count, 0 or nothing picks one per core
+int main(int argc, char** argv)
+{
+    uint32_t threads_count = argc > 1 ? (uint32_t)atoi(argv[1]) : 0;
+
+    agfx_job_system_t job_system;
+    if (AGFX_SUCCESS != agfx_create_job_system(threads_count, &job_system))
+    {
+        printf("failed to create the job system\n");
+        return 1;
+    }
+
+    // one large mesh, optimized and with its chain, the way load_model leaves it before the geometry buffer
+    agfx_mesh_t mesh;
+    if (AGFX_SUCCESS != create_sphere_mesh(BENCH_SPHERE_RINGS, BENCH_SPHERE_SEGMENTS, &mesh))
+    {
+        printf("failed to create the mesh\n");
+        return 1;
+    }
+    agfx_vertex_cache_stats_t before_stats;
+    agfx_vertex_cache_stats_t optimized_stats;
+    if (AGFX_SUCCESS != agfx_optimize_mesh(&mesh, &before_stats, &optimized_stats))
+    {
+        printf("mesh optimization failed\n");
+        return 1;
+    }
+    if (AGFX_SUCCESS != agfx_build_mesh_lods(&mesh))
+    {
+        printf("lod generation failed\n");
+        return 1;
+    }
+
+    size_t all_indices_count = mesh.indices_count + mesh.lod_indices_count;
+    uint32_t* original = malloc(sizeof(uint32_t) * all_indices_count);
+    if (NULL == original)
+    {
+        printf("failed to allocate the copy\n");
+        return 1;
+    }
+    memcpy(original, mesh.indices, sizeof(uint32_t) * mesh.indices_count);
+    memcpy(&original[mesh.indices_count], mesh.lod_indices, sizeof(uint32_t) * mesh.lod_indices_count);
+
+    uint64_t build_start = SDL_GetPerformanceCounter();
+    agfx_result_t result = agfx_build_mesh_meshlets(&mesh);
+    double build_ms = elapsed_ms(build_start, SDL_GetPerformanceCounter());
+    if (AGFX_SUCCESS != result)
+    {
+        printf("meshlet generation failed\n");
+        return 1;
+    }
+
+    uint32_t valid = 1;
+    for (uint32_t lod = 0; lod < mesh.lods_count; ++lod)
+    {
+        const uint32_t* level_original = 0 == lod ? original : &original[mesh.indices_count + mesh.lods[lod].first_index];
+        const uint32_t* level_indices = 0 == lod ? mesh.indices : &mesh.lod_indices[mesh.lods[lod].first_index];
+        size_t level_indices_count = 0 == lod ? mesh.indices_count : mesh.lods[lod].indices_count;
+        uint32_t level_valid = check_level(&mesh, level_original, level_indices, level_indices_count, &mesh.lods[lod]);
+        printf("lod %u: %zu triangles in %u meshlets, %s\n", lod, level_indices_count / 3, mesh.lods[lod].meshlets_count, level_valid ? "valid" : "INVALID");
+        valid &= level_valid;
+    }
+
+    // the meshlets are ranges of the optimized order, which has to come out of the build as it went in
+    agfx_vertex_cache_stats_t meshlet_stats = agfx_analyze_vertex_cache(mesh.indices, mesh.indices_count, mesh.vertices_count);
+    uint32_t order_kept = 0 == memcmp(original, mesh.indices, sizeof(uint32_t) * mesh.indices_count);
+    printf("acmr %.3f before optimizing, %.3f optimized, %.3f after meshlets, order %s\n",
+        agfx_vertex_cache_acmr(&before_stats), agfx_vertex_cache_acmr(&optimized_stats), agfx_vertex_cache_acmr(&meshlet_stats), order_kept ? "kept" : "CHANGED");
+    valid &= order_kept;
+
+    const agfx_mesh_lod_t* full = &mesh.lods[0];
+    uint64_t full_vertices_count = 0;
+    uint64_t full_triangles_count = 0;
+    uint32_t cones_count = 0;
+    for (uint32_t i = 0; i < full->meshlets_count; ++i)
+    {
+        const agfx_meshlet_t* meshlet = &mesh.meshlets[full->first_meshlet + i];
+        full_vertices_count += meshlet->vertices_count;
+        full_triangles_count += meshlet->triangles_count;
+        cones_count += meshlet->cone.w < 1.0f;
+    }
+    printf("%zu triangles, %zu vertices: %u meshlets in %.3f ms, %.1f of %d triangles and %.1f of %d vertices filled, %.3f vertices per triangle, %u with cones\n",
+        mesh.indices_count / 3, mesh.vertices_count, full->meshlets_count, build_ms,
+        (double)full_triangles_count / full->meshlets_count, AGFX_MESHLET_MAX_TRIANGLES, (double)full_vertices_count / full->meshlets_count, AGFX_MESHLET_MAX_VERTICES,
+        (double)full_vertices_count / (double)full_triangles_count, cones_count);
+
+    // back facing clusters from cameras around the equator, and a check that a culled cluster really had no front face
+    uint64_t tested_count = 0;
+    uint64_t culled_count = 0;
+    uint64_t culled_triangles_count = 0;
+    uint64_t back_triangles_count = 0;
+    uint32_t wrongly_culled_count = 0;
+    uint64_t cone_start = SDL_GetPerformanceCounter();
+    for (uint32_t camera = 0; camera < BENCH_CAMERAS_COUNT; ++camera)
+    {
+        float angle = 2.0f * (float)M_PI * (float)camera / (float)BENCH_CAMERAS_COUNT;
+        agfx_vector3_t camera_position = {BENCH_CAMERA_DISTANCE * cosf(angle), 0.5f, BENCH_CAMERA_DISTANCE * sinf(angle)};
+        for (uint32_t i = 0; i < full->meshlets_count; ++i)
+        {
+            const agfx_meshlet_t* meshlet = &mesh.meshlets[full->first_meshlet + i];
+            tested_count++;
+            if (!agfx_meshlet_cone_culled(meshlet, camera_position)) continue;
+
+            culled_count++;
+            culled_triangles_count += meshlet->triangles_count;
+            for (uint32_t triangle = 0; triangle < meshlet->triangles_count; ++triangle)
+            {
+                const uint32_t* corners = &mesh.indices[meshlet->first_index + triangle * 3];
+                agfx_vector3_t p0 = mesh.vertices[corners[0]].position;
+                agfx_vector3_t normal = agfx_vector3_cross(agfx_vector3_subtract_vector3(mesh.vertices[corners[1]].position, p0), agfx_vector3_subtract_vector3(mesh.vertices[corners[2]].position, p0));
+                wrongly_culled_count += agfx_vector3_dot(normal, agfx_vector3_subtract_vector3(p0, camera_position)) < 0.0f;
+            }
+        }
+    }
+    double cone_ms = elapsed_ms(cone_start, SDL_GetPerformanceCounter());
+    for (uint32_t camera = 0; camera < BENCH_CAMERAS_COUNT; ++camera)
+    {
+        float angle = 2.0f * (float)M_PI * (float)camera / (float)BENCH_CAMERAS_COUNT;
+        agfx_vector3_t camera_position = {BENCH_CAMERA_DISTANCE * cosf(angle), 0.5f, BENCH_CAMERA_DISTANCE * sinf(angle)};
+        for (size_t triangle = 0; triangle < mesh.indices_count / 3; ++triangle)
+        {
+            const uint32_t* corners = &mesh.indices[triangle * 3];
+            agfx_vector3_t p0 = mesh.vertices[corners[0]].position;
+            agfx_vector3_t normal = agfx_vector3_cross(agfx_vector3_subtract_vector3(mesh.vertices[corners[1]].position, p0), agfx_vector3_subtract_vector3(mesh.vertices[corners[2]].position, p0));
+            back_triangles_count += agfx_vector3_dot(normal, agfx_vector3_subtract_vector3(p0, camera_position)) >= 0.0f;
+        }
+    }
+    printf("%d cameras: %.1f%% of meshlets and %.1f%% of triangles cone culled before rasterizing (%.1f%% are back facing), %u front faces lost, %.3f ms\n",
+        BENCH_CAMERAS_COUNT, 100.0 * (double)culled_count / (double)tested_count,
+        100.0 * (double)culled_triangles_count / (double)(full_triangles_count * BENCH_CAMERAS_COUNT),
+        100.0 * (double)back_triangles_count / (double)(mesh.indices_count / 3 * BENCH_CAMERAS_COUNT), wrongly_culled_count, cone_ms);
+
+    // many meshes the way load_model builds them
+    agfx_mesh_t* meshes = malloc(sizeof(agfx_mesh_t) * BENCH_MESHES_COUNT);
+    if (NULL == meshes)
+    {
+        printf("failed to allocate the meshes\n");
+        return 1;
+    }
+    for (int i = 0; i < BENCH_MESHES_COUNT; ++i)
+    {
+        if (AGFX_SUCCESS != create_sphere_mesh(BENCH_SMALL_SPHERE_RINGS, BENCH_SMALL_SPHERE_SEGMENTS, &meshes[i]))
+        {
+            printf("failed to create the meshes\n");
+            return 1;
+        }
+    }
+
+    agfx_mesh_optimizer_stats_t optimizer_stats;
+    agfx_optimize_meshes(&job_system, meshes, BENCH_MESHES_COUNT, &optimizer_stats);
+    agfx_meshlet_stats_t stats;
+    agfx_build_meshlets(&job_system, meshes, BENCH_MESHES_COUNT, &stats);
+    printf("%d meshes on %u workers: %u built, %u meshlets, %.3f vertices per triangle in %.3f ms\n",
+        BENCH_MESHES_COUNT, job_system.threads_count, stats.meshes_count, stats.meshlets_count, (double)stats.vertices_count / (double)stats.triangles_count, stats.build_ms);
+
+    for (int i = 0; i < BENCH_MESHES_COUNT; ++i)
+    {
+        free(meshes[i].vertices);
+        free(meshes[i].indices);
+        free(meshes[i].meshlets);
+        free(meshes[i].meshlet_vertices);
+        free(meshes[i].meshlet_triangles);
+    }
+    free(meshes);
+    free(original);
+    free(mesh.vertices);
+    free(mesh.indices);
+    free(mesh.lod_indices);
+    free(mesh.meshlets);
+    free(mesh.meshlet_vertices);
+    free(mesh.meshlet_triangles);
+    agfx_free_job_system(&job_system);
+
+    return !valid || wrongly_culled_count > 0 || culled_triangles_count == 0 || stats.meshes_count != BENCH_MESHES_COUNT;
+}
\ No newline at end of file
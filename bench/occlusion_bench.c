@@ -0,0 +1,158 @@
+#define SDL_MAIN_HANDLED
+#include "software_occlusion.h"
+
+#include <stdio.h>
+
+#define BENCH_OBJECTS_COUNT 20000
+#define BENCH_RUNS 200
+#define BENCH_WALL_DISTANCE 10.0f
+#define BENCH_WALL_HALF_WIDTH 6.0f
+#define BENCH_WALL_HALF_HEIGHT 4.0f
+#define BENCH_BOX_HALF_SIZE 0.2f
+// wall tiles per side, enough triangles to keep the rasterizer busy
+#define BENCH_WALL_SEGMENTS 64
+
+static uint32_t random_state = 0x9e3779b9u;
+
+static float random_float(float min, float max)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return min + (max - min) * (float)(random_state & 0xffffff) / (float)0xffffff;
+}
+
+static double elapsed_ms(uint64_t start, uint64_t end)
+{
+    return (double)(end - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+// a camera at the origin looking down +x at a wall, boxes scattered in front of, behind and around it.
+// a box with any part in front of the wall must never be culled, boxes well inside the wall's shadow should be
+int main(int argc, char** argv)
+{
+    uint32_t threads_count = argc > 1 ? (uint32_t)atoi(argv[1]) : 0;
+
+    agfx_job_system_t job_system;
+    agfx_software_occlusion_t software_occlusion;
+    if (AGFX_SUCCESS != agfx_create_job_system(threads_count, &job_system)
+        || AGFX_SUCCESS != agfx_create_software_occlusion(AGFX_OCCLUSION_WIDTH, AGFX_OCCLUSION_HEIGHT, AGFX_OCCLUSION_MAX_TRIANGLES, BENCH_OBJECTS_COUNT, &software_occlusion))
+    {
+        printf("failed to create the job system or the occlusion buffer\n");
+        return 1;
+    }
+
+    size_t wall_positions_count = (BENCH_WALL_SEGMENTS + 1) * (BENCH_WALL_SEGMENTS + 1);
+    size_t wall_indices_count = BENCH_WALL_SEGMENTS * BENCH_WALL_SEGMENTS * 6;
+    agfx_vector3_t* wall_positions = malloc(sizeof(agfx_vector3_t) * wall_positions_count);
+    uint32_t* wall_indices = malloc(sizeof(uint32_t) * wall_indices_count);
+    agfx_aabb_t* bounds = malloc(sizeof(agfx_aabb_t) * BENCH_OBJECTS_COUNT);
+    uint32_t* indices = malloc(sizeof(uint32_t) * BENCH_OBJECTS_COUNT);
+    if (NULL == wall_positions || NULL == wall_indices || NULL == bounds || NULL == indices)
+    {
+        printf("failed to allocate the scene\n");
+        return 1;
+    }
+
+    for (uint32_t row = 0; row <= BENCH_WALL_SEGMENTS; ++row)
+    {
+        for (uint32_t column = 0; column <= BENCH_WALL_SEGMENTS; ++column)
+        {
+            wall_positions[row * (BENCH_WALL_SEGMENTS + 1) + column] = (agfx_vector3_t) {
+                BENCH_WALL_DISTANCE,
+                -BENCH_WALL_HALF_WIDTH + 2.0f * BENCH_WALL_HALF_WIDTH * column / BENCH_WALL_SEGMENTS,
+                -BENCH_WALL_HALF_HEIGHT + 2.0f * BENCH_WALL_HALF_HEIGHT * row / BENCH_WALL_SEGMENTS
+            };
+        }
+    }
+    size_t wall_index = 0;
+    for (uint32_t row = 0; row < BENCH_WALL_SEGMENTS; ++row)
+    {
+        for (uint32_t column = 0; column < BENCH_WALL_SEGMENTS; ++column)
+        {
+            uint32_t corner = row * (BENCH_WALL_SEGMENTS + 1) + column;
+            uint32_t quad[6] = {corner, corner + 1, corner + BENCH_WALL_SEGMENTS + 2, corner, corner + BENCH_WALL_SEGMENTS + 2, corner + BENCH_WALL_SEGMENTS + 1};
+            for (int i = 0; i < 6; ++i)
+            {
+                wall_indices[wall_index++] = quad[i];
+            }
+        }
+    }
+
+    for (size_t i = 0; i < BENCH_OBJECTS_COUNT; ++i)
+    {
+        agfx_vector3_t center = {random_float(2.0f, 40.0f), random_float(-10.0f, 10.0f), random_float(-6.0f, 6.0f)};
+        bounds[i] = (agfx_aabb_t) {
+            .min = {center.x - BENCH_BOX_HALF_SIZE, center.y - BENCH_BOX_HALF_SIZE, center.z - BENCH_BOX_HALF_SIZE},
+            .max = {center.x + BENCH_BOX_HALF_SIZE, center.y + BENCH_BOX_HALF_SIZE, center.z + BENCH_BOX_HALF_SIZE}
+        };
+    }
+
+    agfx_mat4x4_t view_projection = agfx_mat4x4_multiplied_by_mat4x4(
+        agfx_mat4x4_perspective(60.0f * M_PI / 180.0f, 16.0f / 9.0f, 0.1f, 100.0f),
+        agfx_mat4x4_look_at((agfx_vector3_t) {0.0f, 0.0f, 0.0f}, (agfx_vector3_t) {1.0f, 0.0f, 0.0f}, (agfx_vector3_t) {0.0f, 0.0f, 1.0f})
+    );
+
+    double rasterize_ms = 1e9;
+    double filter_ms = 1e9;
+    size_t visible_count = 0;
+    for (int run = 0; run < BENCH_RUNS; ++run)
+    {
+        uint64_t start = SDL_GetPerformanceCounter();
+        agfx_software_occlusion_clear(&software_occlusion);
+        agfx_software_occlusion_add_triangles(&software_occlusion, wall_positions, wall_indices, wall_indices_count, view_projection);
+        agfx_software_occlusion_rasterize(&software_occlusion, &job_system);
+        uint64_t middle = SDL_GetPerformanceCounter();
+
+        for (size_t i = 0; i < BENCH_OBJECTS_COUNT; ++i)
+        {
+            indices[i] = (uint32_t)i;
+        }
+        visible_count = agfx_software_occlusion_filter(&software_occlusion, &job_system, view_projection, bounds, indices, BENCH_OBJECTS_COUNT);
+        uint64_t end = SDL_GetPerformanceCounter();
+
+        rasterize_ms = elapsed_ms(start, middle) < rasterize_ms ? elapsed_ms(start, middle) : rasterize_ms;
+        filter_ms = elapsed_ms(middle, end) < filter_ms ? elapsed_ms(middle, end) : filter_ms;
+    }
+
+    uint8_t* visible = calloc(BENCH_OBJECTS_COUNT, sizeof(uint8_t));
+    for (size_t i = 0; i < visible_count; ++i)
+    {
+        visible[indices[i]] = 1;
+    }
+
+    // a box is in the wall's shadow when its whole silhouette, seen from the origin, lies inside the wall with a pixel row or two to spare
+    size_t wrongly_culled = 0, shadowed = 0, shadowed_culled = 0;
+    float margin = 0.9f;
+    for (size_t i = 0; i < BENCH_OBJECTS_COUNT; ++i)
+    {
+        if (bounds[i].min.x < BENCH_WALL_DISTANCE && !visible[i])
+        {
+            wrongly_culled++;
+        }
+
+        float scale = BENCH_WALL_DISTANCE / bounds[i].min.x;
+        int behind = bounds[i].min.x > BENCH_WALL_DISTANCE;
+        int inside = fabsf(bounds[i].min.y * scale) < BENCH_WALL_HALF_WIDTH * margin && fabsf(bounds[i].max.y * scale) < BENCH_WALL_HALF_WIDTH * margin
+            && fabsf(bounds[i].min.z * scale) < BENCH_WALL_HALF_HEIGHT * margin && fabsf(bounds[i].max.z * scale) < BENCH_WALL_HALF_HEIGHT * margin;
+        if (behind && inside)
+        {
+            shadowed++;
+            shadowed_culled += !visible[i];
+        }
+    }
+
+    printf("%ux%u buffer, %zu wall triangles, %u workers\n", software_occlusion.width, software_occlusion.height, software_occlusion.triangles_count, job_system.threads_count);
+    printf("rasterize best %.3f ms, test %d boxes best %.3f ms\n", rasterize_ms, BENCH_OBJECTS_COUNT, filter_ms);
+    printf("%zu visible, %zu culled, %zu of %zu shadowed boxes culled, %zu wrongly culled\n", visible_count, software_occlusion.culled_count, shadowed_culled, shadowed, wrongly_culled);
+
+    free(visible);
+    free(indices);
+    free(bounds);
+    free(wall_indices);
+    free(wall_positions);
+    agfx_free_software_occlusion(&software_occlusion);
+    agfx_free_job_system(&job_system);
+
+    return wrongly_culled > 0 || shadowed_culled < shadowed;
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+#define SDL_MAIN_HANDLED
+#include "engine.h"
+
+#include <stdio.h>
+
+#define BENCH_ALPHA_MODES_COUNT 3
+#define BENCH_SIDED_MODES_COUNT 2
+
+static double elapsed_ms(uint64_t start, uint64_t end)
+{
+    return (double)(end - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+// the renderer is up before its pipelines are, the second time includes waiting for every queued compile and optimized relink
+static agfx_result_t timed_initialize(agfx_engine_t* engine, double* out_startup_ms, uint32_t* out_warm, double* out_ready_ms)
+{
+    uint64_t start = SDL_GetPerformanceCounter();
+    agfx_result_t result = agfx_initialize_engine(engine);
+    if (AGFX_SUCCESS != result) return result;
+    uint64_t end = SDL_GetPerformanceCounter();
+    agfx_pipeline_state_cache_wait(&engine->renderer);
+    uint64_t ready = SDL_GetPerformanceCounter();
+    *out_warm = engine->context.pipeline_cache_warm;
+    *out_ready_ms = elapsed_ms(start, ready);
+    *out_startup_ms = elapsed_ms(start, end);
+    return AGFX_SUCCESS;
+}
+
+// every scene pipeline a material can ask for, built into a scratch state cache so the renderer's own stays untouched
+static double timed_prepare_all(agfx_renderer_t* renderer, uint32_t* out_count)
+{
+    const uint32_t alpha_modes[BENCH_ALPHA_MODES_COUNT] = {0, AGFX_PIPELINE_ALPHA_TEST, AGFX_PIPELINE_ALPHA_BLEND | AGFX_PIPELINE_DEPTH_READ_ONLY};
+    const uint32_t sided_modes[BENCH_SIDED_MODES_COUNT] = {0, AGFX_PIPELINE_DOUBLE_SIDED};
+    agfx_pipeline_state_cache_t* renderer_states = renderer->pipeline_states;
+    double ms = -1.0;
+
+    if (AGFX_SUCCESS != agfx_create_pipeline_state_cache(renderer)) goto restore;
+
+    uint64_t start = SDL_GetPerformanceCounter();
+    for (uint32_t alpha = 0; alpha < BENCH_ALPHA_MODES_COUNT; ++alpha)
+    {
+        for (uint32_t sided = 0; sided < BENCH_SIDED_MODES_COUNT; ++sided)
+        {
+            agfx_pipeline_state_cache_prepare(renderer, alpha_modes[alpha] | sided_modes[sided]);
+        }
+    }
+    agfx_pipeline_state_cache_wait(renderer);
+    uint64_t end = SDL_GetPerformanceCounter();
+
+    ms = elapsed_ms(start, end);
+    *out_count = renderer->pipeline_states->count;
+    agfx_free_pipeline_state_cache(renderer);
+
+restore:
+    renderer->pipeline_states = renderer_states;
+    return ms;
+}
+
+// the driver may keep a disk cache of its own, which makes the cold numbers look warmer than a first install really is
+int main(int argc, char** argv)
+{
+    agfx_engine_t engine;
+    uint32_t cold_warm_flag = 0;
+    uint32_t warm_warm_flag = 0;
+    uint32_t pipelines_count = 0;
+    double cold_startup_ms = 0.0;
+    double warm_startup_ms = 0.0;
+    double cold_ready_ms = 0.0;
+    double warm_ready_ms = 0.0;
+
+    remove(AGFX_PIPELINE_CACHE_PATH);
+
+    agfx_result_t result = timed_initialize(&engine, &cold_startup_ms, &cold_warm_flag, &cold_ready_ms);
+    if (AGFX_SUCCESS != result)
+    {
+        printf("could not create the engine: %d\n", result);
+        return 1;
+    }
+    agfx_free_engine(&engine);
+
+    result = timed_initialize(&engine, &warm_startup_ms, &warm_warm_flag, &warm_ready_ms);
+    if (AGFX_SUCCESS != result)
+    {
+        printf("could not create the engine: %d\n", result);
+        return 1;
+    }
+
+    // an empty cache first, then the same one again now that it holds every variant
+    VkPipelineCache loaded_cache = engine.context.pipeline_cache;
+    VkPipelineCacheCreateInfo pipeline_cache_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO
+    };
+    if (VK_SUCCESS != vkCreatePipelineCache(engine.context.device, &pipeline_cache_create_info, NULL, &engine.context.pipeline_cache))
+    {
+        printf("failed to create a scratch pipeline cache\n");
+        engine.context.pipeline_cache = loaded_cache;
+        agfx_free_engine(&engine);
+        return 1;
+    }
+
+    double cold_pipelines_ms = timed_prepare_all(&engine.renderer, &pipelines_count);
+    double warm_pipelines_ms = timed_prepare_all(&engine.renderer, &pipelines_count);
+
+    size_t cache_size = 0;
+    vkGetPipelineCacheData(engine.context.device, loaded_cache, &cache_size, NULL);
+
+    // the flag lives in the context, which is gone once the engine is freed
+    uint32_t graphics_pipeline_library_supported = engine.context.graphics_pipeline_library_supported;
+    vkDestroyPipelineCache(engine.context.device, engine.context.pipeline_cache, NULL);
+    engine.context.pipeline_cache = loaded_cache;
+    agfx_free_engine(&engine);
+
+    printf("startup cold: %.2f ms, pipelines ready at %.2f ms (cache loaded: %u)\n", cold_startup_ms, cold_ready_ms, cold_warm_flag);
+    printf("startup warm: %.2f ms, pipelines ready at %.2f ms (cache loaded: %u)\n", warm_startup_ms, warm_ready_ms, warm_warm_flag);
+    printf("%u scene pipelines cold: %.2f ms, warm: %.2f ms\n", pipelines_count, cold_pipelines_ms, warm_pipelines_ms);
+    printf("cache file: %zu bytes of driver data\n", cache_size);
+    printf("graphics pipeline libraries: %u\n", graphics_pipeline_library_supported);
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,173 @@
+#define SDL_MAIN_HANDLED
+#include "engine.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_SCENE_PATH "./recording_bench.glb"
+// quads along each side of the grid, every one is a primitive of its own and so a draw of its own in the render queue
+#define BENCH_GRID_SIZE 64
+#define BENCH_QUADS_COUNT (BENCH_GRID_SIZE * BENCH_GRID_SIZE)
+#define BENCH_GRID_HALF_EXTENT 1.0f
+#define BENCH_WARMUP_FRAMES (AGFX_MAX_FRAMES_IN_FLIGHT * 2)
+#define BENCH_FRAMES 200
+
+static int append(char* json, size_t capacity, size_t* length, const char* format, ...)
+{
+    va_list arguments;
+    va_start(arguments, format);
+    int written = vsnprintf(json + *length, capacity - *length, format, arguments);
+    va_end(arguments);
+    if (written < 0 || (size_t)written >= capacity - *length)
+    {
+        return 0;
+    }
+    *length += (size_t)written;
+    return 1;
+}
+
+// a grid of small quads square to the fixed camera around the point it looks at, one primitive each and no nodes
+static int write_grid_scene(const char* path)
+{
+    agfx_vector3_t eye = {2.0f, 2.0f, 3.0f};
+    agfx_vector3_t target = {0.0f, 0.0f, 1.9f};
+    agfx_vector3_t back = agfx_vector3_normalize(agfx_vector3_subtract_vector3(eye, target));
+    agfx_vector3_t right = agfx_vector3_normalize(agfx_vector3_cross((agfx_vector3_t) {0.0f, 0.0f, 1.0f}, back));
+    agfx_vector3_t up = agfx_vector3_cross(back, right);
+
+    const size_t positions_size = sizeof(float) * 12;
+    const size_t indices_size = sizeof(uint16_t) * 6;
+    size_t binary_length = BENCH_QUADS_COUNT * (positions_size + indices_size);
+    size_t json_capacity = 256 + BENCH_QUADS_COUNT * 384;
+    uint8_t* binary = malloc(binary_length);
+    char* json = malloc(json_capacity);
+    int result = 0;
+    if (NULL == binary || NULL == json) goto free_buffers;
+
+    float cell = 2.0f * BENCH_GRID_HALF_EXTENT / BENCH_GRID_SIZE;
+    float half_size = cell * 0.4f;
+    const uint16_t indices[6] = {0, 1, 2, 0, 2, 3};
+    for (uint32_t quad_index = 0; quad_index < BENCH_QUADS_COUNT; ++quad_index)
+    {
+        float x = -BENCH_GRID_HALF_EXTENT + cell * ((quad_index % BENCH_GRID_SIZE) + 0.5f);
+        float y = -BENCH_GRID_HALF_EXTENT + cell * ((quad_index / BENCH_GRID_SIZE) + 0.5f);
+        float* positions = (float*)(binary + quad_index * positions_size);
+        for (uint32_t corner = 0; corner < 4; ++corner)
+        {
+            float corner_x = x + ((0 == corner || 3 == corner) ? -half_size : half_size);
+            float corner_y = y + (corner < 2 ? -half_size : half_size);
+            positions[corner * 3 + 0] = target.x + right.x * corner_x + up.x * corner_y;
+            positions[corner * 3 + 1] = target.y + right.y * corner_x + up.y * corner_y;
+            positions[corner * 3 + 2] = target.z + right.z * corner_x + up.z * corner_y;
+        }
+        memcpy(binary + BENCH_QUADS_COUNT * positions_size + quad_index * indices_size, indices, indices_size);
+    }
+
+    size_t length = 0;
+    int ok = append(json, json_capacity, &length, "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"byteLength\":%zu}],\"bufferViews\":[", binary_length);
+    for (uint32_t quad_index = 0; ok && quad_index < BENCH_QUADS_COUNT; ++quad_index)
+    {
+        ok = append(json, json_capacity, &length, "%s{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu},{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}",
+            quad_index > 0 ? "," : "", quad_index * positions_size, positions_size, BENCH_QUADS_COUNT * positions_size + quad_index * indices_size, indices_size);
+    }
+    ok = ok && append(json, json_capacity, &length, "],\"accessors\":[");
+    for (uint32_t quad_index = 0; ok && quad_index < BENCH_QUADS_COUNT; ++quad_index)
+    {
+        ok = append(json, json_capacity, &length, "%s{\"bufferView\":%u,\"byteOffset\":0,\"componentType\":5126,\"count\":4,\"type\":\"VEC3\"},{\"bufferView\":%u,\"byteOffset\":0,\"componentType\":5123,\"count\":6,\"type\":\"SCALAR\"}",
+            quad_index > 0 ? "," : "", quad_index * 2, quad_index * 2 + 1);
+    }
+    ok = ok && append(json, json_capacity, &length, "],\"images\":[],\"samplers\":[],\"textures\":[],\"materials\":[{\"pbrMetallicRoughness\":{\"baseColorFactor\":[0.8,0.8,0.8,1.0]}}],\"meshes\":[{\"primitives\":[");
+    for (uint32_t quad_index = 0; ok && quad_index < BENCH_QUADS_COUNT; ++quad_index)
+    {
+        ok = append(json, json_capacity, &length, "%s{\"attributes\":{\"POSITION\":%u},\"indices\":%u,\"material\":0}", quad_index > 0 ? "," : "", quad_index * 2, quad_index * 2 + 1);
+    }
+    ok = ok && append(json, json_capacity, &length, "]}]}");
+    // the json chunk is padded to four bytes with spaces, the binary one already is a multiple of four
+    while (ok && length % 4 != 0)
+    {
+        ok = append(json, json_capacity, &length, " ");
+    }
+    if (!ok) goto free_buffers;
+
+    uint32_t header[3] = {AGLTF_MAGIC, 2, (uint32_t)(12 + 8 + length + 8 + binary_length)};
+    uint32_t json_chunk[2] = {(uint32_t)length, AGLTF_CHUNK_TYPE_JSON};
+    uint32_t binary_chunk[2] = {(uint32_t)binary_length, AGLTF_CHUNK_TYPE_BIN};
+    FILE* file = fopen(path, "wb");
+    if (NULL == file) goto free_buffers;
+    fwrite(header, sizeof(header), 1, file);
+    fwrite(json_chunk, sizeof(json_chunk), 1, file);
+    fwrite(json, 1, length, file);
+    fwrite(binary_chunk, sizeof(binary_chunk), 1, file);
+    fwrite(binary, 1, binary_length, file);
+    fclose(file);
+    result = 1;
+
+free_buffers:
+    free(json);
+    free(binary);
+    return result;
+}
+
+// the cpu render queue path repacks its draws every frame, so every frame is recorded from scratch and none is cached
+static void timed_recording(agfx_engine_t* engine, uint32_t parallel_recording)
+{
+    engine->state.parallel_recording = parallel_recording;
+    agfx_invalidate_commands(&engine->renderer);
+    for (uint32_t frame = 0; frame < BENCH_WARMUP_FRAMES; ++frame)
+    {
+        agfx_game_loop(engine);
+    }
+
+    agfx_command_recorder_t* command_recorder = &engine->renderer.command_recorder;
+    double total_ms = 0.0;
+    double max_ms = 0.0;
+    uint32_t secondaries_count = 0;
+    for (uint32_t frame = 0; frame < BENCH_FRAMES; ++frame)
+    {
+        agfx_game_loop(engine);
+        total_ms += command_recorder->record_ms;
+        max_ms = command_recorder->record_ms > max_ms ? command_recorder->record_ms : max_ms;
+        secondaries_count = command_recorder->secondaries_count;
+    }
+
+    agfx_render_queue_stats_t* queue_stats = &engine->renderer.render_queue.stats;
+    printf("parallel recording = %u: %.3f ms per frame, slowest %.3f ms, %u secondaries of %u workers, %u batches, %u draws\n", parallel_recording,
+        total_ms / BENCH_FRAMES, max_ms, secondaries_count, command_recorder->workers_count, queue_stats->batches_count, queue_stats->draws_count);
+}
+
+// the optional argument is a model to record instead of the generated grid
+int main(int argc, char** argv)
+{
+    const char* model_path = argc > 1 ? argv[1] : BENCH_SCENE_PATH;
+    if (argc <= 1 && !write_grid_scene(BENCH_SCENE_PATH))
+    {
+        printf("could not write %s\n", BENCH_SCENE_PATH);
+        return 1;
+    }
+
+    agfx_engine_t engine;
+    agfx_default_engine_state(&engine.state);
+    engine.state.model_path = model_path;
+    engine.state.gpu_culling = 0;
+    // merged quads would leave a handful of batches and nothing worth spreading over workers
+    engine.state.static_batching = 0;
+    if (AGFX_SUCCESS != agfx_create_engine(&engine))
+    {
+        printf("could not create the engine\n");
+        return 1;
+    }
+    agfx_pipeline_state_cache_wait(&engine.renderer);
+
+    printf("multi draw indirect = %u, draw indirect count = %u\n", engine.context.multi_draw_indirect_supported, engine.context.draw_indirect_count_supported);
+    timed_recording(&engine, 0);
+    timed_recording(&engine, 1);
+
+    agfx_free_engine(&engine);
+    if (argc <= 1)
+    {
+        remove(BENCH_SCENE_PATH);
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+#define SDL_MAIN_HANDLED
+#include "render_queue.h"
+
+#include <stdio.h>
+
+#define BENCH_DRAWS_COUNT 200000
+#define BENCH_RUNS 50
+#define BENCH_PIPELINES_COUNT 6
+#define BENCH_MATERIALS_COUNT 2000
+// a tenth of the scene blends
+#define BENCH_TRANSPARENT_EVERY 10
+
+static uint32_t random_state = 0x2545f491u;
+
+static uint32_t random_uint(uint32_t max)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state % max;
+}
+
+static double elapsed_ms(uint64_t start, uint64_t end)
+{
+    return (double)(end - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+// the reference order, the draw index breaks ties the way a stable sort would
+static int compare_items(const void* a, const void* b)
+{
+    const agfx_render_item_t* item_a = (const agfx_render_item_t*)a;
+    const agfx_render_item_t* item_b = (const agfx_render_item_t*)b;
+    if (item_a->key != item_b->key) return item_a->key < item_b->key ? -1 : 1;
+    return item_a->draw_index < item_b->draw_index ? -1 : (item_a->draw_index > item_b->draw_index ? 1 : 0);
+}
+
+// the optional argument is the worker count, 0 or nothing picks one per core
+int main(int argc, char** argv)
+{
+    uint32_t threads_count = argc > 1 ? (uint32_t)atoi(argv[1]) : 0;
+
+    agfx_job_system_t job_system;
+    agfx_render_queue_t render_queue;
+    if (AGFX_SUCCESS != agfx_create_job_system(threads_count, &job_system) || AGFX_SUCCESS != agfx_create_render_queue(BENCH_DRAWS_COUNT, &render_queue))
+    {
+        printf("failed to create the job system or the render queue\n");
+        return 1;
+    }
+
+    agfx_render_item_t* unsorted = malloc(sizeof(agfx_render_item_t) * BENCH_DRAWS_COUNT);
+    agfx_render_item_t* reference = malloc(sizeof(agfx_render_item_t) * BENCH_DRAWS_COUNT);
+    if (NULL == unsorted || NULL == reference)
+    {
+        printf("failed to allocate the draws\n");
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < BENCH_DRAWS_COUNT; ++i)
+    {
+        uint32_t pipeline_index = random_uint(BENCH_PIPELINES_COUNT);
+        uint32_t material_index = random_uint(BENCH_MATERIALS_COUNT);
+        uint32_t depth_bucket = agfx_render_depth_bucket(0.1f + (float)random_uint(100000) * 0.001f);
+        uint64_t key = 0 == i % BENCH_TRANSPARENT_EVERY
+            ? agfx_render_key_transparent(pipeline_index, material_index, depth_bucket)
+            : agfx_render_key_opaque(pipeline_index, material_index, depth_bucket);
+        unsorted[i] = (agfx_render_item_t) {.key = key, .draw_index = i};
+    }
+
+    memcpy(reference, unsorted, sizeof(agfx_render_item_t) * BENCH_DRAWS_COUNT);
+    uint64_t qsort_start = SDL_GetPerformanceCounter();
+    qsort(reference, BENCH_DRAWS_COUNT, sizeof(agfx_render_item_t), compare_items);
+    double qsort_ms = elapsed_ms(qsort_start, SDL_GetPerformanceCounter());
+
+    double sort_ms = 1e9;
+    double encode_ms = 1e9;
+    for (int run = 0; run < BENCH_RUNS; ++run)
+    {
+        agfx_render_queue_clear(&render_queue);
+        for (uint32_t i = 0; i < BENCH_DRAWS_COUNT; ++i)
+        {
+            agfx_render_queue_push(&render_queue, unsorted[i].key, unsorted[i].draw_index);
+        }
+
+        agfx_render_queue_sort(&render_queue, &job_system);
+        sort_ms = render_queue.stats.sort_ms < sort_ms ? render_queue.stats.sort_ms : sort_ms;
+
+        uint64_t encode_start = SDL_GetPerformanceCounter();
+        agfx_render_queue_encode(&render_queue);
+        double ms = elapsed_ms(encode_start, SDL_GetPerformanceCounter());
+        encode_ms = ms < encode_ms ? ms : encode_ms;
+    }
+
+    int matches = 0 == memcmp(render_queue.items, reference, sizeof(agfx_render_item_t) * BENCH_DRAWS_COUNT);
+
+    // the opaque part should come out grouped by pipeline, one batch each
+    uint32_t opaque_batches_count = 0;
+    for (size_t i = 0; i < render_queue.batches_count; ++i)
+    {
+        agfx_render_item_t* first = &render_queue.items[render_queue.batches[i].first_draw];
+        opaque_batches_count += AGFX_RENDER_LAYER_OPAQUE == (uint32_t)(first->key >> AGFX_RENDER_KEY_LAYER_SHIFT);
+    }
+
+    agfx_render_queue_stats_t* stats = &render_queue.stats;
+    printf("%d draws, %u workers, %u radix passes\n", BENCH_DRAWS_COUNT, job_system.threads_count, stats->sort_passes_count);
+    printf("radix sort best %.3f ms, qsort %.3f ms, encode best %.3f ms%s\n", sort_ms, qsort_ms, encode_ms, matches ? "" : " MISMATCH");
+    printf("%u batches (%u opaque), %u binds, %u binds saved\n", stats->batches_count, opaque_batches_count, stats->binds_count, stats->binds_saved_count);
+
+    free(reference);
+    free(unsorted);
+    agfx_free_render_queue(&render_queue);
+    agfx_free_job_system(&job_system);
+
+    return !matches || opaque_batches_count != BENCH_PIPELINES_COUNT;
+}
\ No newline at end of file
@@ -0,0 +1,399 @@
+#define SDL_MAIN_HANDLED
+#include "engine.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCENE_PATH "./scene_bench.glb"
+#define SCENE_QUADS_COUNT 9
+#define SCENE_QUAD_HALF_SIZE 0.12f
+#define SCENE_WALL_HEIGHT 0.75f
+#define SCENE_WALL_HALF_SIZE 0.45f
+#define SCENE_HIDDEN_HALF_SIZE 0.03f
+// how much further from the camera than the wall the hidden quads are, along the ray through the wall
+#define SCENE_HIDDEN_DEPTH_SCALE 1.3f
+// two phase culling draws whatever was visible the frame before early, it takes a few frames before hidden quads stop going out
+#define SCENE_FRAMES_COUNT (AGFX_MAX_FRAMES_IN_FLIGHT + 4)
+#define SCENE_VISIBLE_COUNT 4
+#define SCENE_FRUSTUM_CULLED_COUNT 3
+#define SCENE_OCCLUSION_CULLED_COUNT 2
+
+typedef enum scene_placement_t {
+    // in a row through the point the camera looks at
+    SCENE_PLACEMENT_ROW,
+    // a big quad above the row that hides the next ones
+    SCENE_PLACEMENT_WALL,
+    SCENE_PLACEMENT_HIDDEN,
+    SCENE_PLACEMENT_BEHIND_CAMERA
+} scene_placement_t;
+
+typedef struct scene_quad_t {
+    const char* name;
+    scene_placement_t placement;
+    // sideways from the middle of its placement
+    float offset;
+    float color[3];
+    uint32_t double_sided;
+    // wound clockwise seen from the camera, so the camera looks at its back
+    uint32_t reversed;
+    // what the pixel in the middle of it has to come out as, the gray clear color when the quad must not be there
+    float expected[3];
+} scene_quad_t;
+
+typedef struct scene_config_t {
+    const char* name;
+    uint32_t gpu_culling;
+    uint32_t meshlet_culling;
+    uint32_t mesh_shaders;
+    uint32_t visibility_buffer;
+    uint32_t depth_prepass;
+} scene_config_t;
+
+// the ones behind the wall have to leave the wall's white where they are, the ones behind the camera are never on screen
+static const scene_quad_t quads[SCENE_QUADS_COUNT] = {
+    {"single sided front", SCENE_PLACEMENT_ROW, -0.35f, {1.0f, 0.0f, 0.0f}, 0, 0, {1.0f, 0.0f, 0.0f}},
+    {"single sided back", SCENE_PLACEMENT_ROW, 0.0f, {0.0f, 1.0f, 0.0f}, 0, 1, {0.5f, 0.5f, 0.5f}},
+    {"double sided back", SCENE_PLACEMENT_ROW, 0.35f, {0.0f, 0.0f, 1.0f}, 1, 1, {0.0f, 0.0f, 1.0f}},
+    {"occluder", SCENE_PLACEMENT_WALL, 0.0f, {1.0f, 1.0f, 1.0f}, 0, 0, {1.0f, 1.0f, 1.0f}},
+    {"hidden left", SCENE_PLACEMENT_HIDDEN, -0.08f, {1.0f, 1.0f, 0.0f}, 0, 0, {1.0f, 1.0f, 1.0f}},
+    {"hidden right", SCENE_PLACEMENT_HIDDEN, 0.08f, {1.0f, 1.0f, 0.0f}, 0, 0, {1.0f, 1.0f, 1.0f}},
+    {"behind camera left", SCENE_PLACEMENT_BEHIND_CAMERA, -0.3f, {1.0f, 0.0f, 1.0f}, 0, 0, {0}},
+    {"behind camera middle", SCENE_PLACEMENT_BEHIND_CAMERA, 0.0f, {1.0f, 0.0f, 1.0f}, 0, 0, {0}},
+    {"behind camera right", SCENE_PLACEMENT_BEHIND_CAMERA, 0.3f, {1.0f, 0.0f, 1.0f}, 0, 0, {0}}
+};
+
+static const scene_config_t configs[] = {
+    {"cpu", 0, 0, 0, 0, 0},
+    {"gpu", 1, 0, 0, 0, 0},
+    {"gpu depth prepass", 1, 0, 0, 0, 1},
+    {"meshlets", 1, 1, 0, 0, 0},
+    {"mesh shaders", 1, 1, 1, 0, 0},
+    {"visibility buffer", 1, 0, 0, 1, 0}
+};
+
+// every quad is square to the view, wound counter clockwise as the camera sees it
+static void quad_corners(agfx_vector3_t center, float half_size, agfx_vector3_t right, agfx_vector3_t up, agfx_vector3_t* out_corners)
+{
+    for (uint32_t corner = 0; corner < 4; ++corner)
+    {
+        float x = (0 == corner || 3 == corner) ? -half_size : half_size;
+        float y = corner < 2 ? -half_size : half_size;
+        out_corners[corner] = (agfx_vector3_t) {
+            .x = center.x + right.x * x + up.x * y,
+            .y = center.y + right.y * x + up.y * y,
+            .z = center.z + right.z * x + up.z * y
+        };
+    }
+}
+
+// the same basis agfx_mat4x4_look_at builds for the renderer's camera
+static void camera_basis(agfx_vector3_t* out_eye, agfx_vector3_t* out_target, agfx_vector3_t* out_right, agfx_vector3_t* out_up, agfx_vector3_t* out_back)
+{
+    *out_eye = (agfx_vector3_t) {2.0f, 2.0f, 3.0f};
+    *out_target = (agfx_vector3_t) {0.0f, 0.0f, 1.9f};
+    *out_back = agfx_vector3_normalize(agfx_vector3_subtract_vector3(*out_eye, *out_target));
+    *out_right = agfx_vector3_normalize(agfx_vector3_cross((agfx_vector3_t) {0.0f, 0.0f, 1.0f}, *out_back));
+    *out_up = agfx_vector3_cross(*out_back, *out_right);
+}
+
+static agfx_vector3_t offset_point(agfx_vector3_t point, agfx_vector3_t direction, float distance)
+{
+    return (agfx_vector3_t) {point.x + direction.x * distance, point.y + direction.y * distance, point.z + direction.z * distance};
+}
+
+// the hidden quads sit on the ray from the camera through a point of the wall, so they land on the wall's pixels
+static agfx_vector3_t quad_center(uint32_t quad_index, float* out_half_size)
+{
+    agfx_vector3_t eye, target, right, up, back;
+    camera_basis(&eye, &target, &right, &up, &back);
+    const scene_quad_t* quad = &quads[quad_index];
+    agfx_vector3_t wall_point = offset_point(offset_point(target, up, SCENE_WALL_HEIGHT), right, quad->offset);
+    switch (quad->placement)
+    {
+    case SCENE_PLACEMENT_WALL:
+        *out_half_size = SCENE_WALL_HALF_SIZE;
+        return wall_point;
+    case SCENE_PLACEMENT_HIDDEN:
+        *out_half_size = SCENE_HIDDEN_HALF_SIZE;
+        return offset_point(eye, agfx_vector3_subtract_vector3(wall_point, eye), SCENE_HIDDEN_DEPTH_SCALE);
+    case SCENE_PLACEMENT_BEHIND_CAMERA:
+        *out_half_size = SCENE_QUAD_HALF_SIZE;
+        return offset_point(offset_point(eye, back, 1.0f), right, quad->offset);
+    default:
+        *out_half_size = SCENE_QUAD_HALF_SIZE;
+        return offset_point(target, right, quad->offset);
+    }
+}
+
+// one mesh with a primitive and a material per quad and no nodes, so every primitive is drawn once where it is
+static int write_scene(const char* path)
+{
+    agfx_vector3_t eye, target, right, up, back;
+    camera_basis(&eye, &target, &right, &up, &back);
+
+    float positions[SCENE_QUADS_COUNT][4][3];
+    uint16_t indices[SCENE_QUADS_COUNT][6];
+    for (uint32_t quad_index = 0; quad_index < SCENE_QUADS_COUNT; ++quad_index)
+    {
+        float half_size;
+        agfx_vector3_t center = quad_center(quad_index, &half_size);
+        agfx_vector3_t corners[4];
+        quad_corners(center, half_size, right, up, corners);
+        for (uint32_t corner = 0; corner < 4; ++corner)
+        {
+            positions[quad_index][corner][0] = corners[corner].x;
+            positions[quad_index][corner][1] = corners[corner].y;
+            positions[quad_index][corner][2] = corners[corner].z;
+        }
+        const uint16_t front[6] = {0, 1, 2, 0, 2, 3};
+        const uint16_t back[6] = {0, 2, 1, 0, 3, 2};
+        memcpy(indices[quad_index], quads[quad_index].reversed ? back : front, sizeof(front));
+    }
+
+    char json[8192];
+    int length = snprintf(json, sizeof(json), "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"byteLength\":%u}],\"bufferViews\":[", (uint32_t)(sizeof(positions) + sizeof(indices)));
+    for (uint32_t quad_index = 0; quad_index < SCENE_QUADS_COUNT; ++quad_index)
+    {
+        length += snprintf(json + length, sizeof(json) - length, "%s{\"buffer\":0,\"byteOffset\":%u,\"byteLength\":%u},{\"buffer\":0,\"byteOffset\":%u,\"byteLength\":%u}",
+            quad_index > 0 ? "," : "", (uint32_t)sizeof(positions[0]) * quad_index, (uint32_t)sizeof(positions[0]),
+            (uint32_t)(sizeof(positions) + sizeof(indices[0]) * quad_index), (uint32_t)sizeof(indices[0]));
+    }
+    length += snprintf(json + length, sizeof(json) - length, "],\"accessors\":[");
+    for (uint32_t quad_index = 0; quad_index < SCENE_QUADS_COUNT; ++quad_index)
+    {
+        length += snprintf(json + length, sizeof(json) - length, "%s{\"bufferView\":%u,\"byteOffset\":0,\"componentType\":5126,\"count\":4,\"type\":\"VEC3\"},{\"bufferView\":%u,\"byteOffset\":0,\"componentType\":5123,\"count\":6,\"type\":\"SCALAR\"}",
+            quad_index > 0 ? "," : "", quad_index * 2, quad_index * 2 + 1);
+    }
+    length += snprintf(json + length, sizeof(json) - length, "],\"images\":[],\"samplers\":[],\"textures\":[],\"materials\":[");
+    for (uint32_t quad_index = 0; quad_index < SCENE_QUADS_COUNT; ++quad_index)
+    {
+        const scene_quad_t* quad = &quads[quad_index];
+        length += snprintf(json + length, sizeof(json) - length, "%s{\"doubleSided\":%s,\"pbrMetallicRoughness\":{\"baseColorFactor\":[%.1f,%.1f,%.1f,1.0]}}",
+            quad_index > 0 ? "," : "", quad->double_sided ? "true" : "false", quad->color[0], quad->color[1], quad->color[2]);
+    }
+    length += snprintf(json + length, sizeof(json) - length, "],\"meshes\":[{\"primitives\":[");
+    for (uint32_t quad_index = 0; quad_index < SCENE_QUADS_COUNT; ++quad_index)
+    {
+        length += snprintf(json + length, sizeof(json) - length, "%s{\"attributes\":{\"POSITION\":%u},\"indices\":%u,\"material\":%u}",
+            quad_index > 0 ? "," : "", quad_index * 2, quad_index * 2 + 1, quad_index);
+    }
+    length += snprintf(json + length, sizeof(json) - length, "]}]}");
+    if (length < 0 || (size_t)length + 4 > sizeof(json))
+    {
+        return 0;
+    }
+
+    // both chunks are padded to four bytes, the json one with spaces
+    while (length % 4 != 0)
+    {
+        json[length++] = ' ';
+    }
+    uint32_t binary_length = (uint32_t)(sizeof(positions) + sizeof(indices));
+    uint32_t binary_padding = (4 - binary_length % 4) % 4;
+    uint32_t header[3] = {AGLTF_MAGIC, 2, 12 + 8 + (uint32_t)length + 8 + binary_length + binary_padding};
+    uint32_t json_chunk[2] = {(uint32_t)length, AGLTF_CHUNK_TYPE_JSON};
+    uint32_t binary_chunk[2] = {binary_length + binary_padding, AGLTF_CHUNK_TYPE_BIN};
+    const uint8_t zeros[4] = {0};
+
+    FILE* file = fopen(path, "wb");
+    if (NULL == file)
+    {
+        return 0;
+    }
+    fwrite(header, sizeof(header), 1, file);
+    fwrite(json_chunk, sizeof(json_chunk), 1, file);
+    fwrite(json, 1, length, file);
+    fwrite(binary_chunk, sizeof(binary_chunk), 1, file);
+    fwrite(positions, sizeof(positions), 1, file);
+    fwrite(indices, sizeof(indices), 1, file);
+    fwrite(zeros, 1, binary_padding, file);
+    fclose(file);
+    return 1;
+}
+
+// where the quad's middle lands on screen, with the renderer's own camera. the projection already flips y for vulkan
+static void quad_pixel(agfx_renderer_t* renderer, uint32_t quad_index, uint32_t* out_x, uint32_t* out_y)
+{
+    agfx_frame_constants_t constants = agfx_camera_constants(renderer);
+    float half_size;
+    agfx_vector3_t center = quad_center(quad_index, &half_size);
+    agfx_vector4_t clip = agfx_mat4x4_multiplied_by_vector4(constants.view_projection, (agfx_vector4_t) {center.x, center.y, center.z, 1.0f});
+    VkExtent2D extent = renderer->swapchain->swapchain_extent;
+    *out_x = (uint32_t)(int32_t)((clip.x / clip.w * 0.5f + 0.5f) * extent.width);
+    *out_y = (uint32_t)(int32_t)((clip.y / clip.w * 0.5f + 0.5f) * extent.height);
+}
+
+// the swapchain is srgb, so the expected linear color is compared after encoding, with room for dithering and rounding
+static int pixel_matches(const uint8_t* pixel, VkFormat format, const float* expected)
+{
+    uint32_t bgra = VK_FORMAT_B8G8R8A8_SRGB == format || VK_FORMAT_B8G8R8A8_UNORM == format;
+    uint32_t srgb = VK_FORMAT_B8G8R8A8_SRGB == format || VK_FORMAT_R8G8B8A8_SRGB == format;
+    uint8_t rgb[3] = {bgra ? pixel[2] : pixel[0], pixel[1], bgra ? pixel[0] : pixel[2]};
+    for (uint32_t channel = 0; channel < 3; ++channel)
+    {
+        float value = expected[channel];
+        if (srgb)
+        {
+            value = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+        }
+        if (abs((int)rgb[channel] - (int)(value * 255.0f + 0.5f)) > 8)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint32_t check_count(const scene_config_t* config, const char* name, uint32_t count, uint32_t expected)
+{
+    printf("%-18s %-20s %4u, expected %4u %s\n", config->name, name, count, expected, count == expected ? "ok" : "FAILED");
+    return count != expected;
+}
+
+// the last frame went out of the slot before the current one, its counters are complete once the device is idle
+static uint32_t check_culling(agfx_engine_t* engine, const scene_config_t* config)
+{
+    uint32_t failed_count = 0;
+    agfx_renderer_t* renderer = &engine->renderer;
+    if (!config->gpu_culling)
+    {
+        size_t occlusion_culled_count = renderer->software_occlusion.culled_count;
+        size_t frustum_culled_count = renderer->cpu_culling.bounds.count - renderer->cpu_culling.visible_count - occlusion_culled_count;
+        failed_count += check_count(config, "visible", (uint32_t)renderer->cpu_culling.visible_count, SCENE_VISIBLE_COUNT);
+        failed_count += check_count(config, "frustum culled", (uint32_t)frustum_culled_count, SCENE_FRUSTUM_CULLED_COUNT);
+        failed_count += check_count(config, "occlusion culled", (uint32_t)occlusion_culled_count, SCENE_OCCLUSION_CULLED_COUNT);
+        return failed_count;
+    }
+
+    uint32_t frame_index = (engine->state.current_frame + AGFX_MAX_FRAMES_IN_FLIGHT - 1) % AGFX_MAX_FRAMES_IN_FLIGHT;
+    agfx_cull_stats_t stats;
+    memcpy(&stats, renderer->gpu_culling.frames[frame_index].stats_buffer_mapped, sizeof(stats));
+    failed_count += check_count(config, "visible", stats.visible_count, SCENE_VISIBLE_COUNT);
+    failed_count += check_count(config, "frustum culled", stats.frustum_culled_count, SCENE_FRUSTUM_CULLED_COUNT);
+    failed_count += check_count(config, "occlusion culled", stats.occlusion_culled_count, SCENE_OCCLUSION_CULLED_COUNT);
+
+    // every quad is one cluster of two triangles, only the clusters of the objects that made it through are drawn
+    if (agfx_meshlet_culling_enabled(renderer) || agfx_visibility_buffer_enabled(renderer))
+    {
+        agfx_meshlet_cull_stats_t meshlet_stats;
+        memcpy(&meshlet_stats, renderer->meshlet_culling.frames[frame_index].stats_buffer_mapped, sizeof(meshlet_stats));
+        failed_count += check_count(config, "clusters drawn", meshlet_stats.visible_count, SCENE_VISIBLE_COUNT);
+        failed_count += check_count(config, "triangles drawn", meshlet_stats.triangles_count, SCENE_VISIBLE_COUNT * 2);
+    }
+    return failed_count;
+}
+
+static uint32_t run_config(agfx_engine_t* engine, const scene_config_t* config, const uint8_t* capture)
+{
+    engine->state.gpu_culling = config->gpu_culling;
+    engine->state.meshlet_culling = config->meshlet_culling;
+    engine->state.mesh_shaders = config->mesh_shaders;
+    engine->state.visibility_buffer = config->visibility_buffer;
+    engine->state.depth_prepass = config->depth_prepass;
+    agfx_invalidate_commands(&engine->renderer);
+
+    if ((config->meshlet_culling && !agfx_meshlet_culling_enabled(&engine->renderer))
+        || (config->mesh_shaders && !agfx_meshlet_culling_uses_mesh_shaders(&engine->renderer))
+        || (config->visibility_buffer && !agfx_visibility_buffer_enabled(&engine->renderer)))
+    {
+        printf("%-18s skipped, not supported here\n", config->name);
+        return 0;
+    }
+
+    for (uint32_t frame = 0; frame < SCENE_FRAMES_COUNT; ++frame)
+    {
+        agfx_game_loop(engine);
+    }
+    vkDeviceWaitIdle(engine->context.device);
+
+    uint32_t failed_count = 0;
+    VkExtent2D extent = engine->swapchain.swapchain_extent;
+    for (uint32_t quad_index = 0; quad_index < SCENE_QUADS_COUNT; ++quad_index)
+    {
+        if (SCENE_PLACEMENT_BEHIND_CAMERA == quads[quad_index].placement)
+        {
+            continue;
+        }
+        uint32_t x, y;
+        quad_pixel(&engine->renderer, quad_index, &x, &y);
+        if (x >= extent.width || y >= extent.height)
+        {
+            printf("%-18s %-20s is off screen FAILED\n", config->name, quads[quad_index].name);
+            failed_count++;
+            continue;
+        }
+        const uint8_t* pixel = &capture[((size_t)y * extent.width + x) * 4];
+        uint32_t passed = pixel_matches(pixel, engine->swapchain.swapchain_format, quads[quad_index].expected);
+        printf("%-18s %-20s at %4u %4u: %3u %3u %3u %s\n", config->name, quads[quad_index].name, x, y, pixel[0], pixel[1], pixel[2], passed ? "ok" : "FAILED");
+        failed_count += !passed;
+    }
+    return failed_count + check_culling(engine, config);
+}
+
+// three quads in front of the fixed camera, one per way a triangle can face it. every path has to draw the front of the
+// single sided one, drop its back and keep the back of the double sided one. above them a wall hides two more and three
+// sit behind the camera, so every path has to come up with the same visible, frustum culled and occlusion culled counts
+int main(int argc, char** argv)
+{
+    if (!write_scene(SCENE_PATH))
+    {
+        printf("could not write %s\n", SCENE_PATH);
+        return 1;
+    }
+
+    agfx_engine_t engine;
+    agfx_default_engine_state(&engine.state);
+    engine.state.model_path = SCENE_PATH;
+    // merged quads would share one material and the checks would no longer tell them apart
+    engine.state.static_batching = 0;
+    if (AGFX_SUCCESS != agfx_create_engine(&engine))
+    {
+        printf("could not create the engine\n");
+        return 1;
+    }
+    agfx_pipeline_state_cache_wait(&engine.renderer);
+
+    VkDeviceMemory capture_memory = VK_NULL_HANDLE;
+    void* capture = NULL;
+    int result = 0;
+    if (!(engine.swapchain.swapchain_info.surface_capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+    {
+        printf("the swapchain images can not be copied out here, nothing to check\n");
+        goto free_engine;
+    }
+
+    VkExtent2D extent = engine.swapchain.swapchain_extent;
+    VkDeviceSize capture_size = (VkDeviceSize)extent.width * extent.height * 4;
+    if (AGFX_SUCCESS != agfx_helper_create_buffer(&engine.context, capture_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &engine.renderer.capture_buffer, &capture_memory)
+        || VK_SUCCESS != vkMapMemory(engine.context.device, capture_memory, 0, capture_size, 0, &capture))
+    {
+        printf("could not create the capture buffer\n");
+        result = 1;
+        goto free_engine;
+    }
+
+    uint32_t failed_count = 0;
+    for (uint32_t config_index = 0; config_index < sizeof(configs) / sizeof(configs[0]); ++config_index)
+    {
+        failed_count += run_config(&engine, &configs[config_index], capture);
+    }
+    printf("%u checks failed\n", failed_count);
+    result = failed_count > 0;
+
+free_engine:
+    vkDeviceWaitIdle(engine.context.device);
+    if (VK_NULL_HANDLE != engine.renderer.capture_buffer)
+    {
+        vkDestroyBuffer(engine.context.device, engine.renderer.capture_buffer, NULL);
+        engine.renderer.capture_buffer = VK_NULL_HANDLE;
+    }
+    if (VK_NULL_HANDLE != capture_memory)
+    {
+        vkFreeMemory(engine.context.device, capture_memory, NULL);
+    }
+    agfx_free_engine(&engine);
+    remove(SCENE_PATH);
+    return result;
+}
\ No newline at end of file
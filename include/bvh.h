@@ -0,0 +1,32 @@
+#ifndef AGFX_BVH_H
+#define AGFX_BVH_H
+
+#include "engine_types.h"
+#include "job_system.h"
+
+#include <stdlib.h>
+#include <float.h>
+#include <math.h>
+
+#define AGFX_BVH_EMPTY UINT32_MAX
+#define AGFX_BVH_LEAF_SIZE 4
+#define AGFX_BVH_BINS_COUNT 16
+// ranges at least this large are built as their own job
+#define AGFX_BVH_PARALLEL_THRESHOLD 1024
+// a refit tree this much worse than the freshly built one gets rebuilt
+#define AGFX_BVH_REBUILD_COST_RATIO 1.5f
+#define AGFX_BVH_TRAVERSAL_COST 1.0f
+#define AGFX_BVH_PRIMITIVE_COST 1.0f
+
+agfx_result_t agfx_create_bvh(size_t capacity, agfx_bvh_t* out_bvh);
+void agfx_free_bvh(agfx_bvh_t* bvh);
+
+void agfx_bvh_set_primitive(agfx_bvh_t* bvh, size_t index, agfx_aabb_t bounds);
+void agfx_bvh_build(agfx_bvh_t* bvh, agfx_job_system_t* job_system, size_t primitives_count);
+void agfx_bvh_refit(agfx_bvh_t* bvh);
+uint32_t agfx_bvh_needs_rebuild(agfx_bvh_t* bvh);
+
+size_t agfx_bvh_cull_frustum(agfx_bvh_t* bvh, const agfx_frustum_t* frustum, uint32_t* out_visible_indices);
+size_t agfx_bvh_query_aabb(agfx_bvh_t* bvh, agfx_aabb_t bounds, uint32_t* out_indices, size_t indices_capacity);
+
+#endif
\ No newline at end of file
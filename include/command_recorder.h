@@ -0,0 +1,26 @@
+#ifndef AGFX_COMMAND_RECORDER_H
+#define AGFX_COMMAND_RECORDER_H
+
+#include "engine_types.h"
+#include "job_system.h"
+
+#include <stdlib.h>
+
+// one worker slot per job system thread plus the thread that waits on them
+#define AGFX_COMMAND_RECORDER_MAX_WORKERS (AGFX_JOB_SYSTEM_MAX_THREADS + 1)
+// below this many commands per worker a secondary costs more than it saves
+#define AGFX_COMMAND_RECORDER_MIN_RANGE 256
+
+typedef void (*agfx_record_range_function_t)(VkCommandBuffer command_buffer, void* data, size_t begin, size_t end);
+
+agfx_result_t agfx_create_command_recorder(agfx_context_t* context, uint32_t frames_count, uint32_t workers_count, agfx_command_recorder_t* out_command_recorder);
+void agfx_free_command_recorder(agfx_context_t* context, agfx_command_recorder_t* command_recorder);
+
+agfx_result_t agfx_command_recorder_begin_frame(agfx_context_t* context, agfx_command_recorder_t* command_recorder, uint32_t frame_index);
+VkCommandBuffer agfx_command_recorder_primary(agfx_command_recorder_t* command_recorder);
+agfx_result_t agfx_command_recorder_use_cached(agfx_context_t* context, agfx_command_recorder_t* command_recorder, uint32_t image_index, uint64_t generation, uint32_t* out_valid);
+void agfx_command_recorder_mark_cached(agfx_command_recorder_t* command_recorder, uint32_t image_index, uint64_t generation);
+uint32_t agfx_command_recorder_workers_for(agfx_command_recorder_t* command_recorder, size_t count);
+agfx_result_t agfx_command_recorder_record_parallel(agfx_context_t* context, agfx_command_recorder_t* command_recorder, agfx_job_system_t* job_system, const VkCommandBufferInheritanceInfo* inheritance_info, size_t count, agfx_record_range_function_t function, void* data);
+
+#endif
\ No newline at end of file
@@ -3,8 +3,16 @@
 
 #include "engine_types.h"
 #include "utils.h"
+#include "pipeline_cache.h"
 #include <SDL2/SDL_vulkan.h>
 
+// a device-local heap this small is the legacy 256 MiB pci bar window, anything bigger is resizable bar or unified memory
+#define AGFX_LEGACY_BAR_HEAP_SIZE (256ull * 1024ull * 1024ull)
+#define AGFX_LEGACY_BAR_BUDGET_DIVISOR 4
+#define AGFX_LARGE_BAR_BUDGET_DIVISOR 2
+// swapchain, mesh shader and the two pipeline library ones
+#define AGFX_DEVICE_EXTENSIONS_MAX 4
+
 agfx_result_t agfx_create_context(agfx_present_t* present, agfx_context_t* out_context);
 void agfx_free_context(agfx_context_t* context);
 
@@ -12,7 +20,9 @@ agfx_result_t create_vulkan_instance(agfx_context_t* context);
 agfx_result_t create_vulkan_surface(agfx_context_t* context);
 agfx_result_t find_physical_device(agfx_context_t* context);
 size_t get_unique_queue_family_indices(agfx_queue_family_indices_t* const queue_family_indices, uint32_t* output_indices_array);
+uint32_t device_extension_supported(VkPhysicalDevice physical_device, const char* extension_name);
 agfx_result_t create_logical_device(agfx_context_t* context);
+void query_memory_properties(agfx_context_t* context);
 
 void free_vulkan_instance(agfx_context_t* context);
 void free_logical_device(agfx_context_t* context);
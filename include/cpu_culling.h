@@ -0,0 +1,28 @@
+#ifndef AGFX_CPU_CULLING_H
+#define AGFX_CPU_CULLING_H
+
+#include "engine_types.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#define AGFX_CPU_CULL_LANES 8
+#define AGFX_CPU_CULL_STREAM_COUNT 10
+
+agfx_result_t agfx_create_cull_bounds(size_t capacity, agfx_cull_bounds_t* out_bounds);
+void agfx_free_cull_bounds(agfx_cull_bounds_t* bounds);
+void agfx_cull_bounds_set_count(agfx_cull_bounds_t* bounds, size_t count);
+void agfx_cull_bounds_set(agfx_cull_bounds_t* bounds, size_t index, agfx_vector4_t sphere, agfx_vector3_t box_center, agfx_vector3_t box_extent);
+void agfx_cull_bounds_set_transformed(agfx_cull_bounds_t* bounds, size_t index, agfx_mat4x4_t transform, agfx_vector4_t sphere, agfx_vector3_t box_min, agfx_vector3_t box_max);
+
+agfx_frustum_t agfx_frustum_from_view_projection(agfx_mat4x4_t view_projection);
+agfx_cull_path_t agfx_cull_best_path(void);
+size_t agfx_cull_frustum(const agfx_cull_bounds_t* bounds, const agfx_frustum_t* frustum, agfx_cull_path_t path, uint32_t* out_visible_indices);
+
+agfx_result_t agfx_create_cpu_culling(size_t capacity, agfx_cpu_culling_t* out_cpu_culling);
+void agfx_free_cpu_culling(agfx_cpu_culling_t* cpu_culling);
+void agfx_cpu_cull(agfx_cpu_culling_t* cpu_culling, agfx_mat4x4_t view_projection);
+
+#endif
\ No newline at end of file
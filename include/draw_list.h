@@ -0,0 +1,27 @@
+#ifndef AGFX_DRAW_LIST_H
+#define AGFX_DRAW_LIST_H
+
+#include "engine_types.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define AGFX_DRAW_LIST_USAGE (VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+// a count per range of the list, padded to a power of two
+#define AGFX_DRAW_LIST_COUNT_SIZE 32
+// the count can be bound as its own storage buffer, 256 is the largest minStorageBufferOffsetAlignment the spec allows
+#define AGFX_DRAW_LIST_COUNT_ALIGNMENT 256
+
+agfx_result_t agfx_create_draw_list(size_t draws_capacity, agfx_draw_list_t* out_draw_list);
+void agfx_free_draw_list(agfx_draw_list_t* draw_list);
+
+void agfx_draw_list_clear(agfx_draw_list_t* draw_list);
+agfx_result_t agfx_draw_list_push(agfx_draw_list_t* draw_list, uint32_t index_count, uint32_t first_index, int32_t vertex_offset, uint32_t object_index, uint32_t material_index, uint32_t first_lod, uint32_t lods_count);
+
+VkDeviceSize agfx_draw_list_count_offset(size_t draws_capacity);
+VkDeviceSize agfx_draw_list_buffer_size(size_t draws_capacity);
+void agfx_draw_list_write(agfx_draw_list_t* draw_list, void* mapped);
+void agfx_cmd_draw_list(agfx_context_t* context, VkCommandBuffer command_buffer, VkBuffer draw_buffer, VkDeviceSize draw_buffer_offset, size_t draws_capacity, uint32_t range, uint32_t first_draw, uint32_t draws_count);
+void agfx_cmd_draw_list_range(agfx_context_t* context, VkCommandBuffer command_buffer, VkBuffer draw_buffer, VkDeviceSize draw_buffer_offset, uint32_t first_draw, uint32_t draws_count);
+
+#endif
\ No newline at end of file
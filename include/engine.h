@@ -11,6 +11,8 @@
 #include "swapchain.h"
 #include "renderer.h"
 
+void agfx_default_engine_state(agfx_state_t* out_state);
+agfx_result_t agfx_create_engine(agfx_engine_t* engine);
 agfx_result_t agfx_initialize_engine(agfx_engine_t* out_engine);
 void agfx_game_loop(agfx_engine_t* engine);
 void agfx_main(agfx_engine_t* engine);
@@ -42,6 +42,12 @@ typedef enum agfx_result_t {
     AGFX_UNSUPPORTED_LAYOUT_TRANSITION_ERROR,
     AGFX_SAMPLER_CREATE_ERROR,
     AGFX_MODEL_LOAD_ERROR,
+    AGFX_FRAME_ARENA_OUT_OF_MEMORY_ERROR,
+    AGFX_TEXTURE_TABLE_FULL_ERROR,
+    AGFX_DRAW_LIST_FULL_ERROR,
+    AGFX_JOB_SYSTEM_ERROR,
+    AGFX_QUERY_POOL_ERROR,
+    AGFX_PIPELINE_CACHE_ERROR,
 } agfx_result_t;
 
 #define AGFX_QUEUE_FAMILY_INDICES_LENGTH sizeof(agfx_queue_family_indices_t) / sizeof(uint32_t)
@@ -60,15 +66,24 @@ typedef struct agfx_swapchain_info_t {
 
 typedef struct agfx_vertex_t {
     agfx_vector3_t position;
-    agfx_vector3_t color;
+    agfx_vector4_t color;
     agfx_vector2_t texture_coordinate;
 } agfx_vertex_t;
 
+// everything but the position, which the geometry buffer keeps in a stream of its own for passes that only need depth
+typedef struct agfx_vertex_attributes_t {
+    agfx_vector4_t color;
+    agfx_vector2_t texture_coordinate;
+} agfx_vertex_attributes_t;
+
 typedef struct agfx_present_t {
     SDL_Window* window;
     uint32_t width, height;
 } agfx_present_t;
 
+// direct buffers live as long as the scene, past this many the rest go through staging
+#define AGFX_DIRECT_UPLOAD_MAX_ALLOCATIONS 64
+
 typedef struct agfx_context_t {
     agfx_present_t* present;
     VkInstance instance;
@@ -78,6 +93,24 @@ typedef struct agfx_context_t {
     VkQueue present_queue;
     VkSurfaceKHR surface;
     agfx_queue_family_indices_t queue_family_indices;
+    VkPhysicalDeviceProperties device_properties;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    VkBool32 multi_draw_indirect_supported;
+    VkBool32 draw_indirect_count_supported;
+    VkBool32 mesh_shader_supported;
+    uint32_t max_mesh_work_group_count;
+    PFN_vkCmdDrawMeshTasksIndirectEXT cmd_draw_mesh_tasks_indirect;
+    VkBool32 graphics_pipeline_library_supported;
+    uint32_t direct_upload_memory_type_index;
+    VkDeviceSize direct_upload_budget;
+    VkDeviceSize direct_upload_used;
+    // what each live direct buffer took from the budget, freeing one gives it back
+    VkDeviceMemory direct_upload_memories[AGFX_DIRECT_UPLOAD_MAX_ALLOCATIONS];
+    VkDeviceSize direct_upload_sizes[AGFX_DIRECT_UPLOAD_MAX_ALLOCATIONS];
+    uint32_t direct_upload_allocations_count;
+    // shared by every pipeline the engine creates, loaded from and saved to disk
+    VkPipelineCache pipeline_cache;
+    uint32_t pipeline_cache_warm;
 } agfx_context_t;
 
 typedef struct agfx_renderer_t agfx_renderer_t;
@@ -97,36 +130,675 @@ typedef struct agfx_swapchain_t {
     VkImage depth_image;
     VkDeviceMemory depth_image_memory;
     VkImageView depth_image_view;
+    uint32_t depth_generation;
 } agfx_swapchain_t;
 
 typedef struct agfx_state_t {
     uint32_t quit;
     uint32_t resized;
     uint32_t current_frame;
+    const char* model_path;
     agfx_vector3_t rotation;
     float camera_fov;
+    uint32_t gpu_culling;
+    uint32_t occlusion_culling;
+    uint32_t software_occlusion;
+    uint32_t parallel_recording;
+    uint32_t cached_recording;
+    uint32_t static_batching;
+    uint32_t mesh_optimization;
+    uint32_t lod_generation;
+    uint32_t lod_selection;
+    uint32_t meshlet_generation;
+    uint32_t meshlet_culling;
+    uint32_t meshlet_cone_culling;
+    uint32_t mesh_shaders;
+    uint32_t visibility_buffer;
+    uint32_t depth_prepass;
 } agfx_state_t;
 
+#define AGFX_MESH_MAX_LODS 8
+
+// one level of detail as a range of the index buffer. error is the worst collapse's area weighted rms distance to the
+// original planes around it, in mesh units. a vertex may move further than that, it is no bound on the largest distance.
+// every level is also cut into meshlets, the range is into the mesh's meshlets until the meshlet buffer is created.
+// matches the std430 MeshLod in cull.comp and meshlet_cull.comp
+typedef struct agfx_mesh_lod_t {
+    uint32_t first_index;
+    uint32_t indices_count;
+    float error;
+    uint32_t first_meshlet;
+    uint32_t meshlets_count;
+    uint32_t padding[3];
+} agfx_mesh_lod_t;
+
+// a cluster of up to AGFX_MESHLET_MAX_TRIANGLES triangles that is a contiguous run of its level's indices, so the index
+// buffer draws it as is. vertices and packed triangles are the same cluster with 8 bit local indices for mesh shaders.
+// cone is the axis all its triangles face around in xyz and the sine of the spread in w, 1 when it cannot be back facing.
+// every offset is relative to the mesh until the meshlet buffer is created. matches the std430 Meshlet in the shaders
+typedef struct agfx_meshlet_t {
+    agfx_vector4_t bounding_sphere;
+    agfx_vector4_t cone;
+    uint32_t first_index;
+    uint32_t triangles_count;
+    uint32_t first_vertex;
+    uint32_t vertices_count;
+    uint32_t first_triangle;
+    int32_t vertex_offset;
+    uint32_t padding[2];
+} agfx_meshlet_t;
+
+// lods[0] is the full mesh and the count is 0 before the chain is built. the coarser levels index the same vertices,
+// their indices live in lod_indices and their first_index is relative to it until the geometry buffer is created
 typedef struct agfx_mesh_t {
     size_t vertices_count;
     agfx_vertex_t* vertices;
     size_t indices_count;
     uint32_t* indices;
-    VkBuffer vertex_buffer;
-    VkDeviceMemory vertex_buffer_memory;
+    uint32_t first_index;
+    int32_t vertex_offset;
+    agfx_vector4_t bounding_sphere;
+    agfx_vector3_t bounds_min;
+    agfx_vector3_t bounds_max;
+    uint32_t material_index;
+    uint32_t first_instance;
+    uint32_t instances_count;
+    uint32_t lods_count;
+    agfx_mesh_lod_t lods[AGFX_MESH_MAX_LODS];
+    size_t lod_indices_count;
+    uint32_t* lod_indices;
+    uint32_t first_lod;
+    size_t meshlets_count;
+    agfx_meshlet_t* meshlets;
+    size_t meshlet_vertices_count;
+    uint32_t* meshlet_vertices;
+    size_t meshlet_triangles_count;
+    uint32_t* meshlet_triangles;
+} agfx_mesh_t;
+
+// one placement of a mesh, instances of the same mesh are kept next to each other
+typedef struct agfx_instance_t {
+    agfx_mat4x4_t transform;
+    uint32_t mesh_index;
+} agfx_instance_t;
+
+typedef struct agfx_static_batch_stats_t {
+    uint32_t merged_primitives_count;
+    uint32_t batches_count;
+} agfx_static_batch_stats_t;
+
+// acmr is transformed vertices per triangle, atvr is transformed vertices per vertex, both for a fifo cache
+typedef struct agfx_vertex_cache_stats_t {
+    size_t triangles_count;
+    size_t vertices_count;
+    size_t transformed_vertices_count;
+} agfx_vertex_cache_stats_t;
+
+typedef struct agfx_mesh_optimizer_stats_t {
+    agfx_vertex_cache_stats_t before;
+    agfx_vertex_cache_stats_t after;
+    uint32_t optimized_meshes_count;
+    double optimize_ms;
+} agfx_mesh_optimizer_stats_t;
+
+// the triangle counts are from the last frame culled on the cpu
+typedef struct agfx_lod_stats_t {
+    uint32_t meshes_count;
+    uint32_t lods_count;
+    double build_ms;
+    uint64_t full_triangles_count;
+    uint64_t drawn_triangles_count;
+} agfx_lod_stats_t;
+
+typedef struct agfx_meshlet_stats_t {
+    uint32_t meshes_count;
+    uint32_t meshlets_count;
+    uint64_t triangles_count;
+    uint64_t vertices_count;
+    uint32_t cones_count;
+    double build_ms;
+} agfx_meshlet_stats_t;
+
+typedef struct agfx_texture_t {
+    VkImage image;
+    VkDeviceMemory image_memory;
+    VkImageView image_view;
+} agfx_texture_t;
+
+#define AGFX_NO_TEXTURE UINT32_MAX
+
+typedef struct agfx_material_data_t {
+    agfx_vector4_t base_color_factor;
+    float metallic_factor;
+    float roughness_factor;
+    uint32_t base_color_texture_index;
+    // only read by alpha tested pipelines
+    float alpha_cutoff;
+} agfx_material_data_t;
+
+typedef struct agfx_pipeline_state_cache_t agfx_pipeline_state_cache_t;
+
+// VK_EXT_graphics_pipeline_library parts that do not depend on the material: positions only or every stream, the two vertex
+// shaders with and without back face culling, and opaque, blended or no color output
+#define AGFX_PIPELINE_VERTEX_INPUT_LIBRARIES_COUNT 2
+#define AGFX_PIPELINE_PRE_RASTERIZATION_LIBRARIES_COUNT 4
+#define AGFX_PIPELINE_FRAGMENT_OUTPUT_LIBRARIES_COUNT 3
+
+typedef struct agfx_pipeline_compile_job_t {
+    agfx_pipeline_state_cache_t* cache;
+    uint32_t slot;
+} agfx_pipeline_compile_job_t;
+
+// scene pipelines by key. the keys the materials need are queued at load and compiled on the workers, recording only ever
+// looks them up and draws with a fallback until they are ready. compiles outlive the renderer being copied into place, so the
+// cache lives on the heap and keeps its own copy of what a compile needs
+struct agfx_pipeline_state_cache_t {
+    agfx_context_t* context;
+    VkPipelineLayout pipeline_layout;
+    VkRenderPass render_pass;
+    VkShaderModule vertex_shader_module;
+    VkShaderModule fragment_shader_module;
+    VkShaderModule depth_shader_module;
+    struct agfx_job_system_t* job_system;
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t* keys;
+    // fast linked, or compiled whole without libraries
+    VkPipeline* pipelines;
+    // relinked with link time optimization behind the fast link, both stay alive since recorded commands may use either
+    VkPipeline* optimized_pipelines;
+    // a slot's pipeline is only read once its state says it is ready
+    SDL_atomic_t* states;
+    float* compile_ms;
+    float* optimize_ms;
+    agfx_pipeline_compile_job_t* jobs;
+    uint32_t libraries_enabled;
+    VkPipeline vertex_input_libraries[AGFX_PIPELINE_VERTEX_INPUT_LIBRARIES_COUNT];
+    VkPipeline pre_rasterization_libraries[AGFX_PIPELINE_PRE_RASTERIZATION_LIBRARIES_COUNT];
+    VkPipeline fragment_output_libraries[AGFX_PIPELINE_FRAGMENT_OUTPUT_LIBRARIES_COUNT];
+    // fragment shader parts by the key bits they depend on, made the first time a compile needs one
+    SDL_mutex* fragment_libraries_mutex;
+    uint32_t fragment_libraries_count;
+    uint32_t* fragment_library_keys;
+    VkPipeline* fragment_libraries;
+    // compiles queued or running, also the counter they are pushed with
+    SDL_atomic_t pending;
+    // bumped whenever a compile finishes, commands recorded with a fallback are stale from then on
+    SDL_atomic_t completed;
+};
+
+// one per feature constant in shader.frag
+#define AGFX_PIPELINE_SPECIALIZATION_CONSTANTS_COUNT 4
+
+// a key's feature bits as shader.frag's constants, the info points into the struct itself
+typedef struct agfx_pipeline_specialization_t {
+    VkBool32 values[AGFX_PIPELINE_SPECIALIZATION_CONSTANTS_COUNT];
+    VkSpecializationMapEntry map_entries[AGFX_PIPELINE_SPECIALIZATION_CONSTANTS_COUNT];
+    VkSpecializationInfo info;
+} agfx_pipeline_specialization_t;
+
+typedef struct agfx_pipeline_compile_stats_t {
+    uint32_t pending_count;
+    uint32_t ready_count;
+    uint32_t failed_count;
+    uint32_t optimized_count;
+    double total_ms;
+    double max_ms;
+    double optimize_total_ms;
+} agfx_pipeline_compile_stats_t;
+
+typedef struct agfx_frame_arena_t {
+    VkBuffer buffer;
+    VkDeviceMemory buffer_memory;
+    uint8_t* mapped;
+    VkDeviceSize frame_size;
+    VkDeviceSize alignment;
+    uint32_t frame_index;
+    VkDeviceSize head;
+} agfx_frame_arena_t;
+
+typedef struct agfx_frame_allocation_t {
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    void* mapped;
+} agfx_frame_allocation_t;
+
+// draw_index points into the draw list, the queue sorts by key only
+typedef struct agfx_render_item_t {
+    uint64_t key;
+    uint32_t draw_index;
+    uint32_t padding;
+} agfx_render_item_t;
+
+// a run of sorted draws that share a pipeline, one bind and one multi draw
+typedef struct agfx_render_batch_t {
+    uint32_t pipeline_index;
+    uint32_t first_draw;
+    uint32_t draws_count;
+} agfx_render_batch_t;
+
+typedef struct agfx_frame_t {
+    uint32_t constants_offset;
+    VkBuffer object_buffer;
+    VkDeviceMemory object_buffer_memory;
+    void* object_buffer_mapped;
+    VkBuffer instance_buffer;
+    VkDeviceMemory instance_buffer_memory;
+    uint32_t* instance_buffer_mapped;
+    uint64_t object_generation;
+    VkBuffer draw_buffer;
+    VkDeviceMemory draw_buffer_memory;
+    void* draw_buffer_mapped;
+    uint32_t draws_count;
+    VkBuffer cpu_draw_buffer;
+    VkDeviceSize cpu_draw_offset;
+    uint32_t cpu_draws_count;
+    float lod_scale;
+    VkDescriptorSet descriptor_set;
+    // the full list's opaque and alpha tested ranges, then its blended draws back to front as runs that share a pipeline
+    size_t scene_batches_count;
+    agfx_render_batch_t* scene_batches;
+    agfx_render_item_t* blend_items;
+} agfx_frame_t;
+
+// secondaries are allocated as passes ask for them and kept, the pool reset only rewinds them
+typedef struct agfx_command_worker_t {
+    VkCommandPool command_pool;
+    uint32_t command_buffers_count;
+    uint32_t command_buffers_used;
+    VkCommandBuffer* command_buffers;
+} agfx_command_worker_t;
+
+// generation 0 was never recorded
+typedef struct agfx_cached_commands_t {
+    VkCommandBuffer command_buffer;
+    uint64_t generation;
+} agfx_cached_commands_t;
+
+typedef struct agfx_command_frame_t {
+    VkCommandPool command_pool;
+    VkCommandBuffer command_buffer;
+    VkCommandBuffer active_command_buffer;
+    agfx_command_worker_t* workers;
+    VkCommandPool cached_command_pool;
+    uint32_t cached_count;
+    agfx_cached_commands_t* cached;
+} agfx_command_frame_t;
+
+typedef struct agfx_command_recorder_t {
+    uint32_t frames_count;
+    uint32_t workers_count;
+    uint32_t frame_index;
+    agfx_command_frame_t* frames;
+    uint32_t recording_cached;
+    uint32_t secondaries_count;
+    double record_ms;
+    uint64_t recorded_frames;
+    uint64_t reused_frames;
+} agfx_command_recorder_t;
+
+// the indirect command comes first so the record array can be handed to vkCmdDrawIndexedIndirect* with its own stride
+typedef struct agfx_draw_record_t {
+    VkDrawIndexedIndirectCommand command;
+    uint32_t material_index;
+    uint32_t first_lod;
+    uint32_t lods_count;
+} agfx_draw_record_t;
+
+// draws are grouped by the pipeline state they need: opaque, alpha tested and blended, each single then double sided.
+// the two blended buckets share the last range of the list, it is drawn back to front whichever faces a draw culls
+#define AGFX_DRAW_BUCKETS_COUNT 6
+#define AGFX_DRAW_BUCKET_BLEND 4
+#define AGFX_DRAW_RANGES_COUNT (AGFX_DRAW_BUCKET_BLEND + 1)
+
+typedef struct agfx_draw_list_t {
+    size_t draws_count;
+    size_t draws_capacity;
+    agfx_draw_record_t* draws;
+    // where each range starts, the last entry is where the list ends
+    uint32_t range_first_draws[AGFX_DRAW_RANGES_COUNT + 1];
+    uint64_t generation;
+} agfx_draw_list_t;
+
+typedef void (*agfx_job_function_t)(void* data);
+
+typedef struct agfx_job_t {
+    agfx_job_function_t function;
+    void* data;
+    SDL_atomic_t* counter;
+} agfx_job_t;
+
+typedef struct agfx_job_system_t {
+    uint32_t threads_count;
+    SDL_Thread** threads;
+    SDL_mutex* mutex;
+    SDL_cond* job_available;
+    agfx_job_t* jobs;
+    uint32_t jobs_capacity;
+    uint32_t jobs_head;
+    uint32_t jobs_count;
+    // long jobs only the workers take, a thread waiting on a counter never picks one up
+    agfx_job_t* background_jobs;
+    uint32_t background_head;
+    uint32_t background_count;
+    uint32_t quit;
+} agfx_job_system_t;
+
+// world space bounds, one array per component so 8 objects load with one instruction each.
+// the arrays are padded up to a multiple of 8 with bounds that are always outside
+typedef struct agfx_cull_bounds_t {
+    size_t count;
+    size_t capacity;
+    float* data;
+    float* sphere_x;
+    float* sphere_y;
+    float* sphere_z;
+    float* sphere_radius;
+    float* box_center_x;
+    float* box_center_y;
+    float* box_center_z;
+    float* box_extent_x;
+    float* box_extent_y;
+    float* box_extent_z;
+} agfx_cull_bounds_t;
+
+typedef struct agfx_render_queue_stats_t {
+    uint32_t draws_count;
+    uint32_t batches_count;
+    uint32_t binds_count;
+    uint32_t binds_saved_count;
+    uint32_t sort_passes_count;
+    double sort_ms;
+} agfx_render_queue_stats_t;
+
+typedef struct agfx_render_queue_t {
+    size_t capacity;
+    size_t items_count;
+    agfx_render_item_t* items;
+    agfx_render_item_t* scratch;
+    size_t* histograms;
+    size_t batches_count;
+    agfx_render_batch_t* batches;
+    agfx_render_queue_stats_t stats;
+} agfx_render_queue_t;
+
+// normalized, xyz points inside the frustum
+typedef struct agfx_frustum_t {
+    agfx_vector4_t planes[6];
+} agfx_frustum_t;
+
+typedef enum agfx_cull_path_t {
+    AGFX_CULL_PATH_SCALAR = 0,
+    AGFX_CULL_PATH_SSE,
+    AGFX_CULL_PATH_AVX2
+} agfx_cull_path_t;
+
+typedef struct agfx_aabb_t {
+    agfx_vector3_t min;
+    agfx_vector3_t max;
+} agfx_aabb_t;
+
+#define AGFX_BVH_WIDTH 4
+
+// build time copy of a primitive, partitioned in place of the index list
+typedef struct agfx_bvh_reference_t {
+    agfx_aabb_t bounds;
+    uint32_t index;
+} agfx_bvh_reference_t;
+
+// four children side by side so one node is a single pass over each axis, two cache lines in total.
+// a child is an inner node when its count is 0, a leaf's index is its first entry in primitive_indices
+typedef struct agfx_bvh_node_t {
+    float min_x[AGFX_BVH_WIDTH];
+    float min_y[AGFX_BVH_WIDTH];
+    float min_z[AGFX_BVH_WIDTH];
+    float max_x[AGFX_BVH_WIDTH];
+    float max_y[AGFX_BVH_WIDTH];
+    float max_z[AGFX_BVH_WIDTH];
+    uint32_t children[AGFX_BVH_WIDTH];
+    uint32_t counts[AGFX_BVH_WIDTH];
+} agfx_bvh_node_t;
+
+typedef struct agfx_bvh_t {
+    size_t capacity;
+    size_t primitives_count;
+    agfx_aabb_t* primitive_bounds;
+    uint32_t* primitive_indices;
+    agfx_bvh_reference_t* references;
+    size_t nodes_capacity;
+    SDL_atomic_t nodes_count;
+    agfx_bvh_node_t* nodes;
+    uint32_t* traversal_stack;
+    float build_cost;
+    float cost;
+} agfx_bvh_t;
+
+// one 8x4 pixel tile of the software depth buffer, masked occlusion culling style.
+// z_max0 is a conservative farthest depth for the whole tile, z_max1 and mask are the layer still being covered
+typedef struct agfx_occlusion_tile_t {
+    uint32_t mask;
+    float z_max0;
+    float z_max1;
+} agfx_occlusion_tile_t;
+
+// set up once when added: edge functions that are positive inside, the depth plane and the pixel bounds
+typedef struct agfx_occlusion_triangle_t {
+    float edge_a[3];
+    float edge_b[3];
+    float edge_c[3];
+    float depth_a;
+    float depth_b;
+    float depth_c;
+    float depth_min;
+    float depth_max;
+    int32_t min_x;
+    int32_t min_y;
+    int32_t max_x;
+    int32_t max_y;
+} agfx_occlusion_triangle_t;
+
+// a position only copy of a mesh that is cheap enough to rasterize on the cpu, drawn once per instance of its mesh
+typedef struct agfx_occluder_t {
+    uint32_t mesh_index;
+    size_t positions_count;
+    agfx_vector3_t* positions;
+    size_t indices_count;
+    uint32_t* indices;
+} agfx_occluder_t;
+
+typedef struct agfx_software_occlusion_t {
+    uint32_t width;
+    uint32_t height;
+    uint32_t tiles_x;
+    uint32_t tiles_y;
+    agfx_occlusion_tile_t* tiles;
+    size_t triangles_count;
+    size_t triangles_capacity;
+    agfx_occlusion_triangle_t* triangles;
+    size_t objects_capacity;
+    uint8_t* visibility;
+    size_t occluders_count;
+    agfx_occluder_t* occluders;
+    size_t culled_count;
+} agfx_software_occlusion_t;
+
+typedef struct agfx_cpu_culling_t {
+    agfx_cull_bounds_t bounds;
+    uint32_t* visible_indices;
+    size_t visible_count;
+    uint8_t* draw_lods;
+    agfx_cull_path_t path;
+    uint64_t generation;
+} agfx_cpu_culling_t;
+
+#define AGFX_DEPTH_PYRAMID_MAX_LEVELS 16
+
+typedef struct agfx_cull_stats_t {
+    uint32_t visible_count;
+    uint32_t frustum_culled_count;
+    uint32_t occlusion_culled_count;
+    uint32_t padding;
+} agfx_cull_stats_t;
+
+typedef struct agfx_cull_push_constants_t {
+    uint32_t draws_count;
+    uint32_t phase;
+    uint32_t occlusion_enabled;
+    uint32_t compact;
+    float pyramid_width;
+    float pyramid_height;
+    uint32_t pyramid_levels;
+    float lod_scale;
+    uint32_t range_first_draws[AGFX_DRAW_RANGES_COUNT + 1];
+} agfx_cull_push_constants_t;
+
+typedef struct agfx_cull_frame_t {
+    VkBuffer early_draw_buffer;
+    VkDeviceMemory early_draw_buffer_memory;
+    VkBuffer late_draw_buffer;
+    VkDeviceMemory late_draw_buffer_memory;
+    VkBuffer stats_buffer;
+    VkDeviceMemory stats_buffer_memory;
+    void* stats_buffer_mapped;
+    VkDescriptorSet descriptor_set;
+} agfx_cull_frame_t;
+
+typedef struct agfx_gpu_culling_t {
+    size_t draws_capacity;
+    VkDescriptorSetLayout cull_descriptor_set_layout;
+    VkPipelineLayout cull_pipeline_layout;
+    VkPipeline cull_pipeline;
+    VkDescriptorSetLayout reduce_descriptor_set_layout;
+    VkPipelineLayout reduce_pipeline_layout;
+    VkPipeline reduce_pipeline;
+    VkDescriptorPool descriptor_pool;
+    VkSampler pyramid_sampler;
+    VkBuffer visibility_buffer;
+    VkDeviceMemory visibility_buffer_memory;
+    agfx_cull_frame_t* frames;
+    VkImage pyramid_image;
+    VkDeviceMemory pyramid_image_memory;
+    VkImageView pyramid_image_view;
+    VkImageView pyramid_mip_views[AGFX_DEPTH_PYRAMID_MAX_LEVELS];
+    VkDescriptorSet reduce_descriptor_sets[AGFX_DEPTH_PYRAMID_MAX_LEVELS];
+    uint32_t pyramid_width;
+    uint32_t pyramid_height;
+    uint32_t pyramid_levels;
+    uint32_t pyramid_depth_generation;
+    agfx_cull_stats_t stats;
+} agfx_gpu_culling_t;
+
+// counted over both phases, matches Stats in meshlet_cull.comp
+typedef struct agfx_meshlet_cull_stats_t {
+    uint32_t visible_count;
+    uint32_t frustum_culled_count;
+    uint32_t cone_culled_count;
+    uint32_t occlusion_culled_count;
+    uint32_t triangles_count;
+    uint32_t padding[3];
+} agfx_meshlet_cull_stats_t;
+
+typedef struct agfx_meshlet_cull_push_constants_t {
+    uint32_t phase;
+    uint32_t mesh_shader;
+    uint32_t occlusion_enabled;
+    uint32_t cone_culling;
+    float pyramid_width;
+    float pyramid_height;
+    uint32_t pyramid_levels;
+    uint32_t clusters_capacity;
+    uint32_t visibility;
+    uint32_t draws_count;
+    uint32_t range_first_draws[AGFX_DRAW_RANGES_COUNT + 1];
+    uint32_t range_first_clusters[AGFX_DRAW_RANGES_COUNT + 1];
+} agfx_meshlet_cull_push_constants_t;
+
+// the range a mesh pipeline draws and where its clusters are
+typedef struct agfx_meshlet_mesh_push_constants_t {
+    uint32_t range;
+    uint32_t first_cluster;
+    uint32_t clusters_capacity;
+} agfx_meshlet_mesh_push_constants_t;
+
+// one phase's visible clusters at a time: as indexed draw records, or as meshlet and object pairs with the task
+// commands that launch one mesh shader workgroup per pair. each range of the draw list has its own share of the clusters,
+// its own count and its own task command
+typedef struct agfx_meshlet_cull_frame_t {
+    VkBuffer draw_buffer;
+    VkDeviceMemory draw_buffer_memory;
+    VkBuffer cluster_buffer;
+    VkDeviceMemory cluster_buffer_memory;
+    VkBuffer task_buffer;
+    VkDeviceMemory task_buffer_memory;
+    VkBuffer stats_buffer;
+    VkDeviceMemory stats_buffer_memory;
+    void* stats_buffer_mapped;
+    VkDescriptorSet descriptor_set;
+    VkDescriptorSet mesh_descriptor_set;
+} agfx_meshlet_cull_frame_t;
+
+typedef struct agfx_meshlet_culling_t {
+    uint32_t available;
+    uint32_t mesh_shader_available;
+    uint32_t all_meshes_clustered;
+    size_t clusters_capacity;
+    uint32_t range_first_clusters[AGFX_DRAW_RANGES_COUNT + 1];
+    VkDescriptorSetLayout cull_descriptor_set_layout;
+    VkPipelineLayout cull_pipeline_layout;
+    VkPipeline cull_pipeline;
+    VkDescriptorSetLayout mesh_descriptor_set_layout;
+    VkPipelineLayout mesh_pipeline_layout;
+    // one per opaque and alpha tested bucket, blended objects are drawn whole
+    VkPipeline mesh_pipelines[AGFX_DRAW_BUCKET_BLEND];
+    VkDescriptorPool descriptor_pool;
+    agfx_meshlet_cull_frame_t* frames;
+    uint32_t pyramid_depth_generation;
+    agfx_meshlet_cull_stats_t stats;
+} agfx_meshlet_culling_t;
+
+// the geometry passes leave a cluster and triangle id per pixel, the shade pass finds the triangle again from it.
+// the image and its framebuffers follow the depth image, the shade framebuffers one per swapchain image
+typedef struct agfx_visibility_buffer_t {
+    uint32_t available;
+    VkDescriptorSetLayout descriptor_set_layout;
+    VkPipelineLayout pipeline_layout;
+    VkRenderPass render_pass;
+    VkRenderPass late_render_pass;
+    VkRenderPass shade_render_pass;
+    // single sided clusters are culled like the scene pipelines cull them, double sided and blended ones are not
+    VkPipeline geometry_pipeline;
+    VkPipeline double_sided_geometry_pipeline;
+    VkPipeline shade_pipeline;
+    VkSampler sampler;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet* descriptor_sets;
+    VkImage image;
+    VkDeviceMemory image_memory;
+    VkImageView image_view;
+    VkFramebuffer framebuffer;
+    uint32_t shade_framebuffers_count;
+    VkFramebuffer* shade_framebuffers;
+    uint32_t depth_generation;
+} agfx_visibility_buffer_t;
+
+// the primary writes one timestamp before and one after everything it records
+typedef struct agfx_gpu_timer_t {
+    uint32_t available;
+    VkQueryPool query_pool;
+    uint32_t queries_count;
+    double frame_ms;
+} agfx_gpu_timer_t;
+
+typedef struct agfx_geometry_buffer_t {
+    size_t vertices_count;
+    VkBuffer position_buffer;
+    VkDeviceMemory position_buffer_memory;
+    VkBuffer attribute_buffer;
+    VkDeviceMemory attribute_buffer_memory;
+    size_t indices_count;
     VkBuffer index_buffer;
     VkDeviceMemory index_buffer_memory;
-    VkImage texture_image;
-    VkDeviceMemory texture_image_memory;
-    VkImageView texture_image_view;
-    VkSampler texture_sampler;
-    void* image_data;
-    size_t image_size;
-    VkBuffer* uniform_buffers;
-    VkDeviceMemory* uniform_buffer_memories;
-    void** uniform_buffer_mapped;
-    VkDescriptorSet* descriptor_sets;
-} agfx_mesh_t;
+} agfx_geometry_buffer_t;
 
 typedef struct agfx_renderer_t {
     agfx_context_t* context;
@@ -134,16 +806,66 @@ typedef struct agfx_renderer_t {
     agfx_state_t* state;
     VkPipelineLayout pipeline_layout;
     VkRenderPass render_pass;
-    VkPipeline pipeline;
+    VkRenderPass late_render_pass;
+    agfx_pipeline_state_cache_t* pipeline_states;
+    // every key in a bucket merged, for the paths that draw a whole range of the list through one pipeline
+    uint32_t bucket_pipeline_keys[AGFX_DRAW_BUCKETS_COUNT];
     VkCommandPool command_pool;
-    VkCommandBuffer* command_buffers;
+    agfx_command_recorder_t command_recorder;
+    uint64_t commands_generation;
+    uint32_t commands_depth_generation;
+    // when set, every frame copies its swapchain image in here once it is drawn, for checks that read the picture back
+    VkBuffer capture_buffer;
+    uint32_t commands_pipelines_completed;
     VkSemaphore *image_available_semaphores;
     VkSemaphore *render_finished_semaphores;
     VkFence *in_flight_fences;
     VkDescriptorSetLayout descriptor_set_layout;
+    VkDescriptorSetLayout material_descriptor_set_layout;
     VkDescriptorPool descriptor_pool;
+    VkDescriptorSet material_descriptor_set;
+    uint32_t textures_capacity;
+    size_t textures_count;
+    agfx_texture_t* textures;
+    VkSampler texture_sampler;
+    size_t materials_count;
+    agfx_material_data_t* materials;
+    uint32_t* material_pipeline_keys;
+    VkBuffer material_buffer;
+    VkDeviceMemory material_buffer_memory;
+    agfx_frame_arena_t frame_arena;
+    agfx_frame_t* frames;
+    uint64_t object_generation;
+    agfx_draw_list_t draw_list;
+    agfx_gpu_culling_t gpu_culling;
+    agfx_cpu_culling_t cpu_culling;
+    agfx_bvh_t scene_bvh;
+    agfx_software_occlusion_t software_occlusion;
+    agfx_render_queue_t render_queue;
+    agfx_job_system_t* job_system;
     size_t meshes_count;
     agfx_mesh_t* meshes;
+    size_t instances_count;
+    agfx_instance_t* instances;
+    agfx_static_batch_stats_t static_batch_stats;
+    agfx_mesh_optimizer_stats_t mesh_optimizer_stats;
+    size_t lods_count;
+    agfx_mesh_lod_t* lods;
+    VkBuffer lod_buffer;
+    VkDeviceMemory lod_buffer_memory;
+    agfx_lod_stats_t lod_stats;
+    size_t meshlets_count;
+    VkBuffer meshlet_buffer;
+    VkDeviceMemory meshlet_buffer_memory;
+    VkBuffer meshlet_vertex_buffer;
+    VkDeviceMemory meshlet_vertex_buffer_memory;
+    VkBuffer meshlet_triangle_buffer;
+    VkDeviceMemory meshlet_triangle_buffer_memory;
+    agfx_meshlet_stats_t meshlet_stats;
+    agfx_meshlet_culling_t meshlet_culling;
+    agfx_visibility_buffer_t visibility_buffer;
+    agfx_gpu_timer_t gpu_timer;
+    agfx_geometry_buffer_t geometry_buffer;
 } agfx_renderer_t;
 
 typedef struct agfx_engine_t {
@@ -151,13 +873,21 @@ typedef struct agfx_engine_t {
     agfx_context_t context;
     agfx_swapchain_t swapchain;
     agfx_renderer_t renderer;
+    agfx_job_system_t job_system;
     agfx_state_t state;
 } agfx_engine_t;
 
-typedef struct agfx_uniform_buffer_object_t {
-    agfx_mat4x4_t model;
+typedef struct agfx_frame_constants_t {
     agfx_mat4x4_t view;
     agfx_mat4x4_t projection;
-} agfx_uniform_buffer_object_t;
+    agfx_mat4x4_t view_projection;
+} agfx_frame_constants_t;
+
+typedef struct agfx_object_data_t {
+    agfx_mat4x4_t model;
+    agfx_vector4_t bounding_sphere;
+    uint32_t material_index;
+    uint32_t padding[3];
+} agfx_object_data_t;
 
 #endif
\ No newline at end of file
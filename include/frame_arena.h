@@ -0,0 +1,16 @@
+#ifndef AGFX_FRAME_ARENA_H
+#define AGFX_FRAME_ARENA_H
+
+#include "engine_types.h"
+#include "helper.h"
+
+#define AGFX_FRAME_ARENA_FRAME_SIZE (4ull * 1024ull * 1024ull)
+#define AGFX_FRAME_ARENA_USAGE (VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT)
+
+agfx_result_t agfx_create_frame_arena(agfx_context_t* context, uint32_t frames_count, agfx_frame_arena_t* out_frame_arena);
+void agfx_free_frame_arena(agfx_context_t* context, agfx_frame_arena_t* frame_arena);
+
+void agfx_frame_arena_reset(agfx_frame_arena_t* frame_arena, uint32_t frame_index);
+agfx_result_t agfx_frame_arena_allocate(agfx_frame_arena_t* frame_arena, VkDeviceSize size, VkDeviceSize alignment, agfx_frame_allocation_t* out_allocation);
+
+#endif
\ No newline at end of file
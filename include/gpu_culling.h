@@ -0,0 +1,25 @@
+#ifndef AGFX_GPU_CULLING_H
+#define AGFX_GPU_CULLING_H
+
+#include "engine_types.h"
+#include "helper.h"
+#include "draw_list.h"
+
+#define AGFX_CULL_PHASE_EARLY 0
+#define AGFX_CULL_PHASE_LATE 1
+#define AGFX_CULL_WORKGROUP_SIZE 64
+#define AGFX_DEPTH_REDUCE_WORKGROUP_SIZE 8
+#define AGFX_CULL_DESCRIPTOR_COUNT 11
+#define AGFX_CULL_PYRAMID_BINDING 9
+#define AGFX_DEPTH_REDUCE_DESCRIPTOR_COUNT 2
+#define AGFX_CULL_DESCRIPTOR_POOL_SIZE_COUNT 4
+#define AGFX_DEPTH_PYRAMID_FORMAT VK_FORMAT_R32_SFLOAT
+
+agfx_result_t agfx_create_gpu_culling(agfx_renderer_t* renderer);
+void agfx_free_gpu_culling(agfx_renderer_t* renderer);
+
+agfx_result_t agfx_gpu_culling_begin_frame(agfx_renderer_t* renderer);
+void agfx_cmd_gpu_cull(agfx_renderer_t* renderer, VkCommandBuffer command_buffer, uint32_t phase);
+void agfx_cmd_build_depth_pyramid(agfx_renderer_t* renderer, VkCommandBuffer command_buffer);
+
+#endif
\ No newline at end of file
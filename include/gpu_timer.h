@@ -0,0 +1,18 @@
+#ifndef AGFX_GPU_TIMER_H
+#define AGFX_GPU_TIMER_H
+
+#include "engine_types.h"
+#include "helper.h"
+
+// a begin and an end timestamp per swapchain image, command buffers are cached per image. images past this go untimed
+#define AGFX_GPU_TIMER_MAX_IMAGES 8
+#define AGFX_GPU_TIMER_QUERIES_PER_IMAGE 2
+
+agfx_result_t agfx_create_gpu_timer(agfx_renderer_t* renderer);
+void agfx_free_gpu_timer(agfx_renderer_t* renderer);
+
+void agfx_gpu_timer_read(agfx_renderer_t* renderer, uint32_t image_index);
+void agfx_cmd_gpu_timer_begin(agfx_renderer_t* renderer, VkCommandBuffer command_buffer, uint32_t image_index);
+void agfx_cmd_gpu_timer_end(agfx_renderer_t* renderer, VkCommandBuffer command_buffer, uint32_t image_index);
+
+#endif
\ No newline at end of file
@@ -3,13 +3,23 @@
 
 #include "engine_types.h"
 
+// uploads larger than this always go through a staging buffer, even when device-local memory is host visible
+#define AGFX_DIRECT_UPLOAD_MAX_SIZE (64ull * 1024ull * 1024ull)
+
 agfx_result_t agfx_helper_command_buffer_end(agfx_renderer_t *renderer, VkCommandBuffer *command_buffer);
 agfx_result_t agfx_helper_command_buffer_begin(agfx_renderer_t *renderer, VkCommandBuffer* command_buffer);
 agfx_result_t agfx_helper_create_buffer(agfx_context_t *context, VkDeviceSize size, VkBufferUsageFlags usage_flags, VkMemoryPropertyFlags property_flags, VkBuffer* buffer, VkDeviceMemory* buffer_memory);
 agfx_result_t agfx_helper_create_image(agfx_context_t *context, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage_flags, VkMemoryPropertyFlags property_flags, VkImage* image, VkDeviceMemory* image_memory);
+agfx_result_t agfx_helper_create_mipmapped_image(agfx_context_t *context, uint32_t width, uint32_t height, uint32_t mip_levels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage_flags, VkMemoryPropertyFlags property_flags, VkImage* image, VkDeviceMemory* image_memory);
 agfx_result_t agfx_helper_create_image_view(agfx_context_t *context, VkImage image, VkFormat format, VkImageAspectFlags aspect_flags, VkImageView *image_view);
+agfx_result_t agfx_helper_create_image_view_for_mips(agfx_context_t *context, VkImage image, VkFormat format, VkImageAspectFlags aspect_flags, uint32_t base_mip_level, uint32_t mip_levels, VkImageView *image_view);
 agfx_result_t agfx_helper_copy_buffer(agfx_renderer_t *renderer, VkBuffer src, VkBuffer dst, VkDeviceSize size);
 agfx_result_t agfx_helper_copy_buffer_to_image(agfx_renderer_t *renderer, VkBuffer src, VkImage dst, uint32_t width, uint32_t height);
+agfx_result_t agfx_helper_create_direct_buffer(agfx_context_t *context, VkDeviceSize size, VkBufferUsageFlags usage_flags, VkBuffer* buffer, VkDeviceMemory* buffer_memory);
+void agfx_helper_free_buffer(agfx_context_t *context, VkBuffer buffer, VkDeviceMemory buffer_memory);
+agfx_result_t agfx_helper_upload_buffer(agfx_renderer_t *renderer, const void* data, VkDeviceSize size, VkBufferUsageFlags usage_flags, VkBuffer* buffer, VkDeviceMemory* buffer_memory);
+void agfx_helper_stream_copy(void* destination, const void* source, size_t size);
+agfx_result_t agfx_helper_create_shader_module(agfx_context_t *context, const char* path, VkShaderModule* shader_module);
 agfx_result_t agfx_helper_transition_image_layout(agfx_renderer_t *renderer, VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef AGFX_JOB_SYSTEM_H
+#define AGFX_JOB_SYSTEM_H
+
+#include "engine_types.h"
+
+#include <stdlib.h>
+
+#define AGFX_JOB_QUEUE_CAPACITY 4096
+// the main thread works too, so leave it a core
+#define AGFX_JOB_SYSTEM_MAX_THREADS 31
+
+typedef void (*agfx_job_range_function_t)(void* data, size_t begin, size_t end);
+
+agfx_result_t agfx_create_job_system(uint32_t threads_count, agfx_job_system_t* out_job_system);
+void agfx_free_job_system(agfx_job_system_t* job_system);
+
+void agfx_job_system_push(agfx_job_system_t* job_system, agfx_job_function_t function, void* data, SDL_atomic_t* counter);
+void agfx_job_system_push_background(agfx_job_system_t* job_system, agfx_job_function_t function, void* data, SDL_atomic_t* counter);
+void agfx_job_system_wait(agfx_job_system_t* job_system, SDL_atomic_t* counter);
+void agfx_job_system_parallel_for(agfx_job_system_t* job_system, size_t count, size_t batch_size, agfx_job_range_function_t function, void* data);
+
+#endif
\ No newline at end of file
@@ -29,6 +29,7 @@ agfx_mat4x4_t agfx_mat4x4_multiplied_by_mat4x4(agfx_mat4x4_t matrix_a, agfx_mat4
 
 agfx_mat4x4_t agfx_mat4x4_translation(agfx_vector3_t position);
 agfx_mat4x4_t agfx_mat4x4_rotation_euler(agfx_vector3_t rotation);
+agfx_mat4x4_t agfx_mat4x4_rotation_quaternion(agfx_vector4_t rotation);
 agfx_mat4x4_t agfx_mat4x4_scale(agfx_vector3_t scale);
 
 agfx_mat4x4_t agfx_mat4x4_look_at(agfx_vector3_t camera, agfx_vector3_t subject, agfx_vector3_t up);
@@ -0,0 +1,30 @@
+#ifndef AGFX_MESH_LOD_H
+#define AGFX_MESH_LOD_H
+
+#include "engine_types.h"
+#include "job_system.h"
+#include "math/vector.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+// every level aims for this fraction of the triangles of the one before
+#define AGFX_LOD_REDUCTION 0.5f
+// a level that could not get below this fraction of the previous one ends the chain
+#define AGFX_LOD_MIN_REDUCTION 0.85f
+#define AGFX_LOD_MIN_TRIANGLES 16
+// projected error in pixels a level may have and still be picked
+#define AGFX_LOD_PIXEL_ERROR 1.0f
+// the band around the threshold where an object keeps its current level, cull.comp has the same value
+#define AGFX_LOD_HYSTERESIS 0.15f
+#define AGFX_LOD_MESHES_PER_JOB 1
+
+agfx_result_t agfx_simplify_mesh(const agfx_vertex_t* vertices, size_t vertices_count, const uint32_t* indices, size_t indices_count, size_t target_indices_count, uint32_t* destination, size_t* out_indices_count, float* out_error);
+agfx_result_t agfx_build_mesh_lods(agfx_mesh_t* mesh);
+void agfx_build_lods(agfx_job_system_t* job_system, agfx_mesh_t* meshes, size_t meshes_count, agfx_lod_stats_t* out_stats);
+
+uint32_t agfx_select_lod(const agfx_mesh_lod_t* lods, uint32_t lods_count, uint32_t current_lod, float distance, float error_scale);
+
+#endif
\ No newline at end of file
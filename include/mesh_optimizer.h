@@ -0,0 +1,29 @@
+#ifndef AGFX_MESH_OPTIMIZER_H
+#define AGFX_MESH_OPTIMIZER_H
+
+#include "engine_types.h"
+#include "job_system.h"
+#include "math/vector.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// the fifo the reordering aims for and the stats are measured with
+#define AGFX_VERTEX_CACHE_SIZE 16
+// a tipsify cluster is split again once a piece of it is within this much of the whole cluster's acmr
+#define AGFX_OVERDRAW_ACMR_THRESHOLD 1.05f
+#define AGFX_MESH_OPTIMIZER_MESHES_PER_JOB 1
+
+agfx_result_t agfx_weld_vertices(agfx_vertex_t* vertices, size_t vertices_count, uint32_t* indices, size_t indices_count, size_t* out_vertices_count);
+agfx_result_t agfx_optimize_vertex_cache(uint32_t* indices, size_t indices_count, size_t vertices_count, uint32_t* out_cluster_starts, size_t* out_clusters_count);
+agfx_result_t agfx_optimize_overdraw(const agfx_vertex_t* vertices, uint32_t* indices, size_t indices_count, size_t vertices_count, const uint32_t* cluster_starts, size_t clusters_count);
+agfx_result_t agfx_optimize_vertex_fetch(agfx_vertex_t* vertices, size_t vertices_count, uint32_t* indices, size_t indices_count, size_t* out_vertices_count);
+agfx_vertex_cache_stats_t agfx_analyze_vertex_cache(const uint32_t* indices, size_t indices_count, size_t vertices_count);
+float agfx_vertex_cache_acmr(const agfx_vertex_cache_stats_t* stats);
+float agfx_vertex_cache_atvr(const agfx_vertex_cache_stats_t* stats);
+
+agfx_result_t agfx_optimize_mesh(agfx_mesh_t* mesh, agfx_vertex_cache_stats_t* out_before, agfx_vertex_cache_stats_t* out_after);
+void agfx_optimize_meshes(agfx_job_system_t* job_system, agfx_mesh_t* meshes, size_t meshes_count, agfx_mesh_optimizer_stats_t* out_stats);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef AGFX_MESHLET_H
+#define AGFX_MESHLET_H
+
+#include "engine_types.h"
+#include "job_system.h"
+#include "math/vector.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+// what one mesh shader workgroup outputs, 124 keeps the packed triangles of a full meshlet under 512 bytes
+#define AGFX_MESHLET_MAX_VERTICES 64
+#define AGFX_MESHLET_MAX_TRIANGLES 124
+// below this the triangles spread too far around the axis for the cone to cull anything worth the test
+#define AGFX_MESHLET_MIN_CONE_DOT 0.1f
+#define AGFX_MESHLET_MESHES_PER_JOB 1
+
+agfx_result_t agfx_build_mesh_meshlets(agfx_mesh_t* mesh);
+void agfx_build_meshlets(agfx_job_system_t* job_system, agfx_mesh_t* meshes, size_t meshes_count, agfx_meshlet_stats_t* out_stats);
+
+uint32_t agfx_meshlet_cone_culled(const agfx_meshlet_t* meshlet, agfx_vector3_t camera_position);
+
+#endif
\ No newline at end of file
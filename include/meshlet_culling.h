@@ -0,0 +1,29 @@
+#ifndef AGFX_MESHLET_CULLING_H
+#define AGFX_MESHLET_CULLING_H
+
+#include "engine_types.h"
+#include "helper.h"
+#include "draw_list.h"
+#include "gpu_culling.h"
+
+#define AGFX_MESHLET_CULL_DESCRIPTOR_COUNT 14
+#define AGFX_MESHLET_CULL_PYRAMID_BINDING 13
+#define AGFX_MESHLET_MESH_DESCRIPTOR_COUNT 7
+#define AGFX_MESHLET_DESCRIPTOR_POOL_SIZE_COUNT 3
+// mesh shader workgroups are launched in rows of this many, the smallest maxMeshWorkGroupCount the spec allows
+#define AGFX_MESHLET_TASK_ROW_SIZE 65535
+// one workgroup per object draw, past this they loop over the rest
+#define AGFX_MESHLET_CULL_MAX_WORKGROUPS 4096
+// a scene with more clusters than this keeps drawing whole objects
+#define AGFX_MESHLET_MAX_CLUSTERS (1 << 18)
+
+agfx_result_t agfx_create_meshlet_culling(agfx_renderer_t* renderer);
+void agfx_free_meshlet_culling(agfx_renderer_t* renderer);
+
+uint32_t agfx_meshlet_culling_enabled(agfx_renderer_t* renderer);
+uint32_t agfx_meshlet_culling_uses_mesh_shaders(agfx_renderer_t* renderer);
+void agfx_meshlet_culling_begin_frame(agfx_renderer_t* renderer);
+void agfx_cmd_meshlet_cull(agfx_renderer_t* renderer, VkCommandBuffer command_buffer, uint32_t phase);
+void agfx_cmd_draw_meshlets(agfx_renderer_t* renderer, VkCommandBuffer command_buffer);
+
+#endif
\ No newline at end of file
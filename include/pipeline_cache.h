@@ -0,0 +1,19 @@
+#ifndef AGFX_PIPELINE_CACHE_H
+#define AGFX_PIPELINE_CACHE_H
+
+#include "engine_types.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define AGFX_PIPELINE_CACHE_PATH "./pipeline_cache.bin"
+#define AGFX_PIPELINE_CACHE_MAGIC 0x43504741u
+// bump when the file header changes, older files are then dropped instead of misread
+#define AGFX_PIPELINE_CACHE_VERSION 1u
+
+agfx_result_t agfx_create_pipeline_cache(agfx_context_t* context, const char* path);
+agfx_result_t agfx_save_pipeline_cache(agfx_context_t* context, const char* path);
+void agfx_free_pipeline_cache(agfx_context_t* context);
+
+#endif
\ No newline at end of file
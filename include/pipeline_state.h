@@ -0,0 +1,64 @@
+#ifndef AGFX_PIPELINE_STATE_H
+#define AGFX_PIPELINE_STATE_H
+
+#include "engine_types.h"
+#include "helper.h"
+#include "job_system.h"
+
+// a key is the pipeline state a material asks for, it is also the pipeline index in render keys
+#define AGFX_PIPELINE_ALPHA_TEST (1u << 0)
+#define AGFX_PIPELINE_ALPHA_BLEND (1u << 1)
+#define AGFX_PIPELINE_DOUBLE_SIDED (1u << 2)
+#define AGFX_PIPELINE_DEPTH_SHIFT 3
+#define AGFX_PIPELINE_DEPTH_MASK (3u << AGFX_PIPELINE_DEPTH_SHIFT)
+// tested and written, what everything but blended surfaces uses without a prepass
+#define AGFX_PIPELINE_DEPTH_WRITE (0u << AGFX_PIPELINE_DEPTH_SHIFT)
+// positions only and no fragment shader
+#define AGFX_PIPELINE_DEPTH_PREPASS (1u << AGFX_PIPELINE_DEPTH_SHIFT)
+// shading after a prepass, only where the depth is the one it left
+#define AGFX_PIPELINE_DEPTH_EQUAL (2u << AGFX_PIPELINE_DEPTH_SHIFT)
+// tested but not written, so blended surfaces behind each other all show
+#define AGFX_PIPELINE_DEPTH_READ_ONLY (3u << AGFX_PIPELINE_DEPTH_SHIFT)
+// material features, each one a specialization constant so none of them is a branch per fragment
+#define AGFX_PIPELINE_HAS_TEXTURE (1u << 5)
+#define AGFX_PIPELINE_VERTEX_COLOR (1u << 6)
+// one pipeline for materials with and without a texture, the texture index is checked per fragment again
+#define AGFX_PIPELINE_MIXED_MATERIALS (1u << 7)
+#define AGFX_PIPELINE_FEATURE_MASK (AGFX_PIPELINE_HAS_TEXTURE | AGFX_PIPELINE_VERTEX_COLOR | AGFX_PIPELINE_MIXED_MATERIALS)
+#define AGFX_PIPELINE_KEY_BITS 8
+// open addressing over a power of two, well above the keys there are so probes stay short
+#define AGFX_PIPELINE_STATE_CACHE_CAPACITY 64
+#define AGFX_PIPELINE_STATE_EMPTY_KEY UINT32_MAX
+// specialization constant ids in shader.frag
+#define AGFX_PIPELINE_ALPHA_TEST_CONSTANT_ID 0
+#define AGFX_PIPELINE_HAS_TEXTURE_CONSTANT_ID 1
+#define AGFX_PIPELINE_VERTEX_COLOR_CONSTANT_ID 2
+#define AGFX_PIPELINE_MIXED_MATERIALS_CONSTANT_ID 3
+// a slot's compile state, an empty slot has none
+#define AGFX_PIPELINE_COMPILE_PENDING 1
+#define AGFX_PIPELINE_COMPILE_READY 2
+#define AGFX_PIPELINE_COMPILE_FAILED 3
+// ready and relinked with link time optimization, only pipeline libraries get here
+#define AGFX_PIPELINE_COMPILE_OPTIMIZED 4
+// what a key draws with until its own pipeline is ready, built before anything else. culling both sides keeps whatever the
+// key's winding turns out to be from showing holes, and every feature checked per fragment keeps it looking like the material
+#define AGFX_PIPELINE_FALLBACK_KEY (AGFX_PIPELINE_DOUBLE_SIDED | AGFX_PIPELINE_FEATURE_MASK)
+
+agfx_result_t agfx_create_pipeline_state_cache(agfx_renderer_t* renderer);
+void agfx_free_pipeline_state_cache(agfx_renderer_t* renderer);
+
+uint32_t agfx_pipeline_key_is_opaque(uint32_t key);
+uint32_t agfx_pipeline_key_bucket(uint32_t key);
+uint32_t agfx_pipeline_key_draw_range(uint32_t key);
+uint32_t agfx_pipeline_bucket_key(uint32_t bucket);
+void agfx_pipeline_specialization(uint32_t key, agfx_pipeline_specialization_t* out_specialization);
+agfx_result_t agfx_pipeline_state_cache_request(agfx_renderer_t* renderer, uint32_t key, uint32_t* out_state);
+agfx_result_t agfx_pipeline_state_cache_prepare(agfx_renderer_t* renderer, uint32_t key);
+agfx_result_t agfx_pipeline_state_cache_get(agfx_renderer_t* renderer, uint32_t key, VkPipeline* out_pipeline);
+void agfx_pipeline_state_cache_wait(agfx_renderer_t* renderer);
+VkPipeline agfx_pipeline_state_cache_find(const agfx_pipeline_state_cache_t* cache, uint32_t key);
+VkPipeline agfx_pipeline_state_cache_resolve(const agfx_pipeline_state_cache_t* cache, uint32_t key);
+agfx_result_t agfx_pipeline_state_create_mesh_pipeline(const agfx_pipeline_state_cache_t* cache, uint32_t key, VkShaderModule mesh_shader_module, VkPipelineLayout pipeline_layout, VkPipeline* out_pipeline);
+void agfx_pipeline_state_cache_stats(const agfx_pipeline_state_cache_t* cache, agfx_pipeline_compile_stats_t* out_stats);
+
+#endif
\ No newline at end of file
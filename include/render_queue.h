@@ -0,0 +1,42 @@
+#ifndef AGFX_RENDER_QUEUE_H
+#define AGFX_RENDER_QUEUE_H
+
+#include "engine_types.h"
+#include "job_system.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// opaque keys: layer 8 | pipeline 12 | material 20 | depth 24, nearest first
+// transparent keys: layer 8 | inverted depth 24 | pipeline 12 | material 20, farthest first
+#define AGFX_RENDER_LAYER_OPAQUE 0
+#define AGFX_RENDER_LAYER_TRANSPARENT 1
+#define AGFX_RENDER_KEY_LAYER_SHIFT 56
+#define AGFX_RENDER_KEY_PIPELINE_BITS 12
+#define AGFX_RENDER_KEY_MATERIAL_BITS 20
+#define AGFX_RENDER_KEY_DEPTH_BITS 24
+
+#define AGFX_RENDER_QUEUE_RADIX_BITS 8
+#define AGFX_RENDER_QUEUE_RADIX_SIZE (1 << AGFX_RENDER_QUEUE_RADIX_BITS)
+#define AGFX_RENDER_QUEUE_MAX_CHUNKS (AGFX_JOB_SYSTEM_MAX_THREADS + 1)
+// fewer items than this per chunk are sorted on the calling thread
+#define AGFX_RENDER_QUEUE_MIN_CHUNK 4096
+// what drawing in mesh order would bind for every draw: pipeline, vertex buffer, index buffer, material set
+#define AGFX_RENDER_QUEUE_NAIVE_BINDS_PER_DRAW 4
+// vertex buffer, index buffer and the bindless material set go once per pass
+#define AGFX_RENDER_QUEUE_SHARED_BINDS 3
+
+uint32_t agfx_render_depth_bucket(float view_depth);
+uint64_t agfx_render_key_opaque(uint32_t pipeline_index, uint32_t material_index, uint32_t depth_bucket);
+uint64_t agfx_render_key_transparent(uint32_t pipeline_index, uint32_t material_index, uint32_t depth_bucket);
+uint32_t agfx_render_key_pipeline(uint64_t key);
+
+agfx_result_t agfx_create_render_queue(size_t capacity, agfx_render_queue_t* out_render_queue);
+void agfx_free_render_queue(agfx_render_queue_t* render_queue);
+
+void agfx_render_queue_clear(agfx_render_queue_t* render_queue);
+void agfx_render_queue_push(agfx_render_queue_t* render_queue, uint64_t key, uint32_t draw_index);
+void agfx_render_queue_sort(agfx_render_queue_t* render_queue, agfx_job_system_t* job_system);
+void agfx_render_queue_encode(agfx_render_queue_t* render_queue);
+
+#endif
\ No newline at end of file
@@ -3,6 +3,22 @@
 
 #include "engine_types.h"
 #include "helper.h"
+#include "frame_arena.h"
+#include "draw_list.h"
+#include "gpu_culling.h"
+#include "cpu_culling.h"
+#include "bvh.h"
+#include "job_system.h"
+#include "software_occlusion.h"
+#include "command_recorder.h"
+#include "render_queue.h"
+#include "mesh_optimizer.h"
+#include "mesh_lod.h"
+#include "meshlet.h"
+#include "meshlet_culling.h"
+#include "visibility_buffer.h"
+#include "gpu_timer.h"
+#include "pipeline_state.h"
 #include "aluragltf/include/glb.h"
 
 #include <sys/stat.h>
@@ -11,7 +27,22 @@
 #include <SDL2/SDL_image.h>
 
 #define AGFX_MAX_FRAMES_IN_FLIGHT 2
-#define AGFX_DESCRIPTOR_COUNT 2
+#define AGFX_DESCRIPTOR_COUNT 3
+#define AGFX_MATERIAL_DESCRIPTOR_COUNT 2
+#define AGFX_DESCRIPTOR_POOL_SIZE_COUNT 3
+#define AGFX_MAX_TEXTURES 4096
+#define AGFX_SUBPASS_DEPENDENCY_COUNT 2
+#define AGFX_BVH_CULL_MIN_OBJECTS 1024
+#define AGFX_OCCLUDER_MAX_TRIANGLES 2048
+#define AGFX_OCCLUDER_MIN_RELATIVE_RADIUS 0.25f
+#define AGFX_INSTANCE_BUFFER_HALVES 2
+// glTF forbids cycles, the limit only keeps a broken file from overflowing the stack
+#define AGFX_MODEL_MAX_NODE_DEPTH 64
+// primitives bigger than this already pay for their own draw and are left alone by static batching
+#define AGFX_STATIC_BATCH_MAX_MESH_VERTICES 4096
+// a merged chunk stops growing here, so it stays small enough to cull
+#define AGFX_STATIC_BATCH_MAX_VERTICES 32768
+#define AGFX_STATIC_BATCH_MORTON_BITS 10
 
 // #define AGFX_VERTEX_ARRAY_SIZE 24
 // static const agfx_vertex_t agfx_vertices[AGFX_VERTEX_ARRAY_SIZE] = {
@@ -51,31 +82,41 @@
 //     20, 21, 22, 22, 23, 20
 // };
 
-static const VkVertexInputBindingDescription agfx_vertex_input_binding_description = {
-    .binding = 0,
-    .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-    .stride = sizeof(agfx_vertex_t)
+// positions and the other attributes come from two streams, a pass that only needs depth binds the first alone
+#define AGFX_VERTEX_INPUT_BINDING_DESCRIPTION_SIZE 2
+static const VkVertexInputBindingDescription agfx_vertex_input_binding_descriptions[AGFX_VERTEX_INPUT_BINDING_DESCRIPTION_SIZE] = {
+    {
+        .binding = 0,
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+        .stride = sizeof(agfx_vector3_t)
+    },
+    {
+        .binding = 1,
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+        .stride = sizeof(agfx_vertex_attributes_t)
+    }
 };
 
 #define AGFX_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_SIZE 3
+// the position is the first attribute, and the only one of a position only pipeline
 static const VkVertexInputAttributeDescription agfx_vertex_input_attribute_description[AGFX_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_SIZE] = {
     {
         .binding = 0,
         .location = 0,
         .format = VK_FORMAT_R32G32B32_SFLOAT,
-        .offset = offsetof(agfx_vertex_t, position)
+        .offset = 0
     },
     {
-        .binding = 0,
+        .binding = 1,
         .location = 1,
-        .format = VK_FORMAT_R32G32B32_SFLOAT,
-        .offset = offsetof(agfx_vertex_t, color)
+        .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+        .offset = offsetof(agfx_vertex_attributes_t, color)
     },
     {
-        .binding = 0,
+        .binding = 1,
         .location = 2,
         .format = VK_FORMAT_R32G32_SFLOAT,
-        .offset = offsetof(agfx_vertex_t, texture_coordinate)
+        .offset = offsetof(agfx_vertex_attributes_t, texture_coordinate)
     }
 };
 
@@ -83,17 +124,32 @@ agfx_result_t create_descriptor_set_layout(agfx_renderer_t *renderer);
 agfx_result_t create_descriptor_pool(agfx_renderer_t *renderer);
 agfx_result_t create_descriptor_sets(agfx_renderer_t *renderer);
 agfx_result_t create_pipeline(agfx_renderer_t *renderer);
+agfx_result_t create_scene_render_pass(agfx_renderer_t *renderer, uint32_t is_late_pass, VkRenderPass* render_pass);
 agfx_result_t create_render_pass(agfx_renderer_t *renderer);
 agfx_result_t create_command_pool(agfx_renderer_t *renderer);
 agfx_result_t create_command_buffers(agfx_renderer_t *renderer);
 agfx_result_t create_sync_objects(agfx_renderer_t *renderer);
-agfx_result_t create_vertex_buffer_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh);
-agfx_result_t create_index_buffer_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh);
-agfx_result_t create_uniform_buffers_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh);
+agfx_result_t create_geometry_buffer(agfx_renderer_t *renderer);
+agfx_result_t create_meshlet_buffers(agfx_renderer_t *renderer);
+agfx_result_t create_lod_buffer(agfx_renderer_t *renderer);
+agfx_result_t create_frame_resources(agfx_renderer_t *renderer);
+agfx_result_t build_draw_list(agfx_renderer_t *renderer);
+void update_cull_bounds(agfx_renderer_t *renderer);
+void queue_visible_draws(agfx_renderer_t *renderer, agfx_frame_t* frame, agfx_mat4x4_t view_projection);
+uint32_t pack_instanced_draws(agfx_renderer_t *renderer, agfx_frame_t* frame, agfx_draw_record_t* draws);
+void cull_draws_on_cpu(agfx_renderer_t *renderer, agfx_frame_t* frame, agfx_mat4x4_t view_projection);
+agfx_result_t create_occluders(agfx_renderer_t *renderer);
+void cull_occluded_on_cpu(agfx_renderer_t *renderer, agfx_mat4x4_t view_projection);
 agfx_result_t load_model(agfx_renderer_t *renderer);
-agfx_result_t create_texture_images_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh, void* image_data, size_t image_size);
-agfx_result_t create_texture_image_view_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh);
-agfx_result_t create_texture_sampler_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh);
+agfx_result_t load_mesh_primitive(agfx_renderer_t *renderer, agltf_json_mesh_primitive_t* primitive, agfx_mesh_t* engine_mesh);
+agfx_result_t group_instances_by_mesh(agfx_renderer_t *renderer);
+agfx_result_t batch_static_meshes(agfx_renderer_t *renderer);
+void compute_mesh_bounds(agfx_mesh_t* mesh);
+agfx_result_t create_texture_image(agfx_renderer_t *renderer, agfx_texture_t* texture, void* image_data, size_t image_size);
+agfx_result_t create_texture_image_view(agfx_renderer_t *renderer, agfx_texture_t* texture);
+agfx_result_t create_texture_sampler(agfx_renderer_t *renderer);
+agfx_result_t create_texture_table(agfx_renderer_t *renderer, agltf_glb_t* model);
+agfx_result_t create_material_table(agfx_renderer_t *renderer, agltf_glb_t* model);
 
 void free_descriptor_set_layout(agfx_renderer_t *renderer);
 void free_descriptor_pool(agfx_renderer_t *renderer);
@@ -103,17 +159,28 @@ void free_render_pass(agfx_renderer_t *renderer);
 void free_command_pool(agfx_renderer_t *renderer);
 void free_command_buffers(agfx_renderer_t *renderer);
 void free_sync_objects(agfx_renderer_t *renderer);
-void free_vertex_buffer_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh);
-void free_index_buffer_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh);
-void free_uniform_buffers_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh);
-void free_texture_image_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh);
-void free_texture_image_view_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh);
-void free_texture_sampler_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh);
+void free_geometry_buffer(agfx_renderer_t *renderer);
+void free_meshlet_buffers(agfx_renderer_t *renderer);
+void free_lod_buffer(agfx_renderer_t *renderer);
+void free_frame_resources(agfx_renderer_t *renderer);
+void free_texture_image(agfx_renderer_t *renderer, agfx_texture_t* texture);
+void free_texture_image_view(agfx_renderer_t *renderer, agfx_texture_t* texture);
+void free_texture_sampler(agfx_renderer_t *renderer);
+void free_texture_table(agfx_renderer_t *renderer);
+void free_material_table(agfx_renderer_t *renderer);
 void free_model(agfx_renderer_t *renderer);
 
+agfx_frame_constants_t agfx_camera_constants(agfx_renderer_t *renderer);
 void agfx_update_uniform_buffer(agfx_renderer_t *renderer);
-agfx_result_t agfx_create_renderer(agfx_context_t* context, agfx_swapchain_t* swapchain, agfx_state_t* state, agfx_renderer_t* out_renderer);
+agfx_result_t agfx_create_renderer(agfx_context_t* context, agfx_swapchain_t* swapchain, agfx_state_t* state, agfx_job_system_t* job_system, agfx_renderer_t* out_renderer);
 void agfx_free_renderer(agfx_renderer_t *renderer);
+void bind_scene_state(agfx_renderer_t *renderer, VkCommandBuffer command_buffer);
+VkPipeline scene_pipeline(agfx_renderer_t *renderer, uint32_t pipeline_index);
+VkPipeline depth_prepass_pipeline(agfx_renderer_t *renderer, uint32_t pipeline_index);
+void begin_scene_pass(agfx_renderer_t *renderer, VkCommandBuffer command_buffer, VkRenderPass render_pass, uint32_t image_index, VkSubpassContents contents);
+agfx_result_t record_scene_pass(agfx_renderer_t *renderer, VkCommandBuffer command_buffer, VkRenderPass render_pass, uint32_t image_index, VkBuffer draw_buffer, VkDeviceSize draw_buffer_offset, size_t draws_capacity, uint32_t draws_count, const agfx_render_batch_t* batches, size_t batches_count, uint32_t gpu_culled);
+void record_meshlet_pass(agfx_renderer_t *renderer, VkCommandBuffer command_buffer, VkRenderPass render_pass, uint32_t image_index, uint32_t phase);
+void agfx_invalidate_commands(agfx_renderer_t *renderer);
 agfx_result_t agfx_record_command_buffers(agfx_renderer_t *renderer, uint32_t image_index);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef AGFX_SOFTWARE_OCCLUSION_H
+#define AGFX_SOFTWARE_OCCLUSION_H
+
+#include "engine_types.h"
+#include "job_system.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#define AGFX_OCCLUSION_TILE_WIDTH 8
+#define AGFX_OCCLUSION_TILE_HEIGHT 4
+#define AGFX_OCCLUSION_FULL_MASK UINT32_MAX
+#define AGFX_OCCLUSION_WIDTH 320
+#define AGFX_OCCLUSION_HEIGHT 192
+#define AGFX_OCCLUSION_MAX_TRIANGLES 65536
+// rows of tiles per rasterizer job, every job walks the whole triangle list
+#define AGFX_OCCLUSION_ROWS_PER_JOB 4
+#define AGFX_OCCLUSION_OBJECTS_PER_JOB 256
+
+agfx_result_t agfx_create_software_occlusion(uint32_t width, uint32_t height, size_t triangles_capacity, size_t objects_capacity, agfx_software_occlusion_t* out_software_occlusion);
+void agfx_free_software_occlusion(agfx_software_occlusion_t* software_occlusion);
+
+agfx_result_t agfx_software_occlusion_add_occluder_proxy(agfx_software_occlusion_t* software_occlusion, uint32_t mesh_index, const agfx_vertex_t* vertices, size_t vertices_count, const uint32_t* indices, size_t indices_count);
+
+void agfx_software_occlusion_clear(agfx_software_occlusion_t* software_occlusion);
+void agfx_software_occlusion_add_triangles(agfx_software_occlusion_t* software_occlusion, const agfx_vector3_t* positions, const uint32_t* indices, size_t indices_count, agfx_mat4x4_t model_view_projection);
+void agfx_software_occlusion_rasterize(agfx_software_occlusion_t* software_occlusion, agfx_job_system_t* job_system);
+
+uint32_t agfx_software_occlusion_test_aabb(const agfx_software_occlusion_t* software_occlusion, agfx_aabb_t bounds, agfx_mat4x4_t view_projection);
+size_t agfx_software_occlusion_filter(agfx_software_occlusion_t* software_occlusion, agfx_job_system_t* job_system, agfx_mat4x4_t view_projection, const agfx_aabb_t* bounds, uint32_t* indices, size_t indices_count);
+
+#endif
\ No newline at end of file
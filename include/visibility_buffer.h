@@ -0,0 +1,29 @@
+#ifndef AGFX_VISIBILITY_BUFFER_H
+#define AGFX_VISIBILITY_BUFFER_H
+
+#include "engine_types.h"
+#include "helper.h"
+#include "draw_list.h"
+#include "gpu_culling.h"
+#include "meshlet_culling.h"
+
+#define AGFX_VISIBILITY_FORMAT VK_FORMAT_R32_UINT
+// an id is the cluster's slot over both phases shifted past the triangle within it, 124 triangles fit in 7 bits
+#define AGFX_VISIBILITY_TRIANGLE_BITS 7
+// cleared to this, no slot reaches it
+#define AGFX_VISIBILITY_EMPTY 0xFFFFFFFFu
+// visibility image, cluster pairs, meshlets, indices, positions, attributes
+#define AGFX_VISIBILITY_DESCRIPTOR_COUNT 6
+#define AGFX_VISIBILITY_IMAGE_BINDING 0
+#define AGFX_VISIBILITY_DESCRIPTOR_POOL_SIZE_COUNT 2
+#define AGFX_VISIBILITY_ATTACHMENT_COUNT 2
+
+agfx_result_t agfx_create_visibility_buffer(agfx_renderer_t* renderer);
+void agfx_free_visibility_buffer(agfx_renderer_t* renderer);
+
+uint32_t agfx_visibility_buffer_enabled(agfx_renderer_t* renderer);
+agfx_result_t agfx_visibility_buffer_begin_frame(agfx_renderer_t* renderer);
+void agfx_cmd_visibility_geometry_pass(agfx_renderer_t* renderer, VkCommandBuffer command_buffer, uint32_t phase);
+void agfx_cmd_visibility_shade_pass(agfx_renderer_t* renderer, VkCommandBuffer command_buffer, uint32_t image_index);
+
+#endif
\ No newline at end of file
@@ -66,6 +66,12 @@ typedef enum agltf_json_image_mime_type_t {
     AGLTF_JSON_IMAGE_MIME_TYPE_UNKNOWN,
 } agltf_json_image_mime_type_t;
 
+typedef enum agltf_json_alpha_mode_t {
+    AGLTF_JSON_ALPHA_MODE_OPAQUE,
+    AGLTF_JSON_ALPHA_MODE_MASK,
+    AGLTF_JSON_ALPHA_MODE_BLEND,
+} agltf_json_alpha_mode_t;
+
 typedef struct agltf_accessor_data_t {
     void* data;
     size_t size;
@@ -81,7 +87,9 @@ typedef struct agltf_image_data_t {
 typedef struct agltf_json_accessor_t {
     size_t index;
     agltf_json_buffer_view_t* buffer_view;
+    uint32_t byte_offset;
     agltf_json_component_type_t component_type;
+    uint8_t normalized;
     uint32_t count;
     agltf_json_accessor_type_t type;
     agltf_accessor_data_t data;
@@ -124,6 +132,9 @@ typedef struct agltf_json_material_t {
     size_t index;
     char* name;
     agltf_json_material_pbr_t pbr;
+    agltf_json_alpha_mode_t alpha_mode;
+    float alpha_cutoff;
+    uint32_t double_sided;
 } agltf_json_material_t;
 
 typedef struct agltf_json_mesh_primitive_attribute_t {
@@ -146,6 +157,29 @@ typedef struct agltf_json_mesh_t {
     agltf_json_mesh_primitive_t* primitives;
 } agltf_json_mesh_t;
 
+// EXT_mesh_gpu_instancing, one transform per instance built from whichever accessors are there
+typedef struct agltf_json_node_instancing_t {
+    uint32_t count;
+    agltf_json_accessor_t* translation;
+    agltf_json_accessor_t* rotation;
+    agltf_json_accessor_t* scale;
+} agltf_json_node_instancing_t;
+
+// the local transform is either the matrix or translation, rotation and scale, both are filled with the spec defaults
+typedef struct agltf_json_node_t {
+    size_t index;
+    char* name;
+    agltf_json_mesh_t* mesh;
+    size_t children_count;
+    size_t* children;
+    uint8_t has_matrix;
+    float matrix[16];
+    float translation[3];
+    float rotation[4];
+    float scale[3];
+    agltf_json_node_instancing_t instancing;
+} agltf_json_node_t;
+
 typedef struct agltf_stat_t {
     uint32_t magic;
     uint32_t version;
@@ -173,6 +207,8 @@ typedef struct agltf_glb_t {
     agltf_json_texture_t* textures;
     size_t materials_count;
     agltf_json_material_t* materials;
+    size_t nodes_count;
+    agltf_json_node_t* nodes;
 } agltf_glb_t;
 
 #endif
\ No newline at end of file
@@ -142,7 +142,10 @@ agltf_result_t set_accessors_from_json(cJSON* object, agltf_glb_t *gltf)
         agltf_json_accessor_t* accessor = &gltf->accessors[accessor_index];
         accessor->index = accessor_index;
         accessor->buffer_view = &gltf->buffer_views[(size_t) cJSON_GetNumberValue(cJSON_GetObjectItem(json_accessor, "bufferView"))];
+        // instancing data usually shares one buffer view, so the accessor's own offset matters
+        accessor->byte_offset = cJSON_HasObjectItem(json_accessor, "byteOffset") ? (uint32_t) cJSON_GetNumberValue(cJSON_GetObjectItem(json_accessor, "byteOffset")) : 0;
         accessor->component_type = get_component_type_from_value((uint32_t) cJSON_GetNumberValue(cJSON_GetObjectItem(json_accessor, "componentType")));
+        accessor->normalized = cJSON_IsTrue(cJSON_GetObjectItem(json_accessor, "normalized"));
         accessor->count = (uint32_t) cJSON_GetNumberValue(cJSON_GetObjectItem(json_accessor, "count"));
         accessor->type = get_accessor_type_from_string(cJSON_GetStringValue(cJSON_GetObjectItem(json_accessor, "type")));
         accessor_index++;
@@ -207,6 +210,15 @@ agltf_json_image_mime_type_t get_image_mime_type_from_value(char* image_mime_typ
     return AGLTF_JSON_IMAGE_MIME_TYPE_UNKNOWN;
 }
 
+// anything unknown is treated like a missing key
+agltf_json_alpha_mode_t get_alpha_mode_from_value(char* alpha_mode_value)
+{
+    if (alpha_mode_value == NULL) return AGLTF_JSON_ALPHA_MODE_OPAQUE;
+    if (strcmp(alpha_mode_value, "MASK") == 0) return AGLTF_JSON_ALPHA_MODE_MASK;
+    if (strcmp(alpha_mode_value, "BLEND") == 0) return AGLTF_JSON_ALPHA_MODE_BLEND;
+    return AGLTF_JSON_ALPHA_MODE_OPAQUE;
+}
+
 agltf_result_t set_images_from_json(cJSON* object, agltf_glb_t *gltf)
 {
     cJSON* json_images = cJSON_GetObjectItem(object, "images");
@@ -284,29 +296,49 @@ agltf_result_t set_materials_from_json(cJSON* object, agltf_glb_t *gltf)
         material->index = material_index;
         material->name = create_from_json_string(json_material, "name");
 
+        // spec defaults, a missing key would give NaN from cJSON
+        material->pbr.base_color_factor[0] = 1.0f;
+        material->pbr.base_color_factor[1] = 1.0f;
+        material->pbr.base_color_factor[2] = 1.0f;
+        material->pbr.base_color_factor[3] = 1.0f;
+        material->pbr.metallic_factor = 1.0f;
+        material->pbr.roughness_factor = 1.0f;
+        material->alpha_cutoff = 0.5f;
+
+        material->alpha_mode = get_alpha_mode_from_value(cJSON_GetStringValue(cJSON_GetObjectItem(json_material, "alphaMode")));
+        if (cJSON_HasObjectItem(json_material, "alphaCutoff"))
+        {
+            material->alpha_cutoff = (float)cJSON_GetNumberValue(cJSON_GetObjectItem(json_material, "alphaCutoff"));
+        }
+        material->double_sided = cJSON_IsTrue(cJSON_GetObjectItem(json_material, "doubleSided")) ? 1 : 0;
+
         cJSON* json_pbr = cJSON_GetObjectItem(json_material, "pbrMetallicRoughness");
         if (json_pbr != NULL)
         {
-            material->pbr.metallic_factor = (float)cJSON_GetNumberValue(cJSON_GetObjectItem(json_pbr, "metallicFactor"));
-            material->pbr.roughness_factor = (float)cJSON_GetNumberValue(cJSON_GetObjectItem(json_pbr, "roughnessFactor"));
+            if (cJSON_HasObjectItem(json_pbr, "metallicFactor"))
+            {
+                material->pbr.metallic_factor = (float)cJSON_GetNumberValue(cJSON_GetObjectItem(json_pbr, "metallicFactor"));
+            }
+            if (cJSON_HasObjectItem(json_pbr, "roughnessFactor"))
+            {
+                material->pbr.roughness_factor = (float)cJSON_GetNumberValue(cJSON_GetObjectItem(json_pbr, "roughnessFactor"));
+            }
 
             cJSON* json_base_color_texture = cJSON_GetObjectItem(json_pbr, "baseColorTexture");
             if (json_base_color_texture != NULL)
             {
                 material->pbr.base_color_texture.texture = &gltf->textures[(size_t)cJSON_GetNumberValue(cJSON_GetObjectItem(json_base_color_texture, "index"))];
-                material->pbr.base_color_texture.tex_coord = (uint32_t)cJSON_GetNumberValue(cJSON_GetObjectItem(json_base_color_texture, "texCoord"));
+                if (cJSON_HasObjectItem(json_base_color_texture, "texCoord"))
+                {
+                    material->pbr.base_color_texture.tex_coord = (uint32_t)cJSON_GetNumberValue(cJSON_GetObjectItem(json_base_color_texture, "texCoord"));
+                }
             }
 
             cJSON* json_base_color_factor;
             cJSON* json_base_color_factors = cJSON_GetObjectItem(json_pbr, "baseColorFactor");
 
-            if (json_base_color_factors == NULL)
+            if (json_base_color_factors != NULL)
             {
-                material->pbr.base_color_factor[0] = 1.0f;
-                material->pbr.base_color_factor[1] = 1.0f;
-                material->pbr.base_color_factor[2] = 1.0f;
-                material->pbr.base_color_factor[3] = 1.0f;
-            } else {
                 size_t index = 0;
                 cJSON_ArrayForEach(json_base_color_factor, json_base_color_factors)
                 {
@@ -388,6 +420,8 @@ agltf_result_t set_primitives_from_json(agltf_glb_t *gltf, cJSON* object, agltf_
     {
         agltf_json_mesh_primitive_t* primitive = &mesh->primitives[primitive_index];
         primitive->index = primitive_index;
+        primitive->indices = NULL;
+        primitive->material = NULL;
 
         result = set_primitive_attributes_from_json(gltf, json_primitive, primitive);
         if (result != AGLTF_SUCCESS)
@@ -463,6 +497,130 @@ void free_meshes(agltf_glb_t *gltf)
     free(gltf->meshes);
 }
 
+void set_floats_from_json(cJSON* object, char* key, float* values, size_t values_count)
+{
+    cJSON* json_values = cJSON_GetObjectItem(object, key);
+    if (json_values == NULL) return;
+
+    cJSON* json_value;
+    size_t index = 0;
+    cJSON_ArrayForEach(json_value, json_values)
+    {
+        if (index < values_count) values[index] = (float)cJSON_GetNumberValue(json_value);
+        index++;
+    }
+}
+
+agltf_json_accessor_t* get_instancing_accessor_from_json(agltf_glb_t *gltf, cJSON* attributes, char* name)
+{
+    cJSON* json_accessor = cJSON_GetObjectItem(attributes, name);
+    if (json_accessor == NULL) return NULL;
+    return &gltf->accessors[(size_t) cJSON_GetNumberValue(json_accessor)];
+}
+
+// every attribute has to describe the same number of instances, a node without any is drawn once
+agltf_result_t set_node_instancing_from_json(agltf_glb_t *gltf, cJSON* object, agltf_json_node_t *node)
+{
+    cJSON* json_extensions = cJSON_GetObjectItem(object, "extensions");
+    cJSON* json_instancing = cJSON_GetObjectItem(json_extensions, "EXT_mesh_gpu_instancing");
+    cJSON* json_attributes = cJSON_GetObjectItem(json_instancing, "attributes");
+    if (json_attributes == NULL) return AGLTF_SUCCESS;
+
+    node->instancing.translation = get_instancing_accessor_from_json(gltf, json_attributes, "TRANSLATION");
+    node->instancing.rotation = get_instancing_accessor_from_json(gltf, json_attributes, "ROTATION");
+    node->instancing.scale = get_instancing_accessor_from_json(gltf, json_attributes, "SCALE");
+
+    agltf_json_accessor_t* accessors[3] = {node->instancing.translation, node->instancing.rotation, node->instancing.scale};
+    for (size_t i = 0; i < 3; ++i)
+    {
+        if (accessors[i] == NULL) continue;
+        if (node->instancing.count != 0 && node->instancing.count != accessors[i]->count)
+        {
+            return AGLTF_INVALID_JSON_STRUCTURE_ERROR;
+        }
+        node->instancing.count = accessors[i]->count;
+    }
+    return AGLTF_SUCCESS;
+}
+
+void free_nodes(agltf_glb_t *gltf)
+{
+    for (size_t i = 0; i < gltf->nodes_count; ++i)
+    {
+        agltf_json_node_t* node = &gltf->nodes[i];
+        free(node->name);
+        free(node->children);
+    }
+    free(gltf->nodes);
+}
+
+agltf_result_t set_nodes_from_json(cJSON* object, agltf_glb_t *gltf)
+{
+    cJSON* json_nodes = cJSON_GetObjectItem(object, "nodes");
+
+    // no nodes means no scene graph, every mesh is drawn once where it is
+    if (json_nodes == NULL)
+    {
+        gltf->nodes_count = 0;
+        gltf->nodes = NULL;
+        return AGLTF_SUCCESS;
+    }
+
+    cJSON* json_node;
+    gltf->nodes_count = cJSON_GetArraySize(json_nodes);
+    gltf->nodes = calloc(gltf->nodes_count, sizeof(agltf_json_node_t));
+    size_t node_index = 0;
+    cJSON_ArrayForEach(json_node, json_nodes)
+    {
+        agltf_json_node_t* node = &gltf->nodes[node_index];
+        node->index = node_index;
+        node->name = create_from_json_string(json_node, "name");
+
+        if (cJSON_HasObjectItem(json_node, "mesh"))
+        {
+            node->mesh = &gltf->meshes[(size_t) cJSON_GetNumberValue(cJSON_GetObjectItem(json_node, "mesh"))];
+        }
+
+        cJSON* json_children = cJSON_GetObjectItem(json_node, "children");
+        if (json_children != NULL)
+        {
+            cJSON* json_child;
+            node->children_count = cJSON_GetArraySize(json_children);
+            node->children = malloc(node->children_count * sizeof(size_t));
+            size_t child_index = 0;
+            cJSON_ArrayForEach(json_child, json_children)
+            {
+                node->children[child_index++] = (size_t) cJSON_GetNumberValue(json_child);
+            }
+        }
+
+        // spec defaults, a missing key would give NaN from cJSON
+        node->rotation[3] = 1.0f;
+        node->scale[0] = 1.0f;
+        node->scale[1] = 1.0f;
+        node->scale[2] = 1.0f;
+        for (size_t i = 0; i < 16; ++i)
+        {
+            node->matrix[i] = i % 5 == 0 ? 1.0f : 0.0f;
+        }
+
+        node->has_matrix = cJSON_HasObjectItem(json_node, "matrix");
+        set_floats_from_json(json_node, "matrix", node->matrix, 16);
+        set_floats_from_json(json_node, "translation", node->translation, 3);
+        set_floats_from_json(json_node, "rotation", node->rotation, 4);
+        set_floats_from_json(json_node, "scale", node->scale, 3);
+
+        // calloc left the nodes past this one empty, so they free like any other
+        if (set_node_instancing_from_json(gltf, json_node, node) != AGLTF_SUCCESS)
+        {
+            free_nodes(gltf);
+            return AGLTF_INVALID_JSON_STRUCTURE_ERROR;
+        }
+        node_index++;
+    }
+    return AGLTF_SUCCESS;
+}
+
 agltf_result_t parse_gltf_json(char* json_string, size_t json_length, agltf_glb_t *gltf)
 {
     printf("%s\n", json_string);
@@ -493,10 +651,15 @@ agltf_result_t parse_gltf_json(char* json_string, size_t json_length, agltf_glb_
     result = set_meshses_from_json(json, gltf);
     if (result != AGLTF_SUCCESS) goto free_materials;
 
+    result = set_nodes_from_json(json, gltf);
+    if (result != AGLTF_SUCCESS) goto free_meshes;
+
     cJSON_Delete(json);
 
 goto finish;
 
+free_meshes:
+    free_meshes(gltf);
 free_materials:
     free_materials(gltf);
 free_textures:
@@ -517,6 +680,7 @@ finish:
 
 void free_gltf_json(agltf_glb_t *gltf)
 {
+    free_nodes(gltf);
     free_meshes(gltf);
     free_materials(gltf);
     free_textures(gltf);
@@ -535,7 +699,7 @@ agltf_result_t set_accessors_data(agltf_glb_t *gltf, agltf_chunk_t *chunk)
         accessor->data.size = accessor->count * get_component_type_element_size(accessor->component_type) * get_accessor_type_number_of_componenets(accessor->type);
         accessor->data.data = malloc(accessor->data.size);
         accessor->data.size_of_element = get_component_type_element_size(accessor->component_type);
-        memcpy(accessor->data.data, &chunk->chunk_data[accessor->buffer_view->byte_offset], accessor->data.size);
+        memcpy(accessor->data.data, &chunk->chunk_data[accessor->buffer_view->byte_offset + accessor->byte_offset], accessor->data.size);
     }
     return AGLTF_SUCCESS;
 }
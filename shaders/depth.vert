@@ -0,0 +1,33 @@
+#version 450
+
+layout(set = 0, binding = 0) uniform FrameConstants {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+} frame;
+
+struct ObjectData {
+    mat4 model;
+    vec4 boundingSphere;
+    uint materialIndex;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffer;
+
+// instanced draws point gl_InstanceIndex at a run of object indices
+layout(std430, set = 0, binding = 2) readonly buffer InstanceBuffer {
+    uint objectIndices[];
+} instanceBuffer;
+
+layout(location = 0) in vec3 inPosition;
+
+// shader.vert computes the same position, the equal test after a prepass needs both to round the same way
+invariant gl_Position;
+
+// the depth prepass, positions only and no fragment shader
+void main() {
+    ObjectData object = objectBuffer.objects[instanceBuffer.objectIndices[gl_InstanceIndex]];
+    gl_Position = frame.viewProj * object.model * vec4(inPosition, 1.0);
+}
\ No newline at end of file
@@ -1,12 +1,47 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(binding = 1) uniform sampler2D texSampler;
+#define NO_TEXTURE 0xFFFFFFFFu
 
-layout(location = 0) in vec3 fragColor;
+// a material's features, set per pipeline so none of them is a branch per fragment. same ids as AGFX_PIPELINE_*_CONSTANT_ID.
+// alpha masked materials are the only ones that give up early depth testing
+layout(constant_id = 0) const bool ALPHA_TEST = false;
+layout(constant_id = 1) const bool HAS_TEXTURE = true;
+layout(constant_id = 2) const bool VERTEX_COLOR = false;
+// one pipeline drawing materials with and without a texture still has to look at the index
+layout(constant_id = 3) const bool MIXED_MATERIALS = true;
+
+struct MaterialData {
+    vec4 baseColorFactor;
+    float metallicFactor;
+    float roughnessFactor;
+    uint baseColorTextureIndex;
+    float alphaCutoff;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer MaterialBuffer {
+    MaterialData materials[];
+} materialBuffer;
+
+layout(set = 1, binding = 1) uniform sampler2D textures[];
+
+layout(location = 0) in vec4 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragMaterialIndex;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = texture(texSampler, fragTexCoord);
+    MaterialData material = materialBuffer.materials[fragMaterialIndex];
+    vec4 baseColor = material.baseColorFactor;
+    if (HAS_TEXTURE && (!MIXED_MATERIALS || material.baseColorTextureIndex != NO_TEXTURE)) {
+        baseColor *= texture(textures[nonuniformEXT(material.baseColorTextureIndex)], fragTexCoord);
+    }
+    if (VERTEX_COLOR) {
+        baseColor *= fragColor;
+    }
+    if (ALPHA_TEST && baseColor.a < material.alphaCutoff) {
+        discard;
+    }
+    outColor = baseColor;
 }
\ No newline at end of file
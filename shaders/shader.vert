@@ -1,20 +1,41 @@
 #version 450
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
+layout(set = 0, binding = 0) uniform FrameConstants {
     mat4 view;
     mat4 proj;
-} ubo;
+    mat4 viewProj;
+} frame;
+
+struct ObjectData {
+    mat4 model;
+    vec4 boundingSphere;
+    uint materialIndex;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffer;
+
+// instanced draws point gl_InstanceIndex at a run of object indices
+layout(std430, set = 0, binding = 2) readonly buffer InstanceBuffer {
+    uint objectIndices[];
+} instanceBuffer;
 
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inColor;
+layout(location = 1) in vec4 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
-layout(location = 0) out vec3 fragColor;
+layout(location = 0) out vec4 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragMaterialIndex;
+
+// depth.vert computes the same position, the equal test after a prepass needs both to round the same way
+invariant gl_Position;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    ObjectData object = objectBuffer.objects[instanceBuffer.objectIndices[gl_InstanceIndex]];
+    gl_Position = frame.viewProj * object.model * vec4(inPosition, 1.0);
     fragColor = inColor;
     fragTexCoord = inTexCoord;
+    fragMaterialIndex = object.materialIndex;
 }
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 450
+
+// same as AGFX_VISIBILITY_TRIANGLE_BITS
+#define TRIANGLE_BITS 7
+
+layout(location = 0) flat in uint fragCluster;
+
+layout(location = 0) out uint outId;
+
+void main() {
+    // a cluster is drawn on its own, so the primitive id is the triangle within it
+    outId = (fragCluster << TRIANGLE_BITS) | uint(gl_PrimitiveID);
+}
\ No newline at end of file
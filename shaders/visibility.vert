@@ -0,0 +1,33 @@
+#version 450
+
+// positions only, the shade pass fetches everything else for the one triangle that is left per pixel
+layout(set = 0, binding = 0) uniform FrameConstants {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+} frame;
+
+struct ObjectData {
+    mat4 model;
+    vec4 boundingSphere;
+    uint materialIndex;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffer;
+
+// meshlet and object per cluster, a draw's instance is its cluster's slot
+layout(std430, set = 2, binding = 1) readonly buffer Clusters {
+    uvec2 clusters[];
+} clusters;
+
+layout(location = 0) in vec3 inPosition;
+
+layout(location = 0) flat out uint fragCluster;
+
+void main() {
+    ObjectData object = objectBuffer.objects[clusters.clusters[gl_InstanceIndex].y];
+    gl_Position = frame.viewProj * object.model * vec4(inPosition, 1.0);
+    fragCluster = gl_InstanceIndex;
+}
\ No newline at end of file
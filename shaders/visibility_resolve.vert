@@ -0,0 +1,7 @@
+#version 450
+
+// one triangle that covers the screen, the corners past it are clipped away
+void main() {
+    vec2 position = vec2(float((gl_VertexIndex << 1) & 2), float(gl_VertexIndex & 2));
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,166 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+#define NO_TEXTURE 0xFFFFFFFFu
+// same as AGFX_VISIBILITY_TRIANGLE_BITS and AGFX_VISIBILITY_EMPTY
+#define TRIANGLE_BITS 7
+#define EMPTY 0xFFFFFFFFu
+// floats per position and per agfx_vertex_attributes_t: color, texture coordinate
+#define POSITION_STRIDE 3
+#define ATTRIBUTE_STRIDE 6
+
+layout(set = 0, binding = 0) uniform FrameConstants {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+} frame;
+
+struct ObjectData {
+    mat4 model;
+    vec4 boundingSphere;
+    uint materialIndex;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffer;
+
+struct MaterialData {
+    vec4 baseColorFactor;
+    float metallicFactor;
+    float roughnessFactor;
+    uint baseColorTextureIndex;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer MaterialBuffer {
+    MaterialData materials[];
+} materialBuffer;
+
+layout(set = 1, binding = 1) uniform sampler2D textures[];
+
+struct Meshlet {
+    vec4 boundingSphere;
+    vec4 cone;
+    uint firstIndex;
+    uint trianglesCount;
+    uint firstVertex;
+    uint verticesCount;
+    uint firstTriangle;
+    int vertexOffset;
+    uint padding0;
+    uint padding1;
+};
+
+layout(set = 2, binding = 0) uniform usampler2D visibilityImage;
+
+layout(std430, set = 2, binding = 1) readonly buffer Clusters {
+    uvec2 clusters[];
+} clusters;
+
+layout(std430, set = 2, binding = 2) readonly buffer MeshletBuffer {
+    Meshlet meshlets[];
+} meshletBuffer;
+
+layout(std430, set = 2, binding = 3) readonly buffer IndexBuffer {
+    uint indices[];
+} indexBuffer;
+
+layout(std430, set = 2, binding = 4) readonly buffer PositionBuffer {
+    float values[];
+} positionBuffer;
+
+layout(std430, set = 2, binding = 5) readonly buffer AttributeBuffer {
+    float values[];
+} attributeBuffer;
+
+layout(location = 0) out vec4 outColor;
+
+struct Barycentrics {
+    vec3 lambda;
+    vec3 ddx;
+    vec3 ddy;
+};
+
+// perspective correct barycentrics of the pixel and their screen space derivatives, worked out from the triangle's
+// clip space corners since there is no rasterizer to interpolate for us. vulkan's ndc y already runs down the screen
+Barycentrics barycentrics(vec4 clip0, vec4 clip1, vec4 clip2, vec2 pixelNdc, vec2 size) {
+    Barycentrics result;
+    vec3 invW = 1.0 / vec3(clip0.w, clip1.w, clip2.w);
+    vec2 ndc0 = clip0.xy * invW.x;
+    vec2 ndc1 = clip1.xy * invW.y;
+    vec2 ndc2 = clip2.xy * invW.z;
+
+    float invDet = 1.0 / determinant(mat2(ndc2 - ndc1, ndc0 - ndc1));
+    result.ddx = vec3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * invDet * invW;
+    result.ddy = vec3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * invDet * invW;
+    float ddxSum = dot(result.ddx, vec3(1.0));
+    float ddySum = dot(result.ddy, vec3(1.0));
+
+    vec2 delta = pixelNdc - ndc0;
+    float interpolatedInvW = invW.x + delta.x * ddxSum + delta.y * ddySum;
+    float interpolatedW = 1.0 / interpolatedInvW;
+    result.lambda = interpolatedW * (vec3(invW.x, 0.0, 0.0) + delta.x * result.ddx + delta.y * result.ddy);
+
+    // from ndc to pixels, then through the perspective divide of the neighbouring pixel
+    result.ddx *= 2.0 / size.x;
+    result.ddy *= 2.0 / size.y;
+    ddxSum *= 2.0 / size.x;
+    ddySum *= 2.0 / size.y;
+    result.ddx = (result.lambda * interpolatedInvW + result.ddx) / (interpolatedInvW + ddxSum) - result.lambda;
+    result.ddy = (result.lambda * interpolatedInvW + result.ddy) / (interpolatedInvW + ddySum) - result.lambda;
+    return result;
+}
+
+vec3 vertexPosition(uint vertex) {
+    uint base = vertex * POSITION_STRIDE;
+    return vec3(positionBuffer.values[base], positionBuffer.values[base + 1], positionBuffer.values[base + 2]);
+}
+
+vec4 vertexColor(uint vertex) {
+    uint base = vertex * ATTRIBUTE_STRIDE;
+    return vec4(attributeBuffer.values[base], attributeBuffer.values[base + 1], attributeBuffer.values[base + 2], attributeBuffer.values[base + 3]);
+}
+
+vec2 vertexTexCoord(uint vertex) {
+    uint base = vertex * ATTRIBUTE_STRIDE;
+    return vec2(attributeBuffer.values[base + 4], attributeBuffer.values[base + 5]);
+}
+
+void main() {
+    uint id = texelFetch(visibilityImage, ivec2(gl_FragCoord.xy), 0).r;
+    if (id == EMPTY) {
+        // the forward passes' clear color
+        outColor = vec4(0.5, 0.5, 0.5, 1.0);
+        return;
+    }
+
+    uvec2 cluster = clusters.clusters[id >> TRIANGLE_BITS];
+    Meshlet meshlet = meshletBuffer.meshlets[cluster.x];
+    ObjectData object = objectBuffer.objects[cluster.y];
+
+    uint firstIndex = meshlet.firstIndex + (id & ((1u << TRIANGLE_BITS) - 1u)) * 3;
+    uint vertex0 = uint(int(indexBuffer.indices[firstIndex]) + meshlet.vertexOffset);
+    uint vertex1 = uint(int(indexBuffer.indices[firstIndex + 1]) + meshlet.vertexOffset);
+    uint vertex2 = uint(int(indexBuffer.indices[firstIndex + 2]) + meshlet.vertexOffset);
+
+    mat4 modelViewProj = frame.viewProj * object.model;
+    vec2 size = vec2(textureSize(visibilityImage, 0));
+    Barycentrics weights = barycentrics(modelViewProj * vec4(vertexPosition(vertex0), 1.0), modelViewProj * vec4(vertexPosition(vertex1), 1.0),
+        modelViewProj * vec4(vertexPosition(vertex2), 1.0), gl_FragCoord.xy / size * 2.0 - 1.0, size);
+
+    vec2 texCoord0 = vertexTexCoord(vertex0);
+    vec2 texCoord1 = vertexTexCoord(vertex1);
+    vec2 texCoord2 = vertexTexCoord(vertex2);
+    vec2 texCoord = weights.lambda.x * texCoord0 + weights.lambda.y * texCoord1 + weights.lambda.z * texCoord2;
+    vec2 texCoordDdx = weights.ddx.x * texCoord0 + weights.ddx.y * texCoord1 + weights.ddx.z * texCoord2;
+    vec2 texCoordDdy = weights.ddy.x * texCoord0 + weights.ddy.y * texCoord1 + weights.ddy.z * texCoord2;
+
+    // the same shading as shader.frag with every feature checked per pixel, vertices without a color of their own are white
+    MaterialData material = materialBuffer.materials[object.materialIndex];
+    vec4 baseColor = material.baseColorFactor;
+    if (material.baseColorTextureIndex != NO_TEXTURE) {
+        baseColor *= textureGrad(textures[nonuniformEXT(material.baseColorTextureIndex)], texCoord, texCoordDdx, texCoordDdy);
+    }
+    baseColor *= weights.lambda.x * vertexColor(vertex0) + weights.lambda.y * vertexColor(vertex1) + weights.lambda.z * vertexColor(vertex2);
+    outColor = baseColor;
+}
\ No newline at end of file
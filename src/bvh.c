@@ -0,0 +1,593 @@
+#include "bvh.h"
+
+// set on traversal stack entries whose node is already known to be fully inside the frustum
+#define AGFX_BVH_INSIDE_BIT 0x80000000u
+#define AGFX_BVH_REFERENCE_BATCH_SIZE 4096
+
+typedef struct agfx_bvh_build_task_t {
+    agfx_bvh_t* bvh;
+    agfx_job_system_t* job_system;
+    SDL_atomic_t* counter;
+    uint32_t node_index;
+    uint32_t begin;
+    uint32_t end;
+} agfx_bvh_build_task_t;
+
+static agfx_aabb_t empty_aabb(void)
+{
+    return (agfx_aabb_t) {
+        .min = {FLT_MAX, FLT_MAX, FLT_MAX},
+        .max = {-FLT_MAX, -FLT_MAX, -FLT_MAX}
+    };
+}
+
+// plain compares instead of fminf/fmaxf, those have to care about nan and end up as calls
+static void grow_aabb(agfx_aabb_t* aabb, agfx_aabb_t other)
+{
+    aabb->min.x = other.min.x < aabb->min.x ? other.min.x : aabb->min.x;
+    aabb->min.y = other.min.y < aabb->min.y ? other.min.y : aabb->min.y;
+    aabb->min.z = other.min.z < aabb->min.z ? other.min.z : aabb->min.z;
+    aabb->max.x = other.max.x > aabb->max.x ? other.max.x : aabb->max.x;
+    aabb->max.y = other.max.y > aabb->max.y ? other.max.y : aabb->max.y;
+    aabb->max.z = other.max.z > aabb->max.z ? other.max.z : aabb->max.z;
+}
+
+static float centroid_of(agfx_aabb_t aabb, int axis)
+{
+    return 0 == axis ? aabb.min.x + aabb.max.x : (1 == axis ? aabb.min.y + aabb.max.y : aabb.min.z + aabb.max.z);
+}
+
+static float half_area(agfx_aabb_t aabb)
+{
+    if (aabb.max.x < aabb.min.x)
+    {
+        return 0.0f;
+    }
+
+    float dx = aabb.max.x - aabb.min.x;
+    float dy = aabb.max.y - aabb.min.y;
+    float dz = aabb.max.z - aabb.min.z;
+    return dx * dy + dy * dz + dz * dx;
+}
+
+static float axis_of(agfx_vector3_t vector, int axis)
+{
+    return 0 == axis ? vector.x : (1 == axis ? vector.y : vector.z);
+}
+
+static agfx_aabb_t child_bounds(const agfx_bvh_node_t* node, int slot)
+{
+    return (agfx_aabb_t) {
+        .min = {node->min_x[slot], node->min_y[slot], node->min_z[slot]},
+        .max = {node->max_x[slot], node->max_y[slot], node->max_z[slot]}
+    };
+}
+
+static void set_child_bounds(agfx_bvh_node_t* node, int slot, agfx_aabb_t bounds)
+{
+    node->min_x[slot] = bounds.min.x;
+    node->min_y[slot] = bounds.min.y;
+    node->min_z[slot] = bounds.min.z;
+    node->max_x[slot] = bounds.max.x;
+    node->max_y[slot] = bounds.max.y;
+    node->max_z[slot] = bounds.max.z;
+}
+
+static agfx_aabb_t node_bounds(const agfx_bvh_node_t* node)
+{
+    agfx_aabb_t bounds = empty_aabb();
+    for (int slot = 0; slot < AGFX_BVH_WIDTH; ++slot)
+    {
+        if (AGFX_BVH_EMPTY != node->children[slot])
+        {
+            grow_aabb(&bounds, child_bounds(node, slot));
+        }
+    }
+    return bounds;
+}
+
+static agfx_aabb_t range_bounds(agfx_bvh_t* bvh, uint32_t begin, uint32_t end)
+{
+    agfx_aabb_t bounds = empty_aabb();
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        grow_aabb(&bounds, bvh->primitive_bounds[bvh->primitive_indices[i]]);
+    }
+    return bounds;
+}
+
+static agfx_aabb_t reference_bounds(agfx_bvh_t* bvh, uint32_t begin, uint32_t end)
+{
+    agfx_aabb_t bounds = empty_aabb();
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        grow_aabb(&bounds, bvh->references[i].bounds);
+    }
+    return bounds;
+}
+
+agfx_result_t agfx_create_bvh(size_t capacity, agfx_bvh_t* out_bvh)
+{
+    agfx_bvh_t bvh = {0};
+
+    // every inner node but a tiny root has at least two children, so there are fewer nodes than primitives
+    bvh.capacity = capacity > 0 ? capacity : 1;
+    bvh.nodes_capacity = bvh.capacity;
+    bvh.primitive_bounds = calloc(bvh.capacity, sizeof(agfx_aabb_t));
+    bvh.primitive_indices = calloc(bvh.capacity, sizeof(uint32_t));
+    bvh.references = calloc(bvh.capacity, sizeof(agfx_bvh_reference_t));
+    bvh.nodes = calloc(bvh.nodes_capacity, sizeof(agfx_bvh_node_t));
+    bvh.traversal_stack = calloc(bvh.nodes_capacity, sizeof(uint32_t));
+    if (NULL == bvh.primitive_bounds || NULL == bvh.primitive_indices || NULL == bvh.references || NULL == bvh.nodes || NULL == bvh.traversal_stack)
+    {
+        agfx_free_bvh(&bvh);
+        return AGFX_BUFFER_ERROR;
+    }
+
+    *out_bvh = bvh;
+    return AGFX_SUCCESS;
+}
+
+void agfx_free_bvh(agfx_bvh_t* bvh)
+{
+    free(bvh->traversal_stack);
+    free(bvh->nodes);
+    free(bvh->references);
+    free(bvh->primitive_indices);
+    free(bvh->primitive_bounds);
+    *bvh = (agfx_bvh_t) {0};
+}
+
+// bounds can change between refits, the primitive count only with a build
+void agfx_bvh_set_primitive(agfx_bvh_t* bvh, size_t index, agfx_aabb_t bounds)
+{
+    bvh->primitive_bounds[index] = bounds;
+}
+
+// binned sah over the centroids, returns where the range got partitioned.
+// centroids are kept doubled, only their relative position matters.
+// falls back to an even split when every centroid lands in the same spot
+static uint32_t split_range(agfx_bvh_t* bvh, uint32_t begin, uint32_t end)
+{
+    agfx_bvh_reference_t* references = bvh->references;
+    agfx_aabb_t centroid_bounds = empty_aabb();
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        agfx_vector3_t centroid = {centroid_of(references[i].bounds, 0), centroid_of(references[i].bounds, 1), centroid_of(references[i].bounds, 2)};
+        grow_aabb(&centroid_bounds, (agfx_aabb_t) {centroid, centroid});
+    }
+
+    float best_cost = FLT_MAX;
+    int best_axis = -1;
+    uint32_t best_bin = 0;
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float axis_min = axis_of(centroid_bounds.min, axis);
+        float extent = axis_of(centroid_bounds.max, axis) - axis_min;
+        if (extent <= 0.0f)
+        {
+            continue;
+        }
+        float scale = AGFX_BVH_BINS_COUNT / extent;
+
+        agfx_aabb_t bin_bounds[AGFX_BVH_BINS_COUNT];
+        uint32_t bin_counts[AGFX_BVH_BINS_COUNT] = {0};
+        for (int bin = 0; bin < AGFX_BVH_BINS_COUNT; ++bin)
+        {
+            bin_bounds[bin] = empty_aabb();
+        }
+
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            uint32_t bin = (uint32_t)((centroid_of(references[i].bounds, axis) - axis_min) * scale);
+            bin = bin < AGFX_BVH_BINS_COUNT ? bin : AGFX_BVH_BINS_COUNT - 1;
+            bin_counts[bin]++;
+            grow_aabb(&bin_bounds[bin], references[i].bounds);
+        }
+
+        // sweep from the right first so each split knows the cost of everything above it
+        float right_areas[AGFX_BVH_BINS_COUNT];
+        uint32_t right_counts[AGFX_BVH_BINS_COUNT];
+        agfx_aabb_t accumulated = empty_aabb();
+        uint32_t accumulated_count = 0;
+        for (int bin = AGFX_BVH_BINS_COUNT - 1; bin > 0; --bin)
+        {
+            grow_aabb(&accumulated, bin_bounds[bin]);
+            accumulated_count += bin_counts[bin];
+            right_areas[bin] = half_area(accumulated);
+            right_counts[bin] = accumulated_count;
+        }
+
+        accumulated = empty_aabb();
+        accumulated_count = 0;
+        for (int bin = 0; bin < AGFX_BVH_BINS_COUNT - 1; ++bin)
+        {
+            grow_aabb(&accumulated, bin_bounds[bin]);
+            accumulated_count += bin_counts[bin];
+            if (0 == accumulated_count || 0 == right_counts[bin + 1])
+            {
+                continue;
+            }
+
+            float cost = half_area(accumulated) * accumulated_count + right_areas[bin + 1] * right_counts[bin + 1];
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = (uint32_t)bin + 1;
+            }
+        }
+    }
+
+    if (best_axis < 0)
+    {
+        return begin + (end - begin) / 2;
+    }
+
+    // same binning as above, everything below the best bin goes left
+    float axis_min = axis_of(centroid_bounds.min, best_axis);
+    float scale = AGFX_BVH_BINS_COUNT / (axis_of(centroid_bounds.max, best_axis) - axis_min);
+    uint32_t left = begin;
+    uint32_t right = end;
+    while (left < right)
+    {
+        uint32_t bin = (uint32_t)((centroid_of(references[left].bounds, best_axis) - axis_min) * scale);
+        bin = bin < AGFX_BVH_BINS_COUNT ? bin : AGFX_BVH_BINS_COUNT - 1;
+        if (bin < best_bin)
+        {
+            left++;
+        } else
+        {
+            agfx_bvh_reference_t swap = references[left];
+            references[left] = references[--right];
+            references[right] = swap;
+        }
+    }
+
+    if (left == begin || left == end)
+    {
+        return begin + (end - begin) / 2;
+    }
+    return left;
+}
+
+static void build_node(agfx_bvh_t* bvh, agfx_job_system_t* job_system, SDL_atomic_t* counter, uint32_t node_index, uint32_t begin, uint32_t end);
+
+static void build_task(void* data)
+{
+    agfx_bvh_build_task_t* task = (agfx_bvh_build_task_t*)data;
+    build_node(task->bvh, task->job_system, task->counter, task->node_index, task->begin, task->end);
+    free(task);
+}
+
+// a node is filled by splitting its range until there are four children or every child fits in a leaf.
+// large children become jobs, so the tree fans out over the workers after the first couple of levels
+static void build_node(agfx_bvh_t* bvh, agfx_job_system_t* job_system, SDL_atomic_t* counter, uint32_t node_index, uint32_t begin, uint32_t end)
+{
+    uint32_t child_begins[AGFX_BVH_WIDTH] = {begin};
+    uint32_t child_ends[AGFX_BVH_WIDTH] = {end};
+    int children_count = 1;
+
+    while (children_count < AGFX_BVH_WIDTH)
+    {
+        int largest = -1;
+        uint32_t largest_size = AGFX_BVH_LEAF_SIZE;
+        for (int child = 0; child < children_count; ++child)
+        {
+            if (child_ends[child] - child_begins[child] > largest_size)
+            {
+                largest = child;
+                largest_size = child_ends[child] - child_begins[child];
+            }
+        }
+        if (largest < 0)
+        {
+            break;
+        }
+
+        uint32_t middle = split_range(bvh, child_begins[largest], child_ends[largest]);
+        child_begins[children_count] = middle;
+        child_ends[children_count] = child_ends[largest];
+        child_ends[largest] = middle;
+        children_count++;
+    }
+
+    agfx_bvh_node_t* node = &bvh->nodes[node_index];
+    for (int slot = 0; slot < AGFX_BVH_WIDTH; ++slot)
+    {
+        if (slot >= children_count)
+        {
+            set_child_bounds(node, slot, empty_aabb());
+            node->children[slot] = AGFX_BVH_EMPTY;
+            node->counts[slot] = 0;
+            continue;
+        }
+
+        uint32_t child_begin = child_begins[slot];
+        uint32_t child_end = child_ends[slot];
+        set_child_bounds(node, slot, reference_bounds(bvh, child_begin, child_end));
+
+        if (child_end - child_begin <= AGFX_BVH_LEAF_SIZE)
+        {
+            node->children[slot] = child_begin;
+            node->counts[slot] = child_end - child_begin;
+            continue;
+        }
+
+        // a child is always allocated after its parent, refit relies on that
+        uint32_t child_index = (uint32_t)SDL_AtomicAdd(&bvh->nodes_count, 1);
+        node->children[slot] = child_index;
+        node->counts[slot] = 0;
+
+        if (NULL != job_system && child_end - child_begin >= AGFX_BVH_PARALLEL_THRESHOLD)
+        {
+            agfx_bvh_build_task_t* task = malloc(sizeof(agfx_bvh_build_task_t));
+            if (NULL != task)
+            {
+                *task = (agfx_bvh_build_task_t) {
+                    .bvh = bvh,
+                    .job_system = job_system,
+                    .counter = counter,
+                    .node_index = child_index,
+                    .begin = child_begin,
+                    .end = child_end
+                };
+                agfx_job_system_push(job_system, build_task, task, counter);
+                continue;
+            }
+        }
+
+        build_node(bvh, job_system, counter, child_index, child_begin, child_end);
+    }
+}
+
+// the build moves copies of the bounds around so every pass over a range reads memory in order
+static void gather_references(void* data, size_t begin, size_t end)
+{
+    agfx_bvh_t* bvh = (agfx_bvh_t*)data;
+    for (size_t i = begin; i < end; ++i)
+    {
+        bvh->references[i].bounds = bvh->primitive_bounds[i];
+        bvh->references[i].index = (uint32_t)i;
+    }
+}
+
+static void scatter_references(void* data, size_t begin, size_t end)
+{
+    agfx_bvh_t* bvh = (agfx_bvh_t*)data;
+    for (size_t i = begin; i < end; ++i)
+    {
+        bvh->primitive_indices[i] = bvh->references[i].index;
+    }
+}
+
+// expected sah cost of a query relative to the root, used to tell how much refits have degraded the tree
+static float compute_cost(agfx_bvh_t* bvh)
+{
+    uint32_t nodes_count = (uint32_t)SDL_AtomicGet(&bvh->nodes_count);
+    if (0 == nodes_count)
+    {
+        return 0.0f;
+    }
+
+    float root_area = half_area(node_bounds(&bvh->nodes[0]));
+    if (root_area <= 0.0f)
+    {
+        return AGFX_BVH_TRAVERSAL_COST;
+    }
+
+    float cost = AGFX_BVH_TRAVERSAL_COST;
+    for (uint32_t node_index = 0; node_index < nodes_count; ++node_index)
+    {
+        agfx_bvh_node_t* node = &bvh->nodes[node_index];
+        for (int slot = 0; slot < AGFX_BVH_WIDTH; ++slot)
+        {
+            if (AGFX_BVH_EMPTY == node->children[slot])
+            {
+                continue;
+            }
+            float child_cost = node->counts[slot] > 0 ? node->counts[slot] * AGFX_BVH_PRIMITIVE_COST : AGFX_BVH_TRAVERSAL_COST;
+            cost += half_area(child_bounds(node, slot)) / root_area * child_cost;
+        }
+    }
+    return cost;
+}
+
+void agfx_bvh_build(agfx_bvh_t* bvh, agfx_job_system_t* job_system, size_t primitives_count)
+{
+    bvh->primitives_count = primitives_count < bvh->capacity ? primitives_count : bvh->capacity;
+    SDL_AtomicSet(&bvh->nodes_count, 0);
+    bvh->build_cost = 0.0f;
+    bvh->cost = 0.0f;
+
+    if (0 == bvh->primitives_count)
+    {
+        return;
+    }
+
+    agfx_job_system_parallel_for(job_system, bvh->primitives_count, AGFX_BVH_REFERENCE_BATCH_SIZE, gather_references, bvh);
+
+    SDL_AtomicSet(&bvh->nodes_count, 1);
+    SDL_atomic_t counter = {0};
+    build_node(bvh, job_system, &counter, 0, 0, (uint32_t)bvh->primitives_count);
+    agfx_job_system_wait(job_system, &counter);
+
+    agfx_job_system_parallel_for(job_system, bvh->primitives_count, AGFX_BVH_REFERENCE_BATCH_SIZE, scatter_references, bvh);
+
+    bvh->build_cost = compute_cost(bvh);
+    bvh->cost = bvh->build_cost;
+}
+
+// children always come after their parent, so walking the nodes backwards updates every child before it is read
+void agfx_bvh_refit(agfx_bvh_t* bvh)
+{
+    uint32_t nodes_count = (uint32_t)SDL_AtomicGet(&bvh->nodes_count);
+    for (uint32_t node_index = nodes_count; node_index-- > 0;)
+    {
+        agfx_bvh_node_t* node = &bvh->nodes[node_index];
+        for (int slot = 0; slot < AGFX_BVH_WIDTH; ++slot)
+        {
+            if (AGFX_BVH_EMPTY == node->children[slot])
+            {
+                continue;
+            }
+
+            if (node->counts[slot] > 0)
+            {
+                set_child_bounds(node, slot, range_bounds(bvh, node->children[slot], node->children[slot] + node->counts[slot]));
+            } else
+            {
+                set_child_bounds(node, slot, node_bounds(&bvh->nodes[node->children[slot]]));
+            }
+        }
+    }
+
+    bvh->cost = compute_cost(bvh);
+}
+
+uint32_t agfx_bvh_needs_rebuild(agfx_bvh_t* bvh)
+{
+    return bvh->cost > bvh->build_cost * AGFX_BVH_REBUILD_COST_RATIO;
+}
+
+typedef enum agfx_bvh_overlap_t {
+    AGFX_BVH_OUTSIDE = 0,
+    AGFX_BVH_INTERSECTING,
+    AGFX_BVH_INSIDE
+} agfx_bvh_overlap_t;
+
+static agfx_bvh_overlap_t classify_aabb(const agfx_frustum_t* frustum, agfx_aabb_t aabb)
+{
+    agfx_bvh_overlap_t overlap = AGFX_BVH_INSIDE;
+
+    agfx_vector3_t center = {(aabb.min.x + aabb.max.x) * 0.5f, (aabb.min.y + aabb.max.y) * 0.5f, (aabb.min.z + aabb.max.z) * 0.5f};
+    agfx_vector3_t extent = {(aabb.max.x - aabb.min.x) * 0.5f, (aabb.max.y - aabb.min.y) * 0.5f, (aabb.max.z - aabb.min.z) * 0.5f};
+    for (int p = 0; p < 6; ++p)
+    {
+        agfx_vector4_t plane = frustum->planes[p];
+        float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        float radius = fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+        if (distance + radius < 0.0f)
+        {
+            return AGFX_BVH_OUTSIDE;
+        }
+        if (distance - radius < 0.0f)
+        {
+            overlap = AGFX_BVH_INTERSECTING;
+        }
+    }
+
+    return overlap;
+}
+
+// subtrees fully inside the frustum are emitted without testing anything below them.
+// out_visible_indices needs room for every primitive
+size_t agfx_bvh_cull_frustum(agfx_bvh_t* bvh, const agfx_frustum_t* frustum, uint32_t* out_visible_indices)
+{
+    size_t visible_count = 0;
+    if (0 == SDL_AtomicGet(&bvh->nodes_count))
+    {
+        return visible_count;
+    }
+
+    uint32_t* stack = bvh->traversal_stack;
+    size_t stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+        uint32_t entry = stack[--stack_size];
+        uint32_t inside = entry & AGFX_BVH_INSIDE_BIT;
+        agfx_bvh_node_t* node = &bvh->nodes[entry & ~AGFX_BVH_INSIDE_BIT];
+
+        for (int slot = 0; slot < AGFX_BVH_WIDTH; ++slot)
+        {
+            if (AGFX_BVH_EMPTY == node->children[slot])
+            {
+                continue;
+            }
+
+            uint32_t child_inside = inside;
+            if (!inside)
+            {
+                agfx_bvh_overlap_t overlap = classify_aabb(frustum, child_bounds(node, slot));
+                if (AGFX_BVH_OUTSIDE == overlap)
+                {
+                    continue;
+                }
+                child_inside = AGFX_BVH_INSIDE == overlap ? AGFX_BVH_INSIDE_BIT : 0;
+            }
+
+            if (0 == node->counts[slot])
+            {
+                stack[stack_size++] = node->children[slot] | child_inside;
+                continue;
+            }
+
+            for (uint32_t i = node->children[slot]; i < node->children[slot] + node->counts[slot]; ++i)
+            {
+                uint32_t primitive = bvh->primitive_indices[i];
+                if (child_inside || AGFX_BVH_OUTSIDE != classify_aabb(frustum, bvh->primitive_bounds[primitive]))
+                {
+                    out_visible_indices[visible_count++] = primitive;
+                }
+            }
+        }
+    }
+
+    return visible_count;
+}
+
+static int overlaps(agfx_aabb_t a, agfx_aabb_t b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+// stops once out_indices is full, returns how many were written
+size_t agfx_bvh_query_aabb(agfx_bvh_t* bvh, agfx_aabb_t bounds, uint32_t* out_indices, size_t indices_capacity)
+{
+    size_t indices_count = 0;
+    if (0 == SDL_AtomicGet(&bvh->nodes_count))
+    {
+        return indices_count;
+    }
+
+    uint32_t* stack = bvh->traversal_stack;
+    size_t stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+        agfx_bvh_node_t* node = &bvh->nodes[stack[--stack_size]];
+        for (int slot = 0; slot < AGFX_BVH_WIDTH; ++slot)
+        {
+            if (AGFX_BVH_EMPTY == node->children[slot] || !overlaps(child_bounds(node, slot), bounds))
+            {
+                continue;
+            }
+
+            if (0 == node->counts[slot])
+            {
+                stack[stack_size++] = node->children[slot];
+                continue;
+            }
+
+            for (uint32_t i = node->children[slot]; i < node->children[slot] + node->counts[slot]; ++i)
+            {
+                uint32_t primitive = bvh->primitive_indices[i];
+                if (!overlaps(bvh->primitive_bounds[primitive], bounds))
+                {
+                    continue;
+                }
+                if (indices_count == indices_capacity)
+                {
+                    return indices_count;
+                }
+                out_indices[indices_count++] = primitive;
+            }
+        }
+    }
+
+    return indices_count;
+}
\ No newline at end of file
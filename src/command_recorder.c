@@ -0,0 +1,330 @@
+#include "command_recorder.h"
+
+typedef struct agfx_record_job_t {
+    agfx_context_t* context;
+    agfx_command_worker_t* worker;
+    const VkCommandBufferInheritanceInfo* inheritance_info;
+    agfx_record_range_function_t function;
+    void* data;
+    size_t begin;
+    size_t end;
+    VkCommandBuffer command_buffer;
+    agfx_result_t result;
+} agfx_record_job_t;
+
+static agfx_result_t create_recorder_command_pool(agfx_context_t* context, VkCommandPoolCreateFlags flags, VkCommandPool* out_command_pool)
+{
+    VkCommandPoolCreateInfo command_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .queueFamilyIndex = context->queue_family_indices.graphics_index,
+        .flags = flags,
+    };
+
+    if (VK_SUCCESS != vkCreateCommandPool(context->device, &command_pool_create_info, NULL, out_command_pool))
+    {
+        return AGFX_COMMAND_POOL_ERROR;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+agfx_result_t agfx_create_command_recorder(agfx_context_t* context, uint32_t frames_count, uint32_t workers_count, agfx_command_recorder_t* out_command_recorder)
+{
+    agfx_command_recorder_t command_recorder = {0};
+    agfx_result_t result = AGFX_SUCCESS;
+
+    if (0 == workers_count)
+    {
+        workers_count = 1;
+    }
+    if (workers_count > AGFX_COMMAND_RECORDER_MAX_WORKERS)
+    {
+        workers_count = AGFX_COMMAND_RECORDER_MAX_WORKERS;
+    }
+
+    command_recorder.frames_count = frames_count;
+    command_recorder.workers_count = workers_count;
+    command_recorder.frames = calloc(frames_count, sizeof(agfx_command_frame_t));
+    if (NULL == command_recorder.frames)
+    {
+        *out_command_recorder = command_recorder;
+        return AGFX_COMMAND_POOL_ERROR;
+    }
+
+    for (uint32_t frame_index = 0; frame_index < frames_count; ++frame_index)
+    {
+        agfx_command_frame_t* frame = &command_recorder.frames[frame_index];
+
+        // transient, everything in it is rerecorded every frame and the pool is reset as a whole
+        result = create_recorder_command_pool(context, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, &frame->command_pool);
+        if (AGFX_SUCCESS != result) goto free_command_recorder;
+
+        // cached buffers outlive the frame and are rerecorded one by one when they go stale
+        result = create_recorder_command_pool(context, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, &frame->cached_command_pool);
+        if (AGFX_SUCCESS != result) goto free_command_recorder;
+
+        VkCommandBufferAllocateInfo command_buffer_allocate_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = frame->command_pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        if (VK_SUCCESS != vkAllocateCommandBuffers(context->device, &command_buffer_allocate_info, &frame->command_buffer))
+        {
+            result = AGFX_COMMAND_BUFFERS_ERROR;
+            goto free_command_recorder;
+        }
+
+        frame->workers = calloc(workers_count, sizeof(agfx_command_worker_t));
+        if (NULL == frame->workers)
+        {
+            result = AGFX_COMMAND_POOL_ERROR;
+            goto free_command_recorder;
+        }
+
+        for (uint32_t worker_index = 0; worker_index < workers_count; ++worker_index)
+        {
+            result = create_recorder_command_pool(context, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, &frame->workers[worker_index].command_pool);
+            if (AGFX_SUCCESS != result) goto free_command_recorder;
+        }
+    }
+
+    *out_command_recorder = command_recorder;
+    return AGFX_SUCCESS;
+
+free_command_recorder:
+    agfx_free_command_recorder(context, &command_recorder);
+    *out_command_recorder = command_recorder;
+    return result;
+}
+
+// destroying a pool frees every command buffer allocated from it
+void agfx_free_command_recorder(agfx_context_t* context, agfx_command_recorder_t* command_recorder)
+{
+    for (uint32_t frame_index = 0; frame_index < command_recorder->frames_count && NULL != command_recorder->frames; ++frame_index)
+    {
+        agfx_command_frame_t* frame = &command_recorder->frames[frame_index];
+        for (uint32_t worker_index = 0; worker_index < command_recorder->workers_count && NULL != frame->workers; ++worker_index)
+        {
+            agfx_command_worker_t* worker = &frame->workers[worker_index];
+            if (VK_NULL_HANDLE != worker->command_pool) vkDestroyCommandPool(context->device, worker->command_pool, NULL);
+            free(worker->command_buffers);
+        }
+        free(frame->workers);
+        if (VK_NULL_HANDLE != frame->cached_command_pool) vkDestroyCommandPool(context->device, frame->cached_command_pool, NULL);
+        free(frame->cached);
+        if (VK_NULL_HANDLE != frame->command_pool) vkDestroyCommandPool(context->device, frame->command_pool, NULL);
+    }
+    free(command_recorder->frames);
+    *command_recorder = (agfx_command_recorder_t) {0};
+}
+
+// only call once the fence of frame_index signaled, the pools are reset wholesale instead of buffer by buffer
+agfx_result_t agfx_command_recorder_begin_frame(agfx_context_t* context, agfx_command_recorder_t* command_recorder, uint32_t frame_index)
+{
+    agfx_command_frame_t* frame = &command_recorder->frames[frame_index];
+    command_recorder->frame_index = frame_index;
+    command_recorder->recording_cached = 0;
+    command_recorder->secondaries_count = 0;
+    frame->active_command_buffer = frame->command_buffer;
+
+    if (VK_SUCCESS != vkResetCommandPool(context->device, frame->command_pool, 0))
+    {
+        return AGFX_COMMAND_POOL_ERROR;
+    }
+
+    for (uint32_t worker_index = 0; worker_index < command_recorder->workers_count; ++worker_index)
+    {
+        agfx_command_worker_t* worker = &frame->workers[worker_index];
+        if (0 == worker->command_buffers_used)
+        {
+            continue;
+        }
+
+        if (VK_SUCCESS != vkResetCommandPool(context->device, worker->command_pool, 0))
+        {
+            return AGFX_COMMAND_POOL_ERROR;
+        }
+        worker->command_buffers_used = 0;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+// the buffer to record into and submit this frame, the transient one unless a cached one was picked
+VkCommandBuffer agfx_command_recorder_primary(agfx_command_recorder_t* command_recorder)
+{
+    return command_recorder->frames[command_recorder->frame_index].active_command_buffer;
+}
+
+// picks this frame slot's cached buffer for the swapchain image. out_valid tells whether it was last recorded at generation,
+// if not it has to be rerecorded and then marked with agfx_command_recorder_mark_cached.
+// every frame slot has its own, so a cached buffer is never rerecorded while the gpu still runs it
+agfx_result_t agfx_command_recorder_use_cached(agfx_context_t* context, agfx_command_recorder_t* command_recorder, uint32_t image_index, uint64_t generation, uint32_t* out_valid)
+{
+    agfx_command_frame_t* frame = &command_recorder->frames[command_recorder->frame_index];
+
+    if (image_index >= frame->cached_count)
+    {
+        agfx_cached_commands_t* cached = realloc(frame->cached, sizeof(agfx_cached_commands_t) * (image_index + 1));
+        if (NULL == cached)
+        {
+            return AGFX_COMMAND_BUFFERS_ERROR;
+        }
+        frame->cached = cached;
+
+        for (uint32_t cached_index = frame->cached_count; cached_index <= image_index; ++cached_index)
+        {
+            VkCommandBufferAllocateInfo command_buffer_allocate_info = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .commandPool = frame->cached_command_pool,
+                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                .commandBufferCount = 1,
+            };
+            if (VK_SUCCESS != vkAllocateCommandBuffers(context->device, &command_buffer_allocate_info, &frame->cached[cached_index].command_buffer))
+            {
+                return AGFX_COMMAND_BUFFERS_ERROR;
+            }
+            frame->cached[cached_index].generation = 0;
+            frame->cached_count++;
+        }
+    }
+
+    agfx_cached_commands_t* cached = &frame->cached[image_index];
+    frame->active_command_buffer = cached->command_buffer;
+    *out_valid = 0 != generation && cached->generation == generation;
+    command_recorder->recording_cached = !*out_valid;
+
+    if (*out_valid)
+    {
+        command_recorder->reused_frames++;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+void agfx_command_recorder_mark_cached(agfx_command_recorder_t* command_recorder, uint32_t image_index, uint64_t generation)
+{
+    command_recorder->frames[command_recorder->frame_index].cached[image_index].generation = generation;
+}
+
+// how many secondaries a range of count commands is worth, 1 means record it inline.
+// worker pools are reset every frame, so a cached primary can't execute secondaries from them
+uint32_t agfx_command_recorder_workers_for(agfx_command_recorder_t* command_recorder, size_t count)
+{
+    if (command_recorder->recording_cached)
+    {
+        return 1;
+    }
+
+    size_t workers_count = count / AGFX_COMMAND_RECORDER_MIN_RANGE;
+    if (workers_count > command_recorder->workers_count)
+    {
+        workers_count = command_recorder->workers_count;
+    }
+
+    return workers_count > 1 ? (uint32_t)workers_count : 1;
+}
+
+// only the job that owns the worker slot touches its pool, so no locking is needed here
+static agfx_result_t acquire_secondary(agfx_context_t* context, agfx_command_worker_t* worker, VkCommandBuffer* out_command_buffer)
+{
+    if (worker->command_buffers_used == worker->command_buffers_count)
+    {
+        VkCommandBuffer* command_buffers = realloc(worker->command_buffers, sizeof(VkCommandBuffer) * (worker->command_buffers_count + 1));
+        if (NULL == command_buffers)
+        {
+            return AGFX_COMMAND_BUFFERS_ERROR;
+        }
+        worker->command_buffers = command_buffers;
+
+        VkCommandBufferAllocateInfo command_buffer_allocate_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = worker->command_pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = 1,
+        };
+        if (VK_SUCCESS != vkAllocateCommandBuffers(context->device, &command_buffer_allocate_info, &worker->command_buffers[worker->command_buffers_count]))
+        {
+            return AGFX_COMMAND_BUFFERS_ERROR;
+        }
+        worker->command_buffers_count++;
+    }
+
+    *out_command_buffer = worker->command_buffers[worker->command_buffers_used++];
+    return AGFX_SUCCESS;
+}
+
+static void record_range(void* data)
+{
+    agfx_record_job_t* job = (agfx_record_job_t*)data;
+
+    job->result = acquire_secondary(job->context, job->worker, &job->command_buffer);
+    if (AGFX_SUCCESS != job->result)
+    {
+        return;
+    }
+
+    VkCommandBufferBeginInfo command_buffer_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = job->inheritance_info,
+    };
+    if (VK_SUCCESS != vkBeginCommandBuffer(job->command_buffer, &command_buffer_begin_info))
+    {
+        job->result = AGFX_COMMAND_BUFFERS_ERROR;
+        return;
+    }
+
+    job->function(job->command_buffer, job->data, job->begin, job->end);
+
+    if (VK_SUCCESS != vkEndCommandBuffer(job->command_buffer))
+    {
+        job->result = AGFX_COMMAND_BUFFERS_ERROR;
+    }
+}
+
+// splits [0, count) into one contiguous range per worker, each recorded into its own secondary inside the render pass
+// the primary is in. the secondaries execute in range order, so the result is the same as recording inline.
+// secondaries inherit no state, function has to bind everything it draws with
+agfx_result_t agfx_command_recorder_record_parallel(agfx_context_t* context, agfx_command_recorder_t* command_recorder, agfx_job_system_t* job_system, const VkCommandBufferInheritanceInfo* inheritance_info, size_t count, agfx_record_range_function_t function, void* data)
+{
+    agfx_command_frame_t* frame = &command_recorder->frames[command_recorder->frame_index];
+    uint32_t workers_count = agfx_command_recorder_workers_for(command_recorder, count);
+    size_t range_size = (count + workers_count - 1) / workers_count;
+
+    agfx_record_job_t jobs[AGFX_COMMAND_RECORDER_MAX_WORKERS];
+    SDL_atomic_t counter = {0};
+    for (uint32_t worker_index = 0; worker_index < workers_count; ++worker_index)
+    {
+        size_t begin = worker_index * range_size;
+        jobs[worker_index] = (agfx_record_job_t) {
+            .context = context,
+            .worker = &frame->workers[worker_index],
+            .inheritance_info = inheritance_info,
+            .function = function,
+            .data = data,
+            .begin = begin < count ? begin : count,
+            .end = begin + range_size < count ? begin + range_size : count,
+            .command_buffer = VK_NULL_HANDLE,
+            .result = AGFX_SUCCESS,
+        };
+        agfx_job_system_push(job_system, record_range, &jobs[worker_index], &counter);
+    }
+    agfx_job_system_wait(job_system, &counter);
+
+    VkCommandBuffer command_buffers[AGFX_COMMAND_RECORDER_MAX_WORKERS];
+    for (uint32_t worker_index = 0; worker_index < workers_count; ++worker_index)
+    {
+        if (AGFX_SUCCESS != jobs[worker_index].result)
+        {
+            return jobs[worker_index].result;
+        }
+        command_buffers[worker_index] = jobs[worker_index].command_buffer;
+    }
+
+    vkCmdExecuteCommands(frame->command_buffer, workers_count, command_buffers);
+    command_recorder->secondaries_count += workers_count;
+
+    return AGFX_SUCCESS;
+}
\ No newline at end of file
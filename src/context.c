@@ -250,6 +250,33 @@ size_t get_unique_queue_family_indices(agfx_queue_family_indices_t* const queue_
     return unique_size;
 }
 
+uint32_t device_extension_supported(VkPhysicalDevice physical_device, const char* extension_name)
+{
+    uint32_t extension_property_count = 0;
+    if (VK_SUCCESS != vkEnumerateDeviceExtensionProperties(physical_device, NULL, &extension_property_count, NULL) || extension_property_count == 0)
+    {
+        return 0;
+    }
+
+    VkExtensionProperties* extension_properties = (VkExtensionProperties*)malloc(sizeof(VkExtensionProperties) * extension_property_count);
+    if (NULL == extension_properties)
+    {
+        return 0;
+    }
+
+    uint32_t supported = 0;
+    if (VK_SUCCESS == vkEnumerateDeviceExtensionProperties(physical_device, NULL, &extension_property_count, extension_properties))
+    {
+        for (uint32_t i = 0; i < extension_property_count && !supported; ++i)
+        {
+            supported = strcmp(extension_properties[i].extensionName, extension_name) == 0;
+        }
+    }
+
+    free(extension_properties);
+    return supported;
+}
+
 agfx_result_t create_logical_device(agfx_context_t* context)
 {
     agfx_result_t result = AGFX_SUCCESS;
@@ -276,19 +303,126 @@ agfx_result_t create_logical_device(agfx_context_t* context)
         device_queue_create_infos[i].queueCount = 1;
     }
 
-    const char* enabledExtensionName = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+    const char* enabled_extension_names[AGFX_DEVICE_EXTENSIONS_MAX] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    uint32_t enabled_extensions_count = 1;
+    uint32_t mesh_shader_extension = device_extension_supported(context->physical_device, VK_EXT_MESH_SHADER_EXTENSION_NAME);
+    uint32_t pipeline_library_extensions = device_extension_supported(context->physical_device, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME)
+        && device_extension_supported(context->physical_device, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT supported_pipeline_library_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT
+    };
+
+    VkPhysicalDeviceMeshShaderFeaturesEXT supported_mesh_shader_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT,
+        .pNext = pipeline_library_extensions ? &supported_pipeline_library_features : NULL
+    };
+
+    // bindless textures: one big partially bound sampler array indexed by material
+    VkPhysicalDeviceVulkan12Features supported_vulkan12_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .pNext = mesh_shader_extension ? (void*)&supported_mesh_shader_features : (pipeline_library_extensions ? (void*)&supported_pipeline_library_features : NULL)
+    };
+    VkPhysicalDeviceFeatures2 supported_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &supported_vulkan12_features
+    };
+    vkGetPhysicalDeviceFeatures2(context->physical_device, &supported_features);
+
+    if (VK_TRUE != supported_vulkan12_features.descriptorIndexing
+        || VK_TRUE != supported_vulkan12_features.runtimeDescriptorArray
+        || VK_TRUE != supported_vulkan12_features.descriptorBindingPartiallyBound
+        || VK_TRUE != supported_vulkan12_features.shaderSampledImageArrayNonUniformIndexing)
+    {
+        free(device_queue_create_infos);
+        return AGFX_DEVICE_CREATE_ERROR;
+    }
+
+    // indirect draws put the object index in firstInstance, without it every draw would read object 0
+    if (VK_TRUE != supported_features.features.drawIndirectFirstInstance)
+    {
+        free(device_queue_create_infos);
+        return AGFX_DEVICE_CREATE_ERROR;
+    }
+
+    // these two only pick the indirect draw path, see agfx_cmd_draw_list
+    context->multi_draw_indirect_supported = supported_features.features.multiDrawIndirect;
+    context->draw_indirect_count_supported = supported_vulkan12_features.drawIndirectCount;
+
+    // optional, meshlet culling falls back to indexed draws per cluster without it
+    context->mesh_shader_supported = mesh_shader_extension && VK_TRUE == supported_mesh_shader_features.meshShader;
+    context->max_mesh_work_group_count = 0;
+    context->cmd_draw_mesh_tasks_indirect = NULL;
+    if (context->mesh_shader_supported)
+    {
+        VkPhysicalDeviceMeshShaderPropertiesEXT mesh_shader_properties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_PROPERTIES_EXT
+        };
+        VkPhysicalDeviceProperties2 properties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+            .pNext = &mesh_shader_properties
+        };
+        vkGetPhysicalDeviceProperties2(context->physical_device, &properties);
+        context->max_mesh_work_group_count = mesh_shader_properties.maxMeshWorkGroupTotalCount;
+        enabled_extension_names[enabled_extensions_count++] = VK_EXT_MESH_SHADER_EXTENSION_NAME;
+    }
+
+    // optional, scene pipelines are linked from precompiled parts with it and compiled whole without it. linking is only worth
+    // it where the driver says it is fast
+    context->graphics_pipeline_library_supported = 0;
+    if (pipeline_library_extensions && VK_TRUE == supported_pipeline_library_features.graphicsPipelineLibrary)
+    {
+        VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT pipeline_library_properties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT
+        };
+        VkPhysicalDeviceProperties2 properties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+            .pNext = &pipeline_library_properties
+        };
+        vkGetPhysicalDeviceProperties2(context->physical_device, &properties);
+        context->graphics_pipeline_library_supported = VK_TRUE == pipeline_library_properties.graphicsPipelineLibraryFastLinking;
+    }
+    if (context->graphics_pipeline_library_supported)
+    {
+        enabled_extension_names[enabled_extensions_count++] = VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME;
+        enabled_extension_names[enabled_extensions_count++] = VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME;
+    }
+
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipeline_library_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+        .graphicsPipelineLibrary = VK_TRUE
+    };
+
+    VkPhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT,
+        .pNext = context->graphics_pipeline_library_supported ? &pipeline_library_features : NULL,
+        .meshShader = VK_TRUE
+    };
 
     VkPhysicalDeviceFeatures deviceFeatures = {
         .geometryShader = VK_TRUE,
-        .samplerAnisotropy = VK_TRUE
+        .samplerAnisotropy = VK_TRUE,
+        .multiDrawIndirect = context->multi_draw_indirect_supported,
+        .drawIndirectFirstInstance = VK_TRUE
+    };
+
+    VkPhysicalDeviceVulkan12Features vulkan12_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .descriptorIndexing = VK_TRUE,
+        .runtimeDescriptorArray = VK_TRUE,
+        .descriptorBindingPartiallyBound = VK_TRUE,
+        .shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+        .drawIndirectCount = context->draw_indirect_count_supported,
+        .pNext = context->mesh_shader_supported ? (void*)&mesh_shader_features : (context->graphics_pipeline_library_supported ? (void*)&pipeline_library_features : NULL)
     };
 
     VkDeviceCreateInfo device_create_info = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .pNext = &vulkan12_features,
         .pQueueCreateInfos = device_queue_create_infos,
         .queueCreateInfoCount = 1,
-        .enabledExtensionCount = 1,
-        .ppEnabledExtensionNames = &enabledExtensionName,
+        .enabledExtensionCount = enabled_extensions_count,
+        .ppEnabledExtensionNames = enabled_extension_names,
         .pEnabledFeatures = &deviceFeatures
     };
 
@@ -297,6 +431,12 @@ agfx_result_t create_logical_device(agfx_context_t* context)
         result = AGFX_DEVICE_CREATE_ERROR;
     }
 
+    if (AGFX_SUCCESS == result && context->mesh_shader_supported)
+    {
+        context->cmd_draw_mesh_tasks_indirect = (PFN_vkCmdDrawMeshTasksIndirectEXT)vkGetDeviceProcAddr(context->device, "vkCmdDrawMeshTasksIndirectEXT");
+        context->mesh_shader_supported = NULL != context->cmd_draw_mesh_tasks_indirect;
+    }
+
     vkGetDeviceQueue(context->device, context->queue_family_indices.graphics_index, 0, &context->graphics_queue);
     vkGetDeviceQueue(context->device, context->queue_family_indices.present_index, 0, &context->present_queue);
 
@@ -304,6 +444,44 @@ agfx_result_t create_logical_device(agfx_context_t* context)
     return result;
 }
 
+void query_memory_properties(agfx_context_t* context)
+{
+    vkGetPhysicalDeviceMemoryProperties(context->physical_device, &context->memory_properties);
+
+    context->direct_upload_memory_type_index = UINT32_MAX;
+    context->direct_upload_budget = 0;
+    context->direct_upload_used = 0;
+    context->direct_upload_allocations_count = 0;
+
+    VkMemoryPropertyFlags direct_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    VkDeviceSize best_heap_size = 0;
+    uint32_t best_is_coherent = 0;
+
+    for (uint32_t i = 0; i < context->memory_properties.memoryTypeCount; ++i)
+    {
+        VkMemoryType* memory_type = &context->memory_properties.memoryTypes[i];
+        if ((memory_type->propertyFlags & direct_flags) != direct_flags) continue;
+
+        VkMemoryHeap* memory_heap = &context->memory_properties.memoryHeaps[memory_type->heapIndex];
+        if (!(memory_heap->flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) continue;
+
+        // coherent memory saves a flush per upload, after that the biggest heap wins (rebar over the 256 MiB window)
+        uint32_t is_coherent = (memory_type->propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+        if (is_coherent < best_is_coherent) continue;
+        if (is_coherent == best_is_coherent && memory_heap->size <= best_heap_size) continue;
+
+        context->direct_upload_memory_type_index = i;
+        best_heap_size = memory_heap->size;
+        best_is_coherent = is_coherent;
+    }
+
+    if (context->direct_upload_memory_type_index == UINT32_MAX) return;
+
+    context->direct_upload_budget = best_heap_size > AGFX_LEGACY_BAR_HEAP_SIZE
+        ? best_heap_size / AGFX_LARGE_BAR_BUDGET_DIVISOR
+        : best_heap_size / AGFX_LEGACY_BAR_BUDGET_DIVISOR;
+}
+
 agfx_result_t agfx_create_context(agfx_present_t* present, agfx_context_t* out_context)
 {
     agfx_context_t context;
@@ -320,11 +498,20 @@ agfx_result_t agfx_create_context(agfx_present_t* present, agfx_context_t* out_c
     result = find_physical_device(&context);
     if (AGFX_SUCCESS != result) goto free_vulkan_instance;
 
+    vkGetPhysicalDeviceProperties(context.physical_device, &context.device_properties);
+    query_memory_properties(&context);
+
     result = create_logical_device(&context);
     if (AGFX_SUCCESS != result) goto free_vulkan_surface;
 
+    result = agfx_create_pipeline_cache(&context, AGFX_PIPELINE_CACHE_PATH);
+    if (AGFX_SUCCESS != result) goto free_logical_device;
+
 goto finish;
 
+free_logical_device:
+    free_logical_device(&context);
+
 free_vulkan_surface:
     free_vulkan_surface(&context);
 free_vulkan_instance:
@@ -336,6 +523,9 @@ finish:
 
 void agfx_free_context(agfx_context_t* context)
 {
+    // a failed save only costs the next startup its warm cache
+    agfx_save_pipeline_cache(context, AGFX_PIPELINE_CACHE_PATH);
+    agfx_free_pipeline_cache(context);
     free_logical_device(context);
     free_vulkan_surface(context);
     free_vulkan_instance(context);
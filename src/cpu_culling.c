@@ -0,0 +1,351 @@
+#include "cpu_culling.h"
+
+// the simd paths are compiled for their own targets and picked at runtime, the build itself stays generic
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AGFX_CPU_CULL_X86
+#include <immintrin.h>
+#endif
+
+static size_t padded_count(size_t count)
+{
+    return (count + AGFX_CPU_CULL_LANES - 1) / AGFX_CPU_CULL_LANES * AGFX_CPU_CULL_LANES;
+}
+
+agfx_result_t agfx_create_cull_bounds(size_t capacity, agfx_cull_bounds_t* out_bounds)
+{
+    agfx_cull_bounds_t bounds = {0};
+
+    // every stream lives in one block, at least one lane group so the pointers are never null
+    bounds.capacity = padded_count(capacity > 0 ? capacity : 1);
+    bounds.data = calloc(bounds.capacity * AGFX_CPU_CULL_STREAM_COUNT, sizeof(float));
+    if (NULL == bounds.data)
+    {
+        *out_bounds = bounds;
+        return AGFX_BUFFER_ERROR;
+    }
+
+    float** streams[AGFX_CPU_CULL_STREAM_COUNT] = {
+        &bounds.sphere_x, &bounds.sphere_y, &bounds.sphere_z, &bounds.sphere_radius,
+        &bounds.box_center_x, &bounds.box_center_y, &bounds.box_center_z,
+        &bounds.box_extent_x, &bounds.box_extent_y, &bounds.box_extent_z
+    };
+    for (size_t i = 0; i < AGFX_CPU_CULL_STREAM_COUNT; ++i)
+    {
+        *streams[i] = bounds.data + i * bounds.capacity;
+    }
+
+    agfx_cull_bounds_set_count(&bounds, 0);
+
+    *out_bounds = bounds;
+    return AGFX_SUCCESS;
+}
+
+void agfx_free_cull_bounds(agfx_cull_bounds_t* bounds)
+{
+    free(bounds->data);
+    *bounds = (agfx_cull_bounds_t) {0};
+}
+
+// lanes past the count get a radius no plane distance can make up for, so they are always culled
+void agfx_cull_bounds_set_count(agfx_cull_bounds_t* bounds, size_t count)
+{
+    bounds->count = count < bounds->capacity ? count : bounds->capacity;
+
+    for (size_t i = bounds->count; i < padded_count(bounds->count); ++i)
+    {
+        agfx_cull_bounds_set(bounds, i, (agfx_vector4_t) {.w = -FLT_MAX}, (agfx_vector3_t) {0}, (agfx_vector3_t) {0});
+    }
+}
+
+void agfx_cull_bounds_set(agfx_cull_bounds_t* bounds, size_t index, agfx_vector4_t sphere, agfx_vector3_t box_center, agfx_vector3_t box_extent)
+{
+    bounds->sphere_x[index] = sphere.x;
+    bounds->sphere_y[index] = sphere.y;
+    bounds->sphere_z[index] = sphere.z;
+    bounds->sphere_radius[index] = sphere.w;
+    bounds->box_center_x[index] = box_center.x;
+    bounds->box_center_y[index] = box_center.y;
+    bounds->box_center_z[index] = box_center.z;
+    bounds->box_extent_x[index] = box_extent.x;
+    bounds->box_extent_y[index] = box_extent.y;
+    bounds->box_extent_z[index] = box_extent.z;
+}
+
+// model space bounds to world space, the sphere grows with the largest axis scale and the box stays axis aligned around the rotated one
+void agfx_cull_bounds_set_transformed(agfx_cull_bounds_t* bounds, size_t index, agfx_mat4x4_t transform, agfx_vector4_t sphere, agfx_vector3_t box_min, agfx_vector3_t box_max)
+{
+    agfx_vector4_t sphere_center = agfx_mat4x4_multiplied_by_vector4(transform, (agfx_vector4_t) {.x = sphere.x, .y = sphere.y, .z = sphere.z, .w = 1.0f});
+    float scale_x = agfx_vector3_dot((agfx_vector3_t) {transform.mat[0].x, transform.mat[0].y, transform.mat[0].z}, (agfx_vector3_t) {transform.mat[0].x, transform.mat[0].y, transform.mat[0].z});
+    float scale_y = agfx_vector3_dot((agfx_vector3_t) {transform.mat[1].x, transform.mat[1].y, transform.mat[1].z}, (agfx_vector3_t) {transform.mat[1].x, transform.mat[1].y, transform.mat[1].z});
+    float scale_z = agfx_vector3_dot((agfx_vector3_t) {transform.mat[2].x, transform.mat[2].y, transform.mat[2].z}, (agfx_vector3_t) {transform.mat[2].x, transform.mat[2].y, transform.mat[2].z});
+    sphere_center.w = sphere.w * sqrtf(fmaxf(scale_x, fmaxf(scale_y, scale_z)));
+
+    agfx_vector4_t local_center = {
+        .x = (box_min.x + box_max.x) * 0.5f,
+        .y = (box_min.y + box_max.y) * 0.5f,
+        .z = (box_min.z + box_max.z) * 0.5f,
+        .w = 1.0f
+    };
+    agfx_vector3_t local_extent = {
+        .x = (box_max.x - box_min.x) * 0.5f,
+        .y = (box_max.y - box_min.y) * 0.5f,
+        .z = (box_max.z - box_min.z) * 0.5f
+    };
+    agfx_vector4_t box_center = agfx_mat4x4_multiplied_by_vector4(transform, local_center);
+    agfx_vector3_t box_extent = {
+        .x = fabsf(transform.mat[0].x) * local_extent.x + fabsf(transform.mat[1].x) * local_extent.y + fabsf(transform.mat[2].x) * local_extent.z,
+        .y = fabsf(transform.mat[0].y) * local_extent.x + fabsf(transform.mat[1].y) * local_extent.y + fabsf(transform.mat[2].y) * local_extent.z,
+        .z = fabsf(transform.mat[0].z) * local_extent.x + fabsf(transform.mat[1].z) * local_extent.y + fabsf(transform.mat[2].z) * local_extent.z
+    };
+
+    agfx_cull_bounds_set(bounds, index, sphere_center, (agfx_vector3_t) {box_center.x, box_center.y, box_center.z}, box_extent);
+}
+
+// same planes as cull.comp: rows of the view projection, depth is clipped to 0..1
+agfx_frustum_t agfx_frustum_from_view_projection(agfx_mat4x4_t view_projection)
+{
+    agfx_vector4_t rows[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        const float* columns[4] = {&view_projection.mat[0].x, &view_projection.mat[1].x, &view_projection.mat[2].x, &view_projection.mat[3].x};
+        rows[i] = (agfx_vector4_t) {columns[0][i], columns[1][i], columns[2][i], columns[3][i]};
+    }
+
+    agfx_frustum_t frustum = {
+        .planes = {
+            agfx_vector4_add_vector4(rows[3], rows[0]),
+            agfx_vector4_subtract_vector4(rows[3], rows[0]),
+            agfx_vector4_add_vector4(rows[3], rows[1]),
+            agfx_vector4_subtract_vector4(rows[3], rows[1]),
+            rows[2],
+            agfx_vector4_subtract_vector4(rows[3], rows[2])
+        }
+    };
+
+    for (int i = 0; i < 6; ++i)
+    {
+        agfx_vector4_t plane = frustum.planes[i];
+        float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        if (length > 0.0f)
+        {
+            frustum.planes[i] = (agfx_vector4_t) {plane.x / length, plane.y / length, plane.z / length, plane.w / length};
+        }
+    }
+
+    return frustum;
+}
+
+agfx_cull_path_t agfx_cull_best_path(void)
+{
+#if defined(AGFX_CPU_CULL_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return AGFX_CULL_PATH_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return AGFX_CULL_PATH_SSE;
+    }
+#endif
+    return AGFX_CULL_PATH_SCALAR;
+}
+
+// an object is visible when neither its sphere nor its box is fully behind any plane.
+// the box uses the plane normal's absolute value to get its projected half size, no corner selection needed
+static size_t cull_frustum_scalar(const agfx_cull_bounds_t* bounds, const agfx_frustum_t* frustum, uint32_t* out_visible_indices)
+{
+    size_t visible_count = 0;
+
+    for (size_t i = 0; i < bounds->count; ++i)
+    {
+        int visible = 1;
+        for (int p = 0; p < 6 && visible; ++p)
+        {
+            agfx_vector4_t plane = frustum->planes[p];
+            float sphere_distance = plane.x * bounds->sphere_x[i] + plane.y * bounds->sphere_y[i] + plane.z * bounds->sphere_z[i] + plane.w + bounds->sphere_radius[i];
+            float box_distance = plane.x * bounds->box_center_x[i] + plane.y * bounds->box_center_y[i] + plane.z * bounds->box_center_z[i] + plane.w
+                + fabsf(plane.x) * bounds->box_extent_x[i] + fabsf(plane.y) * bounds->box_extent_y[i] + fabsf(plane.z) * bounds->box_extent_z[i];
+            visible = sphere_distance >= 0.0f && box_distance >= 0.0f;
+        }
+
+        if (visible)
+        {
+            out_visible_indices[visible_count++] = (uint32_t)i;
+        }
+    }
+
+    return visible_count;
+}
+
+#if defined(AGFX_CPU_CULL_X86)
+
+static inline size_t emit_visible_lanes(uint32_t mask, size_t base, uint32_t* out_visible_indices, size_t visible_count)
+{
+    while (mask)
+    {
+        out_visible_indices[visible_count++] = (uint32_t)(base + __builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+    return visible_count;
+}
+
+// two 4 wide halves per iteration, sse2 has no fma so this is mul + add
+__attribute__((target("sse2")))
+static size_t cull_frustum_sse(const agfx_cull_bounds_t* bounds, const agfx_frustum_t* frustum, uint32_t* out_visible_indices)
+{
+    __m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6], abs_x[6], abs_y[6], abs_z[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        plane_x[p] = _mm_set1_ps(frustum->planes[p].x);
+        plane_y[p] = _mm_set1_ps(frustum->planes[p].y);
+        plane_z[p] = _mm_set1_ps(frustum->planes[p].z);
+        plane_w[p] = _mm_set1_ps(frustum->planes[p].w);
+        abs_x[p] = _mm_set1_ps(fabsf(frustum->planes[p].x));
+        abs_y[p] = _mm_set1_ps(fabsf(frustum->planes[p].y));
+        abs_z[p] = _mm_set1_ps(fabsf(frustum->planes[p].z));
+    }
+
+    __m128 zero = _mm_setzero_ps();
+    size_t visible_count = 0;
+
+    for (size_t base = 0; base < bounds->count; base += AGFX_CPU_CULL_LANES)
+    {
+        uint32_t mask = 0;
+        for (size_t half = 0; half < AGFX_CPU_CULL_LANES; half += 4)
+        {
+            size_t i = base + half;
+            __m128 sphere_x = _mm_loadu_ps(bounds->sphere_x + i);
+            __m128 sphere_y = _mm_loadu_ps(bounds->sphere_y + i);
+            __m128 sphere_z = _mm_loadu_ps(bounds->sphere_z + i);
+            __m128 sphere_radius = _mm_loadu_ps(bounds->sphere_radius + i);
+            __m128 center_x = _mm_loadu_ps(bounds->box_center_x + i);
+            __m128 center_y = _mm_loadu_ps(bounds->box_center_y + i);
+            __m128 center_z = _mm_loadu_ps(bounds->box_center_z + i);
+            __m128 extent_x = _mm_loadu_ps(bounds->box_extent_x + i);
+            __m128 extent_y = _mm_loadu_ps(bounds->box_extent_y + i);
+            __m128 extent_z = _mm_loadu_ps(bounds->box_extent_z + i);
+
+            __m128 inside = _mm_cmpeq_ps(zero, zero);
+            for (int p = 0; p < 6; ++p)
+            {
+                __m128 sphere_distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane_x[p], sphere_x), _mm_mul_ps(plane_y[p], sphere_y)), _mm_add_ps(_mm_mul_ps(plane_z[p], sphere_z), _mm_add_ps(plane_w[p], sphere_radius)));
+                __m128 box_distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane_x[p], center_x), _mm_mul_ps(plane_y[p], center_y)), _mm_add_ps(_mm_mul_ps(plane_z[p], center_z), plane_w[p]));
+                box_distance = _mm_add_ps(box_distance, _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs_x[p], extent_x), _mm_mul_ps(abs_y[p], extent_y)), _mm_mul_ps(abs_z[p], extent_z)));
+                inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(sphere_distance, zero), _mm_cmpge_ps(box_distance, zero)));
+            }
+            mask |= (uint32_t)_mm_movemask_ps(inside) << half;
+        }
+
+        visible_count = emit_visible_lanes(mask, base, out_visible_indices, visible_count);
+    }
+
+    return visible_count;
+}
+
+__attribute__((target("avx2,fma")))
+static size_t cull_frustum_avx2(const agfx_cull_bounds_t* bounds, const agfx_frustum_t* frustum, uint32_t* out_visible_indices)
+{
+    __m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6], abs_x[6], abs_y[6], abs_z[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        plane_x[p] = _mm256_set1_ps(frustum->planes[p].x);
+        plane_y[p] = _mm256_set1_ps(frustum->planes[p].y);
+        plane_z[p] = _mm256_set1_ps(frustum->planes[p].z);
+        plane_w[p] = _mm256_set1_ps(frustum->planes[p].w);
+        abs_x[p] = _mm256_set1_ps(fabsf(frustum->planes[p].x));
+        abs_y[p] = _mm256_set1_ps(fabsf(frustum->planes[p].y));
+        abs_z[p] = _mm256_set1_ps(fabsf(frustum->planes[p].z));
+    }
+
+    __m256 zero = _mm256_setzero_ps();
+    size_t visible_count = 0;
+
+    for (size_t base = 0; base < bounds->count; base += AGFX_CPU_CULL_LANES)
+    {
+        __m256 sphere_x = _mm256_loadu_ps(bounds->sphere_x + base);
+        __m256 sphere_y = _mm256_loadu_ps(bounds->sphere_y + base);
+        __m256 sphere_z = _mm256_loadu_ps(bounds->sphere_z + base);
+        __m256 sphere_radius = _mm256_loadu_ps(bounds->sphere_radius + base);
+        __m256 center_x = _mm256_loadu_ps(bounds->box_center_x + base);
+        __m256 center_y = _mm256_loadu_ps(bounds->box_center_y + base);
+        __m256 center_z = _mm256_loadu_ps(bounds->box_center_z + base);
+        __m256 extent_x = _mm256_loadu_ps(bounds->box_extent_x + base);
+        __m256 extent_y = _mm256_loadu_ps(bounds->box_extent_y + base);
+        __m256 extent_z = _mm256_loadu_ps(bounds->box_extent_z + base);
+
+        __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+        for (int p = 0; p < 6; ++p)
+        {
+            __m256 sphere_distance = _mm256_fmadd_ps(plane_x[p], sphere_x, _mm256_fmadd_ps(plane_y[p], sphere_y, _mm256_fmadd_ps(plane_z[p], sphere_z, _mm256_add_ps(plane_w[p], sphere_radius))));
+            __m256 box_distance = _mm256_fmadd_ps(plane_x[p], center_x, _mm256_fmadd_ps(plane_y[p], center_y, _mm256_fmadd_ps(plane_z[p], center_z, plane_w[p])));
+            box_distance = _mm256_fmadd_ps(abs_x[p], extent_x, _mm256_fmadd_ps(abs_y[p], extent_y, _mm256_fmadd_ps(abs_z[p], extent_z, box_distance)));
+            inside = _mm256_and_ps(inside, _mm256_and_ps(_mm256_cmp_ps(sphere_distance, zero, _CMP_GE_OQ), _mm256_cmp_ps(box_distance, zero, _CMP_GE_OQ)));
+        }
+
+        visible_count = emit_visible_lanes((uint32_t)_mm256_movemask_ps(inside), base, out_visible_indices, visible_count);
+    }
+
+    return visible_count;
+}
+
+#endif
+
+// indices come out in ascending order whatever the path, out_visible_indices needs room for bounds->count entries
+size_t agfx_cull_frustum(const agfx_cull_bounds_t* bounds, const agfx_frustum_t* frustum, agfx_cull_path_t path, uint32_t* out_visible_indices)
+{
+#if defined(AGFX_CPU_CULL_X86)
+    switch (path)
+    {
+        case AGFX_CULL_PATH_AVX2:
+            return cull_frustum_avx2(bounds, frustum, out_visible_indices);
+        case AGFX_CULL_PATH_SSE:
+            return cull_frustum_sse(bounds, frustum, out_visible_indices);
+        default:
+            break;
+    }
+#endif
+    return cull_frustum_scalar(bounds, frustum, out_visible_indices);
+}
+
+agfx_result_t agfx_create_cpu_culling(size_t capacity, agfx_cpu_culling_t* out_cpu_culling)
+{
+    agfx_cpu_culling_t cpu_culling = {0};
+
+    agfx_result_t result = agfx_create_cull_bounds(capacity, &cpu_culling.bounds);
+    if (AGFX_SUCCESS != result) return result;
+
+    // every draw starts at its full mesh, the level is kept from frame to frame for the hysteresis
+    cpu_culling.visible_indices = calloc(cpu_culling.bounds.capacity, sizeof(uint32_t));
+    cpu_culling.draw_lods = calloc(cpu_culling.bounds.capacity, sizeof(uint8_t));
+    if (NULL == cpu_culling.visible_indices || NULL == cpu_culling.draw_lods)
+    {
+        free(cpu_culling.visible_indices);
+        free(cpu_culling.draw_lods);
+        agfx_free_cull_bounds(&cpu_culling.bounds);
+        return AGFX_BUFFER_ERROR;
+    }
+
+    cpu_culling.path = agfx_cull_best_path();
+    // 0 never matches the renderer generation, so the first frame fills the bounds
+    cpu_culling.generation = 0;
+
+    *out_cpu_culling = cpu_culling;
+    return AGFX_SUCCESS;
+}
+
+void agfx_free_cpu_culling(agfx_cpu_culling_t* cpu_culling)
+{
+    free(cpu_culling->visible_indices);
+    cpu_culling->visible_indices = NULL;
+    free(cpu_culling->draw_lods);
+    cpu_culling->draw_lods = NULL;
+    cpu_culling->visible_count = 0;
+    agfx_free_cull_bounds(&cpu_culling->bounds);
+}
+
+void agfx_cpu_cull(agfx_cpu_culling_t* cpu_culling, agfx_mat4x4_t view_projection)
+{
+    agfx_frustum_t frustum = agfx_frustum_from_view_projection(view_projection);
+    cpu_culling->visible_count = agfx_cull_frustum(&cpu_culling->bounds, &frustum, cpu_culling->path, cpu_culling->visible_indices);
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include "draw_list.h"
+
+agfx_result_t agfx_create_draw_list(size_t draws_capacity, agfx_draw_list_t* out_draw_list)
+{
+    agfx_draw_list_t draw_list = {0};
+
+    draw_list.draws_capacity = draws_capacity;
+    if (draws_capacity > 0)
+    {
+        draw_list.draws = calloc(draws_capacity, sizeof(agfx_draw_record_t));
+        if (NULL == draw_list.draws)
+        {
+            *out_draw_list = draw_list;
+            return AGFX_BUFFER_ERROR;
+        }
+    }
+
+    // 0 never matches the renderer generation, so the first frame builds the list
+    draw_list.generation = 0;
+
+    *out_draw_list = draw_list;
+    return AGFX_SUCCESS;
+}
+
+void agfx_free_draw_list(agfx_draw_list_t* draw_list)
+{
+    free(draw_list->draws);
+    draw_list->draws = NULL;
+    draw_list->draws_count = 0;
+    draw_list->draws_capacity = 0;
+}
+
+void agfx_draw_list_clear(agfx_draw_list_t* draw_list)
+{
+    draw_list->draws_count = 0;
+}
+
+agfx_result_t agfx_draw_list_push(agfx_draw_list_t* draw_list, uint32_t index_count, uint32_t first_index, int32_t vertex_offset, uint32_t object_index, uint32_t material_index, uint32_t first_lod, uint32_t lods_count)
+{
+    if (draw_list->draws_count >= draw_list->draws_capacity)
+    {
+        return AGFX_DRAW_LIST_FULL_ERROR;
+    }
+
+    // first instance is the object index, the vertex shader reads the object data with gl_InstanceIndex
+    agfx_draw_record_t* draw = &draw_list->draws[draw_list->draws_count++];
+    draw->command.indexCount = index_count;
+    draw->command.instanceCount = 1;
+    draw->command.firstIndex = first_index;
+    draw->command.vertexOffset = vertex_offset;
+    draw->command.firstInstance = object_index;
+    draw->material_index = material_index;
+    draw->first_lod = first_lod;
+    draw->lods_count = lods_count;
+
+    return AGFX_SUCCESS;
+}
+
+// the gpu buffer is every record followed by the count of each range
+VkDeviceSize agfx_draw_list_count_offset(size_t draws_capacity)
+{
+    VkDeviceSize records_size = sizeof(agfx_draw_record_t) * draws_capacity;
+    return (records_size + AGFX_DRAW_LIST_COUNT_ALIGNMENT - 1) / AGFX_DRAW_LIST_COUNT_ALIGNMENT * AGFX_DRAW_LIST_COUNT_ALIGNMENT;
+}
+
+VkDeviceSize agfx_draw_list_buffer_size(size_t draws_capacity)
+{
+    return agfx_draw_list_count_offset(draws_capacity) + AGFX_DRAW_LIST_COUNT_SIZE;
+}
+
+// every range's count is its size, what the list is drawn with when nothing culled it
+void agfx_draw_list_write(agfx_draw_list_t* draw_list, void* mapped)
+{
+    memcpy(mapped, draw_list->draws, sizeof(agfx_draw_record_t) * draw_list->draws_count);
+    uint32_t counts[AGFX_DRAW_RANGES_COUNT];
+    for (uint32_t range = 0; range < AGFX_DRAW_RANGES_COUNT; ++range)
+    {
+        counts[range] = draw_list->range_first_draws[range + 1] - draw_list->range_first_draws[range];
+    }
+    memcpy((uint8_t*)mapped + agfx_draw_list_count_offset(draw_list->draws_capacity), counts, sizeof(counts));
+}
+
+// one range of the list, its count is the range's slot after the records and draws_count is the most it can be.
+// recording cost does not depend on the number of draws unless the device has no multi draw indirect at all
+void agfx_cmd_draw_list(agfx_context_t* context, VkCommandBuffer command_buffer, VkBuffer draw_buffer, VkDeviceSize draw_buffer_offset, size_t draws_capacity, uint32_t range, uint32_t first_draw, uint32_t draws_count)
+{
+    uint32_t stride = sizeof(agfx_draw_record_t);
+
+    if (0 == draws_count)
+    {
+        return;
+    }
+
+    if (context->draw_indirect_count_supported)
+    {
+        VkDeviceSize count_offset = draw_buffer_offset + agfx_draw_list_count_offset(draws_capacity) + sizeof(uint32_t) * range;
+        vkCmdDrawIndexedIndirectCount(command_buffer, draw_buffer, draw_buffer_offset + (VkDeviceSize)first_draw * stride, draw_buffer, count_offset, draws_count, stride);
+        return;
+    }
+
+    agfx_cmd_draw_list_range(context, command_buffer, draw_buffer, draw_buffer_offset, first_draw, draws_count);
+}
+
+// the draws are known on the cpu here, so any range of them can go into its own command buffer
+void agfx_cmd_draw_list_range(agfx_context_t* context, VkCommandBuffer command_buffer, VkBuffer draw_buffer, VkDeviceSize draw_buffer_offset, uint32_t first_draw, uint32_t draws_count)
+{
+    uint32_t stride = sizeof(agfx_draw_record_t);
+    uint32_t end_draw = first_draw + draws_count;
+
+    if (context->multi_draw_indirect_supported)
+    {
+        uint32_t max_draw_count = context->device_properties.limits.maxDrawIndirectCount;
+        for (uint32_t chunk_first_draw = first_draw; chunk_first_draw < end_draw; chunk_first_draw += max_draw_count)
+        {
+            uint32_t chunk_count = end_draw - chunk_first_draw < max_draw_count ? end_draw - chunk_first_draw : max_draw_count;
+            vkCmdDrawIndexedIndirect(command_buffer, draw_buffer, draw_buffer_offset + (VkDeviceSize)chunk_first_draw * stride, chunk_count, stride);
+        }
+        return;
+    }
+
+    for (uint32_t draw_index = first_draw; draw_index < end_draw; ++draw_index)
+    {
+        vkCmdDrawIndexedIndirect(command_buffer, draw_buffer, draw_buffer_offset + (VkDeviceSize)draw_index * stride, 1, stride);
+    }
+}
\ No newline at end of file
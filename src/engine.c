@@ -1,28 +1,58 @@
 #include "engine.h"
 
-agfx_result_t agfx_initialize_engine(agfx_engine_t* engine)
+void agfx_default_engine_state(agfx_state_t* out_state)
 {
-    agfx_result_t result = AGFX_SUCCESS;
-
-    SDL_Init(SDL_INIT_EVERYTHING);
-
-    engine->state = (agfx_state_t) {
+    *out_state = (agfx_state_t) {
         .current_frame = 0,
         .quit = 0,
         .resized = 0,
         .rotation = {0},
-        .camera_fov = 45.0f
+        .camera_fov = 45.0f,
+        .gpu_culling = 1,
+        .occlusion_culling = 1,
+        .software_occlusion = 1,
+        .parallel_recording = 1,
+        .cached_recording = 1,
+        .static_batching = 1,
+        .mesh_optimization = 1,
+        .lod_generation = 1,
+        .lod_selection = 1,
+        .meshlet_generation = 1,
+        .meshlet_culling = 1,
+        // double sided materials draw both sides, a cone culled meshlet of theirs could still be seen from behind
+        .meshlet_cone_culling = 0,
+        .mesh_shaders = 1,
+        // forward stays the default, the visibility buffer is there to be compared against it
+        .visibility_buffer = 0,
+        // only pays off where overdraw is heavy and shading costly, otherwise it is a second geometry pass for nothing
+        .depth_prepass = 0,
+        .model_path = "./models/test.glb"
     };
+}
+
+// the state is filled in beforehand, so a caller can change what the engine starts with
+agfx_result_t agfx_create_engine(agfx_engine_t* engine)
+{
+    agfx_result_t result = AGFX_SUCCESS;
+
+    SDL_Init(SDL_INIT_EVERYTHING);
 
+    agfx_create_job_system(0, &engine->job_system);
     agfx_create_present(&engine->present);
     agfx_create_context(&engine->present, &engine->context);
     agfx_create_swapchain(&engine->context, &engine->present, &engine->swapchain);
-    agfx_create_renderer(&engine->context, &engine->swapchain, &engine->state, &engine->renderer);
+    agfx_create_renderer(&engine->context, &engine->swapchain, &engine->state, &engine->job_system, &engine->renderer);
     engine->swapchain.renderer = &engine->renderer; // bruh
     agfx_create_framebuffers(&engine->swapchain);
     return result;
 }
 
+agfx_result_t agfx_initialize_engine(agfx_engine_t* engine)
+{
+    agfx_default_engine_state(&engine->state);
+    return agfx_create_engine(engine);
+}
+
 void agfx_free_engine(agfx_engine_t* engine)
 {
     vkDeviceWaitIdle(engine->context.device);
@@ -31,6 +61,7 @@ void agfx_free_engine(agfx_engine_t* engine)
     agfx_free_swapchain(&engine->swapchain);
     agfx_free_context(&engine->context);
     agfx_free_present(&engine->present);
+    agfx_free_job_system(&engine->job_system);
 
     SDL_Quit();
 }
@@ -49,13 +80,21 @@ void agfx_game_loop(agfx_engine_t* engine)
     }
 
     vkResetFences(engine->context.device, 1, &engine->renderer.in_flight_fences[engine->state.current_frame]);
-    vkResetCommandBuffer(engine->renderer.command_buffers[engine->state.current_frame], 0);
+
+    // the fence signaled, so nothing the gpu reads from this frame's arena region is in flight anymore
+    agfx_frame_arena_reset(&engine->renderer.frame_arena, engine->state.current_frame);
+    agfx_gpu_culling_begin_frame(&engine->renderer);
+    agfx_meshlet_culling_begin_frame(&engine->renderer);
+    agfx_visibility_buffer_begin_frame(&engine->renderer);
+    agfx_gpu_timer_read(&engine->renderer, image_index);
+    agfx_update_uniform_buffer(&engine->renderer);
+
+    agfx_command_recorder_begin_frame(&engine->context, &engine->renderer.command_recorder, engine->state.current_frame);
     agfx_record_command_buffers(&engine->renderer, image_index);
+    VkCommandBuffer command_buffer = agfx_command_recorder_primary(&engine->renderer.command_recorder);
 
     VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
 
-    agfx_update_uniform_buffer(&engine->renderer);
-
     VkSubmitInfo submit_info = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
         .waitSemaphoreCount = 1,
@@ -64,7 +103,7 @@ void agfx_game_loop(agfx_engine_t* engine)
         .pSignalSemaphores = &engine->renderer.render_finished_semaphores[engine->state.current_frame],
         .pWaitDstStageMask = wait_stages,
         .commandBufferCount = 1,
-        .pCommandBuffers = &engine->renderer.command_buffers[engine->state.current_frame],
+        .pCommandBuffers = &command_buffer,
     };
 
     vkQueueSubmit(engine->context.graphics_queue, 1, &submit_info, engine->renderer.in_flight_fences[engine->state.current_frame]);
@@ -135,10 +174,119 @@ void agfx_main(agfx_engine_t* engine)
             if (event.key.keysym.sym == SDLK_HOME) {
                 printf("camera_fov = %f\n", engine->state.camera_fov);
                 engine->state.camera_fov += 3.0f;
+                // the gpu path records the lod scale, which follows the fov, as a push constant
+                agfx_invalidate_commands(&engine->renderer);
             }
             if (event.key.keysym.sym == SDLK_END) {
                 printf("camera_fov = %f\n", engine->state.camera_fov);
                 engine->state.camera_fov -= 3.0f;
+                agfx_invalidate_commands(&engine->renderer);
+            }
+            if (event.key.keysym.sym == SDLK_c) {
+                engine->state.gpu_culling = !engine->state.gpu_culling;
+                agfx_invalidate_commands(&engine->renderer);
+                printf("gpu_culling = %u\n", engine->state.gpu_culling);
+            }
+            if (event.key.keysym.sym == SDLK_o) {
+                engine->state.occlusion_culling = !engine->state.occlusion_culling;
+                agfx_invalidate_commands(&engine->renderer);
+                printf("occlusion_culling = %u\n", engine->state.occlusion_culling);
+            }
+            if (event.key.keysym.sym == SDLK_s) {
+                engine->state.software_occlusion = !engine->state.software_occlusion;
+                printf("software_occlusion = %u\n", engine->state.software_occlusion);
+            }
+            if (event.key.keysym.sym == SDLK_r) {
+                engine->state.parallel_recording = !engine->state.parallel_recording;
+                agfx_invalidate_commands(&engine->renderer);
+                printf("parallel_recording = %u\n", engine->state.parallel_recording);
+            }
+            if (event.key.keysym.sym == SDLK_k) {
+                engine->state.cached_recording = !engine->state.cached_recording;
+                printf("cached_recording = %u\n", engine->state.cached_recording);
+            }
+            if (event.key.keysym.sym == SDLK_l) {
+                engine->state.lod_selection = !engine->state.lod_selection;
+                agfx_invalidate_commands(&engine->renderer);
+                printf("lod_selection = %u\n", engine->state.lod_selection);
+            }
+            if (event.key.keysym.sym == SDLK_m) {
+                engine->state.meshlet_culling = !engine->state.meshlet_culling;
+                agfx_invalidate_commands(&engine->renderer);
+                printf("meshlet_culling = %u\n", engine->state.meshlet_culling);
+            }
+            if (event.key.keysym.sym == SDLK_b) {
+                engine->state.meshlet_cone_culling = !engine->state.meshlet_cone_culling;
+                agfx_invalidate_commands(&engine->renderer);
+                printf("meshlet_cone_culling = %u\n", engine->state.meshlet_cone_culling);
+            }
+            if (event.key.keysym.sym == SDLK_x) {
+                engine->state.mesh_shaders = !engine->state.mesh_shaders;
+                agfx_invalidate_commands(&engine->renderer);
+                printf("mesh_shaders = %u\n", engine->state.mesh_shaders);
+            }
+            if (event.key.keysym.sym == SDLK_g) {
+                engine->state.visibility_buffer = !engine->state.visibility_buffer;
+                agfx_invalidate_commands(&engine->renderer);
+                printf("visibility_buffer = %u\n", engine->state.visibility_buffer);
+            }
+            if (event.key.keysym.sym == SDLK_z) {
+                engine->state.depth_prepass = !engine->state.depth_prepass;
+                agfx_invalidate_commands(&engine->renderer);
+                printf("depth_prepass = %u\n", engine->state.depth_prepass);
+            }
+            if (event.key.keysym.sym == SDLK_v) {
+                if (engine->state.gpu_culling) {
+                    agfx_cull_stats_t* stats = &engine->renderer.gpu_culling.stats;
+                    printf("visible = %u, frustum culled = %u, occlusion culled = %u\n", stats->visible_count, stats->frustum_culled_count, stats->occlusion_culled_count);
+                    if (agfx_meshlet_culling_enabled(&engine->renderer)) {
+                        agfx_meshlet_cull_stats_t* meshlet_cull_stats = &engine->renderer.meshlet_culling.stats;
+                        printf("clusters visible = %u (%u triangles), frustum culled = %u, cone culled = %u, occlusion culled = %u, mesh shaders = %u\n", meshlet_cull_stats->visible_count, meshlet_cull_stats->triangles_count,
+                            meshlet_cull_stats->frustum_culled_count, meshlet_cull_stats->cone_culled_count, meshlet_cull_stats->occlusion_culled_count, agfx_meshlet_culling_uses_mesh_shaders(&engine->renderer));
+                    }
+                } else {
+                    agfx_cpu_culling_t* cpu_culling = &engine->renderer.cpu_culling;
+                    size_t occlusion_culled_count = engine->state.software_occlusion ? engine->renderer.software_occlusion.culled_count : 0;
+                    printf("cpu visible = %zu, frustum culled = %zu, occlusion culled = %zu\n", cpu_culling->visible_count, cpu_culling->bounds.count - cpu_culling->visible_count - occlusion_culled_count, occlusion_culled_count);
+                    agfx_render_queue_stats_t* queue_stats = &engine->renderer.render_queue.stats;
+                    printf("batches = %u, binds = %u, binds saved = %u, sort = %.3f ms\n", queue_stats->batches_count, queue_stats->binds_count, queue_stats->binds_saved_count, queue_stats->sort_ms);
+                    printf("instances = %zu in %u instanced draws\n", cpu_culling->visible_count, engine->renderer.frames[engine->state.current_frame].cpu_draws_count);
+                    agfx_lod_stats_t* lod_stats = &engine->renderer.lod_stats;
+                    printf("lod triangles = %llu of %llu\n", (unsigned long long)lod_stats->drawn_triangles_count, (unsigned long long)lod_stats->full_triangles_count);
+                }
+                agfx_static_batch_stats_t* batch_stats = &engine->renderer.static_batch_stats;
+                printf("static batching merged %u primitives into %u meshes\n", batch_stats->merged_primitives_count, batch_stats->batches_count);
+                agfx_mesh_optimizer_stats_t* optimizer_stats = &engine->renderer.mesh_optimizer_stats;
+                printf("mesh optimization: %u meshes in %.3f ms, acmr %.3f -> %.3f, atvr %.3f -> %.3f\n", optimizer_stats->optimized_meshes_count, optimizer_stats->optimize_ms,
+                    agfx_vertex_cache_acmr(&optimizer_stats->before), agfx_vertex_cache_acmr(&optimizer_stats->after), agfx_vertex_cache_atvr(&optimizer_stats->before), agfx_vertex_cache_atvr(&optimizer_stats->after));
+                agfx_lod_stats_t* lod_stats = &engine->renderer.lod_stats;
+                printf("lod chains: %u meshes with %u levels below the full one in %.3f ms\n", lod_stats->meshes_count, lod_stats->lods_count, lod_stats->build_ms);
+                agfx_meshlet_stats_t* meshlet_stats = &engine->renderer.meshlet_stats;
+                printf("meshlets: %u in %u meshes, %.1f triangles and %.1f vertices each, %u with a cone, in %.3f ms\n", meshlet_stats->meshlets_count, meshlet_stats->meshes_count,
+                    meshlet_stats->meshlets_count > 0 ? (double)meshlet_stats->triangles_count / meshlet_stats->meshlets_count : 0.0,
+                    meshlet_stats->meshlets_count > 0 ? (double)meshlet_stats->vertices_count / meshlet_stats->meshlets_count : 0.0, meshlet_stats->cones_count, meshlet_stats->build_ms);
+                printf("gpu frame = %.3f ms, visibility buffer = %u, depth prepass = %u\n", engine->renderer.gpu_timer.frame_ms, agfx_visibility_buffer_enabled(&engine->renderer), engine->state.depth_prepass);
+                agfx_command_recorder_t* command_recorder = &engine->renderer.command_recorder;
+                printf("recording = %.3f ms, secondaries = %u, workers = %u, recorded frames = %llu, reused frames = %llu\n", command_recorder->record_ms, command_recorder->secondaries_count, command_recorder->workers_count,
+                    (unsigned long long)command_recorder->recorded_frames, (unsigned long long)command_recorder->reused_frames);
+                agfx_pipeline_state_cache_t* pipeline_states = engine->renderer.pipeline_states;
+                agfx_pipeline_compile_stats_t compile_stats;
+                agfx_pipeline_state_cache_stats(pipeline_states, &compile_stats);
+                printf("pipelines ready = %u, compile queue = %u, failed = %u, compile total = %.3f ms, slowest = %.3f ms\n", compile_stats.ready_count, compile_stats.pending_count,
+                    compile_stats.failed_count, compile_stats.total_ms, compile_stats.max_ms);
+                printf("pipeline libraries = %u, optimized = %u, optimize total = %.3f ms, fragment libraries = %u\n", pipeline_states->libraries_enabled, compile_stats.optimized_count,
+                    compile_stats.optimize_total_ms, pipeline_states->fragment_libraries_count);
+                for (uint32_t slot = 0; slot < pipeline_states->capacity; ++slot)
+                {
+                    int state = SDL_AtomicGet(&pipeline_states->states[slot]);
+                    if (AGFX_PIPELINE_COMPILE_READY == state)
+                    {
+                        printf("  pipeline 0x%02x: %.3f ms\n", pipeline_states->keys[slot], pipeline_states->compile_ms[slot]);
+                    } else if (AGFX_PIPELINE_COMPILE_OPTIMIZED == state)
+                    {
+                        printf("  pipeline 0x%02x: %.3f ms, optimized %.3f ms\n", pipeline_states->keys[slot], pipeline_states->compile_ms[slot], pipeline_states->optimize_ms[slot]);
+                    }
+                }
             }
             goto event_switch_end;
         }
@@ -0,0 +1,81 @@
+#include "frame_arena.h"
+
+agfx_result_t agfx_create_frame_arena(agfx_context_t* context, uint32_t frames_count, agfx_frame_arena_t* out_frame_arena)
+{
+    agfx_frame_arena_t frame_arena = {0};
+    agfx_result_t result = AGFX_SUCCESS;
+
+    const VkPhysicalDeviceLimits* limits = &context->device_properties.limits;
+    frame_arena.alignment = limits->minUniformBufferOffsetAlignment;
+    if (limits->minStorageBufferOffsetAlignment > frame_arena.alignment)
+    {
+        frame_arena.alignment = limits->minStorageBufferOffsetAlignment;
+    }
+    if (frame_arena.alignment == 0)
+    {
+        frame_arena.alignment = 16;
+    }
+    frame_arena.frame_size = AGFX_FRAME_ARENA_FRAME_SIZE;
+
+    VkDeviceSize arena_size = frame_arena.frame_size * frames_count;
+
+    // with rebar or unified memory the gpu reads transient data without crossing the bus, as long as the memory needs no flushes
+    uint32_t direct_memory_is_coherent = context->direct_upload_memory_type_index != UINT32_MAX &&
+        (context->memory_properties.memoryTypes[context->direct_upload_memory_type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    if (!direct_memory_is_coherent || AGFX_SUCCESS != agfx_helper_create_direct_buffer(context, arena_size, AGFX_FRAME_ARENA_USAGE, &frame_arena.buffer, &frame_arena.buffer_memory))
+    {
+        result = agfx_helper_create_buffer(context, arena_size, AGFX_FRAME_ARENA_USAGE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame_arena.buffer, &frame_arena.buffer_memory);
+        if (AGFX_SUCCESS != result) goto finish;
+    }
+
+    void* mapped;
+    if (VK_SUCCESS != vkMapMemory(context->device, frame_arena.buffer_memory, 0, VK_WHOLE_SIZE, 0, &mapped))
+    {
+        agfx_helper_free_buffer(context, frame_arena.buffer, frame_arena.buffer_memory);
+        result = AGFX_BUFFER_MAP_ERROR;
+        goto finish;
+    }
+    frame_arena.mapped = (uint8_t*)mapped;
+
+    agfx_frame_arena_reset(&frame_arena, 0);
+
+finish:
+    *out_frame_arena = frame_arena;
+    return result;
+}
+
+void agfx_free_frame_arena(agfx_context_t* context, agfx_frame_arena_t* frame_arena)
+{
+    agfx_helper_free_buffer(context, frame_arena->buffer, frame_arena->buffer_memory);
+}
+
+// only call once the fence of frame_index signaled, everything handed out for that frame before is reused
+void agfx_frame_arena_reset(agfx_frame_arena_t* frame_arena, uint32_t frame_index)
+{
+    frame_arena->frame_index = frame_index;
+    frame_arena->head = frame_arena->frame_size * frame_index;
+}
+
+agfx_result_t agfx_frame_arena_allocate(agfx_frame_arena_t* frame_arena, VkDeviceSize size, VkDeviceSize alignment, agfx_frame_allocation_t* out_allocation)
+{
+    if (alignment < frame_arena->alignment)
+    {
+        alignment = frame_arena->alignment;
+    }
+
+    VkDeviceSize offset = (frame_arena->head + alignment - 1) / alignment * alignment;
+    VkDeviceSize frame_end = frame_arena->frame_size * (frame_arena->frame_index + 1);
+    if (offset + size > frame_end)
+    {
+        return AGFX_FRAME_ARENA_OUT_OF_MEMORY_ERROR;
+    }
+
+    frame_arena->head = offset + size;
+
+    out_allocation->buffer = frame_arena->buffer;
+    out_allocation->offset = offset;
+    out_allocation->mapped = frame_arena->mapped + offset;
+
+    return AGFX_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,674 @@
+#include "gpu_culling.h"
+#include "renderer.h"
+
+static agfx_result_t create_compute_pipeline(agfx_context_t* context, const char* path, VkPipelineLayout pipeline_layout, VkPipeline* pipeline)
+{
+    VkShaderModule shader_module;
+    agfx_result_t result = agfx_helper_create_shader_module(context, path, &shader_module);
+    if (AGFX_SUCCESS != result) return result;
+
+    VkComputePipelineCreateInfo pipeline_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shader_module,
+            .pName = "main"
+        },
+        .layout = pipeline_layout
+    };
+
+    if (VK_SUCCESS != vkCreateComputePipelines(context->device, context->pipeline_cache, 1, &pipeline_create_info, NULL, pipeline))
+    {
+        result = AGFX_PIPELINE_ERROR;
+    }
+
+    vkDestroyShaderModule(context->device, shader_module, NULL);
+    return result;
+}
+
+static agfx_result_t create_culling_pipelines(agfx_renderer_t* renderer)
+{
+    agfx_gpu_culling_t* culling = &renderer->gpu_culling;
+    VkDevice device = renderer->context->device;
+    agfx_result_t result = AGFX_SUCCESS;
+
+    // constants, objects, input draws, early draws + count, late draws + count, visibility, stats, depth pyramid, mesh levels
+    VkDescriptorSetLayoutBinding cull_bindings[AGFX_CULL_DESCRIPTOR_COUNT];
+    for (uint32_t i = 0; i < AGFX_CULL_DESCRIPTOR_COUNT; ++i)
+    {
+        cull_bindings[i] = (VkDescriptorSetLayoutBinding) {
+            .binding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+        };
+    }
+    cull_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    cull_bindings[AGFX_CULL_PYRAMID_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+    VkDescriptorSetLayoutCreateInfo cull_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = AGFX_CULL_DESCRIPTOR_COUNT,
+        .pBindings = cull_bindings
+    };
+
+    if (VK_SUCCESS != vkCreateDescriptorSetLayout(device, &cull_layout_create_info, NULL, &culling->cull_descriptor_set_layout))
+    {
+        return AGFX_DESCRIPTOR_SET_LAYOUT_ERROR;
+    }
+
+    VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(agfx_cull_push_constants_t)
+    };
+
+    VkPipelineLayoutCreateInfo cull_pipeline_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &culling->cull_descriptor_set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constant_range
+    };
+
+    if (VK_SUCCESS != vkCreatePipelineLayout(device, &cull_pipeline_layout_create_info, NULL, &culling->cull_pipeline_layout))
+    {
+        result = AGFX_PIPELINE_ERROR;
+        goto free_cull_descriptor_set_layout;
+    }
+
+    result = create_compute_pipeline(renderer->context, "./shaders/cull.spv", culling->cull_pipeline_layout, &culling->cull_pipeline);
+    if (AGFX_SUCCESS != result) goto free_cull_pipeline_layout;
+
+    VkDescriptorSetLayoutBinding reduce_bindings[AGFX_DEPTH_REDUCE_DESCRIPTOR_COUNT] = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+        }
+    };
+
+    VkDescriptorSetLayoutCreateInfo reduce_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = AGFX_DEPTH_REDUCE_DESCRIPTOR_COUNT,
+        .pBindings = reduce_bindings
+    };
+
+    if (VK_SUCCESS != vkCreateDescriptorSetLayout(device, &reduce_layout_create_info, NULL, &culling->reduce_descriptor_set_layout))
+    {
+        result = AGFX_DESCRIPTOR_SET_LAYOUT_ERROR;
+        goto free_cull_pipeline;
+    }
+
+    VkPipelineLayoutCreateInfo reduce_pipeline_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &culling->reduce_descriptor_set_layout
+    };
+
+    if (VK_SUCCESS != vkCreatePipelineLayout(device, &reduce_pipeline_layout_create_info, NULL, &culling->reduce_pipeline_layout))
+    {
+        result = AGFX_PIPELINE_ERROR;
+        goto free_reduce_descriptor_set_layout;
+    }
+
+    result = create_compute_pipeline(renderer->context, "./shaders/depth_reduce.spv", culling->reduce_pipeline_layout, &culling->reduce_pipeline);
+    if (AGFX_SUCCESS != result) goto free_reduce_pipeline_layout;
+
+goto finish;
+
+free_reduce_pipeline_layout:
+    vkDestroyPipelineLayout(device, culling->reduce_pipeline_layout, NULL);
+free_reduce_descriptor_set_layout:
+    vkDestroyDescriptorSetLayout(device, culling->reduce_descriptor_set_layout, NULL);
+free_cull_pipeline:
+    vkDestroyPipeline(device, culling->cull_pipeline, NULL);
+free_cull_pipeline_layout:
+    vkDestroyPipelineLayout(device, culling->cull_pipeline_layout, NULL);
+free_cull_descriptor_set_layout:
+    vkDestroyDescriptorSetLayout(device, culling->cull_descriptor_set_layout, NULL);
+finish:
+    return result;
+}
+
+static void free_culling_pipelines(agfx_renderer_t* renderer)
+{
+    agfx_gpu_culling_t* culling = &renderer->gpu_culling;
+    VkDevice device = renderer->context->device;
+
+    vkDestroyPipeline(device, culling->reduce_pipeline, NULL);
+    vkDestroyPipelineLayout(device, culling->reduce_pipeline_layout, NULL);
+    vkDestroyDescriptorSetLayout(device, culling->reduce_descriptor_set_layout, NULL);
+    vkDestroyPipeline(device, culling->cull_pipeline, NULL);
+    vkDestroyPipelineLayout(device, culling->cull_pipeline_layout, NULL);
+    vkDestroyDescriptorSetLayout(device, culling->cull_descriptor_set_layout, NULL);
+}
+
+static agfx_result_t create_culling_descriptor_pool(agfx_renderer_t* renderer)
+{
+    VkDescriptorPoolSize descriptor_pool_sizes[AGFX_CULL_DESCRIPTOR_POOL_SIZE_COUNT] = {
+        {
+            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            .descriptorCount = AGFX_MAX_FRAMES_IN_FLIGHT
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = AGFX_MAX_FRAMES_IN_FLIGHT * (AGFX_CULL_DESCRIPTOR_COUNT - 2)
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = AGFX_MAX_FRAMES_IN_FLIGHT + AGFX_DEPTH_PYRAMID_MAX_LEVELS
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = AGFX_DEPTH_PYRAMID_MAX_LEVELS
+        }
+    };
+
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = AGFX_CULL_DESCRIPTOR_POOL_SIZE_COUNT,
+        .pPoolSizes = descriptor_pool_sizes,
+        .maxSets = AGFX_MAX_FRAMES_IN_FLIGHT + AGFX_DEPTH_PYRAMID_MAX_LEVELS
+    };
+
+    if (VK_SUCCESS != vkCreateDescriptorPool(renderer->context->device, &descriptor_pool_create_info, NULL, &renderer->gpu_culling.descriptor_pool))
+    {
+        return AGFX_DESCRIPTOR_POOL_ERROR;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+static void free_culling_frame(agfx_renderer_t* renderer, agfx_cull_frame_t* cull_frame)
+{
+    VkDevice device = renderer->context->device;
+
+    vkDestroyBuffer(device, cull_frame->stats_buffer, NULL);
+    vkFreeMemory(device, cull_frame->stats_buffer_memory, NULL);
+    vkDestroyBuffer(device, cull_frame->late_draw_buffer, NULL);
+    vkFreeMemory(device, cull_frame->late_draw_buffer_memory, NULL);
+    vkDestroyBuffer(device, cull_frame->early_draw_buffer, NULL);
+    vkFreeMemory(device, cull_frame->early_draw_buffer_memory, NULL);
+}
+
+static agfx_result_t create_culling_frame(agfx_renderer_t* renderer, agfx_cull_frame_t* cull_frame)
+{
+    agfx_context_t* context = renderer->context;
+    agfx_result_t result = AGFX_SUCCESS;
+
+    VkDeviceSize draw_buffer_size = agfx_draw_list_buffer_size(renderer->gpu_culling.draws_capacity);
+
+    result = agfx_helper_create_buffer(context, draw_buffer_size, AGFX_DRAW_LIST_USAGE | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &cull_frame->early_draw_buffer, &cull_frame->early_draw_buffer_memory);
+    if (AGFX_SUCCESS != result) return result;
+
+    result = agfx_helper_create_buffer(context, draw_buffer_size, AGFX_DRAW_LIST_USAGE | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &cull_frame->late_draw_buffer, &cull_frame->late_draw_buffer_memory);
+    if (AGFX_SUCCESS != result) goto free_early_draw_buffer;
+
+    // host visible so the counters can be read back once the frame's fence signaled
+    result = agfx_helper_create_buffer(context, sizeof(agfx_cull_stats_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &cull_frame->stats_buffer, &cull_frame->stats_buffer_memory);
+    if (AGFX_SUCCESS != result) goto free_late_draw_buffer;
+
+    if (VK_SUCCESS != vkMapMemory(context->device, cull_frame->stats_buffer_memory, 0, sizeof(agfx_cull_stats_t), 0, &cull_frame->stats_buffer_mapped))
+    {
+        result = AGFX_BUFFER_MAP_ERROR;
+        goto free_stats_buffer;
+    }
+    memset(cull_frame->stats_buffer_mapped, 0, sizeof(agfx_cull_stats_t));
+
+goto finish;
+
+free_stats_buffer:
+    vkDestroyBuffer(context->device, cull_frame->stats_buffer, NULL);
+    vkFreeMemory(context->device, cull_frame->stats_buffer_memory, NULL);
+free_late_draw_buffer:
+    vkDestroyBuffer(context->device, cull_frame->late_draw_buffer, NULL);
+    vkFreeMemory(context->device, cull_frame->late_draw_buffer_memory, NULL);
+free_early_draw_buffer:
+    vkDestroyBuffer(context->device, cull_frame->early_draw_buffer, NULL);
+    vkFreeMemory(context->device, cull_frame->early_draw_buffer_memory, NULL);
+finish:
+    return result;
+}
+
+// everything but the depth pyramid, that one is written when the pyramid is (re)created
+static void write_culling_frame_descriptor_set(agfx_renderer_t* renderer, size_t frame_index)
+{
+    agfx_gpu_culling_t* culling = &renderer->gpu_culling;
+    agfx_frame_t* frame = &renderer->frames[frame_index];
+    agfx_cull_frame_t* cull_frame = &culling->frames[frame_index];
+
+    VkDeviceSize count_offset = agfx_draw_list_count_offset(culling->draws_capacity);
+
+    VkDescriptorBufferInfo buffer_infos[AGFX_CULL_DESCRIPTOR_COUNT] = {
+        {.buffer = renderer->frame_arena.buffer, .offset = 0, .range = sizeof(agfx_frame_constants_t)},
+        {.buffer = frame->object_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        {.buffer = frame->draw_buffer, .offset = 0, .range = count_offset > 0 ? count_offset : VK_WHOLE_SIZE},
+        {.buffer = cull_frame->early_draw_buffer, .offset = 0, .range = count_offset > 0 ? count_offset : VK_WHOLE_SIZE},
+        {.buffer = cull_frame->early_draw_buffer, .offset = count_offset, .range = AGFX_DRAW_LIST_COUNT_SIZE},
+        {.buffer = cull_frame->late_draw_buffer, .offset = 0, .range = count_offset > 0 ? count_offset : VK_WHOLE_SIZE},
+        {.buffer = cull_frame->late_draw_buffer, .offset = count_offset, .range = AGFX_DRAW_LIST_COUNT_SIZE},
+        {.buffer = culling->visibility_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        {.buffer = cull_frame->stats_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        {0},
+        {.buffer = renderer->lod_buffer, .offset = 0, .range = VK_WHOLE_SIZE}
+    };
+
+    VkWriteDescriptorSet write_descriptor_sets[AGFX_CULL_DESCRIPTOR_COUNT - 1];
+    uint32_t writes_count = 0;
+    for (uint32_t i = 0; i < AGFX_CULL_DESCRIPTOR_COUNT; ++i)
+    {
+        if (AGFX_CULL_PYRAMID_BINDING == i) continue;
+
+        write_descriptor_sets[writes_count++] = (VkWriteDescriptorSet) {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = cull_frame->descriptor_set,
+            .dstBinding = i,
+            .dstArrayElement = 0,
+            .descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .pBufferInfo = &buffer_infos[i]
+        };
+    }
+
+    vkUpdateDescriptorSets(renderer->context->device, writes_count, write_descriptor_sets, 0, NULL);
+}
+
+static agfx_result_t create_visibility_buffer(agfx_renderer_t* renderer)
+{
+    agfx_gpu_culling_t* culling = &renderer->gpu_culling;
+    VkDeviceSize visibility_buffer_size = sizeof(uint32_t) * (culling->draws_capacity > 0 ? culling->draws_capacity : 1);
+
+    agfx_result_t result = agfx_helper_create_buffer(renderer->context, visibility_buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &culling->visibility_buffer, &culling->visibility_buffer_memory);
+    if (AGFX_SUCCESS != result) return result;
+
+    // nothing counts as visible last frame, so the first early phase draws nothing and the late phase does all the work
+    VkCommandBuffer command_buffer;
+    result = agfx_helper_command_buffer_begin(renderer, &command_buffer);
+    if (AGFX_SUCCESS != result) goto free_visibility_buffer;
+
+    vkCmdFillBuffer(command_buffer, culling->visibility_buffer, 0, VK_WHOLE_SIZE, 0);
+
+    result = agfx_helper_command_buffer_end(renderer, &command_buffer);
+    if (AGFX_SUCCESS != result) goto free_visibility_buffer;
+
+    return result;
+
+free_visibility_buffer:
+    vkDestroyBuffer(renderer->context->device, culling->visibility_buffer, NULL);
+    vkFreeMemory(renderer->context->device, culling->visibility_buffer_memory, NULL);
+    return result;
+}
+
+static agfx_result_t create_pyramid_sampler(agfx_renderer_t* renderer)
+{
+    VkSamplerCreateInfo sampler_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .anisotropyEnable = VK_FALSE,
+        .compareEnable = VK_FALSE,
+        .minLod = 0.0f,
+        .maxLod = VK_LOD_CLAMP_NONE,
+        .unnormalizedCoordinates = VK_FALSE
+    };
+
+    if (VK_SUCCESS != vkCreateSampler(renderer->context->device, &sampler_create_info, NULL, &renderer->gpu_culling.pyramid_sampler))
+    {
+        return AGFX_SAMPLER_CREATE_ERROR;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+static void free_depth_pyramid(agfx_renderer_t* renderer)
+{
+    agfx_gpu_culling_t* culling = &renderer->gpu_culling;
+    VkDevice device = renderer->context->device;
+
+    if (culling->pyramid_levels == 0) return;
+
+    for (uint32_t level = 0; level < culling->pyramid_levels; ++level)
+    {
+        vkDestroyImageView(device, culling->pyramid_mip_views[level], NULL);
+    }
+    vkDestroyImageView(device, culling->pyramid_image_view, NULL);
+    vkDestroyImage(device, culling->pyramid_image, NULL);
+    vkFreeMemory(device, culling->pyramid_image_memory, NULL);
+
+    culling->pyramid_levels = 0;
+}
+
+// level 0 is half the depth buffer, every level halves again rounding down
+static agfx_result_t create_depth_pyramid(agfx_renderer_t* renderer)
+{
+    agfx_gpu_culling_t* culling = &renderer->gpu_culling;
+    agfx_context_t* context = renderer->context;
+    agfx_result_t result = AGFX_SUCCESS;
+    uint32_t created_views = 0;
+
+    uint32_t width = renderer->swapchain->swapchain_extent.width / 2;
+    uint32_t height = renderer->swapchain->swapchain_extent.height / 2;
+    if (width == 0) width = 1;
+    if (height == 0) height = 1;
+
+    uint32_t levels = 1;
+    for (uint32_t size = width > height ? width : height; size > 1 && levels < AGFX_DEPTH_PYRAMID_MAX_LEVELS; size /= 2)
+    {
+        levels++;
+    }
+
+    result = agfx_helper_create_mipmapped_image(context, width, height, levels, AGFX_DEPTH_PYRAMID_FORMAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &culling->pyramid_image, &culling->pyramid_image_memory);
+    if (AGFX_SUCCESS != result) return result;
+
+    result = agfx_helper_create_image_view_for_mips(context, culling->pyramid_image, AGFX_DEPTH_PYRAMID_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, &culling->pyramid_image_view);
+    if (AGFX_SUCCESS != result) goto free_pyramid_image;
+
+    for (; created_views < levels; ++created_views)
+    {
+        result = agfx_helper_create_image_view_for_mips(context, culling->pyramid_image, AGFX_DEPTH_PYRAMID_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, created_views, 1, &culling->pyramid_mip_views[created_views]);
+        if (AGFX_SUCCESS != result) goto free_pyramid_views;
+    }
+
+    result = agfx_helper_transition_image_layout(renderer, culling->pyramid_image, AGFX_DEPTH_PYRAMID_FORMAT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    if (AGFX_SUCCESS != result) goto free_pyramid_views;
+
+    culling->pyramid_width = width;
+    culling->pyramid_height = height;
+    culling->pyramid_levels = levels;
+    culling->pyramid_depth_generation = renderer->swapchain->depth_generation;
+
+    // level 0 reads the depth buffer the early pass left in shader read layout, the rest read the level above
+    for (uint32_t level = 0; level < levels; ++level)
+    {
+        VkDescriptorImageInfo source_image_info = {
+            .sampler = culling->pyramid_sampler,
+            .imageView = level == 0 ? renderer->swapchain->depth_image_view : culling->pyramid_mip_views[level - 1],
+            .imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL
+        };
+
+        VkDescriptorImageInfo destination_image_info = {
+            .imageView = culling->pyramid_mip_views[level],
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+        };
+
+        VkWriteDescriptorSet write_descriptor_sets[AGFX_DEPTH_REDUCE_DESCRIPTOR_COUNT] = {
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = culling->reduce_descriptor_sets[level],
+                .dstBinding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = 1,
+                .pImageInfo = &source_image_info
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = culling->reduce_descriptor_sets[level],
+                .dstBinding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = 1,
+                .pImageInfo = &destination_image_info
+            }
+        };
+        vkUpdateDescriptorSets(context->device, AGFX_DEPTH_REDUCE_DESCRIPTOR_COUNT, write_descriptor_sets, 0, NULL);
+    }
+
+    VkDescriptorImageInfo pyramid_image_info = {
+        .sampler = culling->pyramid_sampler,
+        .imageView = culling->pyramid_image_view,
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+    };
+
+    for (size_t i = 0; i < AGFX_MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        VkWriteDescriptorSet write_descriptor_set = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = culling->frames[i].descriptor_set,
+            .dstBinding = AGFX_CULL_PYRAMID_BINDING,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .pImageInfo = &pyramid_image_info
+        };
+        vkUpdateDescriptorSets(context->device, 1, &write_descriptor_set, 0, NULL);
+    }
+
+    return result;
+
+free_pyramid_views:
+    for (uint32_t level = 0; level < created_views; ++level)
+    {
+        vkDestroyImageView(context->device, culling->pyramid_mip_views[level], NULL);
+    }
+    vkDestroyImageView(context->device, culling->pyramid_image_view, NULL);
+free_pyramid_image:
+    vkDestroyImage(context->device, culling->pyramid_image, NULL);
+    vkFreeMemory(context->device, culling->pyramid_image_memory, NULL);
+    return result;
+}
+
+agfx_result_t agfx_create_gpu_culling(agfx_renderer_t* renderer)
+{
+    agfx_gpu_culling_t* culling = &renderer->gpu_culling;
+    agfx_result_t result = AGFX_SUCCESS;
+    size_t created_frames = 0;
+
+    memset(culling, 0, sizeof(agfx_gpu_culling_t));
+    culling->draws_capacity = renderer->draw_list.draws_capacity;
+
+    result = create_culling_pipelines(renderer);
+    if (AGFX_SUCCESS != result) return result;
+
+    result = create_culling_descriptor_pool(renderer);
+    if (AGFX_SUCCESS != result) goto free_pipelines;
+
+    result = create_pyramid_sampler(renderer);
+    if (AGFX_SUCCESS != result) goto free_descriptor_pool;
+
+    result = create_visibility_buffer(renderer);
+    if (AGFX_SUCCESS != result) goto free_pyramid_sampler;
+
+    culling->frames = calloc(AGFX_MAX_FRAMES_IN_FLIGHT, sizeof(agfx_cull_frame_t));
+    if (NULL == culling->frames)
+    {
+        result = AGFX_BUFFER_ERROR;
+        goto free_visibility_buffer;
+    }
+
+    for (; created_frames < AGFX_MAX_FRAMES_IN_FLIGHT; ++created_frames)
+    {
+        result = create_culling_frame(renderer, &culling->frames[created_frames]);
+        if (AGFX_SUCCESS != result) goto free_frames;
+    }
+
+    VkDescriptorSetLayout cull_set_layouts[AGFX_MAX_FRAMES_IN_FLIGHT];
+    VkDescriptorSet cull_sets[AGFX_MAX_FRAMES_IN_FLIGHT];
+    for (size_t i = 0; i < AGFX_MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        cull_set_layouts[i] = culling->cull_descriptor_set_layout;
+    }
+
+    VkDescriptorSetAllocateInfo cull_set_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = culling->descriptor_pool,
+        .descriptorSetCount = AGFX_MAX_FRAMES_IN_FLIGHT,
+        .pSetLayouts = cull_set_layouts
+    };
+
+    if (VK_SUCCESS != vkAllocateDescriptorSets(renderer->context->device, &cull_set_allocate_info, cull_sets))
+    {
+        result = AGFX_DESCRIPTOR_SET_ERROR;
+        goto free_frames;
+    }
+
+    for (size_t i = 0; i < AGFX_MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        culling->frames[i].descriptor_set = cull_sets[i];
+        write_culling_frame_descriptor_set(renderer, i);
+    }
+
+    VkDescriptorSetLayout reduce_set_layouts[AGFX_DEPTH_PYRAMID_MAX_LEVELS];
+    for (size_t i = 0; i < AGFX_DEPTH_PYRAMID_MAX_LEVELS; ++i)
+    {
+        reduce_set_layouts[i] = culling->reduce_descriptor_set_layout;
+    }
+
+    VkDescriptorSetAllocateInfo reduce_set_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = culling->descriptor_pool,
+        .descriptorSetCount = AGFX_DEPTH_PYRAMID_MAX_LEVELS,
+        .pSetLayouts = reduce_set_layouts
+    };
+
+    if (VK_SUCCESS != vkAllocateDescriptorSets(renderer->context->device, &reduce_set_allocate_info, culling->reduce_descriptor_sets))
+    {
+        result = AGFX_DESCRIPTOR_SET_ERROR;
+        goto free_frames;
+    }
+
+    // the depth image does not exist yet, the pyramid is created on the first frame
+    culling->pyramid_levels = 0;
+    culling->pyramid_depth_generation = 0;
+
+    return result;
+
+free_frames:
+    for (size_t i = 0; i < created_frames; ++i)
+    {
+        free_culling_frame(renderer, &culling->frames[i]);
+    }
+    free(culling->frames);
+free_visibility_buffer:
+    vkDestroyBuffer(renderer->context->device, culling->visibility_buffer, NULL);
+    vkFreeMemory(renderer->context->device, culling->visibility_buffer_memory, NULL);
+free_pyramid_sampler:
+    vkDestroySampler(renderer->context->device, culling->pyramid_sampler, NULL);
+free_descriptor_pool:
+    vkDestroyDescriptorPool(renderer->context->device, culling->descriptor_pool, NULL);
+free_pipelines:
+    free_culling_pipelines(renderer);
+    return result;
+}
+
+void agfx_free_gpu_culling(agfx_renderer_t* renderer)
+{
+    agfx_gpu_culling_t* culling = &renderer->gpu_culling;
+
+    free_depth_pyramid(renderer);
+    for (size_t i = 0; i < AGFX_MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        free_culling_frame(renderer, &culling->frames[i]);
+    }
+    free(culling->frames);
+    vkDestroyBuffer(renderer->context->device, culling->visibility_buffer, NULL);
+    vkFreeMemory(renderer->context->device, culling->visibility_buffer_memory, NULL);
+    vkDestroySampler(renderer->context->device, culling->pyramid_sampler, NULL);
+    vkDestroyDescriptorPool(renderer->context->device, culling->descriptor_pool, NULL);
+    free_culling_pipelines(renderer);
+}
+
+// call after the frame's fence signaled: picks up the counters that frame slot wrote last time
+// and rebuilds the pyramid when the swapchain got a new depth image
+agfx_result_t agfx_gpu_culling_begin_frame(agfx_renderer_t* renderer)
+{
+    agfx_gpu_culling_t* culling = &renderer->gpu_culling;
+    agfx_cull_frame_t* cull_frame = &culling->frames[renderer->state->current_frame];
+
+    memcpy(&culling->stats, cull_frame->stats_buffer_mapped, sizeof(agfx_cull_stats_t));
+
+    if (culling->pyramid_levels != 0 && culling->pyramid_depth_generation == renderer->swapchain->depth_generation)
+    {
+        return AGFX_SUCCESS;
+    }
+
+    vkDeviceWaitIdle(renderer->context->device);
+    free_depth_pyramid(renderer);
+    return create_depth_pyramid(renderer);
+}
+
+void agfx_cmd_gpu_cull(agfx_renderer_t* renderer, VkCommandBuffer command_buffer, uint32_t phase)
+{
+    agfx_gpu_culling_t* culling = &renderer->gpu_culling;
+    agfx_frame_t* frame = &renderer->frames[renderer->state->current_frame];
+    agfx_cull_frame_t* cull_frame = &culling->frames[renderer->state->current_frame];
+
+    if (phase == AGFX_CULL_PHASE_EARLY)
+    {
+        VkDeviceSize count_offset = agfx_draw_list_count_offset(culling->draws_capacity);
+        vkCmdFillBuffer(command_buffer, cull_frame->early_draw_buffer, count_offset, AGFX_DRAW_LIST_COUNT_SIZE, 0);
+        vkCmdFillBuffer(command_buffer, cull_frame->late_draw_buffer, count_offset, AGFX_DRAW_LIST_COUNT_SIZE, 0);
+        vkCmdFillBuffer(command_buffer, cull_frame->stats_buffer, 0, VK_WHOLE_SIZE, 0);
+
+        // also orders against the previous frame's late phase, which wrote the visibility this one reads
+        VkMemoryBarrier clear_barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+        };
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clear_barrier, 0, NULL, 0, NULL);
+    }
+
+    agfx_cull_push_constants_t push_constants = {
+        .draws_count = frame->draws_count,
+        .phase = phase,
+        .occlusion_enabled = renderer->state->occlusion_culling,
+        .compact = renderer->context->draw_indirect_count_supported,
+        .pyramid_width = (float)culling->pyramid_width,
+        .pyramid_height = (float)culling->pyramid_height,
+        .pyramid_levels = culling->pyramid_levels,
+        .lod_scale = frame->lod_scale
+    };
+    memcpy(push_constants.range_first_draws, renderer->draw_list.range_first_draws, sizeof(push_constants.range_first_draws));
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling->cull_pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling->cull_pipeline_layout, 0, 1, &cull_frame->descriptor_set, 1, &frame->constants_offset);
+    vkCmdPushConstants(command_buffer, culling->cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+    if (frame->draws_count > 0)
+    {
+        vkCmdDispatch(command_buffer, (frame->draws_count + AGFX_CULL_WORKGROUP_SIZE - 1) / AGFX_CULL_WORKGROUP_SIZE, 1, 1);
+    }
+
+    VkMemoryBarrier cull_barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT
+    };
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &cull_barrier, 0, NULL, 0, NULL);
+}
+
+// the early pass already moved the depth buffer to shader read and made its writes visible to compute
+void agfx_cmd_build_depth_pyramid(agfx_renderer_t* renderer, VkCommandBuffer command_buffer)
+{
+    agfx_gpu_culling_t* culling = &renderer->gpu_culling;
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling->reduce_pipeline);
+
+    for (uint32_t level = 0; level < culling->pyramid_levels; ++level)
+    {
+        uint32_t level_width = culling->pyramid_width >> level;
+        uint32_t level_height = culling->pyramid_height >> level;
+        if (level_width == 0) level_width = 1;
+        if (level_height == 0) level_height = 1;
+
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling->reduce_pipeline_layout, 0, 1, &culling->reduce_descriptor_sets[level], 0, NULL);
+        vkCmdDispatch(command_buffer, (level_width + AGFX_DEPTH_REDUCE_WORKGROUP_SIZE - 1) / AGFX_DEPTH_REDUCE_WORKGROUP_SIZE, (level_height + AGFX_DEPTH_REDUCE_WORKGROUP_SIZE - 1) / AGFX_DEPTH_REDUCE_WORKGROUP_SIZE, 1);
+
+        VkMemoryBarrier reduce_barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+        };
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &reduce_barrier, 0, NULL, 0, NULL);
+    }
+}
\ No newline at end of file
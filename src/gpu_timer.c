@@ -0,0 +1,90 @@
+#include "gpu_timer.h"
+#include "renderer.h"
+
+// a device that cannot timestamp graphics and compute queues leaves the timer off and frame_ms at 0
+agfx_result_t agfx_create_gpu_timer(agfx_renderer_t* renderer)
+{
+    agfx_gpu_timer_t* timer = &renderer->gpu_timer;
+    agfx_result_t result = AGFX_SUCCESS;
+
+    memset(timer, 0, sizeof(agfx_gpu_timer_t));
+
+    if (!renderer->context->device_properties.limits.timestampComputeAndGraphics)
+    {
+        return AGFX_SUCCESS;
+    }
+
+    timer->queries_count = AGFX_GPU_TIMER_MAX_IMAGES * AGFX_GPU_TIMER_QUERIES_PER_IMAGE;
+
+    VkQueryPoolCreateInfo query_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = timer->queries_count
+    };
+
+    if (VK_SUCCESS != vkCreateQueryPool(renderer->context->device, &query_pool_create_info, NULL, &timer->query_pool))
+    {
+        return AGFX_QUERY_POOL_ERROR;
+    }
+
+    // results are read before an image was ever drawn, so every query starts out reset instead of undefined
+    VkCommandBuffer command_buffer;
+    result = agfx_helper_command_buffer_begin(renderer, &command_buffer);
+    if (AGFX_SUCCESS != result) goto free_query_pool;
+
+    vkCmdResetQueryPool(command_buffer, timer->query_pool, 0, timer->queries_count);
+
+    result = agfx_helper_command_buffer_end(renderer, &command_buffer);
+    if (AGFX_SUCCESS != result) goto free_query_pool;
+
+    timer->available = 1;
+    return result;
+
+free_query_pool:
+    vkDestroyQueryPool(renderer->context->device, timer->query_pool, NULL);
+    return result;
+}
+
+void agfx_free_gpu_timer(agfx_renderer_t* renderer)
+{
+    if (!renderer->gpu_timer.available) return;
+
+    vkDestroyQueryPool(renderer->context->device, renderer->gpu_timer.query_pool, NULL);
+    renderer->gpu_timer.available = 0;
+}
+
+// the image's last frame may still be in flight, a pair that is not there yet keeps the previous time
+void agfx_gpu_timer_read(agfx_renderer_t* renderer, uint32_t image_index)
+{
+    agfx_gpu_timer_t* timer = &renderer->gpu_timer;
+
+    if (!timer->available || image_index >= AGFX_GPU_TIMER_MAX_IMAGES) return;
+
+    // value and availability for each query
+    uint64_t results[AGFX_GPU_TIMER_QUERIES_PER_IMAGE * 2];
+    vkGetQueryPoolResults(renderer->context->device, timer->query_pool, image_index * AGFX_GPU_TIMER_QUERIES_PER_IMAGE, AGFX_GPU_TIMER_QUERIES_PER_IMAGE,
+        sizeof(results), results, sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    if (0 == results[1] || 0 == results[3] || results[2] < results[0]) return;
+
+    timer->frame_ms = (double)(results[2] - results[0]) * (double)renderer->context->device_properties.limits.timestampPeriod / 1000000.0;
+}
+
+void agfx_cmd_gpu_timer_begin(agfx_renderer_t* renderer, VkCommandBuffer command_buffer, uint32_t image_index)
+{
+    agfx_gpu_timer_t* timer = &renderer->gpu_timer;
+
+    if (!timer->available || image_index >= AGFX_GPU_TIMER_MAX_IMAGES) return;
+
+    vkCmdResetQueryPool(command_buffer, timer->query_pool, image_index * AGFX_GPU_TIMER_QUERIES_PER_IMAGE, AGFX_GPU_TIMER_QUERIES_PER_IMAGE);
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timer->query_pool, image_index * AGFX_GPU_TIMER_QUERIES_PER_IMAGE);
+}
+
+void agfx_cmd_gpu_timer_end(agfx_renderer_t* renderer, VkCommandBuffer command_buffer, uint32_t image_index)
+{
+    agfx_gpu_timer_t* timer = &renderer->gpu_timer;
+
+    if (!timer->available || image_index >= AGFX_GPU_TIMER_MAX_IMAGES) return;
+
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timer->query_pool, image_index * AGFX_GPU_TIMER_QUERIES_PER_IMAGE + 1);
+}
\ No newline at end of file
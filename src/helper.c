@@ -1,13 +1,20 @@
 #include "helper.h"
 
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 uint32_t find_vulkan_memory_type(agfx_context_t *context, uint32_t type_filter, VkMemoryPropertyFlags property_flags)
 {
-    VkPhysicalDeviceMemoryProperties memory_properties;
-    vkGetPhysicalDeviceMemoryProperties(context->physical_device, &memory_properties);
+    VkPhysicalDeviceMemoryProperties* memory_properties = &context->memory_properties;
 
-    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i)
+    for (uint32_t i = 0; i < memory_properties->memoryTypeCount; ++i)
     {
-        if (type_filter & (1 << i) && (memory_properties.memoryTypes[i].propertyFlags & property_flags) == property_flags) {
+        if (type_filter & (1 << i) && (memory_properties->memoryTypes[i].propertyFlags & property_flags) == property_flags) {
             return i;
         }
     }
@@ -16,6 +23,11 @@ uint32_t find_vulkan_memory_type(agfx_context_t *context, uint32_t type_filter,
 }
 
 agfx_result_t agfx_helper_create_image(agfx_context_t *context, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage_flags, VkMemoryPropertyFlags property_flags, VkImage* image, VkDeviceMemory* image_memory)
+{
+    return agfx_helper_create_mipmapped_image(context, width, height, 1, format, tiling, usage_flags, property_flags, image, image_memory);
+}
+
+agfx_result_t agfx_helper_create_mipmapped_image(agfx_context_t *context, uint32_t width, uint32_t height, uint32_t mip_levels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage_flags, VkMemoryPropertyFlags property_flags, VkImage* image, VkDeviceMemory* image_memory)
 {
     agfx_result_t result = AGFX_SUCCESS;
     VkImageCreateInfo image_create_info = {
@@ -26,7 +38,7 @@ agfx_result_t agfx_helper_create_image(agfx_context_t *context, uint32_t width,
             .height = height,
             .depth = 1
         },
-        .mipLevels = 1,
+        .mipLevels = mip_levels,
         .arrayLayers = 1,
         .format = format,
         .tiling = tiling,
@@ -211,7 +223,214 @@ agfx_result_t agfx_helper_create_buffer(agfx_context_t *context, VkDeviceSize si
     return AGFX_SUCCESS;
 }
 
+// mapped device-local memory is usually write-combined, so it gets written front to back in full 16 byte stores that skip the cache
+void agfx_helper_stream_copy(void* destination, const void* source, size_t size)
+{
+#if defined(__SSE2__)
+    uint8_t* destination_bytes = (uint8_t*)destination;
+    const uint8_t* source_bytes = (const uint8_t*)source;
+
+    size_t head_size = (16 - ((uintptr_t)destination_bytes & 15)) & 15;
+    if (head_size > size) head_size = size;
+    memcpy(destination_bytes, source_bytes, head_size);
+    destination_bytes += head_size;
+    source_bytes += head_size;
+    size -= head_size;
+
+    for (; size >= 64; size -= 64, destination_bytes += 64, source_bytes += 64)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(source_bytes + 0));
+        __m128i b = _mm_loadu_si128((const __m128i*)(source_bytes + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(source_bytes + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(source_bytes + 48));
+        _mm_stream_si128((__m128i*)(destination_bytes + 0), a);
+        _mm_stream_si128((__m128i*)(destination_bytes + 16), b);
+        _mm_stream_si128((__m128i*)(destination_bytes + 32), c);
+        _mm_stream_si128((__m128i*)(destination_bytes + 48), d);
+    }
+
+    for (; size >= 16; size -= 16, destination_bytes += 16, source_bytes += 16)
+    {
+        _mm_stream_si128((__m128i*)destination_bytes, _mm_loadu_si128((const __m128i*)source_bytes));
+    }
+
+    memcpy(destination_bytes, source_bytes, size);
+    _mm_sfence();
+#else
+    memcpy(destination, source, size);
+#endif
+}
+
+agfx_result_t agfx_helper_create_direct_buffer(agfx_context_t *context, VkDeviceSize size, VkBufferUsageFlags usage_flags, VkBuffer* buffer, VkDeviceMemory* buffer_memory)
+{
+    if (context->direct_upload_memory_type_index == UINT32_MAX || size > AGFX_DIRECT_UPLOAD_MAX_SIZE)
+    {
+        return AGFX_BUFFER_ERROR;
+    }
+
+    VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage_flags,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    if (VK_SUCCESS != vkCreateBuffer(context->device, &buffer_create_info, NULL, buffer))
+    {
+        return AGFX_BUFFER_ERROR;
+    }
+
+    VkMemoryRequirements memory_requirements;
+    vkGetBufferMemoryRequirements(context->device, *buffer, &memory_requirements);
+
+    if (!(memory_requirements.memoryTypeBits & (1 << context->direct_upload_memory_type_index)) ||
+        context->direct_upload_used + memory_requirements.size > context->direct_upload_budget ||
+        context->direct_upload_allocations_count == AGFX_DIRECT_UPLOAD_MAX_ALLOCATIONS)
+    {
+        vkDestroyBuffer(context->device, *buffer, NULL);
+        return AGFX_BUFFER_ERROR;
+    }
+
+    VkMemoryAllocateInfo memory_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .memoryTypeIndex = context->direct_upload_memory_type_index,
+        .allocationSize = memory_requirements.size
+    };
+
+    if (VK_SUCCESS != vkAllocateMemory(context->device, &memory_allocate_info, NULL, buffer_memory))
+    {
+        vkDestroyBuffer(context->device, *buffer, NULL);
+        return AGFX_BUFFER_ERROR;
+    }
+
+    if (VK_SUCCESS != vkBindBufferMemory(context->device, *buffer, *buffer_memory, 0))
+    {
+        vkFreeMemory(context->device, *buffer_memory, NULL);
+        vkDestroyBuffer(context->device, *buffer, NULL);
+        return AGFX_BUFFER_ERROR;
+    }
+
+    context->direct_upload_used += memory_requirements.size;
+    context->direct_upload_memories[context->direct_upload_allocations_count] = *buffer_memory;
+    context->direct_upload_sizes[context->direct_upload_allocations_count] = memory_requirements.size;
+    context->direct_upload_allocations_count++;
+
+    return AGFX_SUCCESS;
+}
+
+// frees any buffer, one that was made direct also hands its size back to the budget
+void agfx_helper_free_buffer(agfx_context_t *context, VkBuffer buffer, VkDeviceMemory buffer_memory)
+{
+    for (uint32_t i = 0; i < context->direct_upload_allocations_count; ++i)
+    {
+        if (context->direct_upload_memories[i] != buffer_memory) continue;
+
+        context->direct_upload_used -= context->direct_upload_sizes[i];
+        context->direct_upload_allocations_count--;
+        context->direct_upload_memories[i] = context->direct_upload_memories[context->direct_upload_allocations_count];
+        context->direct_upload_sizes[i] = context->direct_upload_sizes[context->direct_upload_allocations_count];
+        break;
+    }
+
+    vkDestroyBuffer(context->device, buffer, NULL);
+    vkFreeMemory(context->device, buffer_memory, NULL);
+}
+
+agfx_result_t upload_buffer_direct(agfx_context_t *context, const void* data, VkDeviceSize size, VkBufferUsageFlags usage_flags, VkBuffer* buffer, VkDeviceMemory* buffer_memory)
+{
+    agfx_result_t result = agfx_helper_create_direct_buffer(context, size, usage_flags, buffer, buffer_memory);
+    if (AGFX_SUCCESS != result) return result;
+
+    void* mapped;
+    if (VK_SUCCESS != vkMapMemory(context->device, *buffer_memory, 0, VK_WHOLE_SIZE, 0, &mapped))
+    {
+        agfx_helper_free_buffer(context, *buffer, *buffer_memory);
+        return AGFX_BUFFER_MAP_ERROR;
+    }
+
+    agfx_helper_stream_copy(mapped, data, size);
+
+    if (!(context->memory_properties.memoryTypes[context->direct_upload_memory_type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+    {
+        VkMappedMemoryRange mapped_memory_range = {
+            .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+            .memory = *buffer_memory,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE
+        };
+        vkFlushMappedMemoryRanges(context->device, 1, &mapped_memory_range);
+    }
+
+    vkUnmapMemory(context->device, *buffer_memory);
+
+    return AGFX_SUCCESS;
+}
+
+agfx_result_t upload_buffer_staged(agfx_renderer_t *renderer, const void* data, VkDeviceSize size, VkBufferUsageFlags usage_flags, VkBuffer* buffer, VkDeviceMemory* buffer_memory)
+{
+    agfx_result_t result;
+
+    VkBuffer staging_buffer;
+    VkDeviceMemory staging_buffer_memory;
+
+    result = agfx_helper_create_buffer(renderer->context, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging_buffer, &staging_buffer_memory);
+    if (AGFX_SUCCESS != result)
+    {
+        return result;
+    }
+
+    void* mapped;
+    if (VK_SUCCESS != vkMapMemory(renderer->context->device, staging_buffer_memory, 0, size, 0, &mapped))
+    {
+        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
+        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
+        return AGFX_BUFFER_MAP_ERROR;
+    }
+    agfx_helper_stream_copy(mapped, data, size);
+    vkUnmapMemory(renderer->context->device, staging_buffer_memory);
+
+    result = agfx_helper_create_buffer(renderer->context, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage_flags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, buffer_memory);
+    if (AGFX_SUCCESS != result)
+    {
+        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
+        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
+        return result;
+    }
+
+    result = agfx_helper_copy_buffer(renderer, staging_buffer, *buffer, size);
+    if (AGFX_SUCCESS != result)
+    {
+        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
+        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
+        vkFreeMemory(renderer->context->device, *buffer_memory, NULL);
+        vkDestroyBuffer(renderer->context->device, *buffer, NULL);
+        return result;
+    }
+
+    vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
+    vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
+
+    return AGFX_SUCCESS;
+}
+
+// writes straight into device-local memory when the device maps it (integrated gpus, rebar, software rasterizers)
+// and the budget allows, otherwise falls back to a staging buffer and a gpu copy
+agfx_result_t agfx_helper_upload_buffer(agfx_renderer_t *renderer, const void* data, VkDeviceSize size, VkBufferUsageFlags usage_flags, VkBuffer* buffer, VkDeviceMemory* buffer_memory)
+{
+    if (AGFX_SUCCESS == upload_buffer_direct(renderer->context, data, size, usage_flags, buffer, buffer_memory))
+    {
+        return AGFX_SUCCESS;
+    }
+
+    return upload_buffer_staged(renderer, data, size, usage_flags, buffer, buffer_memory);
+}
+
 agfx_result_t agfx_helper_create_image_view(agfx_context_t *context, VkImage image, VkFormat format, VkImageAspectFlags aspect_flags, VkImageView *image_view)
+{
+    return agfx_helper_create_image_view_for_mips(context, image, format, aspect_flags, 0, 1, image_view);
+}
+
+agfx_result_t agfx_helper_create_image_view_for_mips(agfx_context_t *context, VkImage image, VkFormat format, VkImageAspectFlags aspect_flags, uint32_t base_mip_level, uint32_t mip_levels, VkImageView *image_view)
 {
     VkImageViewCreateInfo image_view_create_info = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -219,8 +438,8 @@ agfx_result_t agfx_helper_create_image_view(agfx_context_t *context, VkImage ima
         .viewType = VK_IMAGE_VIEW_TYPE_2D,
         .format = format,
         .subresourceRange.aspectMask = aspect_flags,
-        .subresourceRange.baseMipLevel = 0,
-        .subresourceRange.levelCount = 1,
+        .subresourceRange.baseMipLevel = base_mip_level,
+        .subresourceRange.levelCount = mip_levels,
         .subresourceRange.baseArrayLayer = 0,
         .subresourceRange.layerCount = 1,
     };
@@ -253,7 +472,7 @@ agfx_result_t agfx_helper_transition_image_layout(agfx_renderer_t* renderer, VkI
             .baseArrayLayer = 0,
             .layerCount = 1,
             .baseMipLevel = 0,
-            .levelCount = 1
+            .levelCount = VK_REMAINING_MIP_LEVELS
         },
         .srcAccessMask = 0,
         .dstAccessMask = 0
@@ -276,6 +495,14 @@ agfx_result_t agfx_helper_transition_image_layout(agfx_renderer_t* renderer, VkI
 
         source_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
         destination_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    } else if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_GENERAL)
+    {
+        // compute written images stay in general for their whole life
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        source_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        destination_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
     } else
     {
         result = agfx_helper_command_buffer_end(renderer, &command_buffer);
@@ -287,3 +514,44 @@ agfx_result_t agfx_helper_transition_image_layout(agfx_renderer_t* renderer, VkI
     result = agfx_helper_command_buffer_end(renderer, &command_buffer);
     return result;
 }
+
+
+agfx_result_t agfx_helper_create_shader_module(agfx_context_t *context, const char* path, VkShaderModule* shader_module)
+{
+    struct stat shader_stat;
+    if (0 != stat(path, &shader_stat))
+    {
+        return AGFX_PIPELINE_ERROR;
+    }
+
+    char* shader_data = (char*)malloc(shader_stat.st_size);
+    if (NULL == shader_data)
+    {
+        return AGFX_PIPELINE_ERROR;
+    }
+
+    FILE* shader_fd = fopen(path, "rb");
+    if (NULL == shader_fd)
+    {
+        free(shader_data);
+        return AGFX_PIPELINE_ERROR;
+    }
+    size_t read_count = fread(shader_data, shader_stat.st_size, 1, shader_fd);
+    fclose(shader_fd);
+    if (read_count != 1)
+    {
+        free(shader_data);
+        return AGFX_PIPELINE_ERROR;
+    }
+
+    VkShaderModuleCreateInfo shader_module_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = shader_stat.st_size,
+        .pCode = (uint32_t*)shader_data
+    };
+
+    VkResult vk_result = vkCreateShaderModule(context->device, &shader_module_create_info, NULL, shader_module);
+    free(shader_data);
+
+    return VK_SUCCESS == vk_result ? AGFX_SUCCESS : AGFX_PIPELINE_ERROR;
+}
\ No newline at end of file
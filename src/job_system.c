@@ -0,0 +1,255 @@
+#include "job_system.h"
+
+typedef struct agfx_job_range_t {
+    agfx_job_range_function_t function;
+    void* data;
+    size_t begin;
+    size_t end;
+} agfx_job_range_t;
+
+static void run_job(agfx_job_t job)
+{
+    job.function(job.data);
+    (void)SDL_AtomicDecRef(job.counter);
+}
+
+// expects the mutex to be held and a job to be queued
+static agfx_job_t pop_job(agfx_job_system_t* job_system)
+{
+    agfx_job_t job = job_system->jobs[job_system->jobs_head];
+    job_system->jobs_head = (job_system->jobs_head + 1) % job_system->jobs_capacity;
+    job_system->jobs_count--;
+    return job;
+}
+
+// expects the mutex to be held and a background job to be queued
+static agfx_job_t pop_background_job(agfx_job_system_t* job_system)
+{
+    agfx_job_t job = job_system->background_jobs[job_system->background_head];
+    job_system->background_head = (job_system->background_head + 1) % job_system->jobs_capacity;
+    job_system->background_count--;
+    return job;
+}
+
+static int job_worker(void* data)
+{
+    agfx_job_system_t* job_system = (agfx_job_system_t*)data;
+
+    SDL_LockMutex(job_system->mutex);
+    for (;;)
+    {
+        while (0 == job_system->jobs_count && 0 == job_system->background_count && !job_system->quit)
+        {
+            SDL_CondWait(job_system->job_available, job_system->mutex);
+        }
+        if (0 == job_system->jobs_count && 0 == job_system->background_count)
+        {
+            break;
+        }
+
+        // frame work first, a background job only gets a worker nothing else needs
+        agfx_job_t job = job_system->jobs_count > 0 ? pop_job(job_system) : pop_background_job(job_system);
+        SDL_UnlockMutex(job_system->mutex);
+        run_job(job);
+        SDL_LockMutex(job_system->mutex);
+    }
+    SDL_UnlockMutex(job_system->mutex);
+
+    return 0;
+}
+
+// 0 threads means one per core besides the calling one, which helps out whenever it waits
+agfx_result_t agfx_create_job_system(uint32_t threads_count, agfx_job_system_t* out_job_system)
+{
+    agfx_job_system_t job_system = {0};
+
+    if (0 == threads_count)
+    {
+        int cpu_count = SDL_GetCPUCount();
+        threads_count = cpu_count > 1 ? (uint32_t)(cpu_count - 1) : 0;
+    }
+    if (threads_count > AGFX_JOB_SYSTEM_MAX_THREADS)
+    {
+        threads_count = AGFX_JOB_SYSTEM_MAX_THREADS;
+    }
+
+    job_system.jobs_capacity = AGFX_JOB_QUEUE_CAPACITY;
+    job_system.jobs = calloc(job_system.jobs_capacity, sizeof(agfx_job_t));
+    job_system.background_jobs = calloc(job_system.jobs_capacity, sizeof(agfx_job_t));
+    job_system.threads = calloc(threads_count > 0 ? threads_count : 1, sizeof(SDL_Thread*));
+    job_system.mutex = SDL_CreateMutex();
+    job_system.job_available = SDL_CreateCond();
+    if (NULL == job_system.jobs || NULL == job_system.background_jobs || NULL == job_system.threads || NULL == job_system.mutex || NULL == job_system.job_available)
+    {
+        agfx_free_job_system(&job_system);
+        return AGFX_JOB_SYSTEM_ERROR;
+    }
+
+    *out_job_system = job_system;
+
+    // the workers get the caller's copy, it has to stay where it is from here on
+    for (uint32_t i = 0; i < threads_count; ++i)
+    {
+        out_job_system->threads[i] = SDL_CreateThread(job_worker, "agfx_worker", out_job_system);
+        if (NULL == out_job_system->threads[i])
+        {
+            agfx_free_job_system(out_job_system);
+            return AGFX_JOB_SYSTEM_ERROR;
+        }
+        out_job_system->threads_count++;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+void agfx_free_job_system(agfx_job_system_t* job_system)
+{
+    if (NULL != job_system->mutex)
+    {
+        SDL_LockMutex(job_system->mutex);
+        job_system->quit = 1;
+        SDL_CondBroadcast(job_system->job_available);
+        SDL_UnlockMutex(job_system->mutex);
+    }
+
+    for (uint32_t i = 0; i < job_system->threads_count; ++i)
+    {
+        SDL_WaitThread(job_system->threads[i], NULL);
+    }
+
+    if (NULL != job_system->job_available) SDL_DestroyCond(job_system->job_available);
+    if (NULL != job_system->mutex) SDL_DestroyMutex(job_system->mutex);
+    free(job_system->threads);
+    free(job_system->jobs);
+    free(job_system->background_jobs);
+    *job_system = (agfx_job_system_t) {0};
+}
+
+// a full queue or no job system at all runs the job right here
+void agfx_job_system_push(agfx_job_system_t* job_system, agfx_job_function_t function, void* data, SDL_atomic_t* counter)
+{
+    agfx_job_t job = {
+        .function = function,
+        .data = data,
+        .counter = counter
+    };
+    SDL_AtomicIncRef(counter);
+
+    if (NULL == job_system)
+    {
+        run_job(job);
+        return;
+    }
+
+    SDL_LockMutex(job_system->mutex);
+    if (job_system->jobs_count == job_system->jobs_capacity)
+    {
+        SDL_UnlockMutex(job_system->mutex);
+        run_job(job);
+        return;
+    }
+
+    job_system->jobs[(job_system->jobs_head + job_system->jobs_count) % job_system->jobs_capacity] = job;
+    job_system->jobs_count++;
+    SDL_CondSignal(job_system->job_available);
+    SDL_UnlockMutex(job_system->mutex);
+}
+
+// without a worker to hand it to, or with the background queue full, the job runs right here
+void agfx_job_system_push_background(agfx_job_system_t* job_system, agfx_job_function_t function, void* data, SDL_atomic_t* counter)
+{
+    agfx_job_t job = {
+        .function = function,
+        .data = data,
+        .counter = counter
+    };
+    SDL_AtomicIncRef(counter);
+
+    if (NULL == job_system || 0 == job_system->threads_count)
+    {
+        run_job(job);
+        return;
+    }
+
+    SDL_LockMutex(job_system->mutex);
+    if (job_system->background_count == job_system->jobs_capacity)
+    {
+        SDL_UnlockMutex(job_system->mutex);
+        run_job(job);
+        return;
+    }
+
+    job_system->background_jobs[(job_system->background_head + job_system->background_count) % job_system->jobs_capacity] = job;
+    job_system->background_count++;
+    SDL_CondSignal(job_system->job_available);
+    SDL_UnlockMutex(job_system->mutex);
+}
+
+// the waiting thread takes jobs off the queue instead of sleeping, so jobs can push and wait on more jobs
+void agfx_job_system_wait(agfx_job_system_t* job_system, SDL_atomic_t* counter)
+{
+    while (SDL_AtomicGet(counter) > 0)
+    {
+        if (NULL == job_system)
+        {
+            break;
+        }
+
+        SDL_LockMutex(job_system->mutex);
+        if (job_system->jobs_count > 0)
+        {
+            agfx_job_t job = pop_job(job_system);
+            SDL_UnlockMutex(job_system->mutex);
+            run_job(job);
+            continue;
+        }
+        SDL_UnlockMutex(job_system->mutex);
+        SDL_Delay(0);
+    }
+}
+
+static void run_job_range(void* data)
+{
+    agfx_job_range_t* range = (agfx_job_range_t*)data;
+    range->function(range->data, range->begin, range->end);
+}
+
+void agfx_job_system_parallel_for(agfx_job_system_t* job_system, size_t count, size_t batch_size, agfx_job_range_function_t function, void* data)
+{
+    if (0 == count)
+    {
+        return;
+    }
+
+    if (0 == batch_size)
+    {
+        batch_size = 1;
+    }
+
+    size_t batches_count = (count + batch_size - 1) / batch_size;
+    agfx_job_range_t* ranges = NULL;
+    if (NULL != job_system && job_system->threads_count > 0 && batches_count > 1)
+    {
+        ranges = calloc(batches_count, sizeof(agfx_job_range_t));
+    }
+    if (NULL == ranges)
+    {
+        function(data, 0, count);
+        return;
+    }
+
+    SDL_atomic_t counter = {0};
+    for (size_t batch = 0; batch < batches_count; ++batch)
+    {
+        ranges[batch] = (agfx_job_range_t) {
+            .function = function,
+            .data = data,
+            .begin = batch * batch_size,
+            .end = (batch + 1) * batch_size < count ? (batch + 1) * batch_size : count
+        };
+        agfx_job_system_push(job_system, run_job_range, &ranges[batch], &counter);
+    }
+    agfx_job_system_wait(job_system, &counter);
+
+    free(ranges);
+}
\ No newline at end of file
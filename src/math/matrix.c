@@ -67,8 +67,8 @@ agfx_mat2x2_t agfx_mat2x2_multiplied_by_mat2x2(agfx_mat2x2_t matrix_a, agfx_mat2
 {
     return (agfx_mat2x2_t) {
         .mat = {
-            {matrix_a.mat[0].x * matrix_b.mat[0].x + matrix_a.mat[1].x * matrix_b.mat[0].y, matrix_a.mat[0].x * matrix_b.mat[1].x + matrix_a.mat[1].x * matrix_b.mat[1].y},
-            {matrix_a.mat[0].y * matrix_b.mat[0].x + matrix_a.mat[1].y * matrix_b.mat[0].y, matrix_a.mat[0].y * matrix_b.mat[1].x + matrix_a.mat[1].y * matrix_b.mat[1].y},
+            agfx_mat2x2_multiplied_by_vector2(matrix_a, matrix_b.mat[0]),
+            agfx_mat2x2_multiplied_by_vector2(matrix_a, matrix_b.mat[1]),
         }
     };
 }
@@ -77,9 +77,9 @@ agfx_mat3x3_t agfx_mat3x3_multiplied_by_mat3x3(agfx_mat3x3_t matrix_a, agfx_mat3
 {
     return (agfx_mat3x3_t) {
         .mat = {
-            {matrix_a.mat[0].x * matrix_b.mat[0].x + matrix_a.mat[1].x * matrix_b.mat[0].y + matrix_a.mat[2].x * matrix_b.mat[0].z, matrix_a.mat[0].x * matrix_b.mat[1].x + matrix_a.mat[1].x * matrix_b.mat[1].y + matrix_a.mat[2].x * matrix_b.mat[1].z, matrix_a.mat[0].x * matrix_b.mat[2].x + matrix_a.mat[1].x * matrix_b.mat[2].y + matrix_a.mat[2].x * matrix_b.mat[2].z},
-            {matrix_a.mat[0].y * matrix_b.mat[0].x + matrix_a.mat[1].y * matrix_b.mat[0].y + matrix_a.mat[2].y * matrix_b.mat[0].z, matrix_a.mat[0].y * matrix_b.mat[1].x + matrix_a.mat[1].y * matrix_b.mat[1].y + matrix_a.mat[2].y * matrix_b.mat[1].z, matrix_a.mat[0].y * matrix_b.mat[2].x + matrix_a.mat[1].y * matrix_b.mat[2].y + matrix_a.mat[2].y * matrix_b.mat[2].z},
-            {matrix_a.mat[0].z * matrix_b.mat[0].x + matrix_a.mat[1].z * matrix_b.mat[0].y + matrix_a.mat[2].z * matrix_b.mat[0].z, matrix_a.mat[0].z * matrix_b.mat[1].x + matrix_a.mat[1].z * matrix_b.mat[1].y + matrix_a.mat[2].z * matrix_b.mat[1].z, matrix_a.mat[0].z * matrix_b.mat[2].x + matrix_a.mat[1].z * matrix_b.mat[2].y + matrix_a.mat[2].z * matrix_b.mat[2].z}
+            agfx_mat3x3_multiplied_by_vector3(matrix_a, matrix_b.mat[0]),
+            agfx_mat3x3_multiplied_by_vector3(matrix_a, matrix_b.mat[1]),
+            agfx_mat3x3_multiplied_by_vector3(matrix_a, matrix_b.mat[2]),
         }
     };
 }
@@ -88,30 +88,10 @@ agfx_mat4x4_t agfx_mat4x4_multiplied_by_mat4x4(agfx_mat4x4_t matrix_a, agfx_mat4
 {
     return (agfx_mat4x4_t) {
         .mat = {
-            {
-                matrix_a.mat[0].x * matrix_b.mat[0].x + matrix_a.mat[1].x * matrix_b.mat[0].y + matrix_a.mat[2].x * matrix_b.mat[0].z + matrix_a.mat[3].x * matrix_b.mat[0].w,
-                matrix_a.mat[0].x * matrix_b.mat[1].x + matrix_a.mat[1].x * matrix_b.mat[1].y + matrix_a.mat[2].x * matrix_b.mat[1].z + matrix_a.mat[3].x * matrix_b.mat[1].w,
-                matrix_a.mat[0].x * matrix_b.mat[2].x + matrix_a.mat[1].x * matrix_b.mat[2].y + matrix_a.mat[2].x * matrix_b.mat[2].z + matrix_a.mat[3].x * matrix_b.mat[2].w,
-                matrix_a.mat[0].x * matrix_b.mat[3].x + matrix_a.mat[1].x * matrix_b.mat[3].y + matrix_a.mat[2].x * matrix_b.mat[3].z + matrix_a.mat[3].x * matrix_b.mat[3].w
-            },
-            {
-                matrix_a.mat[0].y * matrix_b.mat[0].x + matrix_a.mat[1].y * matrix_b.mat[0].y + matrix_a.mat[2].y * matrix_b.mat[0].z + matrix_a.mat[3].y * matrix_b.mat[0].w,
-                matrix_a.mat[0].y * matrix_b.mat[1].x + matrix_a.mat[1].y * matrix_b.mat[1].y + matrix_a.mat[2].y * matrix_b.mat[1].z + matrix_a.mat[3].y * matrix_b.mat[1].w,
-                matrix_a.mat[0].y * matrix_b.mat[2].x + matrix_a.mat[1].y * matrix_b.mat[2].y + matrix_a.mat[2].y * matrix_b.mat[2].z + matrix_a.mat[3].y * matrix_b.mat[2].w,
-                matrix_a.mat[0].y * matrix_b.mat[3].x + matrix_a.mat[1].y * matrix_b.mat[3].y + matrix_a.mat[2].y * matrix_b.mat[3].z + matrix_a.mat[3].y * matrix_b.mat[3].w
-            },
-            {
-                matrix_a.mat[0].z * matrix_b.mat[0].x + matrix_a.mat[1].z * matrix_b.mat[0].y + matrix_a.mat[2].z * matrix_b.mat[0].z + matrix_a.mat[3].z * matrix_b.mat[0].w,
-                matrix_a.mat[0].z * matrix_b.mat[1].x + matrix_a.mat[1].z * matrix_b.mat[1].y + matrix_a.mat[2].z * matrix_b.mat[1].z + matrix_a.mat[3].z * matrix_b.mat[1].w,
-                matrix_a.mat[0].z * matrix_b.mat[2].x + matrix_a.mat[1].z * matrix_b.mat[2].y + matrix_a.mat[2].z * matrix_b.mat[2].z + matrix_a.mat[3].z * matrix_b.mat[2].w,
-                matrix_a.mat[0].z * matrix_b.mat[3].x + matrix_a.mat[1].z * matrix_b.mat[3].y + matrix_a.mat[2].z * matrix_b.mat[3].z + matrix_a.mat[3].z * matrix_b.mat[3].w
-            },
-            {
-                matrix_a.mat[0].w * matrix_b.mat[0].x + matrix_a.mat[1].w * matrix_b.mat[0].y + matrix_a.mat[2].w * matrix_b.mat[0].z + matrix_a.mat[3].w * matrix_b.mat[0].w,
-                matrix_a.mat[0].w * matrix_b.mat[1].x + matrix_a.mat[1].w * matrix_b.mat[1].y + matrix_a.mat[2].w * matrix_b.mat[1].z + matrix_a.mat[3].w * matrix_b.mat[1].w,
-                matrix_a.mat[0].w * matrix_b.mat[2].x + matrix_a.mat[1].w * matrix_b.mat[2].y + matrix_a.mat[2].w * matrix_b.mat[2].z + matrix_a.mat[3].w * matrix_b.mat[2].w,
-                matrix_a.mat[0].w * matrix_b.mat[3].x + matrix_a.mat[1].w * matrix_b.mat[3].y + matrix_a.mat[2].w * matrix_b.mat[3].z + matrix_a.mat[3].w * matrix_b.mat[3].w
-            },
+            agfx_mat4x4_multiplied_by_vector4(matrix_a, matrix_b.mat[0]),
+            agfx_mat4x4_multiplied_by_vector4(matrix_a, matrix_b.mat[1]),
+            agfx_mat4x4_multiplied_by_vector4(matrix_a, matrix_b.mat[2]),
+            agfx_mat4x4_multiplied_by_vector4(matrix_a, matrix_b.mat[3]),
         }
     };
 }
@@ -153,6 +133,33 @@ agfx_mat4x4_t agfx_mat4x4_rotation_euler(agfx_vector3_t rotation)
     return rotation_matrix;
 }
 
+// unit quaternion, xyz is the axis part and w the angle part
+agfx_mat4x4_t agfx_mat4x4_rotation_quaternion(agfx_vector4_t rotation)
+{
+    float xx = rotation.x * rotation.x;
+    float yy = rotation.y * rotation.y;
+    float zz = rotation.z * rotation.z;
+    float xy = rotation.x * rotation.y;
+    float xz = rotation.x * rotation.z;
+    float yz = rotation.y * rotation.z;
+    float wx = rotation.w * rotation.x;
+    float wy = rotation.w * rotation.y;
+    float wz = rotation.w * rotation.z;
+
+    agfx_mat4x4_t rotation_matrix = agfx_mat4x4_create_diagonal(1.0f);
+    rotation_matrix.mat[0].x = 1.0f - 2.0f * (yy + zz);
+    rotation_matrix.mat[0].y = 2.0f * (xy + wz);
+    rotation_matrix.mat[0].z = 2.0f * (xz - wy);
+    rotation_matrix.mat[1].x = 2.0f * (xy - wz);
+    rotation_matrix.mat[1].y = 1.0f - 2.0f * (xx + zz);
+    rotation_matrix.mat[1].z = 2.0f * (yz + wx);
+    rotation_matrix.mat[2].x = 2.0f * (xz + wy);
+    rotation_matrix.mat[2].y = 2.0f * (yz - wx);
+    rotation_matrix.mat[2].z = 1.0f - 2.0f * (xx + yy);
+
+    return rotation_matrix;
+}
+
 agfx_mat4x4_t agfx_mat4x4_scale(agfx_vector3_t scale)
 {
     agfx_mat4x4_t scale_matrix = agfx_mat4x4_create_diagonal(1.0f);
@@ -0,0 +1,448 @@
+#include "mesh_lod.h"
+
+// the plane distance squared summed over the triangles around a vertex, weighted by their area (garland and heckbert 1997)
+typedef struct agfx_quadric_t {
+    float xx, yy, zz, xy, xz, yz, xw, yw, zw, ww;
+    float weight;
+} agfx_quadric_t;
+
+typedef struct agfx_collapse_t {
+    float cost;
+    uint32_t from;
+    uint32_t to;
+} agfx_collapse_t;
+
+// the working copy of the indices and everything a pass needs, kept between the levels of a chain
+typedef struct agfx_simplifier_t {
+    const agfx_vertex_t* vertices;
+    size_t vertices_count;
+    size_t indices_count;
+    uint32_t* indices;
+    agfx_quadric_t* quadrics;
+    uint8_t* locked;
+    uint8_t* touched;
+    uint32_t* remap;
+    uint32_t* counts;
+    uint32_t* offsets;
+    uint32_t* adjacency;
+    agfx_collapse_t* collapses;
+    float error;
+} agfx_simplifier_t;
+
+typedef struct agfx_lod_job_t {
+    agfx_mesh_t* meshes;
+    uint8_t* built;
+} agfx_lod_job_t;
+
+static void add_quadric(agfx_quadric_t* destination, const agfx_quadric_t* source)
+{
+    destination->xx += source->xx; destination->yy += source->yy; destination->zz += source->zz;
+    destination->xy += source->xy; destination->xz += source->xz; destination->yz += source->yz;
+    destination->xw += source->xw; destination->yw += source->yw; destination->zw += source->zw;
+    destination->ww += source->ww;
+    destination->weight += source->weight;
+}
+
+static agfx_quadric_t plane_quadric(agfx_vector3_t normal, float distance, float weight)
+{
+    return (agfx_quadric_t) {
+        .xx = normal.x * normal.x * weight, .yy = normal.y * normal.y * weight, .zz = normal.z * normal.z * weight,
+        .xy = normal.x * normal.y * weight, .xz = normal.x * normal.z * weight, .yz = normal.y * normal.z * weight,
+        .xw = normal.x * distance * weight, .yw = normal.y * distance * weight, .zw = normal.z * distance * weight,
+        .ww = distance * distance * weight,
+        .weight = weight
+    };
+}
+
+// mean squared distance to the planes, so the error is in the mesh's own units whatever the triangle sizes are
+static float quadric_error(const agfx_quadric_t* quadric, agfx_vector3_t p)
+{
+    float error = quadric->xx * p.x * p.x + quadric->yy * p.y * p.y + quadric->zz * p.z * p.z
+        + 2.0f * (quadric->xy * p.x * p.y + quadric->xz * p.x * p.z + quadric->yz * p.y * p.z)
+        + 2.0f * (quadric->xw * p.x + quadric->yw * p.y + quadric->zw * p.z)
+        + quadric->ww;
+    return quadric->weight > 0.0f ? fmaxf(error, 0.0f) / quadric->weight : 0.0f;
+}
+
+static agfx_vector3_t triangle_normal(agfx_vector3_t p0, agfx_vector3_t p1, agfx_vector3_t p2)
+{
+    return agfx_vector3_cross(agfx_vector3_subtract_vector3(p1, p0), agfx_vector3_subtract_vector3(p2, p0));
+}
+
+static int compare_collapses(const void* a, const void* b)
+{
+    const agfx_collapse_t* collapse_a = (const agfx_collapse_t*)a;
+    const agfx_collapse_t* collapse_b = (const agfx_collapse_t*)b;
+    if (collapse_a->cost != collapse_b->cost) return collapse_a->cost < collapse_b->cost ? -1 : 1;
+    if (collapse_a->from != collapse_b->from) return collapse_a->from < collapse_b->from ? -1 : 1;
+    return collapse_a->to < collapse_b->to ? -1 : (collapse_a->to > collapse_b->to ? 1 : 0);
+}
+
+// vertex to triangle lists for the triangles that are still alive, rebuilt every pass
+static void build_adjacency(const uint32_t* indices, size_t indices_count, size_t vertices_count, uint32_t* counts, uint32_t* offsets, uint32_t* adjacency)
+{
+    memset(counts, 0, sizeof(uint32_t) * vertices_count);
+    for (size_t i = 0; i < indices_count; ++i)
+    {
+        counts[indices[i]]++;
+    }
+    offsets[0] = 0;
+    for (size_t vertex = 0; vertex < vertices_count; ++vertex)
+    {
+        offsets[vertex + 1] = offsets[vertex] + counts[vertex];
+    }
+    memset(counts, 0, sizeof(uint32_t) * vertices_count);
+    for (size_t i = 0; i < indices_count; ++i)
+    {
+        adjacency[offsets[indices[i]] + counts[indices[i]]++] = (uint32_t)(i / 3);
+    }
+}
+
+// moving from onto to must not turn any of from's other triangles around
+static uint32_t collapse_flips(const agfx_vertex_t* vertices, const uint32_t* indices, const uint32_t* offsets, const uint32_t* adjacency, uint32_t from, uint32_t to)
+{
+    for (uint32_t adjacent = offsets[from]; adjacent < offsets[from + 1]; ++adjacent)
+    {
+        const uint32_t* triangle = &indices[adjacency[adjacent] * 3];
+        if (triangle[0] == to || triangle[1] == to || triangle[2] == to) continue;
+
+        agfx_vector3_t before[3];
+        agfx_vector3_t after[3];
+        for (uint32_t corner = 0; corner < 3; ++corner)
+        {
+            before[corner] = vertices[triangle[corner]].position;
+            after[corner] = triangle[corner] == from ? vertices[to].position : before[corner];
+        }
+        if (agfx_vector3_dot(triangle_normal(before[0], before[1], before[2]), triangle_normal(after[0], after[1], after[2])) <= 0.0f)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void free_simplifier(agfx_simplifier_t* simplifier)
+{
+    free(simplifier->collapses);
+    free(simplifier->adjacency);
+    free(simplifier->offsets);
+    free(simplifier->counts);
+    free(simplifier->remap);
+    free(simplifier->touched);
+    free(simplifier->locked);
+    free(simplifier->quadrics);
+    free(simplifier->indices);
+}
+
+// open borders and attribute seams (vertices sharing a position with another one) are locked, which keeps the outline and
+// the texture layout where they are
+static agfx_result_t create_simplifier(const agfx_vertex_t* vertices, size_t vertices_count, const uint32_t* indices, size_t indices_count, agfx_simplifier_t* out_simplifier)
+{
+    agfx_simplifier_t simplifier = {
+        .vertices = vertices,
+        .vertices_count = vertices_count,
+        .indices_count = indices_count / 3 * 3
+    };
+    simplifier.indices = malloc(sizeof(uint32_t) * (simplifier.indices_count + 1));
+    simplifier.quadrics = calloc(vertices_count + 1, sizeof(agfx_quadric_t));
+    simplifier.locked = calloc(vertices_count + 1, sizeof(uint8_t));
+    simplifier.touched = calloc(vertices_count + 1, sizeof(uint8_t));
+    simplifier.remap = malloc(sizeof(uint32_t) * (vertices_count + 1));
+    simplifier.counts = malloc(sizeof(uint32_t) * (vertices_count + 1));
+    simplifier.offsets = malloc(sizeof(uint32_t) * (vertices_count + 1));
+    simplifier.adjacency = malloc(sizeof(uint32_t) * (simplifier.indices_count + 1));
+    simplifier.collapses = malloc(sizeof(agfx_collapse_t) * (simplifier.indices_count + 1));
+
+    size_t table_size = 1;
+    while (table_size < vertices_count * 2) table_size <<= 1;
+    uint32_t* position_table = malloc(sizeof(uint32_t) * table_size);
+
+    if (NULL == simplifier.indices || NULL == simplifier.quadrics || NULL == simplifier.locked || NULL == simplifier.touched || NULL == simplifier.remap
+        || NULL == simplifier.counts || NULL == simplifier.offsets || NULL == simplifier.adjacency || NULL == simplifier.collapses || NULL == position_table)
+    {
+        free(position_table);
+        free_simplifier(&simplifier);
+        return AGFX_BUFFER_ERROR;
+    }
+    memcpy(simplifier.indices, indices, sizeof(uint32_t) * simplifier.indices_count);
+
+    // seams: a position used by more than one vertex
+    memset(position_table, 0xff, sizeof(uint32_t) * table_size);
+    for (size_t vertex = 0; vertex < vertices_count; ++vertex)
+    {
+        uint32_t bits[3];
+        memcpy(bits, &vertices[vertex].position, sizeof(bits));
+        size_t slot = ((bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u)) & (table_size - 1);
+        while (UINT32_MAX != position_table[slot] && 0 != memcmp(&vertices[position_table[slot]].position, &vertices[vertex].position, sizeof(agfx_vector3_t)))
+        {
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if (UINT32_MAX == position_table[slot])
+        {
+            position_table[slot] = (uint32_t)vertex;
+        } else
+        {
+            simplifier.locked[vertex] = 1;
+            simplifier.locked[position_table[slot]] = 1;
+        }
+    }
+    free(position_table);
+
+    for (size_t triangle = 0; triangle < simplifier.indices_count / 3; ++triangle)
+    {
+        const uint32_t* corners = &simplifier.indices[triangle * 3];
+        agfx_vector3_t p0 = vertices[corners[0]].position;
+        agfx_vector3_t normal = triangle_normal(p0, vertices[corners[1]].position, vertices[corners[2]].position);
+        float length = agfx_vector3_magnitude(normal);
+        if (length <= 0.0f) continue;
+
+        normal = agfx_vector3_multiply_scalar(normal, 1.0f / length);
+        agfx_quadric_t quadric = plane_quadric(normal, -agfx_vector3_dot(normal, p0), length * 0.5f);
+        for (uint32_t corner = 0; corner < 3; ++corner)
+        {
+            add_quadric(&simplifier.quadrics[corners[corner]], &quadric);
+        }
+    }
+
+    // an edge only one triangle uses is a border
+    build_adjacency(simplifier.indices, simplifier.indices_count, vertices_count, simplifier.counts, simplifier.offsets, simplifier.adjacency);
+    for (size_t i = 0; i < simplifier.indices_count; ++i)
+    {
+        uint32_t a = simplifier.indices[i];
+        uint32_t b = simplifier.indices[i - i % 3 + (i + 1) % 3];
+        uint32_t shared = 0;
+        for (uint32_t adjacent = simplifier.offsets[a]; adjacent < simplifier.offsets[a + 1]; ++adjacent)
+        {
+            const uint32_t* triangle = &simplifier.indices[simplifier.adjacency[adjacent] * 3];
+            shared += triangle[0] == b || triangle[1] == b || triangle[2] == b;
+        }
+        if (shared < 2)
+        {
+            simplifier.locked[a] = 1;
+            simplifier.locked[b] = 1;
+        }
+    }
+
+    *out_simplifier = simplifier;
+    return AGFX_SUCCESS;
+}
+
+// each pass collapses the cheapest edges whose neighbourhoods do not overlap, until the target is reached or nothing
+// collapses anymore. it carries on from where the last call stopped, the quadrics keep the error against the full mesh
+static void simplify_to(agfx_simplifier_t* simplifier, size_t target_indices_count)
+{
+    const agfx_vertex_t* vertices = simplifier->vertices;
+    uint32_t* indices = simplifier->indices;
+
+    while (simplifier->indices_count > target_indices_count)
+    {
+        size_t count = simplifier->indices_count;
+        build_adjacency(indices, count, simplifier->vertices_count, simplifier->counts, simplifier->offsets, simplifier->adjacency);
+
+        size_t collapses_count = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t a = indices[i];
+            uint32_t b = indices[i - i % 3 + (i + 1) % 3];
+            if (a >= b || (simplifier->locked[a] && simplifier->locked[b])) continue;
+
+            agfx_quadric_t quadric = simplifier->quadrics[a];
+            add_quadric(&quadric, &simplifier->quadrics[b]);
+            float cost_to_b = simplifier->locked[a] ? FLT_MAX : quadric_error(&quadric, vertices[b].position);
+            float cost_to_a = simplifier->locked[b] ? FLT_MAX : quadric_error(&quadric, vertices[a].position);
+            simplifier->collapses[collapses_count++] = cost_to_b <= cost_to_a
+                ? (agfx_collapse_t) {.cost = cost_to_b, .from = a, .to = b}
+                : (agfx_collapse_t) {.cost = cost_to_a, .from = b, .to = a};
+        }
+        if (0 == collapses_count) break;
+
+        qsort(simplifier->collapses, collapses_count, sizeof(agfx_collapse_t), compare_collapses);
+
+        // a collapse takes two triangles on average
+        size_t triangles_to_remove = (count - target_indices_count) / 3;
+        size_t removed_count = 0;
+        memset(simplifier->touched, 0, sizeof(uint8_t) * simplifier->vertices_count);
+        for (size_t vertex = 0; vertex < simplifier->vertices_count; ++vertex)
+        {
+            simplifier->remap[vertex] = (uint32_t)vertex;
+        }
+
+        for (size_t i = 0; i < collapses_count && removed_count < triangles_to_remove; ++i)
+        {
+            agfx_collapse_t* collapse = &simplifier->collapses[i];
+            if (simplifier->touched[collapse->from] || simplifier->touched[collapse->to]) continue;
+            if (collapse_flips(vertices, indices, simplifier->offsets, simplifier->adjacency, collapse->from, collapse->to)) continue;
+
+            // everything around from moves with it this pass, so later collapses never test against stale triangles
+            for (uint32_t adjacent = simplifier->offsets[collapse->from]; adjacent < simplifier->offsets[collapse->from + 1]; ++adjacent)
+            {
+                const uint32_t* triangle = &indices[simplifier->adjacency[adjacent] * 3];
+                simplifier->touched[triangle[0]] = 1;
+                simplifier->touched[triangle[1]] = 1;
+                simplifier->touched[triangle[2]] = 1;
+            }
+            simplifier->remap[collapse->from] = collapse->to;
+            add_quadric(&simplifier->quadrics[collapse->to], &simplifier->quadrics[collapse->from]);
+            simplifier->error = fmaxf(simplifier->error, collapse->cost);
+            removed_count += 2;
+        }
+        if (0 == removed_count) break;
+
+        size_t kept_count = 0;
+        for (size_t i = 0; i < count; i += 3)
+        {
+            uint32_t a = simplifier->remap[indices[i]];
+            uint32_t b = simplifier->remap[indices[i + 1]];
+            uint32_t c = simplifier->remap[indices[i + 2]];
+            if (a == b || b == c || a == c) continue;
+            indices[kept_count++] = a;
+            indices[kept_count++] = b;
+            indices[kept_count++] = c;
+        }
+        simplifier->indices_count = kept_count;
+    }
+}
+
+// greedy edge collapse onto existing vertices, so every level indexes the same vertex range as the full mesh.
+// the error is the largest collapse's area weighted rms distance to the original planes, in the mesh's units
+agfx_result_t agfx_simplify_mesh(const agfx_vertex_t* vertices, size_t vertices_count, const uint32_t* indices, size_t indices_count, size_t target_indices_count, uint32_t* destination, size_t* out_indices_count, float* out_error)
+{
+    agfx_simplifier_t simplifier;
+    agfx_result_t result = create_simplifier(vertices, vertices_count, indices, indices_count, &simplifier);
+    if (AGFX_SUCCESS != result) return result;
+
+    simplify_to(&simplifier, target_indices_count);
+    memcpy(destination, simplifier.indices, sizeof(uint32_t) * simplifier.indices_count);
+    *out_indices_count = simplifier.indices_count;
+    *out_error = sqrtf(simplifier.error);
+
+    free_simplifier(&simplifier);
+    return AGFX_SUCCESS;
+}
+
+// one simplification runs down the whole chain and every target it reaches becomes a level, so the quadrics still measure
+// against the full mesh and the errors only grow. the levels' indices go into one array, their ranges are relative to it
+// until the geometry buffer places them
+agfx_result_t agfx_build_mesh_lods(agfx_mesh_t* mesh)
+{
+    agfx_result_t result = AGFX_SUCCESS;
+
+    free(mesh->lod_indices);
+    mesh->lod_indices = NULL;
+    mesh->lod_indices_count = 0;
+    mesh->lods_count = 1;
+    mesh->lods[0] = (agfx_mesh_lod_t) {.first_index = 0, .indices_count = (uint32_t)mesh->indices_count, .error = 0.0f};
+
+    if (mesh->indices_count / 3 < AGFX_LOD_MIN_TRIANGLES * 2)
+    {
+        return AGFX_SUCCESS;
+    }
+
+    // the levels shrink geometrically, so all of them together stay below the full mesh
+    uint32_t* lod_indices = malloc(sizeof(uint32_t) * mesh->indices_count);
+    if (NULL == lod_indices) return AGFX_BUFFER_ERROR;
+
+    agfx_simplifier_t simplifier;
+    result = create_simplifier(mesh->vertices, mesh->vertices_count, mesh->indices, mesh->indices_count, &simplifier);
+    if (AGFX_SUCCESS != result)
+    {
+        free(lod_indices);
+        return result;
+    }
+
+    size_t lod_indices_count = 0;
+    size_t previous_count = simplifier.indices_count;
+    while (mesh->lods_count < AGFX_MESH_MAX_LODS)
+    {
+        size_t target_count = (size_t)((float)(previous_count / 3) * AGFX_LOD_REDUCTION) * 3;
+        if (target_count / 3 < AGFX_LOD_MIN_TRIANGLES) break;
+
+        simplify_to(&simplifier, target_count);
+        size_t simplified_count = simplifier.indices_count;
+        if ((float)simplified_count > (float)previous_count * AGFX_LOD_MIN_REDUCTION || lod_indices_count + simplified_count > mesh->indices_count)
+        {
+            break;
+        }
+
+        memcpy(&lod_indices[lod_indices_count], simplifier.indices, sizeof(uint32_t) * simplified_count);
+        mesh->lods[mesh->lods_count++] = (agfx_mesh_lod_t) {
+            .first_index = (uint32_t)lod_indices_count,
+            .indices_count = (uint32_t)simplified_count,
+            .error = sqrtf(simplifier.error)
+        };
+        lod_indices_count += simplified_count;
+        previous_count = simplified_count;
+    }
+    free_simplifier(&simplifier);
+
+    if (lod_indices_count > 0)
+    {
+        mesh->lod_indices = lod_indices;
+        mesh->lod_indices_count = lod_indices_count;
+    } else
+    {
+        free(lod_indices);
+    }
+
+    return result;
+}
+
+static void build_lod_range(void* data, size_t begin, size_t end)
+{
+    agfx_lod_job_t* job = (agfx_lod_job_t*)data;
+
+    for (size_t mesh_index = begin; mesh_index < end; ++mesh_index)
+    {
+        job->built[mesh_index] = AGFX_SUCCESS == agfx_build_mesh_lods(&job->meshes[mesh_index]);
+    }
+}
+
+void agfx_build_lods(agfx_job_system_t* job_system, agfx_mesh_t* meshes, size_t meshes_count, agfx_lod_stats_t* out_stats)
+{
+    uint64_t start = SDL_GetPerformanceCounter();
+    out_stats->meshes_count = 0;
+    out_stats->lods_count = 0;
+
+    agfx_lod_job_t job = {
+        .meshes = meshes,
+        .built = calloc(meshes_count > 0 ? meshes_count : 1, sizeof(uint8_t))
+    };
+    if (NULL != job.built)
+    {
+        agfx_job_system_parallel_for(job_system, meshes_count, AGFX_LOD_MESHES_PER_JOB, build_lod_range, &job);
+    }
+
+    for (size_t mesh_index = 0; mesh_index < meshes_count; ++mesh_index)
+    {
+        if (NULL != job.built && job.built[mesh_index] && meshes[mesh_index].lods_count > 1)
+        {
+            out_stats->meshes_count++;
+            out_stats->lods_count += meshes[mesh_index].lods_count - 1;
+        }
+    }
+
+    free(job.built);
+    out_stats->build_ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+// error_scale turns a level's error into pixels at distance 1, so a level fits when error * error_scale <= distance.
+// the coarsest level that fits a tightened threshold and the coarsest that fits a loosened one bound a band, and an object
+// only changes level when its current one falls out of that band. cull.comp does the same on the gpu
+uint32_t agfx_select_lod(const agfx_mesh_lod_t* lods, uint32_t lods_count, uint32_t current_lod, float distance, float error_scale)
+{
+    if (lods_count <= 1 || error_scale <= 0.0f)
+    {
+        return 0;
+    }
+
+    uint32_t min_lod = 0;
+    uint32_t max_lod = 0;
+    for (uint32_t lod = 1; lod < lods_count; ++lod)
+    {
+        float projected_error = lods[lod].error * error_scale;
+        if (projected_error <= distance * (1.0f - AGFX_LOD_HYSTERESIS)) min_lod = lod;
+        if (projected_error <= distance * (1.0f + AGFX_LOD_HYSTERESIS)) max_lod = lod;
+    }
+
+    return current_lod < min_lod ? min_lod : (current_lod > max_lod ? max_lod : current_lod);
+}
\ No newline at end of file
@@ -0,0 +1,518 @@
+#include "mesh_optimizer.h"
+
+typedef struct agfx_overdraw_cluster_t {
+    float sort_key;
+    uint32_t first_triangle;
+    uint32_t triangles_count;
+} agfx_overdraw_cluster_t;
+
+typedef struct agfx_mesh_optimizer_job_t {
+    agfx_mesh_t* meshes;
+    agfx_vertex_cache_stats_t* before;
+    agfx_vertex_cache_stats_t* after;
+    uint8_t* optimized;
+} agfx_mesh_optimizer_job_t;
+
+// the timestamps make a fifo without storing one: a vertex is still cached until cache size more vertices went in after it
+static uint32_t cache_miss(uint32_t* timestamps, uint32_t* time, uint32_t vertex)
+{
+    if (*time - timestamps[vertex] > AGFX_VERTEX_CACHE_SIZE)
+    {
+        timestamps[vertex] = (*time)++;
+        return 1;
+    }
+    return 0;
+}
+
+static void flush_cache(uint32_t* time)
+{
+    *time += AGFX_VERTEX_CACHE_SIZE + 1;
+}
+
+// murmur style mixing a word at a time, welding only merges vertices that are bit for bit the same
+static uint32_t hash_vertex(const agfx_vertex_t* vertex)
+{
+    uint32_t words[sizeof(agfx_vertex_t) / sizeof(uint32_t)];
+    memcpy(words, vertex, sizeof(words));
+
+    uint32_t hash = 0;
+    for (size_t i = 0; i < sizeof(words) / sizeof(uint32_t); ++i)
+    {
+        uint32_t word = words[i] * 0xcc9e2d51u;
+        word = (word << 15) | (word >> 17);
+        hash ^= word * 0x1b873593u;
+        hash = ((hash << 13) | (hash >> 19)) * 5 + 0xe6546b64u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    return hash;
+}
+
+// unique vertices move down in place and keep their first occurrence's order, the indices are rewritten to match
+agfx_result_t agfx_weld_vertices(agfx_vertex_t* vertices, size_t vertices_count, uint32_t* indices, size_t indices_count, size_t* out_vertices_count)
+{
+    *out_vertices_count = vertices_count;
+
+    size_t table_size = 1;
+    while (table_size < vertices_count * 2) table_size <<= 1;
+
+    uint32_t* table = malloc(sizeof(uint32_t) * table_size);
+    uint32_t* remap = malloc(sizeof(uint32_t) * (vertices_count > 0 ? vertices_count : 1));
+    if (NULL == table || NULL == remap)
+    {
+        free(table);
+        free(remap);
+        return AGFX_BUFFER_ERROR;
+    }
+    memset(table, 0xff, sizeof(uint32_t) * table_size);
+
+    uint32_t unique_count = 0;
+    for (size_t i = 0; i < vertices_count; ++i)
+    {
+        size_t slot = hash_vertex(&vertices[i]) & (table_size - 1);
+        while (UINT32_MAX != table[slot] && 0 != memcmp(&vertices[table[slot]], &vertices[i], sizeof(agfx_vertex_t)))
+        {
+            slot = (slot + 1) & (table_size - 1);
+        }
+
+        if (UINT32_MAX == table[slot])
+        {
+            vertices[unique_count] = vertices[i];
+            table[slot] = unique_count++;
+        }
+        remap[i] = table[slot];
+    }
+
+    for (size_t i = 0; i < indices_count; ++i)
+    {
+        indices[i] = remap[indices[i]];
+    }
+
+    free(remap);
+    free(table);
+    *out_vertices_count = unique_count;
+    return AGFX_SUCCESS;
+}
+
+// tipsify (sander, nehab and barczak 2007): fans around the vertex that keeps the most of the cache alive and only jumps
+// somewhere new at a dead end. the jumps are where the cache restarts, so they are handed out as cluster starts
+agfx_result_t agfx_optimize_vertex_cache(uint32_t* indices, size_t indices_count, size_t vertices_count, uint32_t* out_cluster_starts, size_t* out_clusters_count)
+{
+    agfx_result_t result = AGFX_SUCCESS;
+    size_t triangles_count = indices_count / 3;
+    *out_clusters_count = 0;
+
+    uint32_t* live = calloc(vertices_count + 1, sizeof(uint32_t));
+    uint32_t* offsets = calloc(vertices_count + 1, sizeof(uint32_t));
+    uint32_t* timestamps = calloc(vertices_count + 1, sizeof(uint32_t));
+    uint32_t* adjacency = malloc(sizeof(uint32_t) * (indices_count + 1));
+    uint32_t* dead_ends = malloc(sizeof(uint32_t) * (indices_count + 1));
+    uint32_t* candidates = malloc(sizeof(uint32_t) * (indices_count + 1));
+    uint32_t* destination = malloc(sizeof(uint32_t) * (indices_count + 1));
+    uint8_t* emitted = calloc(triangles_count + 1, sizeof(uint8_t));
+    if (NULL == live || NULL == offsets || NULL == timestamps || NULL == adjacency || NULL == dead_ends || NULL == candidates || NULL == destination || NULL == emitted)
+    {
+        result = AGFX_BUFFER_ERROR;
+        goto free_scratch;
+    }
+
+    // every vertex's triangles, the live count is how many of them are still to be emitted
+    for (size_t i = 0; i < triangles_count * 3; ++i)
+    {
+        live[indices[i]]++;
+    }
+    for (size_t vertex = 0; vertex < vertices_count; ++vertex)
+    {
+        offsets[vertex + 1] = offsets[vertex] + live[vertex];
+    }
+    for (size_t i = 0; i < triangles_count * 3; ++i)
+    {
+        adjacency[offsets[indices[i]] + timestamps[indices[i]]++] = (uint32_t)(i / 3);
+    }
+    memset(timestamps, 0, sizeof(uint32_t) * vertices_count);
+
+    uint32_t time = AGFX_VERTEX_CACHE_SIZE + 1;
+    size_t output_count = 0;
+    size_t dead_ends_count = 0;
+    size_t cursor = 0;
+    uint32_t fan = UINT32_MAX;
+    while (cursor < vertices_count && 0 == live[cursor]) cursor++;
+    if (cursor < vertices_count) fan = (uint32_t)cursor;
+
+    while (UINT32_MAX != fan)
+    {
+        if (0 == *out_clusters_count || output_count / 3 != out_cluster_starts[*out_clusters_count - 1])
+        {
+            out_cluster_starts[(*out_clusters_count)++] = (uint32_t)(output_count / 3);
+        }
+
+        uint32_t continued_fan = fan;
+        while (UINT32_MAX != continued_fan)
+        {
+            fan = continued_fan;
+            size_t candidates_count = 0;
+            for (uint32_t adjacent = offsets[fan]; adjacent < offsets[fan + 1]; ++adjacent)
+            {
+                uint32_t triangle = adjacency[adjacent];
+                if (emitted[triangle]) continue;
+                emitted[triangle] = 1;
+
+                for (uint32_t corner = 0; corner < 3; ++corner)
+                {
+                    uint32_t vertex = indices[triangle * 3 + corner];
+                    destination[output_count++] = vertex;
+                    dead_ends[dead_ends_count++] = vertex;
+                    candidates[candidates_count++] = vertex;
+                    live[vertex]--;
+                    cache_miss(timestamps, &time, vertex);
+                }
+            }
+
+            // a vertex whose remaining triangles still fit before it falls out of the cache scores by how long it has been in
+            continued_fan = UINT32_MAX;
+            int64_t best_priority = -1;
+            for (size_t i = 0; i < candidates_count; ++i)
+            {
+                uint32_t vertex = candidates[i];
+                if (0 == live[vertex]) continue;
+
+                int64_t priority = 0;
+                if ((int64_t)(time - timestamps[vertex]) + 2 * (int64_t)live[vertex] <= AGFX_VERTEX_CACHE_SIZE)
+                {
+                    priority = time - timestamps[vertex];
+                }
+                if (priority > best_priority)
+                {
+                    best_priority = priority;
+                    continued_fan = vertex;
+                }
+            }
+        }
+
+        // dead end: the most recently used vertex with work left, then the next one in index order
+        fan = UINT32_MAX;
+        while (dead_ends_count > 0 && UINT32_MAX == fan)
+        {
+            uint32_t vertex = dead_ends[--dead_ends_count];
+            if (live[vertex] > 0) fan = vertex;
+        }
+        while (UINT32_MAX == fan && cursor < vertices_count)
+        {
+            if (live[cursor] > 0) fan = (uint32_t)cursor;
+            else cursor++;
+        }
+    }
+
+    memcpy(indices, destination, sizeof(uint32_t) * output_count);
+
+free_scratch:
+    free(emitted);
+    free(destination);
+    free(candidates);
+    free(dead_ends);
+    free(adjacency);
+    free(timestamps);
+    free(offsets);
+    free(live);
+    return result;
+}
+
+static int compare_overdraw_clusters(const void* a, const void* b)
+{
+    const agfx_overdraw_cluster_t* cluster_a = (const agfx_overdraw_cluster_t*)a;
+    const agfx_overdraw_cluster_t* cluster_b = (const agfx_overdraw_cluster_t*)b;
+    if (cluster_a->sort_key != cluster_b->sort_key) return cluster_a->sort_key > cluster_b->sort_key ? -1 : 1;
+    return cluster_a->first_triangle < cluster_b->first_triangle ? -1 : 1;
+}
+
+// area weighted, the normal keeps its length so a cluster's normals sum before being normalized
+static void accumulate_triangle(const agfx_vertex_t* vertices, const uint32_t* triangle, agfx_vector3_t* centroid, agfx_vector3_t* normal, float* area)
+{
+    agfx_vector3_t p0 = vertices[triangle[0]].position;
+    agfx_vector3_t p1 = vertices[triangle[1]].position;
+    agfx_vector3_t p2 = vertices[triangle[2]].position;
+    agfx_vector3_t triangle_normal = agfx_vector3_cross(agfx_vector3_subtract_vector3(p1, p0), agfx_vector3_subtract_vector3(p2, p0));
+    float triangle_area = agfx_vector3_magnitude(triangle_normal) * 0.5f;
+    agfx_vector3_t triangle_centroid = agfx_vector3_multiply_scalar(agfx_vector3_add_vector3(agfx_vector3_add_vector3(p0, p1), p2), 1.0f / 3.0f);
+
+    *centroid = agfx_vector3_add_vector3(*centroid, agfx_vector3_multiply_scalar(triangle_centroid, triangle_area));
+    *normal = agfx_vector3_add_vector3(*normal, triangle_normal);
+    *area += triangle_area;
+}
+
+// clusters that face away from the mesh's centre go first, they are the likeliest to hide the rest from any side (sander 2007).
+// tipsify's clusters are cut again wherever a piece of one is already about as cache friendly as the whole, so there is more
+// to sort without giving up much of the vertex cache order
+agfx_result_t agfx_optimize_overdraw(const agfx_vertex_t* vertices, uint32_t* indices, size_t indices_count, size_t vertices_count, const uint32_t* cluster_starts, size_t clusters_count)
+{
+    agfx_result_t result = AGFX_SUCCESS;
+    size_t triangles_count = indices_count / 3;
+
+    uint32_t* timestamps = calloc(vertices_count + 1, sizeof(uint32_t));
+    agfx_overdraw_cluster_t* clusters = malloc(sizeof(agfx_overdraw_cluster_t) * (triangles_count + 1));
+    uint32_t* destination = malloc(sizeof(uint32_t) * (indices_count + 1));
+    if (NULL == timestamps || NULL == clusters || NULL == destination)
+    {
+        result = AGFX_BUFFER_ERROR;
+        goto free_scratch;
+    }
+
+    uint32_t time = AGFX_VERTEX_CACHE_SIZE + 1;
+    size_t soft_clusters_count = 0;
+    for (size_t hard_index = 0; hard_index < clusters_count; ++hard_index)
+    {
+        size_t begin = cluster_starts[hard_index];
+        size_t end = hard_index + 1 < clusters_count ? cluster_starts[hard_index + 1] : triangles_count;
+
+        flush_cache(&time);
+        uint32_t misses = 0;
+        for (size_t i = begin * 3; i < end * 3; ++i)
+        {
+            misses += cache_miss(timestamps, &time, indices[i]);
+        }
+        float threshold = AGFX_OVERDRAW_ACMR_THRESHOLD * (float)misses / (float)(end - begin);
+
+        flush_cache(&time);
+        misses = 0;
+        size_t soft_begin = begin;
+        for (size_t triangle = begin; triangle < end; ++triangle)
+        {
+            for (size_t corner = 0; corner < 3; ++corner)
+            {
+                misses += cache_miss(timestamps, &time, indices[triangle * 3 + corner]);
+            }
+
+            if (triangle + 1 == end || (float)misses <= threshold * (float)(triangle + 1 - soft_begin))
+            {
+                clusters[soft_clusters_count++] = (agfx_overdraw_cluster_t) {
+                    .first_triangle = (uint32_t)soft_begin,
+                    .triangles_count = (uint32_t)(triangle + 1 - soft_begin)
+                };
+                soft_begin = triangle + 1;
+                misses = 0;
+                flush_cache(&time);
+            }
+        }
+    }
+
+    agfx_vector3_t mesh_centroid = {0};
+    agfx_vector3_t mesh_normal = {0};
+    float mesh_area = 0.0f;
+    for (size_t triangle = 0; triangle < triangles_count; ++triangle)
+    {
+        accumulate_triangle(vertices, &indices[triangle * 3], &mesh_centroid, &mesh_normal, &mesh_area);
+    }
+    mesh_centroid = mesh_area > 0.0f ? agfx_vector3_multiply_scalar(mesh_centroid, 1.0f / mesh_area) : mesh_centroid;
+
+    for (size_t cluster_index = 0; cluster_index < soft_clusters_count; ++cluster_index)
+    {
+        agfx_overdraw_cluster_t* cluster = &clusters[cluster_index];
+        agfx_vector3_t centroid = {0};
+        agfx_vector3_t normal = {0};
+        float area = 0.0f;
+        for (uint32_t triangle = cluster->first_triangle; triangle < cluster->first_triangle + cluster->triangles_count; ++triangle)
+        {
+            accumulate_triangle(vertices, &indices[triangle * 3], &centroid, &normal, &area);
+        }
+
+        float normal_length = agfx_vector3_magnitude(normal);
+        if (area <= 0.0f || normal_length <= 0.0f)
+        {
+            cluster->sort_key = 0.0f;
+            continue;
+        }
+        centroid = agfx_vector3_multiply_scalar(centroid, 1.0f / area);
+        cluster->sort_key = agfx_vector3_dot(agfx_vector3_subtract_vector3(centroid, mesh_centroid), agfx_vector3_multiply_scalar(normal, 1.0f / normal_length));
+    }
+
+    qsort(clusters, soft_clusters_count, sizeof(agfx_overdraw_cluster_t), compare_overdraw_clusters);
+
+    size_t output_count = 0;
+    for (size_t cluster_index = 0; cluster_index < soft_clusters_count; ++cluster_index)
+    {
+        agfx_overdraw_cluster_t* cluster = &clusters[cluster_index];
+        memcpy(&destination[output_count], &indices[cluster->first_triangle * 3], sizeof(uint32_t) * cluster->triangles_count * 3);
+        output_count += cluster->triangles_count * 3;
+    }
+    memcpy(indices, destination, sizeof(uint32_t) * output_count);
+
+free_scratch:
+    free(destination);
+    free(clusters);
+    free(timestamps);
+    return result;
+}
+
+// vertices are laid out in the order the index buffer first reads them, so fetches walk memory forward. unused ones are dropped
+agfx_result_t agfx_optimize_vertex_fetch(agfx_vertex_t* vertices, size_t vertices_count, uint32_t* indices, size_t indices_count, size_t* out_vertices_count)
+{
+    *out_vertices_count = vertices_count;
+
+    uint32_t* remap = malloc(sizeof(uint32_t) * (vertices_count > 0 ? vertices_count : 1));
+    agfx_vertex_t* reordered = malloc(sizeof(agfx_vertex_t) * (vertices_count > 0 ? vertices_count : 1));
+    if (NULL == remap || NULL == reordered)
+    {
+        free(remap);
+        free(reordered);
+        return AGFX_BUFFER_ERROR;
+    }
+    memset(remap, 0xff, sizeof(uint32_t) * vertices_count);
+
+    uint32_t used_count = 0;
+    for (size_t i = 0; i < indices_count; ++i)
+    {
+        uint32_t vertex = indices[i];
+        if (UINT32_MAX == remap[vertex])
+        {
+            reordered[used_count] = vertices[vertex];
+            remap[vertex] = used_count++;
+        }
+        indices[i] = remap[vertex];
+    }
+
+    memcpy(vertices, reordered, sizeof(agfx_vertex_t) * used_count);
+    free(reordered);
+    free(remap);
+    *out_vertices_count = used_count;
+    return AGFX_SUCCESS;
+}
+
+agfx_vertex_cache_stats_t agfx_analyze_vertex_cache(const uint32_t* indices, size_t indices_count, size_t vertices_count)
+{
+    agfx_vertex_cache_stats_t stats = {
+        .triangles_count = indices_count / 3,
+        .vertices_count = vertices_count,
+        .transformed_vertices_count = indices_count
+    };
+
+    uint32_t* timestamps = calloc(vertices_count + 1, sizeof(uint32_t));
+    if (NULL == timestamps)
+    {
+        return stats;
+    }
+
+    uint32_t time = AGFX_VERTEX_CACHE_SIZE + 1;
+    stats.transformed_vertices_count = 0;
+    for (size_t i = 0; i < indices_count; ++i)
+    {
+        stats.transformed_vertices_count += cache_miss(timestamps, &time, indices[i]);
+    }
+
+    free(timestamps);
+    return stats;
+}
+
+float agfx_vertex_cache_acmr(const agfx_vertex_cache_stats_t* stats)
+{
+    return stats->triangles_count > 0 ? (float)stats->transformed_vertices_count / (float)stats->triangles_count : 0.0f;
+}
+
+float agfx_vertex_cache_atvr(const agfx_vertex_cache_stats_t* stats)
+{
+    return stats->vertices_count > 0 ? (float)stats->transformed_vertices_count / (float)stats->vertices_count : 0.0f;
+}
+
+// weld, then cache order, then overdraw order on top of the cache clusters, then fetch order for the final index buffer.
+// a mesh with an index out of range or a failed allocation is left the way it was loaded
+agfx_result_t agfx_optimize_mesh(agfx_mesh_t* mesh, agfx_vertex_cache_stats_t* out_before, agfx_vertex_cache_stats_t* out_after)
+{
+    agfx_result_t result = AGFX_SUCCESS;
+
+    *out_before = agfx_analyze_vertex_cache(mesh->indices, mesh->indices_count, mesh->vertices_count);
+    *out_after = *out_before;
+
+    for (size_t i = 0; i < mesh->indices_count; ++i)
+    {
+        if (mesh->indices[i] >= mesh->vertices_count) return AGFX_INDEX_BUFFER_ERROR;
+    }
+    if (mesh->indices_count < 3)
+    {
+        return AGFX_SUCCESS;
+    }
+
+    // the stages work on copies, so a stage that fails halfway cannot leave the mesh half rewritten
+    size_t triangles_count = mesh->indices_count / 3;
+    agfx_vertex_t* vertices = malloc(sizeof(agfx_vertex_t) * mesh->vertices_count);
+    uint32_t* indices = malloc(sizeof(uint32_t) * mesh->indices_count);
+    uint32_t* cluster_starts = malloc(sizeof(uint32_t) * triangles_count);
+    if (NULL == vertices || NULL == indices || NULL == cluster_starts)
+    {
+        result = AGFX_BUFFER_ERROR;
+        goto free_copies;
+    }
+    memcpy(vertices, mesh->vertices, sizeof(agfx_vertex_t) * mesh->vertices_count);
+    memcpy(indices, mesh->indices, sizeof(uint32_t) * mesh->indices_count);
+
+    size_t vertices_count = mesh->vertices_count;
+    size_t clusters_count = 0;
+    result = agfx_weld_vertices(vertices, vertices_count, indices, mesh->indices_count, &vertices_count);
+    if (AGFX_SUCCESS != result) goto free_copies;
+
+    result = agfx_optimize_vertex_cache(indices, mesh->indices_count, vertices_count, cluster_starts, &clusters_count);
+    if (AGFX_SUCCESS != result) goto free_copies;
+
+    result = agfx_optimize_overdraw(vertices, indices, mesh->indices_count, vertices_count, cluster_starts, clusters_count);
+    if (AGFX_SUCCESS != result) goto free_copies;
+
+    result = agfx_optimize_vertex_fetch(vertices, vertices_count, indices, mesh->indices_count, &vertices_count);
+    if (AGFX_SUCCESS != result) goto free_copies;
+
+    memcpy(mesh->vertices, vertices, sizeof(agfx_vertex_t) * vertices_count);
+    memcpy(mesh->indices, indices, sizeof(uint32_t) * mesh->indices_count);
+    mesh->vertices_count = vertices_count;
+    *out_after = agfx_analyze_vertex_cache(mesh->indices, mesh->indices_count, mesh->vertices_count);
+
+free_copies:
+    free(cluster_starts);
+    free(indices);
+    free(vertices);
+    return result;
+}
+
+static void optimize_mesh_range(void* data, size_t begin, size_t end)
+{
+    agfx_mesh_optimizer_job_t* job = (agfx_mesh_optimizer_job_t*)data;
+
+    for (size_t mesh_index = begin; mesh_index < end; ++mesh_index)
+    {
+        job->optimized[mesh_index] = AGFX_SUCCESS == agfx_optimize_mesh(&job->meshes[mesh_index], &job->before[mesh_index], &job->after[mesh_index]);
+    }
+}
+
+// meshes are independent, so they spread over the job system one at a time, big ones would make batches uneven
+void agfx_optimize_meshes(agfx_job_system_t* job_system, agfx_mesh_t* meshes, size_t meshes_count, agfx_mesh_optimizer_stats_t* out_stats)
+{
+    uint64_t start = SDL_GetPerformanceCounter();
+    *out_stats = (agfx_mesh_optimizer_stats_t) {0};
+
+    agfx_mesh_optimizer_job_t job = {
+        .meshes = meshes,
+        .before = malloc(sizeof(agfx_vertex_cache_stats_t) * (meshes_count > 0 ? meshes_count : 1)),
+        .after = malloc(sizeof(agfx_vertex_cache_stats_t) * (meshes_count > 0 ? meshes_count : 1)),
+        .optimized = calloc(meshes_count > 0 ? meshes_count : 1, sizeof(uint8_t))
+    };
+    if (NULL == job.before || NULL == job.after || NULL == job.optimized)
+    {
+        goto free_job;
+    }
+
+    agfx_job_system_parallel_for(job_system, meshes_count, AGFX_MESH_OPTIMIZER_MESHES_PER_JOB, optimize_mesh_range, &job);
+
+    for (size_t mesh_index = 0; mesh_index < meshes_count; ++mesh_index)
+    {
+        out_stats->before.triangles_count += job.before[mesh_index].triangles_count;
+        out_stats->before.vertices_count += job.before[mesh_index].vertices_count;
+        out_stats->before.transformed_vertices_count += job.before[mesh_index].transformed_vertices_count;
+        out_stats->after.triangles_count += job.after[mesh_index].triangles_count;
+        out_stats->after.vertices_count += job.after[mesh_index].vertices_count;
+        out_stats->after.transformed_vertices_count += job.after[mesh_index].transformed_vertices_count;
+        out_stats->optimized_meshes_count += job.optimized[mesh_index];
+    }
+
+free_job:
+    free(job.optimized);
+    free(job.after);
+    free(job.before);
+    out_stats->optimize_ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
\ No newline at end of file
@@ -0,0 +1,301 @@
+#include "meshlet.h"
+
+// the scratch of one mesh. a stamp marks the vertices of the meshlet being filled, so nothing is cleared between meshlets
+typedef struct agfx_meshlet_builder_t {
+    const agfx_vertex_t* vertices;
+    size_t vertices_count;
+    uint32_t* vertex_stamps;
+    uint8_t* vertex_slots;
+    uint32_t stamp;
+    size_t meshlets_count;
+    size_t meshlets_capacity;
+    agfx_meshlet_t* meshlets;
+    size_t meshlet_vertices_count;
+    uint32_t* meshlet_vertices;
+    size_t meshlet_triangles_count;
+    uint32_t* meshlet_triangles;
+} agfx_meshlet_builder_t;
+
+typedef struct agfx_meshlet_job_t {
+    agfx_mesh_t* meshes;
+    uint8_t* built;
+} agfx_meshlet_job_t;
+
+static agfx_vector3_t triangle_normal(agfx_vector3_t p0, agfx_vector3_t p1, agfx_vector3_t p2)
+{
+    return agfx_vector3_cross(agfx_vector3_subtract_vector3(p1, p0), agfx_vector3_subtract_vector3(p2, p0));
+}
+
+static void free_builder(agfx_meshlet_builder_t* builder)
+{
+    free(builder->vertex_stamps);
+    free(builder->vertex_slots);
+    free(builder->meshlets);
+    free(builder->meshlet_vertices);
+    free(builder->meshlet_triangles);
+}
+
+// every level together bounds the outputs: a meshlet never has more vertices than three per triangle
+static agfx_result_t create_builder(const agfx_mesh_t* mesh, size_t total_indices_count, agfx_meshlet_builder_t* out_builder)
+{
+    agfx_meshlet_builder_t builder = {
+        .vertices = mesh->vertices,
+        .vertices_count = mesh->vertices_count
+    };
+    size_t total_triangles_count = total_indices_count / 3 > 0 ? total_indices_count / 3 : 1;
+
+    builder.vertex_stamps = calloc(mesh->vertices_count > 0 ? mesh->vertices_count : 1, sizeof(uint32_t));
+    builder.vertex_slots = malloc(mesh->vertices_count > 0 ? mesh->vertices_count : 1);
+    builder.meshlet_vertices = malloc(sizeof(uint32_t) * total_triangles_count * 3);
+    builder.meshlet_triangles = malloc(sizeof(uint32_t) * total_triangles_count);
+    builder.meshlets_capacity = total_triangles_count / AGFX_MESHLET_MAX_TRIANGLES + 1;
+    builder.meshlets = malloc(sizeof(agfx_meshlet_t) * builder.meshlets_capacity);
+
+    if (NULL == builder.vertex_stamps || NULL == builder.vertex_slots || NULL == builder.meshlet_vertices || NULL == builder.meshlet_triangles || NULL == builder.meshlets)
+    {
+        free_builder(&builder);
+        return AGFX_BUFFER_ERROR;
+    }
+
+    *out_builder = builder;
+    return AGFX_SUCCESS;
+}
+
+static uint32_t new_vertices_count(const agfx_meshlet_builder_t* builder, const uint32_t* corners)
+{
+    uint32_t count = 0;
+    for (uint32_t corner = 0; corner < 3; ++corner)
+    {
+        count += builder->vertex_stamps[corners[corner]] != builder->stamp;
+    }
+    return count;
+}
+
+static void add_triangle(agfx_meshlet_builder_t* builder, const uint32_t* corners, agfx_meshlet_t* meshlet)
+{
+    uint32_t packed = 0;
+    for (uint32_t corner = 0; corner < 3; ++corner)
+    {
+        uint32_t vertex = corners[corner];
+        if (builder->vertex_stamps[vertex] != builder->stamp)
+        {
+            builder->vertex_stamps[vertex] = builder->stamp;
+            builder->vertex_slots[vertex] = (uint8_t)meshlet->vertices_count;
+            builder->meshlet_vertices[meshlet->first_vertex + meshlet->vertices_count++] = vertex;
+        }
+        packed |= (uint32_t)builder->vertex_slots[vertex] << (corner * 8);
+    }
+
+    builder->meshlet_triangles[meshlet->first_triangle + meshlet->triangles_count] = packed;
+    meshlet->triangles_count++;
+}
+
+// the sphere is around the box of the vertices. the cone axis is the average of the unit normals and its cutoff the sine
+// of the widest angle any of them makes with it, so the cluster faces away from every point inside the cone's mirror
+static void compute_meshlet_bounds(const agfx_meshlet_builder_t* builder, const uint32_t* indices, agfx_meshlet_t* meshlet)
+{
+    agfx_vector3_t bounds_min = builder->vertices[builder->meshlet_vertices[meshlet->first_vertex]].position;
+    agfx_vector3_t bounds_max = bounds_min;
+    for (uint32_t i = 1; i < meshlet->vertices_count; ++i)
+    {
+        agfx_vector3_t position = builder->vertices[builder->meshlet_vertices[meshlet->first_vertex + i]].position;
+        bounds_min = (agfx_vector3_t) {fminf(bounds_min.x, position.x), fminf(bounds_min.y, position.y), fminf(bounds_min.z, position.z)};
+        bounds_max = (agfx_vector3_t) {fmaxf(bounds_max.x, position.x), fmaxf(bounds_max.y, position.y), fmaxf(bounds_max.z, position.z)};
+    }
+
+    agfx_vector3_t center = agfx_vector3_multiply_scalar(agfx_vector3_add_vector3(bounds_min, bounds_max), 0.5f);
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < meshlet->vertices_count; ++i)
+    {
+        agfx_vector3_t position = builder->vertices[builder->meshlet_vertices[meshlet->first_vertex + i]].position;
+        radius = fmaxf(radius, agfx_vector3_magnitude(agfx_vector3_subtract_vector3(position, center)));
+    }
+    meshlet->bounding_sphere = (agfx_vector4_t) {center.x, center.y, center.z, radius};
+
+    agfx_vector3_t normals[AGFX_MESHLET_MAX_TRIANGLES];
+    uint32_t normals_count = 0;
+    agfx_vector3_t normal_sum = {0.0f, 0.0f, 0.0f};
+    for (uint32_t triangle = 0; triangle < meshlet->triangles_count; ++triangle)
+    {
+        const uint32_t* corners = &indices[meshlet->first_index + triangle * 3];
+        agfx_vector3_t normal = triangle_normal(builder->vertices[corners[0]].position, builder->vertices[corners[1]].position, builder->vertices[corners[2]].position);
+        float length = agfx_vector3_magnitude(normal);
+        if (length <= 0.0f) continue;
+
+        normals[normals_count] = agfx_vector3_multiply_scalar(normal, 1.0f / length);
+        normal_sum = agfx_vector3_add_vector3(normal_sum, normals[normals_count]);
+        normals_count++;
+    }
+
+    meshlet->cone = (agfx_vector4_t) {0.0f, 0.0f, 0.0f, 1.0f};
+    float sum_length = agfx_vector3_magnitude(normal_sum);
+    if (0 == normals_count || sum_length <= 0.0f) return;
+
+    agfx_vector3_t axis = agfx_vector3_multiply_scalar(normal_sum, 1.0f / sum_length);
+    float min_dot = 1.0f;
+    for (uint32_t i = 0; i < normals_count; ++i)
+    {
+        min_dot = fminf(min_dot, agfx_vector3_dot(normals[i], axis));
+    }
+    if (min_dot < AGFX_MESHLET_MIN_CONE_DOT) return;
+
+    meshlet->cone = (agfx_vector4_t) {axis.x, axis.y, axis.z, sqrtf(1.0f - min_dot * min_dot)};
+}
+
+// the triangles are taken in the order the level already has, the one the vertex cache and overdraw passes left, and a
+// meshlet closes when the next triangle would overflow it. every meshlet is a plain range of the untouched indices
+static agfx_result_t build_level_meshlets(agfx_meshlet_builder_t* builder, const uint32_t* indices, size_t indices_count, agfx_mesh_lod_t* lod)
+{
+    size_t triangles_count = indices_count / 3;
+    lod->first_meshlet = (uint32_t)builder->meshlets_count;
+
+    size_t triangle = 0;
+    while (triangle < triangles_count)
+    {
+        if (builder->meshlets_count == builder->meshlets_capacity)
+        {
+            size_t capacity = builder->meshlets_capacity * 2;
+            agfx_meshlet_t* meshlets = realloc(builder->meshlets, sizeof(agfx_meshlet_t) * capacity);
+            if (NULL == meshlets) return AGFX_BUFFER_ERROR;
+
+            builder->meshlets = meshlets;
+            builder->meshlets_capacity = capacity;
+        }
+
+        agfx_meshlet_t* meshlet = &builder->meshlets[builder->meshlets_count];
+        *meshlet = (agfx_meshlet_t) {
+            .first_index = (uint32_t)(triangle * 3),
+            .first_vertex = (uint32_t)builder->meshlet_vertices_count,
+            .first_triangle = (uint32_t)builder->meshlet_triangles_count
+        };
+        builder->stamp++;
+
+        while (triangle < triangles_count && meshlet->triangles_count < AGFX_MESHLET_MAX_TRIANGLES
+            && meshlet->vertices_count + new_vertices_count(builder, &indices[triangle * 3]) <= AGFX_MESHLET_MAX_VERTICES)
+        {
+            add_triangle(builder, &indices[triangle * 3], meshlet);
+            triangle++;
+        }
+
+        builder->meshlet_vertices_count += meshlet->vertices_count;
+        builder->meshlet_triangles_count += meshlet->triangles_count;
+        compute_meshlet_bounds(builder, indices, meshlet);
+        builder->meshlets_count++;
+    }
+
+    lod->meshlets_count = (uint32_t)builder->meshlets_count - lod->first_meshlet;
+    return AGFX_SUCCESS;
+}
+
+// every level of the chain gets its own meshlets, so a draw keeps its clusters whichever level it picked
+agfx_result_t agfx_build_mesh_meshlets(agfx_mesh_t* mesh)
+{
+    free(mesh->meshlets);
+    free(mesh->meshlet_vertices);
+    free(mesh->meshlet_triangles);
+    mesh->meshlets = NULL;
+    mesh->meshlets_count = 0;
+    mesh->meshlet_vertices = NULL;
+    mesh->meshlet_vertices_count = 0;
+    mesh->meshlet_triangles = NULL;
+    mesh->meshlet_triangles_count = 0;
+
+    if (0 == mesh->lods_count)
+    {
+        mesh->lods_count = 1;
+        mesh->lods[0] = (agfx_mesh_lod_t) {.first_index = 0, .indices_count = (uint32_t)mesh->indices_count, .error = 0.0f};
+    }
+
+    agfx_meshlet_builder_t builder;
+    agfx_result_t result = create_builder(mesh, mesh->indices_count + mesh->lod_indices_count, &builder);
+    if (AGFX_SUCCESS != result) return result;
+
+    for (uint32_t lod = 0; lod < mesh->lods_count && AGFX_SUCCESS == result; ++lod)
+    {
+        const uint32_t* indices = 0 == lod ? mesh->indices : &mesh->lod_indices[mesh->lods[lod].first_index];
+        size_t indices_count = 0 == lod ? mesh->indices_count : mesh->lods[lod].indices_count;
+        result = build_level_meshlets(&builder, indices, indices_count, &mesh->lods[lod]);
+    }
+
+    if (AGFX_SUCCESS != result)
+    {
+        for (uint32_t lod = 0; lod < mesh->lods_count; ++lod)
+        {
+            mesh->lods[lod].first_meshlet = 0;
+            mesh->lods[lod].meshlets_count = 0;
+        }
+        free_builder(&builder);
+        return result;
+    }
+
+    // the vertex list was sized for the worst case, most of it is shared
+    uint32_t* meshlet_vertices = realloc(builder.meshlet_vertices, sizeof(uint32_t) * (builder.meshlet_vertices_count > 0 ? builder.meshlet_vertices_count : 1));
+    if (NULL != meshlet_vertices) builder.meshlet_vertices = meshlet_vertices;
+
+    mesh->meshlets = builder.meshlets;
+    mesh->meshlets_count = builder.meshlets_count;
+    mesh->meshlet_vertices = builder.meshlet_vertices;
+    mesh->meshlet_vertices_count = builder.meshlet_vertices_count;
+    mesh->meshlet_triangles = builder.meshlet_triangles;
+    mesh->meshlet_triangles_count = builder.meshlet_triangles_count;
+    builder.meshlets = NULL;
+    builder.meshlet_vertices = NULL;
+    builder.meshlet_triangles = NULL;
+    free_builder(&builder);
+
+    return AGFX_SUCCESS;
+}
+
+static void build_meshlet_range(void* data, size_t begin, size_t end)
+{
+    agfx_meshlet_job_t* job = (agfx_meshlet_job_t*)data;
+
+    for (size_t mesh_index = begin; mesh_index < end; ++mesh_index)
+    {
+        job->built[mesh_index] = AGFX_SUCCESS == agfx_build_mesh_meshlets(&job->meshes[mesh_index]);
+    }
+}
+
+void agfx_build_meshlets(agfx_job_system_t* job_system, agfx_mesh_t* meshes, size_t meshes_count, agfx_meshlet_stats_t* out_stats)
+{
+    uint64_t start = SDL_GetPerformanceCounter();
+    *out_stats = (agfx_meshlet_stats_t) {0};
+
+    agfx_meshlet_job_t job = {
+        .meshes = meshes,
+        .built = calloc(meshes_count > 0 ? meshes_count : 1, sizeof(uint8_t))
+    };
+    if (NULL != job.built)
+    {
+        agfx_job_system_parallel_for(job_system, meshes_count, AGFX_MESHLET_MESHES_PER_JOB, build_meshlet_range, &job);
+    }
+
+    for (size_t mesh_index = 0; mesh_index < meshes_count; ++mesh_index)
+    {
+        agfx_mesh_t* mesh = &meshes[mesh_index];
+        if (NULL == job.built || !job.built[mesh_index]) continue;
+
+        out_stats->meshes_count++;
+        out_stats->meshlets_count += (uint32_t)mesh->meshlets_count;
+        for (size_t i = 0; i < mesh->meshlets_count; ++i)
+        {
+            out_stats->triangles_count += mesh->meshlets[i].triangles_count;
+            out_stats->vertices_count += mesh->meshlets[i].vertices_count;
+            out_stats->cones_count += mesh->meshlets[i].cone.w < 1.0f;
+        }
+    }
+
+    free(job.built);
+    out_stats->build_ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+// the camera in the meshlet's space. the same test meshlet_cull.comp runs: every point of the sphere sees the cluster
+// from inside the mirrored cone, so every triangle faces away
+uint32_t agfx_meshlet_cone_culled(const agfx_meshlet_t* meshlet, agfx_vector3_t camera_position)
+{
+    agfx_vector3_t center = {meshlet->bounding_sphere.x, meshlet->bounding_sphere.y, meshlet->bounding_sphere.z};
+    agfx_vector3_t axis = {meshlet->cone.x, meshlet->cone.y, meshlet->cone.z};
+    agfx_vector3_t offset = agfx_vector3_subtract_vector3(center, camera_position);
+
+    return agfx_vector3_dot(offset, axis) >= meshlet->cone.w * agfx_vector3_magnitude(offset) + meshlet->bounding_sphere.w;
+}
\ No newline at end of file
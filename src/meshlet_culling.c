@@ -0,0 +1,669 @@
+#include "meshlet_culling.h"
+#include "renderer.h"
+
+static agfx_result_t create_meshlet_cull_pipeline(agfx_renderer_t* renderer)
+{
+    agfx_meshlet_culling_t* culling = &renderer->meshlet_culling;
+    VkDevice device = renderer->context->device;
+    agfx_result_t result = AGFX_SUCCESS;
+
+    // constants, objects, meshlets, mesh levels, early draws + count, late draws + count, cluster draws + count,
+    // cluster pairs, task command, stats, depth pyramid
+    VkDescriptorSetLayoutBinding bindings[AGFX_MESHLET_CULL_DESCRIPTOR_COUNT];
+    for (uint32_t i = 0; i < AGFX_MESHLET_CULL_DESCRIPTOR_COUNT; ++i)
+    {
+        bindings[i] = (VkDescriptorSetLayoutBinding) {
+            .binding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+        };
+    }
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    bindings[AGFX_MESHLET_CULL_PYRAMID_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+    VkDescriptorSetLayoutCreateInfo layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = AGFX_MESHLET_CULL_DESCRIPTOR_COUNT,
+        .pBindings = bindings
+    };
+
+    if (VK_SUCCESS != vkCreateDescriptorSetLayout(device, &layout_create_info, NULL, &culling->cull_descriptor_set_layout))
+    {
+        return AGFX_DESCRIPTOR_SET_LAYOUT_ERROR;
+    }
+
+    VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(agfx_meshlet_cull_push_constants_t)
+    };
+
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &culling->cull_descriptor_set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constant_range
+    };
+
+    if (VK_SUCCESS != vkCreatePipelineLayout(device, &pipeline_layout_create_info, NULL, &culling->cull_pipeline_layout))
+    {
+        result = AGFX_PIPELINE_ERROR;
+        goto free_descriptor_set_layout;
+    }
+
+    VkShaderModule shader_module;
+    result = agfx_helper_create_shader_module(renderer->context, "./shaders/meshlet_cull.spv", &shader_module);
+    if (AGFX_SUCCESS != result) goto free_pipeline_layout;
+
+    VkComputePipelineCreateInfo pipeline_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shader_module,
+            .pName = "main"
+        },
+        .layout = culling->cull_pipeline_layout
+    };
+
+    if (VK_SUCCESS != vkCreateComputePipelines(device, renderer->context->pipeline_cache, 1, &pipeline_create_info, NULL, &culling->cull_pipeline))
+    {
+        result = AGFX_PIPELINE_ERROR;
+    }
+
+    vkDestroyShaderModule(device, shader_module, NULL);
+    if (AGFX_SUCCESS == result) return result;
+
+free_pipeline_layout:
+    vkDestroyPipelineLayout(device, culling->cull_pipeline_layout, NULL);
+free_descriptor_set_layout:
+    vkDestroyDescriptorSetLayout(device, culling->cull_descriptor_set_layout, NULL);
+    return result;
+}
+
+// sets 0 and 1 are the scene's, set 2 is what the mesh shader fetches the clusters from. each opaque and alpha tested
+// bucket gets the state the scene pipelines derive from its key, so clusters land in the passes like the draws they replace
+static agfx_result_t create_meshlet_mesh_pipeline(agfx_renderer_t* renderer)
+{
+    agfx_meshlet_culling_t* culling = &renderer->meshlet_culling;
+    VkDevice device = renderer->context->device;
+    agfx_result_t result = AGFX_SUCCESS;
+
+    // positions, meshlets, meshlet vertices, meshlet triangles, cluster pairs, cluster count, attributes
+    VkDescriptorSetLayoutBinding bindings[AGFX_MESHLET_MESH_DESCRIPTOR_COUNT];
+    for (uint32_t i = 0; i < AGFX_MESHLET_MESH_DESCRIPTOR_COUNT; ++i)
+    {
+        bindings[i] = (VkDescriptorSetLayoutBinding) {
+            .binding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_MESH_BIT_EXT
+        };
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = AGFX_MESHLET_MESH_DESCRIPTOR_COUNT,
+        .pBindings = bindings
+    };
+
+    if (VK_SUCCESS != vkCreateDescriptorSetLayout(device, &layout_create_info, NULL, &culling->mesh_descriptor_set_layout))
+    {
+        return AGFX_DESCRIPTOR_SET_LAYOUT_ERROR;
+    }
+
+    VkDescriptorSetLayout set_layouts[] = {
+        renderer->descriptor_set_layout,
+        renderer->material_descriptor_set_layout,
+        culling->mesh_descriptor_set_layout
+    };
+
+    VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_MESH_BIT_EXT,
+        .offset = 0,
+        .size = sizeof(agfx_meshlet_mesh_push_constants_t)
+    };
+
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 3,
+        .pSetLayouts = set_layouts,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constant_range
+    };
+
+    if (VK_SUCCESS != vkCreatePipelineLayout(device, &pipeline_layout_create_info, NULL, &culling->mesh_pipeline_layout))
+    {
+        result = AGFX_PIPELINE_ERROR;
+        goto free_descriptor_set_layout;
+    }
+
+    VkShaderModule mesh_shader_module;
+    result = agfx_helper_create_shader_module(renderer->context, "./shaders/meshlet.spv", &mesh_shader_module);
+    if (AGFX_SUCCESS != result) goto free_pipeline_layout;
+
+    // a bucket no material is in has no clusters, its pipeline is never bound
+    uint32_t bucket = 0;
+    for (; bucket < AGFX_DRAW_BUCKET_BLEND; ++bucket)
+    {
+        culling->mesh_pipelines[bucket] = VK_NULL_HANDLE;
+        if (culling->range_first_clusters[bucket] == culling->range_first_clusters[bucket + 1]) continue;
+
+        result = agfx_pipeline_state_create_mesh_pipeline(renderer->pipeline_states, renderer->bucket_pipeline_keys[bucket], mesh_shader_module, culling->mesh_pipeline_layout, &culling->mesh_pipelines[bucket]);
+        if (AGFX_SUCCESS != result) break;
+    }
+
+    vkDestroyShaderModule(device, mesh_shader_module, NULL);
+    if (AGFX_SUCCESS == result) return result;
+
+    for (uint32_t i = 0; i < bucket; ++i)
+    {
+        vkDestroyPipeline(device, culling->mesh_pipelines[i], NULL);
+    }
+free_pipeline_layout:
+    vkDestroyPipelineLayout(device, culling->mesh_pipeline_layout, NULL);
+free_descriptor_set_layout:
+    vkDestroyDescriptorSetLayout(device, culling->mesh_descriptor_set_layout, NULL);
+    return result;
+}
+
+static void free_meshlet_pipelines(agfx_renderer_t* renderer)
+{
+    agfx_meshlet_culling_t* culling = &renderer->meshlet_culling;
+    VkDevice device = renderer->context->device;
+
+    if (culling->mesh_shader_available)
+    {
+        for (uint32_t bucket = 0; bucket < AGFX_DRAW_BUCKET_BLEND; ++bucket)
+        {
+            vkDestroyPipeline(device, culling->mesh_pipelines[bucket], NULL);
+        }
+        vkDestroyPipelineLayout(device, culling->mesh_pipeline_layout, NULL);
+        vkDestroyDescriptorSetLayout(device, culling->mesh_descriptor_set_layout, NULL);
+    }
+    vkDestroyPipeline(device, culling->cull_pipeline, NULL);
+    vkDestroyPipelineLayout(device, culling->cull_pipeline_layout, NULL);
+    vkDestroyDescriptorSetLayout(device, culling->cull_descriptor_set_layout, NULL);
+}
+
+static agfx_result_t create_meshlet_descriptor_pool(agfx_renderer_t* renderer)
+{
+    VkDescriptorPoolSize descriptor_pool_sizes[AGFX_MESHLET_DESCRIPTOR_POOL_SIZE_COUNT] = {
+        {
+            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            .descriptorCount = AGFX_MAX_FRAMES_IN_FLIGHT
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = AGFX_MAX_FRAMES_IN_FLIGHT * (AGFX_MESHLET_CULL_DESCRIPTOR_COUNT - 2 + AGFX_MESHLET_MESH_DESCRIPTOR_COUNT)
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = AGFX_MAX_FRAMES_IN_FLIGHT
+        }
+    };
+
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = AGFX_MESHLET_DESCRIPTOR_POOL_SIZE_COUNT,
+        .pPoolSizes = descriptor_pool_sizes,
+        .maxSets = AGFX_MAX_FRAMES_IN_FLIGHT * 2
+    };
+
+    if (VK_SUCCESS != vkCreateDescriptorPool(renderer->context->device, &descriptor_pool_create_info, NULL, &renderer->meshlet_culling.descriptor_pool))
+    {
+        return AGFX_DESCRIPTOR_POOL_ERROR;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+static void free_meshlet_cull_frame(agfx_renderer_t* renderer, agfx_meshlet_cull_frame_t* cull_frame)
+{
+    VkDevice device = renderer->context->device;
+
+    vkDestroyBuffer(device, cull_frame->stats_buffer, NULL);
+    vkFreeMemory(device, cull_frame->stats_buffer_memory, NULL);
+    vkDestroyBuffer(device, cull_frame->task_buffer, NULL);
+    vkFreeMemory(device, cull_frame->task_buffer_memory, NULL);
+    vkDestroyBuffer(device, cull_frame->cluster_buffer, NULL);
+    vkFreeMemory(device, cull_frame->cluster_buffer_memory, NULL);
+    vkDestroyBuffer(device, cull_frame->draw_buffer, NULL);
+    vkFreeMemory(device, cull_frame->draw_buffer_memory, NULL);
+}
+
+// the draw buffer's counts double as the mesh shader's, its records are only written without mesh shaders
+// and the pairs only with them or for the visibility buffer, which keeps both phases' pairs. slots, counts and task
+// commands are split by the ranges of the draw list
+static agfx_result_t create_meshlet_cull_frame(agfx_renderer_t* renderer, agfx_meshlet_cull_frame_t* cull_frame)
+{
+    agfx_meshlet_culling_t* culling = &renderer->meshlet_culling;
+    agfx_context_t* context = renderer->context;
+    agfx_result_t result = AGFX_SUCCESS;
+
+    result = agfx_helper_create_buffer(context, agfx_draw_list_buffer_size(culling->clusters_capacity), AGFX_DRAW_LIST_USAGE | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &cull_frame->draw_buffer, &cull_frame->draw_buffer_memory);
+    if (AGFX_SUCCESS != result) return result;
+
+    VkDeviceSize cluster_buffer_size = sizeof(uint32_t) * 2 * (culling->all_meshes_clustered ? 2 * culling->clusters_capacity : 1);
+    result = agfx_helper_create_buffer(context, cluster_buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &cull_frame->cluster_buffer, &cull_frame->cluster_buffer_memory);
+    if (AGFX_SUCCESS != result) goto free_draw_buffer;
+
+    result = agfx_helper_create_buffer(context, sizeof(VkDrawMeshTasksIndirectCommandEXT) * AGFX_DRAW_RANGES_COUNT, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &cull_frame->task_buffer, &cull_frame->task_buffer_memory);
+    if (AGFX_SUCCESS != result) goto free_cluster_buffer;
+
+    // host visible so the counters can be read back once the frame's fence signaled
+    result = agfx_helper_create_buffer(context, sizeof(agfx_meshlet_cull_stats_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &cull_frame->stats_buffer, &cull_frame->stats_buffer_memory);
+    if (AGFX_SUCCESS != result) goto free_task_buffer;
+
+    if (VK_SUCCESS != vkMapMemory(context->device, cull_frame->stats_buffer_memory, 0, sizeof(agfx_meshlet_cull_stats_t), 0, &cull_frame->stats_buffer_mapped))
+    {
+        result = AGFX_BUFFER_MAP_ERROR;
+        goto free_stats_buffer;
+    }
+    memset(cull_frame->stats_buffer_mapped, 0, sizeof(agfx_meshlet_cull_stats_t));
+
+goto finish;
+
+free_stats_buffer:
+    vkDestroyBuffer(context->device, cull_frame->stats_buffer, NULL);
+    vkFreeMemory(context->device, cull_frame->stats_buffer_memory, NULL);
+free_task_buffer:
+    vkDestroyBuffer(context->device, cull_frame->task_buffer, NULL);
+    vkFreeMemory(context->device, cull_frame->task_buffer_memory, NULL);
+free_cluster_buffer:
+    vkDestroyBuffer(context->device, cull_frame->cluster_buffer, NULL);
+    vkFreeMemory(context->device, cull_frame->cluster_buffer_memory, NULL);
+free_draw_buffer:
+    vkDestroyBuffer(context->device, cull_frame->draw_buffer, NULL);
+    vkFreeMemory(context->device, cull_frame->draw_buffer_memory, NULL);
+finish:
+    return result;
+}
+
+// everything but the depth pyramid, that one is written once gpu_culling.c created it
+static void write_meshlet_cull_frame_descriptor_sets(agfx_renderer_t* renderer, size_t frame_index)
+{
+    agfx_meshlet_culling_t* culling = &renderer->meshlet_culling;
+    agfx_frame_t* frame = &renderer->frames[frame_index];
+    agfx_cull_frame_t* object_cull_frame = &renderer->gpu_culling.frames[frame_index];
+    agfx_meshlet_cull_frame_t* cull_frame = &culling->frames[frame_index];
+
+    VkDeviceSize object_count_offset = agfx_draw_list_count_offset(renderer->gpu_culling.draws_capacity);
+    VkDeviceSize cluster_count_offset = agfx_draw_list_count_offset(culling->clusters_capacity);
+
+    VkDescriptorBufferInfo buffer_infos[AGFX_MESHLET_CULL_DESCRIPTOR_COUNT] = {
+        {.buffer = renderer->frame_arena.buffer, .offset = 0, .range = sizeof(agfx_frame_constants_t)},
+        {.buffer = frame->object_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        {.buffer = renderer->meshlet_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        {.buffer = renderer->lod_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        {.buffer = object_cull_frame->early_draw_buffer, .offset = 0, .range = object_count_offset > 0 ? object_count_offset : VK_WHOLE_SIZE},
+        {.buffer = object_cull_frame->early_draw_buffer, .offset = object_count_offset, .range = AGFX_DRAW_LIST_COUNT_SIZE},
+        {.buffer = object_cull_frame->late_draw_buffer, .offset = 0, .range = object_count_offset > 0 ? object_count_offset : VK_WHOLE_SIZE},
+        {.buffer = object_cull_frame->late_draw_buffer, .offset = object_count_offset, .range = AGFX_DRAW_LIST_COUNT_SIZE},
+        {.buffer = cull_frame->draw_buffer, .offset = 0, .range = cluster_count_offset},
+        {.buffer = cull_frame->draw_buffer, .offset = cluster_count_offset, .range = AGFX_DRAW_LIST_COUNT_SIZE},
+        {.buffer = cull_frame->cluster_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        {.buffer = cull_frame->task_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        {.buffer = cull_frame->stats_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        {0}
+    };
+
+    VkWriteDescriptorSet write_descriptor_sets[AGFX_MESHLET_CULL_DESCRIPTOR_COUNT - 1 + AGFX_MESHLET_MESH_DESCRIPTOR_COUNT];
+    uint32_t writes_count = 0;
+    for (uint32_t i = 0; i < AGFX_MESHLET_CULL_DESCRIPTOR_COUNT; ++i)
+    {
+        if (AGFX_MESHLET_CULL_PYRAMID_BINDING == i) continue;
+
+        write_descriptor_sets[writes_count++] = (VkWriteDescriptorSet) {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = cull_frame->descriptor_set,
+            .dstBinding = i,
+            .dstArrayElement = 0,
+            .descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .pBufferInfo = &buffer_infos[i]
+        };
+    }
+
+    VkDescriptorBufferInfo mesh_buffer_infos[AGFX_MESHLET_MESH_DESCRIPTOR_COUNT] = {
+        {.buffer = renderer->geometry_buffer.position_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        {.buffer = renderer->meshlet_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        {.buffer = renderer->meshlet_vertex_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        {.buffer = renderer->meshlet_triangle_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        // only the first phase's half, the mesh shader bounds its reads by the length
+        {.buffer = cull_frame->cluster_buffer, .offset = 0, .range = sizeof(uint32_t) * 2 * culling->clusters_capacity},
+        {.buffer = cull_frame->draw_buffer, .offset = cluster_count_offset, .range = AGFX_DRAW_LIST_COUNT_SIZE},
+        {.buffer = renderer->geometry_buffer.attribute_buffer, .offset = 0, .range = VK_WHOLE_SIZE}
+    };
+
+    for (uint32_t i = 0; culling->mesh_shader_available && i < AGFX_MESHLET_MESH_DESCRIPTOR_COUNT; ++i)
+    {
+        write_descriptor_sets[writes_count++] = (VkWriteDescriptorSet) {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = cull_frame->mesh_descriptor_set,
+            .dstBinding = i,
+            .dstArrayElement = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .pBufferInfo = &mesh_buffer_infos[i]
+        };
+    }
+
+    vkUpdateDescriptorSets(renderer->context->device, writes_count, write_descriptor_sets, 0, NULL);
+}
+
+static agfx_result_t allocate_meshlet_descriptor_sets(agfx_renderer_t* renderer)
+{
+    agfx_meshlet_culling_t* culling = &renderer->meshlet_culling;
+    VkDescriptorSetLayout set_layouts[AGFX_MAX_FRAMES_IN_FLIGHT * 2];
+    VkDescriptorSet sets[AGFX_MAX_FRAMES_IN_FLIGHT * 2];
+    uint32_t sets_count = 0;
+
+    for (size_t i = 0; i < AGFX_MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        set_layouts[sets_count++] = culling->cull_descriptor_set_layout;
+    }
+    for (size_t i = 0; culling->mesh_shader_available && i < AGFX_MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        set_layouts[sets_count++] = culling->mesh_descriptor_set_layout;
+    }
+
+    VkDescriptorSetAllocateInfo set_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = culling->descriptor_pool,
+        .descriptorSetCount = sets_count,
+        .pSetLayouts = set_layouts
+    };
+
+    if (VK_SUCCESS != vkAllocateDescriptorSets(renderer->context->device, &set_allocate_info, sets))
+    {
+        return AGFX_DESCRIPTOR_SET_ERROR;
+    }
+
+    for (size_t i = 0; i < AGFX_MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        culling->frames[i].descriptor_set = sets[i];
+        if (culling->mesh_shader_available) culling->frames[i].mesh_descriptor_set = sets[AGFX_MAX_FRAMES_IN_FLIGHT + i];
+        write_meshlet_cull_frame_descriptor_sets(renderer, i);
+    }
+
+    return AGFX_SUCCESS;
+}
+
+// a scene without meshlets, or a device without draw indirect count to draw a variable number of clusters, keeps culling
+// whole objects and nothing is created. mesh shaders are only used when every mesh has its meshlets and the worst case
+// fits in one launch
+agfx_result_t agfx_create_meshlet_culling(agfx_renderer_t* renderer)
+{
+    agfx_meshlet_culling_t* culling = &renderer->meshlet_culling;
+    agfx_result_t result = AGFX_SUCCESS;
+    size_t created_frames = 0;
+
+    memset(culling, 0, sizeof(agfx_meshlet_culling_t));
+
+    // every instance at its full level is the most clusters a phase can pass, a range gets the share of its instances.
+    // a mesh without meshlets goes out as one cluster
+    for (uint32_t range = 0; range < AGFX_DRAW_RANGES_COUNT; ++range)
+    {
+        culling->range_first_clusters[range] = (uint32_t)culling->clusters_capacity;
+        for (size_t instance_index = 0; instance_index < renderer->instances_count; ++instance_index)
+        {
+            agfx_mesh_t* mesh = &renderer->meshes[renderer->instances[instance_index].mesh_index];
+            if (agfx_pipeline_key_draw_range(renderer->material_pipeline_keys[mesh->material_index]) != range) continue;
+
+            culling->clusters_capacity += mesh->lods[0].meshlets_count > 0 ? mesh->lods[0].meshlets_count : 1;
+        }
+    }
+    culling->range_first_clusters[AGFX_DRAW_RANGES_COUNT] = (uint32_t)culling->clusters_capacity;
+
+    if (0 == renderer->meshlets_count || !renderer->context->draw_indirect_count_supported || 0 == culling->clusters_capacity || culling->clusters_capacity > AGFX_MESHLET_MAX_CLUSTERS)
+    {
+        return AGFX_SUCCESS;
+    }
+
+    culling->all_meshes_clustered = renderer->meshlet_stats.meshes_count == renderer->meshes_count;
+    culling->mesh_shader_available = renderer->context->mesh_shader_supported
+        && culling->all_meshes_clustered
+        && culling->clusters_capacity <= renderer->context->max_mesh_work_group_count;
+
+    result = create_meshlet_cull_pipeline(renderer);
+    if (AGFX_SUCCESS != result) return result;
+
+    // a mesh pipeline that does not build only costs the faster path
+    if (culling->mesh_shader_available && AGFX_SUCCESS != create_meshlet_mesh_pipeline(renderer))
+    {
+        culling->mesh_shader_available = 0;
+    }
+
+    result = create_meshlet_descriptor_pool(renderer);
+    if (AGFX_SUCCESS != result) goto free_pipelines;
+
+    culling->frames = calloc(AGFX_MAX_FRAMES_IN_FLIGHT, sizeof(agfx_meshlet_cull_frame_t));
+    if (NULL == culling->frames)
+    {
+        result = AGFX_BUFFER_ERROR;
+        goto free_descriptor_pool;
+    }
+
+    for (; created_frames < AGFX_MAX_FRAMES_IN_FLIGHT; ++created_frames)
+    {
+        result = create_meshlet_cull_frame(renderer, &culling->frames[created_frames]);
+        if (AGFX_SUCCESS != result) goto free_frames;
+    }
+
+    result = allocate_meshlet_descriptor_sets(renderer);
+    if (AGFX_SUCCESS != result) goto free_frames;
+
+    culling->available = 1;
+    return result;
+
+free_frames:
+    for (size_t i = 0; i < created_frames; ++i)
+    {
+        free_meshlet_cull_frame(renderer, &culling->frames[i]);
+    }
+    free(culling->frames);
+    culling->frames = NULL;
+free_descriptor_pool:
+    vkDestroyDescriptorPool(renderer->context->device, culling->descriptor_pool, NULL);
+free_pipelines:
+    free_meshlet_pipelines(renderer);
+    culling->mesh_shader_available = 0;
+    return result;
+}
+
+void agfx_free_meshlet_culling(agfx_renderer_t* renderer)
+{
+    agfx_meshlet_culling_t* culling = &renderer->meshlet_culling;
+
+    if (!culling->available) return;
+
+    for (size_t i = 0; i < AGFX_MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        free_meshlet_cull_frame(renderer, &culling->frames[i]);
+    }
+    free(culling->frames);
+    vkDestroyDescriptorPool(renderer->context->device, culling->descriptor_pool, NULL);
+    free_meshlet_pipelines(renderer);
+    culling->available = 0;
+}
+
+uint32_t agfx_meshlet_culling_enabled(agfx_renderer_t* renderer)
+{
+    return renderer->meshlet_culling.available && renderer->state->gpu_culling && renderer->state->meshlet_culling;
+}
+
+uint32_t agfx_meshlet_culling_uses_mesh_shaders(agfx_renderer_t* renderer)
+{
+    // the visibility buffer draws clusters as indexed draws to get a primitive id that is the triangle's index in its cluster
+    return agfx_meshlet_culling_enabled(renderer) && renderer->meshlet_culling.mesh_shader_available && renderer->state->mesh_shaders
+        && !agfx_visibility_buffer_enabled(renderer);
+}
+
+// call after agfx_gpu_culling_begin_frame: picks up the counters this frame slot wrote last time and points
+// the late phase at the pyramid when gpu_culling.c rebuilt it
+void agfx_meshlet_culling_begin_frame(agfx_renderer_t* renderer)
+{
+    agfx_meshlet_culling_t* culling = &renderer->meshlet_culling;
+    agfx_gpu_culling_t* object_culling = &renderer->gpu_culling;
+
+    if (!culling->available) return;
+
+    memcpy(&culling->stats, culling->frames[renderer->state->current_frame].stats_buffer_mapped, sizeof(agfx_meshlet_cull_stats_t));
+
+    if (0 == object_culling->pyramid_levels || culling->pyramid_depth_generation == object_culling->pyramid_depth_generation)
+    {
+        return;
+    }
+
+    // gpu_culling.c waited for the device before it replaced the pyramid, no frame still reads the old one
+    VkDescriptorImageInfo pyramid_image_info = {
+        .sampler = object_culling->pyramid_sampler,
+        .imageView = object_culling->pyramid_image_view,
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+    };
+
+    for (size_t i = 0; i < AGFX_MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        VkWriteDescriptorSet write_descriptor_set = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = culling->frames[i].descriptor_set,
+            .dstBinding = AGFX_MESHLET_CULL_PYRAMID_BINDING,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .pImageInfo = &pyramid_image_info
+        };
+        vkUpdateDescriptorSets(renderer->context->device, 1, &write_descriptor_set, 0, NULL);
+    }
+    culling->pyramid_depth_generation = object_culling->pyramid_depth_generation;
+}
+
+// runs after agfx_cmd_gpu_cull of the same phase and splits the objects it let through into clusters
+void agfx_cmd_meshlet_cull(agfx_renderer_t* renderer, VkCommandBuffer command_buffer, uint32_t phase)
+{
+    agfx_meshlet_culling_t* culling = &renderer->meshlet_culling;
+    agfx_gpu_culling_t* object_culling = &renderer->gpu_culling;
+    agfx_frame_t* frame = &renderer->frames[renderer->state->current_frame];
+    agfx_meshlet_cull_frame_t* cull_frame = &culling->frames[renderer->state->current_frame];
+    uint32_t mesh_shaders = agfx_meshlet_culling_uses_mesh_shaders(renderer);
+    uint32_t visibility = agfx_visibility_buffer_enabled(renderer);
+
+    // the early pass drew from the same buffers the late phase is about to clear
+    VkPipelineStageFlags draw_stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+    if (mesh_shaders) draw_stages |= VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT;
+    vkCmdPipelineBarrier(command_buffer, draw_stages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 0, NULL);
+
+    VkDrawMeshTasksIndirectCommandEXT empty_task_commands[AGFX_DRAW_RANGES_COUNT];
+    for (uint32_t range = 0; range < AGFX_DRAW_RANGES_COUNT; ++range)
+    {
+        empty_task_commands[range] = (VkDrawMeshTasksIndirectCommandEXT) {.groupCountX = 0, .groupCountY = 0, .groupCountZ = 1};
+    }
+    vkCmdFillBuffer(command_buffer, cull_frame->draw_buffer, agfx_draw_list_count_offset(culling->clusters_capacity), AGFX_DRAW_LIST_COUNT_SIZE, 0);
+    vkCmdUpdateBuffer(command_buffer, cull_frame->task_buffer, 0, sizeof(empty_task_commands), empty_task_commands);
+    if (phase == AGFX_CULL_PHASE_EARLY)
+    {
+        vkCmdFillBuffer(command_buffer, cull_frame->stats_buffer, 0, VK_WHOLE_SIZE, 0);
+    }
+
+    VkMemoryBarrier clear_barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    };
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clear_barrier, 0, NULL, 0, NULL);
+
+    agfx_meshlet_cull_push_constants_t push_constants = {
+        .phase = phase,
+        .mesh_shader = mesh_shaders,
+        .occlusion_enabled = renderer->state->occlusion_culling,
+        .cone_culling = renderer->state->meshlet_cone_culling,
+        .pyramid_width = (float)object_culling->pyramid_width,
+        .pyramid_height = (float)object_culling->pyramid_height,
+        .pyramid_levels = object_culling->pyramid_levels,
+        .clusters_capacity = (uint32_t)culling->clusters_capacity,
+        .visibility = visibility,
+        .draws_count = frame->draws_count
+    };
+    memcpy(push_constants.range_first_draws, renderer->draw_list.range_first_draws, sizeof(push_constants.range_first_draws));
+    memcpy(push_constants.range_first_clusters, culling->range_first_clusters, sizeof(push_constants.range_first_clusters));
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling->cull_pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling->cull_pipeline_layout, 0, 1, &cull_frame->descriptor_set, 1, &frame->constants_offset);
+    vkCmdPushConstants(command_buffer, culling->cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+    // the phase's counts are only known on the gpu, the workgroups loop over every slot they could fill
+    uint32_t workgroups_count = frame->draws_count < AGFX_MESHLET_CULL_MAX_WORKGROUPS ? frame->draws_count : AGFX_MESHLET_CULL_MAX_WORKGROUPS;
+    if (workgroups_count > 0)
+    {
+        vkCmdDispatch(command_buffer, workgroups_count, 1, 1);
+    }
+
+    VkPipelineStageFlags consumer_stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT;
+    if (mesh_shaders) consumer_stages |= VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT;
+    if (visibility) consumer_stages |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+    VkMemoryBarrier cull_barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT
+    };
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, consumer_stages, 0, 1, &cull_barrier, 0, NULL, 0, NULL);
+}
+
+// the cluster records of every opaque and alpha tested range, each with the count meshlet_cull.comp left for it
+static void draw_cluster_ranges(agfx_renderer_t* renderer, VkCommandBuffer command_buffer, uint32_t depth_only)
+{
+    agfx_meshlet_culling_t* culling = &renderer->meshlet_culling;
+    agfx_meshlet_cull_frame_t* cull_frame = &culling->frames[renderer->state->current_frame];
+
+    for (uint32_t range = 0; range < AGFX_DRAW_BUCKET_BLEND; ++range)
+    {
+        uint32_t first_cluster = culling->range_first_clusters[range];
+        uint32_t range_capacity = culling->range_first_clusters[range + 1] - first_cluster;
+        uint32_t key = renderer->bucket_pipeline_keys[range];
+        VkPipeline pipeline = depth_only ? depth_prepass_pipeline(renderer, key) : scene_pipeline(renderer, key);
+        if (0 == range_capacity || VK_NULL_HANDLE == pipeline) continue;
+
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        agfx_cmd_draw_list(renderer->context, command_buffer, cull_frame->draw_buffer, 0, culling->clusters_capacity, range, first_cluster, range_capacity);
+    }
+}
+
+// inside the scene pass: per range of the list, one indirect launch of a workgroup per cluster or the clusters as ordinary
+// indexed draws, through the pipeline of the range's bucket. blended objects are not split, the caller draws them after
+void agfx_cmd_draw_meshlets(agfx_renderer_t* renderer, VkCommandBuffer command_buffer)
+{
+    agfx_meshlet_culling_t* culling = &renderer->meshlet_culling;
+    agfx_meshlet_cull_frame_t* cull_frame = &culling->frames[renderer->state->current_frame];
+
+    bind_scene_state(renderer, command_buffer);
+    if (!agfx_meshlet_culling_uses_mesh_shaders(renderer))
+    {
+        // the clusters' depth first, the mesh shader path has no position only variant and draws without a prepass
+        if (renderer->state->depth_prepass)
+        {
+            draw_cluster_ranges(renderer, command_buffer, 1);
+        }
+        draw_cluster_ranges(renderer, command_buffer, 0);
+        return;
+    }
+
+    agfx_frame_t* frame = &renderer->frames[renderer->state->current_frame];
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, culling->mesh_pipeline_layout, 0, 1, &frame->descriptor_set, 1, &frame->constants_offset);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, culling->mesh_pipeline_layout, 1, 1, &renderer->material_descriptor_set, 0, NULL);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, culling->mesh_pipeline_layout, 2, 1, &cull_frame->mesh_descriptor_set, 0, NULL);
+    for (uint32_t range = 0; range < AGFX_DRAW_BUCKET_BLEND; ++range)
+    {
+        if (VK_NULL_HANDLE == culling->mesh_pipelines[range]) continue;
+
+        agfx_meshlet_mesh_push_constants_t push_constants = {
+            .range = range,
+            .first_cluster = culling->range_first_clusters[range],
+            .clusters_capacity = culling->range_first_clusters[range + 1] - culling->range_first_clusters[range]
+        };
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, culling->mesh_pipelines[range]);
+        vkCmdPushConstants(command_buffer, culling->mesh_pipeline_layout, VK_SHADER_STAGE_MESH_BIT_EXT, 0, sizeof(push_constants), &push_constants);
+        renderer->context->cmd_draw_mesh_tasks_indirect(command_buffer, cull_frame->task_buffer, sizeof(VkDrawMeshTasksIndirectCommandEXT) * range, 1, sizeof(VkDrawMeshTasksIndirectCommandEXT));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "pipeline_cache.h"
+
+// written in front of the driver's blob, the driver checks its own header too but not every driver rejects a stale one gracefully
+typedef struct agfx_pipeline_cache_file_header_t {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint32_t padding;
+    uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+    uint8_t driver_uuid[VK_UUID_SIZE];
+    uint64_t data_size;
+    uint64_t data_hash;
+} agfx_pipeline_cache_file_header_t;
+
+static uint64_t hash_data(const uint8_t* data, size_t size)
+{
+    // fnv-1a, only there to catch a file truncated or corrupted on disk
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static void fill_file_header(agfx_context_t* context, agfx_pipeline_cache_file_header_t* header)
+{
+    VkPhysicalDeviceIDProperties id_properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES
+    };
+    VkPhysicalDeviceProperties2 properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &id_properties
+    };
+    vkGetPhysicalDeviceProperties2(context->physical_device, &properties);
+
+    memset(header, 0, sizeof(agfx_pipeline_cache_file_header_t));
+    header->magic = AGFX_PIPELINE_CACHE_MAGIC;
+    header->version = AGFX_PIPELINE_CACHE_VERSION;
+    header->vendor_id = properties.properties.vendorID;
+    header->device_id = properties.properties.deviceID;
+    header->driver_version = properties.properties.driverVersion;
+    memcpy(header->pipeline_cache_uuid, properties.properties.pipelineCacheUUID, VK_UUID_SIZE);
+    memcpy(header->driver_uuid, id_properties.driverUUID, VK_UUID_SIZE);
+}
+
+static uint32_t driver_data_valid(const agfx_pipeline_cache_file_header_t* expected, const uint8_t* data, size_t size)
+{
+    VkPipelineCacheHeaderVersionOne driver_header;
+    if (size < sizeof(VkPipelineCacheHeaderVersionOne)) return 0;
+    memcpy(&driver_header, data, sizeof(VkPipelineCacheHeaderVersionOne));
+
+    return driver_header.headerSize >= sizeof(VkPipelineCacheHeaderVersionOne) &&
+        driver_header.headerSize <= size &&
+        VK_PIPELINE_CACHE_HEADER_VERSION_ONE == driver_header.headerVersion &&
+        driver_header.vendorID == expected->vendor_id &&
+        driver_header.deviceID == expected->device_id &&
+        0 == memcmp(driver_header.pipelineCacheUUID, expected->pipeline_cache_uuid, VK_UUID_SIZE);
+}
+
+// returns the driver data when the file was written by this exact device and driver, NULL otherwise
+static uint8_t* read_cache_file(agfx_context_t* context, const char* path, size_t* out_size)
+{
+    agfx_pipeline_cache_file_header_t expected;
+    agfx_pipeline_cache_file_header_t header;
+    uint8_t* data = NULL;
+
+    fill_file_header(context, &expected);
+
+    FILE* cache_fd = fopen(path, "rb");
+    if (NULL == cache_fd) return NULL;
+
+    if (1 != fread(&header, sizeof(header), 1, cache_fd)) goto close_file;
+
+    if (header.magic != expected.magic || header.version != expected.version ||
+        header.vendor_id != expected.vendor_id || header.device_id != expected.device_id ||
+        header.driver_version != expected.driver_version ||
+        0 != memcmp(header.pipeline_cache_uuid, expected.pipeline_cache_uuid, VK_UUID_SIZE) ||
+        0 != memcmp(header.driver_uuid, expected.driver_uuid, VK_UUID_SIZE) ||
+        0 == header.data_size)
+    {
+        goto close_file;
+    }
+
+    data = (uint8_t*)malloc(header.data_size);
+    if (NULL == data) goto close_file;
+
+    if (1 != fread(data, header.data_size, 1, cache_fd) ||
+        header.data_hash != hash_data(data, header.data_size) ||
+        !driver_data_valid(&expected, data, header.data_size))
+    {
+        free(data);
+        data = NULL;
+        goto close_file;
+    }
+
+    *out_size = header.data_size;
+
+close_file:
+    fclose(cache_fd);
+    return data;
+}
+
+// a missing or stale file is not an error, the cache just starts out cold
+agfx_result_t agfx_create_pipeline_cache(agfx_context_t* context, const char* path)
+{
+    size_t data_size = 0;
+    uint8_t* data = read_cache_file(context, path, &data_size);
+
+    VkPipelineCacheCreateInfo pipeline_cache_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = data_size,
+        .pInitialData = data
+    };
+
+    VkResult vk_result = vkCreatePipelineCache(context->device, &pipeline_cache_create_info, NULL, &context->pipeline_cache);
+    context->pipeline_cache_warm = VK_SUCCESS == vk_result && NULL != data;
+
+    // the driver may still refuse data that passed our checks, retry empty rather than run without a cache
+    if (VK_SUCCESS != vk_result && NULL != data)
+    {
+        pipeline_cache_create_info.initialDataSize = 0;
+        pipeline_cache_create_info.pInitialData = NULL;
+        vk_result = vkCreatePipelineCache(context->device, &pipeline_cache_create_info, NULL, &context->pipeline_cache);
+    }
+
+    free(data);
+    return VK_SUCCESS == vk_result ? AGFX_SUCCESS : AGFX_PIPELINE_CACHE_ERROR;
+}
+
+// written to a temporary file first so a crash mid-write never leaves a truncated cache behind
+agfx_result_t agfx_save_pipeline_cache(agfx_context_t* context, const char* path)
+{
+    agfx_result_t result = AGFX_PIPELINE_CACHE_ERROR;
+    agfx_pipeline_cache_file_header_t header;
+    size_t data_size = 0;
+    char temporary_path[FILENAME_MAX];
+
+    if (VK_NULL_HANDLE == context->pipeline_cache) return AGFX_SUCCESS;
+
+    if (VK_SUCCESS != vkGetPipelineCacheData(context->device, context->pipeline_cache, &data_size, NULL) || 0 == data_size)
+    {
+        return AGFX_PIPELINE_CACHE_ERROR;
+    }
+
+    uint8_t* data = (uint8_t*)malloc(data_size);
+    if (NULL == data) return AGFX_PIPELINE_CACHE_ERROR;
+
+    // the size can shrink between the two calls, never grow past what was asked for
+    if (VK_SUCCESS != vkGetPipelineCacheData(context->device, context->pipeline_cache, &data_size, data)) goto free_data;
+
+    fill_file_header(context, &header);
+    header.data_size = data_size;
+    header.data_hash = hash_data(data, data_size);
+
+    if (snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", path) >= (int)sizeof(temporary_path)) goto free_data;
+
+    FILE* cache_fd = fopen(temporary_path, "wb");
+    if (NULL == cache_fd) goto free_data;
+
+    uint32_t written = 1 == fwrite(&header, sizeof(header), 1, cache_fd) && 1 == fwrite(data, data_size, 1, cache_fd);
+    if (0 != fclose(cache_fd) || !written)
+    {
+        remove(temporary_path);
+        goto free_data;
+    }
+
+    // rename does not replace an existing file on windows
+    remove(path);
+    if (0 != rename(temporary_path, path))
+    {
+        remove(temporary_path);
+        goto free_data;
+    }
+
+    result = AGFX_SUCCESS;
+
+free_data:
+    free(data);
+    return result;
+}
+
+void agfx_free_pipeline_cache(agfx_context_t* context)
+{
+    vkDestroyPipelineCache(context->device, context->pipeline_cache, NULL);
+    context->pipeline_cache = VK_NULL_HANDLE;
+    context->pipeline_cache_warm = 0;
+}
\ No newline at end of file
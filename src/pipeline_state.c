@@ -0,0 +1,798 @@
+#include "pipeline_state.h"
+#include "renderer.h"
+
+// murmur3's finalizer, keys only differ in a few low bits
+static uint32_t hash_key(uint32_t key)
+{
+    key ^= key >> 16;
+    key *= 0x85ebca6bu;
+    key ^= key >> 13;
+    key *= 0xc2b2ae35u;
+    key ^= key >> 16;
+    return key;
+}
+
+// the key's slot, or the empty one it would go in. the table is never more than half full so the probe ends
+static uint32_t find_slot(const agfx_pipeline_state_cache_t* cache, uint32_t key)
+{
+    uint32_t mask = cache->capacity - 1;
+    uint32_t slot = hash_key(key) & mask;
+    while (cache->keys[slot] != key && cache->keys[slot] != AGFX_PIPELINE_STATE_EMPTY_KEY)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static double elapsed_ms(uint64_t start)
+{
+    return (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+// an acquire after the state, whatever the compile wrote before setting it is visible from here on
+static uint32_t slot_state(const agfx_pipeline_state_cache_t* cache, uint32_t slot)
+{
+    uint32_t state = (uint32_t)SDL_AtomicGet((SDL_atomic_t*)&cache->states[slot]);
+    SDL_MemoryBarrierAcquire();
+    return state;
+}
+
+// opaque surfaces are the ones a depth prepass can go in front of
+uint32_t agfx_pipeline_key_is_opaque(uint32_t key)
+{
+    return 0 == (key & (AGFX_PIPELINE_ALPHA_TEST | AGFX_PIPELINE_ALPHA_BLEND));
+}
+
+// opaque, alpha tested and blended, each single then double sided
+uint32_t agfx_pipeline_key_bucket(uint32_t key)
+{
+    uint32_t alpha_mode = (key & AGFX_PIPELINE_ALPHA_BLEND) ? 2 : ((key & AGFX_PIPELINE_ALPHA_TEST) ? 1 : 0);
+    return alpha_mode * 2 + ((key & AGFX_PIPELINE_DOUBLE_SIDED) ? 1 : 0);
+}
+
+// both blended buckets land in the one range that is sorted back to front
+uint32_t agfx_pipeline_key_draw_range(uint32_t key)
+{
+    uint32_t bucket = agfx_pipeline_key_bucket(key);
+    return bucket < AGFX_DRAW_BUCKET_BLEND ? bucket : AGFX_DRAW_BUCKET_BLEND;
+}
+
+// the state every key in a bucket shares, the features are whatever its materials add
+uint32_t agfx_pipeline_bucket_key(uint32_t bucket)
+{
+    uint32_t key = (bucket & 1) ? AGFX_PIPELINE_DOUBLE_SIDED : 0;
+    if (1 == bucket / 2) key |= AGFX_PIPELINE_ALPHA_TEST;
+    if (2 == bucket / 2) key |= AGFX_PIPELINE_ALPHA_BLEND | AGFX_PIPELINE_DEPTH_READ_ONLY;
+    return key;
+}
+
+// the struct is filled in place, its info points at its own values and entries
+void agfx_pipeline_specialization(uint32_t key, agfx_pipeline_specialization_t* out_specialization)
+{
+    const uint32_t constant_ids[AGFX_PIPELINE_SPECIALIZATION_CONSTANTS_COUNT] = {
+        AGFX_PIPELINE_ALPHA_TEST_CONSTANT_ID,
+        AGFX_PIPELINE_HAS_TEXTURE_CONSTANT_ID,
+        AGFX_PIPELINE_VERTEX_COLOR_CONSTANT_ID,
+        AGFX_PIPELINE_MIXED_MATERIALS_CONSTANT_ID
+    };
+    const uint32_t key_bits[AGFX_PIPELINE_SPECIALIZATION_CONSTANTS_COUNT] = {
+        AGFX_PIPELINE_ALPHA_TEST,
+        AGFX_PIPELINE_HAS_TEXTURE,
+        AGFX_PIPELINE_VERTEX_COLOR,
+        AGFX_PIPELINE_MIXED_MATERIALS
+    };
+
+    for (uint32_t i = 0; i < AGFX_PIPELINE_SPECIALIZATION_CONSTANTS_COUNT; ++i)
+    {
+        out_specialization->values[i] = (key & key_bits[i]) ? VK_TRUE : VK_FALSE;
+        out_specialization->map_entries[i] = (VkSpecializationMapEntry) {
+            .constantID = constant_ids[i],
+            .offset = i * sizeof(VkBool32),
+            .size = sizeof(VkBool32)
+        };
+    }
+
+    out_specialization->info = (VkSpecializationInfo) {
+        .mapEntryCount = AGFX_PIPELINE_SPECIALIZATION_CONSTANTS_COUNT,
+        .pMapEntries = out_specialization->map_entries,
+        .dataSize = sizeof(out_specialization->values),
+        .pData = out_specialization->values
+    };
+}
+
+// the state every scene pipeline is made of, the create infos point into the struct so it is filled in place
+typedef struct
+{
+    agfx_pipeline_specialization_t specialization;
+    VkPipelineShaderStageCreateInfo stages[2];
+    uint32_t stages_count;
+    VkPipelineVertexInputStateCreateInfo vertex_input;
+    VkPipelineInputAssemblyStateCreateInfo input_assembly;
+    VkPipelineRasterizationStateCreateInfo rasterization;
+    VkPipelineMultisampleStateCreateInfo multisample;
+    VkPipelineColorBlendAttachmentState color_blend_attachment;
+    VkPipelineColorBlendStateCreateInfo color_blend;
+    VkPipelineViewportStateCreateInfo viewport;
+    VkDynamicState dynamic_states[2];
+    VkPipelineDynamicStateCreateInfo dynamic;
+    VkPipelineDepthStencilStateCreateInfo depth_stencil;
+    VkGraphicsPipelineCreateInfo create_info;
+} agfx_scene_pipeline_states_t;
+
+// everything but the key's bits is the same for every scene pipeline: the layout, the render pass, dynamic viewport and scissor
+static void fill_scene_pipeline_states(const agfx_pipeline_state_cache_t* cache, uint32_t key, agfx_scene_pipeline_states_t* states)
+{
+    uint32_t depth_mode = key & AGFX_PIPELINE_DEPTH_MASK;
+
+    // alpha testing is a constant so the pipelines without it keep early depth testing, the other features are constants so
+    // a material only pays for the ones it has
+    agfx_pipeline_specialization(key, &states->specialization);
+
+    states->stages[0] = (VkPipelineShaderStageCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage = VK_SHADER_STAGE_VERTEX_BIT,
+        .module = AGFX_PIPELINE_DEPTH_PREPASS == depth_mode ? cache->depth_shader_module : cache->vertex_shader_module,
+        .pName = "main",
+    };
+    states->stages[1] = (VkPipelineShaderStageCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .module = cache->fragment_shader_module,
+        .pName = "main",
+        .pSpecializationInfo = &states->specialization.info
+    };
+    states->stages_count = AGFX_PIPELINE_DEPTH_PREPASS == depth_mode ? 1 : 2;
+
+    // the prepass fetches positions only
+    states->vertex_input = (VkPipelineVertexInputStateCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = AGFX_PIPELINE_DEPTH_PREPASS == depth_mode ? 1 : AGFX_VERTEX_INPUT_BINDING_DESCRIPTION_SIZE,
+        .pVertexBindingDescriptions = agfx_vertex_input_binding_descriptions,
+        .vertexAttributeDescriptionCount = AGFX_PIPELINE_DEPTH_PREPASS == depth_mode ? 1 : AGFX_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_SIZE,
+        .pVertexAttributeDescriptions = agfx_vertex_input_attribute_description
+    };
+
+    states->input_assembly = (VkPipelineInputAssemblyStateCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .primitiveRestartEnable = VK_FALSE
+    };
+
+    // glTF faces are counter clockwise. the projection's flipped y and vulkan's y down framebuffer cancel, so they stay
+    // counter clockwise on screen
+    states->rasterization = (VkPipelineRasterizationStateCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .lineWidth = 1.0f,
+        .cullMode = (key & AGFX_PIPELINE_DOUBLE_SIDED) ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT,
+        .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+        .depthBiasEnable = VK_FALSE
+    };
+
+    states->multisample = (VkPipelineMultisampleStateCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .sampleShadingEnable = VK_FALSE,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+    };
+
+    states->color_blend_attachment = (VkPipelineColorBlendAttachmentState) {
+        .colorWriteMask = AGFX_PIPELINE_DEPTH_PREPASS == depth_mode ? 0 : VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .colorBlendOp = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+        .alphaBlendOp = VK_BLEND_OP_ADD,
+        .blendEnable = (key & AGFX_PIPELINE_ALPHA_BLEND) ? VK_TRUE : VK_FALSE,
+    };
+
+    states->color_blend = (VkPipelineColorBlendStateCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &states->color_blend_attachment,
+        .logicOpEnable = VK_FALSE,
+        .logicOp = VK_LOGIC_OP_COPY,
+        .blendConstants = {0.0f, 0.0f, 0.0f, 0.0f}
+    };
+
+    states->viewport = (VkPipelineViewportStateCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 0,
+        .scissorCount = 0,
+    };
+
+    states->dynamic_states[0] = VK_DYNAMIC_STATE_VIEWPORT_WITH_COUNT;
+    states->dynamic_states[1] = VK_DYNAMIC_STATE_SCISSOR_WITH_COUNT;
+
+    states->dynamic = (VkPipelineDynamicStateCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = 2,
+        .pDynamicStates = states->dynamic_states,
+    };
+
+    states->depth_stencil = (VkPipelineDepthStencilStateCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_TRUE,
+        .depthWriteEnable = (AGFX_PIPELINE_DEPTH_WRITE == depth_mode || AGFX_PIPELINE_DEPTH_PREPASS == depth_mode) ? VK_TRUE : VK_FALSE,
+        .depthCompareOp = AGFX_PIPELINE_DEPTH_EQUAL == depth_mode ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS,
+        .depthBoundsTestEnable = VK_FALSE,
+        .stencilTestEnable = VK_FALSE,
+    };
+
+    states->create_info = (VkGraphicsPipelineCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stageCount = states->stages_count,
+        .pStages = states->stages,
+        .pVertexInputState = &states->vertex_input,
+        .pInputAssemblyState = &states->input_assembly,
+        .pRasterizationState = &states->rasterization,
+        .pMultisampleState = &states->multisample,
+        .pColorBlendState = &states->color_blend,
+        .layout = cache->pipeline_layout,
+        .renderPass = cache->render_pass,
+        .subpass = 0,
+        .pDynamicState = &states->dynamic,
+        .pViewportState = &states->viewport,
+        .pDepthStencilState = &states->depth_stencil,
+    };
+}
+
+// the whole pipeline in one go, what a device without pipeline libraries compiles
+static agfx_result_t create_scene_pipeline(const agfx_pipeline_state_cache_t* cache, uint32_t key, VkPipeline* pipeline)
+{
+    agfx_scene_pipeline_states_t states;
+    fill_scene_pipeline_states(cache, key, &states);
+
+    // the vulkan pipeline cache synchronizes itself, the workers share it without a lock
+    if (VK_SUCCESS != vkCreateGraphicsPipelines(cache->context->device, cache->context->pipeline_cache, 1, &states.create_info, NULL, pipeline))
+    {
+        return AGFX_PIPELINE_ERROR;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+// the key's state with a mesh shader in place of the vertex stages, for clusters that go through their own layout.
+// compiled right away, not through the cache
+agfx_result_t agfx_pipeline_state_create_mesh_pipeline(const agfx_pipeline_state_cache_t* cache, uint32_t key, VkShaderModule mesh_shader_module, VkPipelineLayout pipeline_layout, VkPipeline* out_pipeline)
+{
+    agfx_scene_pipeline_states_t states;
+    fill_scene_pipeline_states(cache, key, &states);
+
+    states.stages[0].stage = VK_SHADER_STAGE_MESH_BIT_EXT;
+    states.stages[0].module = mesh_shader_module;
+    // mesh pipelines take no vertex input or input assembly state
+    states.create_info.pVertexInputState = NULL;
+    states.create_info.pInputAssemblyState = NULL;
+    states.create_info.layout = pipeline_layout;
+
+    if (VK_SUCCESS != vkCreateGraphicsPipelines(cache->context->device, cache->context->pipeline_cache, 1, &states.create_info, NULL, out_pipeline))
+    {
+        return AGFX_PIPELINE_ERROR;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+// one part of the key's pipeline, the driver only looks at the state that belongs to the part. the link time optimization
+// info is kept so a linked pipeline can be optimized across the parts later
+static agfx_result_t create_library(const agfx_pipeline_state_cache_t* cache, uint32_t key, VkGraphicsPipelineLibraryFlagsEXT flags, VkPipeline* library)
+{
+    agfx_scene_pipeline_states_t states;
+    fill_scene_pipeline_states(cache, key, &states);
+
+    VkGraphicsPipelineLibraryCreateInfoEXT library_create_info = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT,
+        .flags = flags
+    };
+
+    states.create_info.pNext = &library_create_info;
+    states.create_info.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+    // each part only gets its own shader, the prepass has no fragment shader at all
+    states.create_info.stageCount = 0;
+    states.create_info.pStages = NULL;
+    if (flags & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT)
+    {
+        states.create_info.stageCount = 1;
+        states.create_info.pStages = &states.stages[0];
+    } else if ((flags & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT) && states.stages_count > 1)
+    {
+        states.create_info.stageCount = 1;
+        states.create_info.pStages = &states.stages[1];
+    }
+
+    if (VK_SUCCESS != vkCreateGraphicsPipelines(cache->context->device, cache->context->pipeline_cache, 1, &states.create_info, NULL, library))
+    {
+        return AGFX_PIPELINE_ERROR;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+// the library each key takes its fixed parts from, they match the keys the libraries are made from in create_libraries
+static uint32_t vertex_input_library_index(uint32_t key)
+{
+    return AGFX_PIPELINE_DEPTH_PREPASS == (key & AGFX_PIPELINE_DEPTH_MASK) ? 1 : 0;
+}
+
+static uint32_t pre_rasterization_library_index(uint32_t key)
+{
+    return (AGFX_PIPELINE_DEPTH_PREPASS == (key & AGFX_PIPELINE_DEPTH_MASK) ? 2 : 0) | ((key & AGFX_PIPELINE_DOUBLE_SIDED) ? 1 : 0);
+}
+
+static uint32_t fragment_output_library_index(uint32_t key)
+{
+    if (AGFX_PIPELINE_DEPTH_PREPASS == (key & AGFX_PIPELINE_DEPTH_MASK)) return 2;
+    return (key & AGFX_PIPELINE_ALPHA_BLEND) ? 1 : 0;
+}
+
+// the fragment shader part only depends on the constants and the depth test
+static uint32_t fragment_library_key(uint32_t key)
+{
+    if (AGFX_PIPELINE_DEPTH_PREPASS == (key & AGFX_PIPELINE_DEPTH_MASK)) return AGFX_PIPELINE_DEPTH_PREPASS;
+    return key & (AGFX_PIPELINE_ALPHA_TEST | AGFX_PIPELINE_FEATURE_MASK | AGFX_PIPELINE_DEPTH_MASK);
+}
+
+static void free_libraries(agfx_pipeline_state_cache_t* cache)
+{
+    VkDevice device = cache->context->device;
+
+    for (uint32_t i = 0; i < cache->fragment_libraries_count; ++i)
+    {
+        vkDestroyPipeline(device, cache->fragment_libraries[i], NULL);
+    }
+    cache->fragment_libraries_count = 0;
+
+    for (uint32_t i = 0; i < AGFX_PIPELINE_VERTEX_INPUT_LIBRARIES_COUNT; ++i)
+    {
+        vkDestroyPipeline(device, cache->vertex_input_libraries[i], NULL);
+        cache->vertex_input_libraries[i] = VK_NULL_HANDLE;
+    }
+    for (uint32_t i = 0; i < AGFX_PIPELINE_PRE_RASTERIZATION_LIBRARIES_COUNT; ++i)
+    {
+        vkDestroyPipeline(device, cache->pre_rasterization_libraries[i], NULL);
+        cache->pre_rasterization_libraries[i] = VK_NULL_HANDLE;
+    }
+    for (uint32_t i = 0; i < AGFX_PIPELINE_FRAGMENT_OUTPUT_LIBRARIES_COUNT; ++i)
+    {
+        vkDestroyPipeline(device, cache->fragment_output_libraries[i], NULL);
+        cache->fragment_output_libraries[i] = VK_NULL_HANDLE;
+    }
+}
+
+// the parts no material changes are made once up front. without the extension, or if a part fails, every key is compiled
+// whole like before
+static void create_libraries(agfx_pipeline_state_cache_t* cache)
+{
+    const uint32_t vertex_input_keys[AGFX_PIPELINE_VERTEX_INPUT_LIBRARIES_COUNT] = {
+        AGFX_PIPELINE_DEPTH_WRITE,
+        AGFX_PIPELINE_DEPTH_PREPASS
+    };
+    const uint32_t pre_rasterization_keys[AGFX_PIPELINE_PRE_RASTERIZATION_LIBRARIES_COUNT] = {
+        AGFX_PIPELINE_DEPTH_WRITE,
+        AGFX_PIPELINE_DEPTH_WRITE | AGFX_PIPELINE_DOUBLE_SIDED,
+        AGFX_PIPELINE_DEPTH_PREPASS,
+        AGFX_PIPELINE_DEPTH_PREPASS | AGFX_PIPELINE_DOUBLE_SIDED
+    };
+    const uint32_t fragment_output_keys[AGFX_PIPELINE_FRAGMENT_OUTPUT_LIBRARIES_COUNT] = {
+        AGFX_PIPELINE_DEPTH_WRITE,
+        AGFX_PIPELINE_DEPTH_READ_ONLY | AGFX_PIPELINE_ALPHA_BLEND,
+        AGFX_PIPELINE_DEPTH_PREPASS
+    };
+
+    cache->libraries_enabled = 0;
+    if (!cache->context->graphics_pipeline_library_supported) return;
+
+    for (uint32_t i = 0; i < AGFX_PIPELINE_VERTEX_INPUT_LIBRARIES_COUNT; ++i)
+    {
+        if (AGFX_SUCCESS != create_library(cache, vertex_input_keys[i], VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT, &cache->vertex_input_libraries[i])) goto free_libraries;
+    }
+    for (uint32_t i = 0; i < AGFX_PIPELINE_PRE_RASTERIZATION_LIBRARIES_COUNT; ++i)
+    {
+        if (AGFX_SUCCESS != create_library(cache, pre_rasterization_keys[i], VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT, &cache->pre_rasterization_libraries[i])) goto free_libraries;
+    }
+    for (uint32_t i = 0; i < AGFX_PIPELINE_FRAGMENT_OUTPUT_LIBRARIES_COUNT; ++i)
+    {
+        if (AGFX_SUCCESS != create_library(cache, fragment_output_keys[i], VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT, &cache->fragment_output_libraries[i])) goto free_libraries;
+    }
+
+    cache->libraries_enabled = 1;
+    return;
+
+free_libraries:
+    free_libraries(cache);
+}
+
+// the key's fragment shader part, made the first time a key needs it. it is compiled outside the lock so workers do not
+// wait on each other, two that raced for the same one keep the first
+static agfx_result_t get_fragment_library(agfx_pipeline_state_cache_t* cache, uint32_t key, VkPipeline* out_library)
+{
+    uint32_t library_key = fragment_library_key(key);
+
+    SDL_LockMutex(cache->fragment_libraries_mutex);
+    for (uint32_t i = 0; i < cache->fragment_libraries_count; ++i)
+    {
+        if (cache->fragment_library_keys[i] != library_key) continue;
+        *out_library = cache->fragment_libraries[i];
+        SDL_UnlockMutex(cache->fragment_libraries_mutex);
+        return AGFX_SUCCESS;
+    }
+    SDL_UnlockMutex(cache->fragment_libraries_mutex);
+
+    VkPipeline library;
+    agfx_result_t result = create_library(cache, library_key, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT, &library);
+    if (AGFX_SUCCESS != result) return result;
+
+    SDL_LockMutex(cache->fragment_libraries_mutex);
+    uint32_t found = 0;
+    for (uint32_t i = 0; i < cache->fragment_libraries_count && !found; ++i)
+    {
+        if (cache->fragment_library_keys[i] != library_key) continue;
+        vkDestroyPipeline(cache->context->device, library, NULL);
+        library = cache->fragment_libraries[i];
+        found = 1;
+    }
+    if (!found)
+    {
+        cache->fragment_library_keys[cache->fragment_libraries_count] = library_key;
+        cache->fragment_libraries[cache->fragment_libraries_count] = library;
+        cache->fragment_libraries_count++;
+    }
+    SDL_UnlockMutex(cache->fragment_libraries_mutex);
+
+    *out_library = library;
+    return AGFX_SUCCESS;
+}
+
+// without link time optimization this is the fast link, the driver mostly just puts the parts together
+static agfx_result_t link_scene_pipeline(agfx_pipeline_state_cache_t* cache, uint32_t key, VkPipelineCreateFlags flags, VkPipeline* pipeline)
+{
+    VkPipeline fragment_library;
+    agfx_result_t result = get_fragment_library(cache, key, &fragment_library);
+    if (AGFX_SUCCESS != result) return result;
+
+    VkPipeline libraries[] = {
+        cache->vertex_input_libraries[vertex_input_library_index(key)],
+        cache->pre_rasterization_libraries[pre_rasterization_library_index(key)],
+        fragment_library,
+        cache->fragment_output_libraries[fragment_output_library_index(key)]
+    };
+
+    VkPipelineLibraryCreateInfoKHR library_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,
+        .libraryCount = sizeof(libraries) / sizeof(libraries[0]),
+        .pLibraries = libraries
+    };
+
+    VkGraphicsPipelineCreateInfo pipeline_create_info = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext = &library_create_info,
+        .flags = flags,
+        .layout = cache->pipeline_layout
+    };
+
+    if (VK_SUCCESS != vkCreateGraphicsPipelines(cache->context->device, cache->context->pipeline_cache, 1, &pipeline_create_info, NULL, pipeline))
+    {
+        return AGFX_PIPELINE_ERROR;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+// the slow relink behind a fast one, draws keep using the fast link until this one is there
+static void optimize_pipeline_job(void* data)
+{
+    agfx_pipeline_compile_job_t* job = (agfx_pipeline_compile_job_t*)data;
+    agfx_pipeline_state_cache_t* cache = job->cache;
+
+    uint64_t start = SDL_GetPerformanceCounter();
+    agfx_result_t result = link_scene_pipeline(cache, cache->keys[job->slot], VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT, &cache->optimized_pipelines[job->slot]);
+    if (AGFX_SUCCESS != result) return;
+    cache->optimize_ms[job->slot] = (float)elapsed_ms(start);
+
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&cache->states[job->slot], AGFX_PIPELINE_COMPILE_OPTIMIZED);
+    SDL_AtomicIncRef(&cache->completed);
+}
+
+// the slot's key is set and its job filled in. a linked pipeline queues its optimized relink as soon as it is ready
+static agfx_result_t build_slot(agfx_pipeline_state_cache_t* cache, uint32_t slot)
+{
+    uint64_t start = SDL_GetPerformanceCounter();
+    agfx_result_t result = cache->libraries_enabled ? link_scene_pipeline(cache, cache->keys[slot], 0, &cache->pipelines[slot]) :
+        create_scene_pipeline(cache, cache->keys[slot], &cache->pipelines[slot]);
+    cache->compile_ms[slot] = (float)elapsed_ms(start);
+
+    // the pipeline has to be visible before the state that says it is there
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&cache->states[slot], AGFX_SUCCESS == result ? AGFX_PIPELINE_COMPILE_READY : AGFX_PIPELINE_COMPILE_FAILED);
+    SDL_AtomicIncRef(&cache->completed);
+
+    if (AGFX_SUCCESS == result && cache->libraries_enabled)
+    {
+        agfx_job_system_push_background(cache->job_system, optimize_pipeline_job, &cache->jobs[slot], &cache->pending);
+    }
+
+    return result;
+}
+
+static void compile_pipeline_job(void* data)
+{
+    agfx_pipeline_compile_job_t* job = (agfx_pipeline_compile_job_t*)data;
+    build_slot(job->cache, job->slot);
+}
+
+// the optimized relink once it is there, the fast link or whole pipeline until then
+static VkPipeline slot_pipeline(const agfx_pipeline_state_cache_t* cache, uint32_t slot, uint32_t state)
+{
+    if (AGFX_PIPELINE_COMPILE_OPTIMIZED == state) return cache->optimized_pipelines[slot];
+    if (AGFX_PIPELINE_COMPILE_READY == state) return cache->pipelines[slot];
+    return VK_NULL_HANDLE;
+}
+
+agfx_result_t agfx_create_pipeline_state_cache(agfx_renderer_t* renderer)
+{
+    VkDevice device = renderer->context->device;
+    agfx_result_t result = AGFX_SUCCESS;
+
+    renderer->pipeline_states = NULL;
+    agfx_pipeline_state_cache_t* cache = calloc(1, sizeof(agfx_pipeline_state_cache_t));
+    if (NULL == cache) return AGFX_PIPELINE_ERROR;
+
+    cache->context = renderer->context;
+    cache->pipeline_layout = renderer->pipeline_layout;
+    cache->render_pass = renderer->render_pass;
+    cache->job_system = renderer->job_system;
+
+    result = agfx_helper_create_shader_module(renderer->context, "./shaders/vert.spv", &cache->vertex_shader_module);
+    if (AGFX_SUCCESS != result) goto free_cache;
+
+    result = agfx_helper_create_shader_module(renderer->context, "./shaders/frag.spv", &cache->fragment_shader_module);
+    if (AGFX_SUCCESS != result) goto free_vertex_shader_module;
+
+    result = agfx_helper_create_shader_module(renderer->context, "./shaders/depth_vert.spv", &cache->depth_shader_module);
+    if (AGFX_SUCCESS != result) goto free_fragment_shader_module;
+
+    cache->capacity = AGFX_PIPELINE_STATE_CACHE_CAPACITY;
+    cache->keys = malloc(sizeof(uint32_t) * cache->capacity);
+    cache->pipelines = calloc(cache->capacity, sizeof(VkPipeline));
+    cache->optimized_pipelines = calloc(cache->capacity, sizeof(VkPipeline));
+    cache->states = calloc(cache->capacity, sizeof(SDL_atomic_t));
+    cache->compile_ms = calloc(cache->capacity, sizeof(float));
+    cache->optimize_ms = calloc(cache->capacity, sizeof(float));
+    cache->jobs = calloc(cache->capacity, sizeof(agfx_pipeline_compile_job_t));
+    // never more fragment parts than keys
+    cache->fragment_library_keys = malloc(sizeof(uint32_t) * cache->capacity);
+    cache->fragment_libraries = calloc(cache->capacity, sizeof(VkPipeline));
+    cache->fragment_libraries_mutex = SDL_CreateMutex();
+    if (NULL == cache->keys || NULL == cache->pipelines || NULL == cache->optimized_pipelines || NULL == cache->states || NULL == cache->compile_ms ||
+        NULL == cache->optimize_ms || NULL == cache->jobs || NULL == cache->fragment_library_keys || NULL == cache->fragment_libraries ||
+        NULL == cache->fragment_libraries_mutex)
+    {
+        result = AGFX_PIPELINE_ERROR;
+        goto free_tables;
+    }
+    memset(cache->keys, 0xFF, sizeof(uint32_t) * cache->capacity);
+
+    create_libraries(cache);
+
+    renderer->pipeline_states = cache;
+
+    // every other key can be pending because these are not, one per depth mode that has a fallback. masked surfaces stay out
+    // of the prepass and the equal test after it, so their alpha tested fallback is only needed with depth write
+    const uint32_t fallback_keys[] = {
+        AGFX_PIPELINE_FALLBACK_KEY | AGFX_PIPELINE_DEPTH_WRITE,
+        AGFX_PIPELINE_FALLBACK_KEY | AGFX_PIPELINE_DEPTH_PREPASS,
+        AGFX_PIPELINE_FALLBACK_KEY | AGFX_PIPELINE_DEPTH_EQUAL,
+        AGFX_PIPELINE_FALLBACK_KEY | AGFX_PIPELINE_ALPHA_TEST | AGFX_PIPELINE_DEPTH_WRITE
+    };
+    for (uint32_t i = 0; i < sizeof(fallback_keys) / sizeof(fallback_keys[0]); ++i)
+    {
+        VkPipeline fallback_pipeline;
+        result = agfx_pipeline_state_cache_get(renderer, fallback_keys[i], &fallback_pipeline);
+        if (AGFX_SUCCESS != result)
+        {
+            agfx_free_pipeline_state_cache(renderer);
+            return result;
+        }
+    }
+
+    return result;
+
+free_tables:
+    free(cache->keys);
+    free(cache->pipelines);
+    free(cache->optimized_pipelines);
+    free(cache->states);
+    free(cache->compile_ms);
+    free(cache->optimize_ms);
+    free(cache->jobs);
+    free(cache->fragment_library_keys);
+    free(cache->fragment_libraries);
+    SDL_DestroyMutex(cache->fragment_libraries_mutex);
+    vkDestroyShaderModule(device, cache->depth_shader_module, NULL);
+free_fragment_shader_module:
+    vkDestroyShaderModule(device, cache->fragment_shader_module, NULL);
+free_vertex_shader_module:
+    vkDestroyShaderModule(device, cache->vertex_shader_module, NULL);
+free_cache:
+    free(cache);
+    return result;
+}
+
+void agfx_free_pipeline_state_cache(agfx_renderer_t* renderer)
+{
+    agfx_pipeline_state_cache_t* cache = renderer->pipeline_states;
+    if (NULL == cache) return;
+
+    VkDevice device = cache->context->device;
+
+    // a compile or relink still running writes into the tables
+    agfx_job_system_wait(renderer->job_system, &cache->pending);
+
+    for (uint32_t slot = 0; slot < cache->capacity; ++slot)
+    {
+        uint32_t state = slot_state(cache, slot);
+        if (AGFX_PIPELINE_COMPILE_OPTIMIZED == state)
+        {
+            vkDestroyPipeline(device, cache->optimized_pipelines[slot], NULL);
+        }
+        if (AGFX_PIPELINE_COMPILE_READY == state || AGFX_PIPELINE_COMPILE_OPTIMIZED == state)
+        {
+            vkDestroyPipeline(device, cache->pipelines[slot], NULL);
+        }
+    }
+
+    free_libraries(cache);
+
+    free(cache->keys);
+    free(cache->pipelines);
+    free(cache->optimized_pipelines);
+    free(cache->states);
+    free(cache->compile_ms);
+    free(cache->optimize_ms);
+    free(cache->jobs);
+    free(cache->fragment_library_keys);
+    free(cache->fragment_libraries);
+    SDL_DestroyMutex(cache->fragment_libraries_mutex);
+    vkDestroyShaderModule(device, cache->depth_shader_module, NULL);
+    vkDestroyShaderModule(device, cache->fragment_shader_module, NULL);
+    vkDestroyShaderModule(device, cache->vertex_shader_module, NULL);
+    free(cache);
+    renderer->pipeline_states = NULL;
+}
+
+// creates the pipeline right here the first time a key is asked for, one already queued is waited for
+agfx_result_t agfx_pipeline_state_cache_get(agfx_renderer_t* renderer, uint32_t key, VkPipeline* out_pipeline)
+{
+    agfx_pipeline_state_cache_t* cache = renderer->pipeline_states;
+
+    uint32_t slot = find_slot(cache, key);
+    if (cache->keys[slot] != key)
+    {
+        if (2 * (cache->count + 1) > cache->capacity)
+        {
+            return AGFX_PIPELINE_ERROR;
+        }
+
+        cache->keys[slot] = key;
+        cache->count++;
+        SDL_AtomicSet(&cache->states[slot], AGFX_PIPELINE_COMPILE_PENDING);
+        cache->jobs[slot] = (agfx_pipeline_compile_job_t) {
+            .cache = cache,
+            .slot = slot
+        };
+
+        agfx_result_t result = build_slot(cache, slot);
+        if (AGFX_SUCCESS != result) return result;
+    }
+
+    // queued earlier by a request, its compile is one of the pending jobs
+    uint32_t state = slot_state(cache, slot);
+    if (AGFX_PIPELINE_COMPILE_PENDING == state)
+    {
+        agfx_job_system_wait(renderer->job_system, &cache->pending);
+        state = slot_state(cache, slot);
+    }
+
+    *out_pipeline = slot_pipeline(cache, slot, state);
+    return VK_NULL_HANDLE == *out_pipeline ? AGFX_PIPELINE_ERROR : AGFX_SUCCESS;
+}
+
+// queues the key's compile on the workers the first time it is asked for and never waits, the state says where it is at
+agfx_result_t agfx_pipeline_state_cache_request(agfx_renderer_t* renderer, uint32_t key, uint32_t* out_state)
+{
+    agfx_pipeline_state_cache_t* cache = renderer->pipeline_states;
+
+    uint32_t slot = find_slot(cache, key);
+    if (cache->keys[slot] != key)
+    {
+        if (2 * (cache->count + 1) > cache->capacity)
+        {
+            return AGFX_PIPELINE_ERROR;
+        }
+
+        cache->keys[slot] = key;
+        cache->count++;
+        SDL_AtomicSet(&cache->states[slot], AGFX_PIPELINE_COMPILE_PENDING);
+        cache->jobs[slot] = (agfx_pipeline_compile_job_t) {
+            .cache = cache,
+            .slot = slot
+        };
+        agfx_job_system_push_background(renderer->job_system, compile_pipeline_job, &cache->jobs[slot], &cache->pending);
+    }
+
+    *out_state = slot_state(cache, slot);
+    return AGFX_SUCCESS;
+}
+
+// a key and, for opaque ones, the prepass and the shading after it
+agfx_result_t agfx_pipeline_state_cache_prepare(agfx_renderer_t* renderer, uint32_t key)
+{
+    uint32_t state;
+    agfx_result_t result = agfx_pipeline_state_cache_request(renderer, key, &state);
+    if (AGFX_SUCCESS != result || !agfx_pipeline_key_is_opaque(key)) return result;
+
+    result = agfx_pipeline_state_cache_request(renderer, (key & ~AGFX_PIPELINE_DEPTH_MASK) | AGFX_PIPELINE_DEPTH_EQUAL, &state);
+    if (AGFX_SUCCESS != result) return result;
+
+    return agfx_pipeline_state_cache_request(renderer, (key & AGFX_PIPELINE_DOUBLE_SIDED) | AGFX_PIPELINE_DEPTH_PREPASS, &state);
+}
+
+// until every queued compile is done, ready or failed
+void agfx_pipeline_state_cache_wait(agfx_renderer_t* renderer)
+{
+    agfx_job_system_wait(renderer->job_system, &renderer->pipeline_states->pending);
+}
+
+// read only, so it is safe from the recording workers. a key nobody asked for or one still compiling comes back null
+VkPipeline agfx_pipeline_state_cache_find(const agfx_pipeline_state_cache_t* cache, uint32_t key)
+{
+    uint32_t slot = find_slot(cache, key);
+    if (cache->keys[slot] != key) return VK_NULL_HANDLE;
+    return slot_pipeline(cache, slot, slot_state(cache, slot));
+}
+
+// a key that is not ready draws with the fallback for its depth mode, an alpha tested one with the alpha tested fallback so
+// masked surfaces keep their holes. blended keys have none, drawn opaque they would hide what is behind them, so they come
+// back null and are skipped until their own pipeline is there
+VkPipeline agfx_pipeline_state_cache_resolve(const agfx_pipeline_state_cache_t* cache, uint32_t key)
+{
+    uint32_t depth_mode = key & AGFX_PIPELINE_DEPTH_MASK;
+    VkPipeline pipeline = agfx_pipeline_state_cache_find(cache, key);
+    if (VK_NULL_HANDLE != pipeline || AGFX_PIPELINE_DEPTH_READ_ONLY == depth_mode) return pipeline;
+
+    return agfx_pipeline_state_cache_find(cache, AGFX_PIPELINE_FALLBACK_KEY | (key & AGFX_PIPELINE_ALPHA_TEST) | depth_mode);
+}
+
+void agfx_pipeline_state_cache_stats(const agfx_pipeline_state_cache_t* cache, agfx_pipeline_compile_stats_t* out_stats)
+{
+    agfx_pipeline_compile_stats_t stats = {0};
+
+    for (uint32_t slot = 0; slot < cache->capacity; ++slot)
+    {
+        uint32_t state = slot_state(cache, slot);
+        if (AGFX_PIPELINE_COMPILE_PENDING == state)
+        {
+            stats.pending_count++;
+        } else if (AGFX_PIPELINE_COMPILE_FAILED == state)
+        {
+            stats.failed_count++;
+        } else if (AGFX_PIPELINE_COMPILE_READY == state || AGFX_PIPELINE_COMPILE_OPTIMIZED == state)
+        {
+            stats.ready_count++;
+            stats.total_ms += cache->compile_ms[slot];
+            stats.max_ms = cache->compile_ms[slot] > stats.max_ms ? cache->compile_ms[slot] : stats.max_ms;
+        }
+        if (AGFX_PIPELINE_COMPILE_OPTIMIZED == state)
+        {
+            stats.optimized_count++;
+            stats.optimize_total_ms += cache->optimize_ms[slot];
+        }
+    }
+
+    *out_stats = stats;
+}
\ No newline at end of file
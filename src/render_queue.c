@@ -0,0 +1,232 @@
+#include "render_queue.h"
+
+typedef struct agfx_radix_pass_t {
+    size_t* histograms;
+    const agfx_render_item_t* source;
+    agfx_render_item_t* destination;
+    size_t chunk_size;
+    uint32_t shift;
+} agfx_radix_pass_t;
+
+// positive floats compare the same as their bits, the top ones make the bucket without knowing the depth range
+uint32_t agfx_render_depth_bucket(float view_depth)
+{
+    float depth = view_depth > 0.0f ? view_depth : 0.0f;
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return bits >> (32 - AGFX_RENDER_KEY_DEPTH_BITS);
+}
+
+uint64_t agfx_render_key_opaque(uint32_t pipeline_index, uint32_t material_index, uint32_t depth_bucket)
+{
+    uint64_t pipeline = pipeline_index & ((1u << AGFX_RENDER_KEY_PIPELINE_BITS) - 1);
+    uint64_t material = material_index & ((1u << AGFX_RENDER_KEY_MATERIAL_BITS) - 1);
+    uint64_t depth = depth_bucket & ((1u << AGFX_RENDER_KEY_DEPTH_BITS) - 1);
+
+    return ((uint64_t)AGFX_RENDER_LAYER_OPAQUE << AGFX_RENDER_KEY_LAYER_SHIFT)
+        | (pipeline << (AGFX_RENDER_KEY_MATERIAL_BITS + AGFX_RENDER_KEY_DEPTH_BITS))
+        | (material << AGFX_RENDER_KEY_DEPTH_BITS)
+        | depth;
+}
+
+// blending needs back to front, so depth goes above the state and state changes are whatever the order leaves
+uint64_t agfx_render_key_transparent(uint32_t pipeline_index, uint32_t material_index, uint32_t depth_bucket)
+{
+    uint64_t pipeline = pipeline_index & ((1u << AGFX_RENDER_KEY_PIPELINE_BITS) - 1);
+    uint64_t material = material_index & ((1u << AGFX_RENDER_KEY_MATERIAL_BITS) - 1);
+    uint64_t depth = ~depth_bucket & ((1u << AGFX_RENDER_KEY_DEPTH_BITS) - 1);
+
+    return ((uint64_t)AGFX_RENDER_LAYER_TRANSPARENT << AGFX_RENDER_KEY_LAYER_SHIFT)
+        | (depth << (AGFX_RENDER_KEY_PIPELINE_BITS + AGFX_RENDER_KEY_MATERIAL_BITS))
+        | (pipeline << AGFX_RENDER_KEY_MATERIAL_BITS)
+        | material;
+}
+
+uint32_t agfx_render_key_pipeline(uint64_t key)
+{
+    uint32_t layer = (uint32_t)(key >> AGFX_RENDER_KEY_LAYER_SHIFT);
+    uint32_t shift = AGFX_RENDER_LAYER_TRANSPARENT == layer ? AGFX_RENDER_KEY_MATERIAL_BITS : AGFX_RENDER_KEY_MATERIAL_BITS + AGFX_RENDER_KEY_DEPTH_BITS;
+    return (uint32_t)(key >> shift) & ((1u << AGFX_RENDER_KEY_PIPELINE_BITS) - 1);
+}
+
+agfx_result_t agfx_create_render_queue(size_t capacity, agfx_render_queue_t* out_render_queue)
+{
+    agfx_render_queue_t render_queue = {0};
+
+    render_queue.capacity = capacity > 0 ? capacity : 1;
+    render_queue.items = calloc(render_queue.capacity, sizeof(agfx_render_item_t));
+    render_queue.scratch = calloc(render_queue.capacity, sizeof(agfx_render_item_t));
+    render_queue.histograms = calloc(AGFX_RENDER_QUEUE_MAX_CHUNKS * AGFX_RENDER_QUEUE_RADIX_SIZE, sizeof(size_t));
+    render_queue.batches = calloc(render_queue.capacity, sizeof(agfx_render_batch_t));
+    if (NULL == render_queue.items || NULL == render_queue.scratch || NULL == render_queue.histograms || NULL == render_queue.batches)
+    {
+        agfx_free_render_queue(&render_queue);
+        *out_render_queue = render_queue;
+        return AGFX_BUFFER_ERROR;
+    }
+
+    *out_render_queue = render_queue;
+    return AGFX_SUCCESS;
+}
+
+void agfx_free_render_queue(agfx_render_queue_t* render_queue)
+{
+    free(render_queue->batches);
+    free(render_queue->histograms);
+    free(render_queue->scratch);
+    free(render_queue->items);
+    *render_queue = (agfx_render_queue_t) {0};
+}
+
+void agfx_render_queue_clear(agfx_render_queue_t* render_queue)
+{
+    render_queue->items_count = 0;
+    render_queue->batches_count = 0;
+}
+
+// the queue is sized for every draw in the scene, anything past that is dropped
+void agfx_render_queue_push(agfx_render_queue_t* render_queue, uint64_t key, uint32_t draw_index)
+{
+    if (render_queue->items_count >= render_queue->capacity)
+    {
+        return;
+    }
+
+    render_queue->items[render_queue->items_count++] = (agfx_render_item_t) {
+        .key = key,
+        .draw_index = draw_index
+    };
+}
+
+// a range can span several chunks if the job system ran it inline, every chunk still gets its own histogram
+static void count_digits(void* data, size_t begin, size_t end)
+{
+    agfx_radix_pass_t* pass = (agfx_radix_pass_t*)data;
+
+    for (size_t chunk_begin = begin; chunk_begin < end; chunk_begin += pass->chunk_size)
+    {
+        size_t chunk_end = chunk_begin + pass->chunk_size < end ? chunk_begin + pass->chunk_size : end;
+        size_t* histogram = &pass->histograms[chunk_begin / pass->chunk_size * AGFX_RENDER_QUEUE_RADIX_SIZE];
+        memset(histogram, 0, sizeof(size_t) * AGFX_RENDER_QUEUE_RADIX_SIZE);
+        for (size_t i = chunk_begin; i < chunk_end; ++i)
+        {
+            histogram[(pass->source[i].key >> pass->shift) & (AGFX_RENDER_QUEUE_RADIX_SIZE - 1)]++;
+        }
+    }
+}
+
+// the histograms hold each chunk's first slot per digit by now, so chunks scatter without touching each other
+static void scatter_digits(void* data, size_t begin, size_t end)
+{
+    agfx_radix_pass_t* pass = (agfx_radix_pass_t*)data;
+
+    for (size_t chunk_begin = begin; chunk_begin < end; chunk_begin += pass->chunk_size)
+    {
+        size_t chunk_end = chunk_begin + pass->chunk_size < end ? chunk_begin + pass->chunk_size : end;
+        size_t* offsets = &pass->histograms[chunk_begin / pass->chunk_size * AGFX_RENDER_QUEUE_RADIX_SIZE];
+        for (size_t i = chunk_begin; i < chunk_end; ++i)
+        {
+            pass->destination[offsets[(pass->source[i].key >> pass->shift) & (AGFX_RENDER_QUEUE_RADIX_SIZE - 1)]++] = pass->source[i];
+        }
+    }
+}
+
+// lsd radix sort, a byte at a time. it's stable, so equal keys keep the order they were pushed in
+void agfx_render_queue_sort(agfx_render_queue_t* render_queue, agfx_job_system_t* job_system)
+{
+    uint64_t start = SDL_GetPerformanceCounter();
+    size_t count = render_queue->items_count;
+    render_queue->stats.sort_passes_count = 0;
+
+    size_t chunks_count = count / AGFX_RENDER_QUEUE_MIN_CHUNK;
+    size_t workers_count = NULL != job_system ? job_system->threads_count + 1 : 1;
+    if (chunks_count > workers_count) chunks_count = workers_count;
+    if (chunks_count > AGFX_RENDER_QUEUE_MAX_CHUNKS) chunks_count = AGFX_RENDER_QUEUE_MAX_CHUNKS;
+    if (chunks_count < 1) chunks_count = 1;
+
+    agfx_radix_pass_t pass = {
+        .histograms = render_queue->histograms,
+        .source = render_queue->items,
+        .destination = render_queue->scratch,
+        .chunk_size = count > 0 ? (count + chunks_count - 1) / chunks_count : 1
+    };
+    chunks_count = (count + pass.chunk_size - 1) / pass.chunk_size;
+
+    for (uint32_t shift = 0; shift < 64 && count > 1; shift += AGFX_RENDER_QUEUE_RADIX_BITS)
+    {
+        pass.shift = shift;
+        agfx_job_system_parallel_for(job_system, count, pass.chunk_size, count_digits, &pass);
+
+        // a byte every key shares would only copy the items over
+        size_t offset = 0;
+        uint32_t shared_digit = 0;
+        for (uint32_t digit = 0; digit < AGFX_RENDER_QUEUE_RADIX_SIZE && !shared_digit; ++digit)
+        {
+            size_t digit_count = 0;
+            for (size_t chunk = 0; chunk < chunks_count; ++chunk)
+            {
+                digit_count += pass.histograms[chunk * AGFX_RENDER_QUEUE_RADIX_SIZE + digit];
+            }
+            shared_digit = digit_count == count;
+        }
+        if (shared_digit)
+        {
+            continue;
+        }
+
+        for (uint32_t digit = 0; digit < AGFX_RENDER_QUEUE_RADIX_SIZE; ++digit)
+        {
+            for (size_t chunk = 0; chunk < chunks_count; ++chunk)
+            {
+                size_t* histogram_entry = &pass.histograms[chunk * AGFX_RENDER_QUEUE_RADIX_SIZE + digit];
+                size_t digit_count = *histogram_entry;
+                *histogram_entry = offset;
+                offset += digit_count;
+            }
+        }
+
+        agfx_job_system_parallel_for(job_system, count, pass.chunk_size, scatter_digits, &pass);
+
+        agfx_render_item_t* sorted = pass.destination;
+        pass.destination = (agfx_render_item_t*)pass.source;
+        pass.source = sorted;
+        render_queue->stats.sort_passes_count++;
+    }
+
+    // an odd number of passes leaves the result in scratch, swapping is cheaper than copying it back
+    if (pass.source != render_queue->items)
+    {
+        render_queue->scratch = render_queue->items;
+        render_queue->items = (agfx_render_item_t*)pass.source;
+    }
+
+    render_queue->stats.sort_ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+// splits the sorted draws into runs that share a pipeline. materials are bindless and geometry lives in one buffer,
+// so a pipeline change is the only bind between draws
+void agfx_render_queue_encode(agfx_render_queue_t* render_queue)
+{
+    render_queue->batches_count = 0;
+
+    for (size_t i = 0; i < render_queue->items_count; ++i)
+    {
+        uint32_t pipeline_index = agfx_render_key_pipeline(render_queue->items[i].key);
+        if (0 == render_queue->batches_count || render_queue->batches[render_queue->batches_count - 1].pipeline_index != pipeline_index)
+        {
+            render_queue->batches[render_queue->batches_count++] = (agfx_render_batch_t) {
+                .pipeline_index = pipeline_index,
+                .first_draw = (uint32_t)i,
+                .draws_count = 0
+            };
+        }
+        render_queue->batches[render_queue->batches_count - 1].draws_count++;
+    }
+
+    agfx_render_queue_stats_t* stats = &render_queue->stats;
+    stats->draws_count = (uint32_t)render_queue->items_count;
+    stats->batches_count = (uint32_t)render_queue->batches_count;
+    stats->binds_count = render_queue->batches_count > 0 ? (uint32_t)render_queue->batches_count + AGFX_RENDER_QUEUE_SHARED_BINDS : 0;
+    uint32_t naive_binds_count = stats->draws_count * AGFX_RENDER_QUEUE_NAIVE_BINDS_PER_DRAW;
+    stats->binds_saved_count = naive_binds_count > stats->binds_count ? naive_binds_count - stats->binds_count : 0;
+}
\ No newline at end of file
@@ -2,17 +2,21 @@
 
 #include "math/martix.h"
 
-agfx_result_t create_render_pass(agfx_renderer_t *renderer)
+#include <math.h>
+
+// the frame is drawn in two passes so the depth pyramid can be built in between (see gpu_culling.c).
+// the early pass clears and leaves depth readable by compute, the late pass loads both attachments and presents
+agfx_result_t create_scene_render_pass(agfx_renderer_t *renderer, uint32_t is_late_pass, VkRenderPass* render_pass)
 {
     VkAttachmentDescription swapchain_attachment_description = {
         .format = renderer->swapchain->swapchain_format,
         .samples = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .loadOp = is_late_pass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR,
         .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+        .initialLayout = is_late_pass ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+        .finalLayout = is_late_pass ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
     };
 
     VkAttachmentReference swapchain_attachment_description_ref = {
@@ -23,12 +27,12 @@ agfx_result_t create_render_pass(agfx_renderer_t *renderer)
     VkAttachmentDescription depth_attachment_description = {
         .format = VK_FORMAT_D32_SFLOAT,
         .samples = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .loadOp = is_late_pass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = is_late_pass ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE,
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+        .initialLayout = is_late_pass ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+        .finalLayout = is_late_pass ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
     };
 
     VkAttachmentReference depth_attachment_description_ref = {
@@ -43,13 +47,24 @@ agfx_result_t create_render_pass(agfx_renderer_t *renderer)
         .pDepthStencilAttachment = &depth_attachment_description_ref
     };
 
-    VkSubpassDependency subpass_dependency = {
-        .srcSubpass = VK_SUBPASS_EXTERNAL,
-        .dstSubpass = 0,
-        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-        .srcAccessMask = 0,
-        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+    // compute reads the depth buffer between the passes, so it shows up on both sides of both passes
+    VkSubpassDependency subpass_dependencies[AGFX_SUBPASS_DEPENDENCY_COUNT] = {
+        {
+            .srcSubpass = VK_SUBPASS_EXTERNAL,
+            .dstSubpass = 0,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        },
+        {
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        }
     };
 
     VkAttachmentDescription attachment_descriptions[AGFX_ATTACHMENT_ARRAY_SIZE] = {
@@ -63,11 +78,11 @@ agfx_result_t create_render_pass(agfx_renderer_t *renderer)
         .pAttachments = attachment_descriptions,
         .subpassCount = 1,
         .pSubpasses = &subpass_description,
-        .dependencyCount = 1,
-        .pDependencies = &subpass_dependency
+        .dependencyCount = AGFX_SUBPASS_DEPENDENCY_COUNT,
+        .pDependencies = subpass_dependencies
     };
 
-    if (VK_SUCCESS != vkCreateRenderPass(renderer->context->device, &render_pass_create_info, NULL, &renderer->render_pass))
+    if (VK_SUCCESS != vkCreateRenderPass(renderer->context->device, &render_pass_create_info, NULL, render_pass))
     {
         return AGFX_RENDER_PASS_ERROR;
     }
@@ -75,6 +90,20 @@ agfx_result_t create_render_pass(agfx_renderer_t *renderer)
     return AGFX_SUCCESS;
 }
 
+agfx_result_t create_render_pass(agfx_renderer_t *renderer)
+{
+    agfx_result_t result = create_scene_render_pass(renderer, 0, &renderer->render_pass);
+    if (AGFX_SUCCESS != result) return result;
+
+    result = create_scene_render_pass(renderer, 1, &renderer->late_render_pass);
+    if (AGFX_SUCCESS != result)
+    {
+        vkDestroyRenderPass(renderer->context->device, renderer->render_pass, NULL);
+    }
+
+    return result;
+}
+
 agfx_result_t create_command_pool(agfx_renderer_t *renderer)
 {
     VkCommandPoolCreateInfo command_pool_create_info = {
@@ -91,40 +120,121 @@ agfx_result_t create_command_pool(agfx_renderer_t *renderer)
     return AGFX_SUCCESS;
 }
 
+// per frame pools with a primary each, plus a pool per worker that records secondaries
 agfx_result_t create_command_buffers(agfx_renderer_t *renderer)
 {
-    VkCommandBufferAllocateInfo command_buffer_allocate_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = renderer->command_pool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = AGFX_MAX_FRAMES_IN_FLIGHT,
+    uint32_t workers_count = NULL != renderer->job_system ? renderer->job_system->threads_count + 1 : 1;
+    renderer->commands_generation = 1;
+    renderer->commands_depth_generation = renderer->swapchain->depth_generation;
+    renderer->commands_pipelines_completed = (uint32_t)SDL_AtomicGet(&renderer->pipeline_states->completed);
+    return agfx_create_command_recorder(renderer->context, AGFX_MAX_FRAMES_IN_FLIGHT, workers_count, &renderer->command_recorder);
+}
+
+// everything a scene draw needs bound but the pipeline, secondaries inherit none of it from the primary
+void bind_scene_state(agfx_renderer_t *renderer, VkCommandBuffer command_buffer)
+{
+    VkViewport viewport = {
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = (float)renderer->swapchain->swapchain_extent.width,
+        .height = (float)renderer->swapchain->swapchain_extent.height,
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f
+    };
+
+    uint32_t viewport_count = 1;
+    
+    VkRect2D scissor = {
+        .extent = renderer->swapchain->swapchain_extent,
+        .offset = {0, 0}
     };
 
-    renderer->command_buffers = (VkCommandBuffer*)malloc(sizeof(VkCommandBuffer) * AGFX_MAX_FRAMES_IN_FLIGHT);
+    uint32_t scissor_count = 1;
+
+    vkCmdSetViewportWithCount(command_buffer, viewport_count, &viewport);
+    vkCmdSetScissorWithCount(command_buffer, scissor_count, &scissor);
+    VkBuffer vertex_buffers[AGFX_VERTEX_INPUT_BINDING_DESCRIPTION_SIZE] = {renderer->geometry_buffer.position_buffer, renderer->geometry_buffer.attribute_buffer};
+    VkDeviceSize vertex_buffer_offsets[AGFX_VERTEX_INPUT_BINDING_DESCRIPTION_SIZE] = {0, 0};
+    vkCmdBindVertexBuffers(command_buffer, 0, AGFX_VERTEX_INPUT_BINDING_DESCRIPTION_SIZE, vertex_buffers, vertex_buffer_offsets);
+    vkCmdBindIndexBuffer(command_buffer, renderer->geometry_buffer.index_buffer, 0, VK_INDEX_TYPE_UINT32);
+    agfx_frame_t* frame = &renderer->frames[renderer->state->current_frame];
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipeline_layout, 0, 1, &frame->descriptor_set, 1, &frame->constants_offset);
+    // materials and textures are bindless, one set for the whole frame
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipeline_layout, 1, 1, &renderer->material_descriptor_set, 0, NULL);
+}
 
-    if (VK_SUCCESS != vkAllocateCommandBuffers(renderer->context->device, &command_buffer_allocate_info, renderer->command_buffers))
+// the pipeline index in render keys is a material's pipeline key. after a depth prepass opaque draws only pass where their
+// depth equals what the prepass left and write none of their own
+VkPipeline scene_pipeline(agfx_renderer_t *renderer, uint32_t pipeline_index)
+{
+    if (renderer->state->depth_prepass && agfx_pipeline_key_is_opaque(pipeline_index))
     {
-        free(renderer->command_buffers);
-        return AGFX_COMMAND_BUFFERS_ERROR;
+        pipeline_index = (pipeline_index & ~AGFX_PIPELINE_DEPTH_MASK) | AGFX_PIPELINE_DEPTH_EQUAL;
     }
+    return agfx_pipeline_state_cache_resolve(renderer->pipeline_states, pipeline_index);
+}
 
-    return AGFX_SUCCESS;
+// masked and blended surfaces stay out of the prepass, null for them
+VkPipeline depth_prepass_pipeline(agfx_renderer_t *renderer, uint32_t pipeline_index)
+{
+    if (!agfx_pipeline_key_is_opaque(pipeline_index)) return VK_NULL_HANDLE;
+    return agfx_pipeline_state_cache_resolve(renderer->pipeline_states, (pipeline_index & AGFX_PIPELINE_DOUBLE_SIDED) | AGFX_PIPELINE_DEPTH_PREPASS);
 }
 
-agfx_result_t agfx_record_command_buffers(agfx_renderer_t *renderer, uint32_t image_index)
+typedef struct agfx_scene_draws_t {
+    agfx_renderer_t* renderer;
+    VkBuffer draw_buffer;
+    VkDeviceSize draw_buffer_offset;
+    size_t draws_capacity;
+    const agfx_render_batch_t* batches;
+    size_t batches_count;
+    // the batches before this one are ranges the gpu compacted, each goes out whole with its count
+    size_t compacted_batches_count;
+    uint32_t depth_only;
+} agfx_scene_draws_t;
+
+// the pipeline is only rebound where a batch needs a different one. depth only draws skip the batches that have no
+// prepass pipeline. compacted ranges only exist with draw indirect count, which never spreads a pass over workers
+static void record_scene_draws(VkCommandBuffer command_buffer, void* data, size_t begin, size_t end)
 {
-    VkCommandBufferInheritanceInfo command_buffer_inheritance_info = {};
-    VkCommandBufferBeginInfo command_buffer_begin_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .pInheritanceInfo = &command_buffer_inheritance_info,
-        .flags = 0,
-    };
+    agfx_scene_draws_t* scene_draws = (agfx_scene_draws_t*)data;
+    agfx_renderer_t* renderer = scene_draws->renderer;
 
-    if (VK_SUCCESS != vkBeginCommandBuffer(renderer->command_buffers[renderer->state->current_frame], &command_buffer_begin_info))
+    bind_scene_state(renderer, command_buffer);
+    VkPipeline bound_pipeline = VK_NULL_HANDLE;
+    for (size_t batch_index = 0; batch_index < scene_draws->batches_count; ++batch_index)
     {
-        return AGFX_COMMAND_BUFFERS_ERROR;
+        const agfx_render_batch_t* batch = &scene_draws->batches[batch_index];
+        size_t batch_begin = batch->first_draw > begin ? batch->first_draw : begin;
+        size_t batch_end = batch->first_draw + batch->draws_count < end ? batch->first_draw + batch->draws_count : end;
+        if (batch_begin >= batch_end)
+        {
+            continue;
+        }
+
+        VkPipeline pipeline = scene_draws->depth_only ? depth_prepass_pipeline(renderer, batch->pipeline_index) : scene_pipeline(renderer, batch->pipeline_index);
+        if (VK_NULL_HANDLE == pipeline)
+        {
+            continue;
+        }
+
+        if (pipeline != bound_pipeline)
+        {
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            bound_pipeline = pipeline;
+        }
+        if (batch_index < scene_draws->compacted_batches_count)
+        {
+            agfx_cmd_draw_list(renderer->context, command_buffer, scene_draws->draw_buffer, scene_draws->draw_buffer_offset, scene_draws->draws_capacity, (uint32_t)batch_index, batch->first_draw, batch->draws_count);
+        } else
+        {
+            agfx_cmd_draw_list_range(renderer->context, command_buffer, scene_draws->draw_buffer, scene_draws->draw_buffer_offset, (uint32_t)batch_begin, (uint32_t)(batch_end - batch_begin));
+        }
     }
+}
 
+void begin_scene_pass(agfx_renderer_t *renderer, VkCommandBuffer command_buffer, VkRenderPass render_pass, uint32_t image_index, VkSubpassContents contents)
+{
     VkRect2D render_area = {
         .offset = {},
         .extent = renderer->swapchain->swapchain_extent,
@@ -147,246 +257,296 @@ agfx_result_t agfx_record_command_buffers(agfx_renderer_t *renderer, uint32_t im
 
     VkRenderPassBeginInfo render_pass_begin_info = {
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .renderPass = renderer->render_pass,
+        .renderPass = render_pass,
         .framebuffer = renderer->swapchain->framebuffers[image_index],
         .renderArea = render_area,
         .clearValueCount = AGFX_ATTACHMENT_ARRAY_SIZE,
         .pClearValues = clear_values
     };
 
-    vkCmdBeginRenderPass(renderer->command_buffers[renderer->state->current_frame], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, contents);
+}
 
-    VkViewport viewport = {
-        .x = 0.0f,
-        .y = 0.0f,
-        .width = (float)renderer->swapchain->swapchain_extent.width,
-        .height = (float)renderer->swapchain->swapchain_extent.height,
-        .minDepth = 0.0f,
-        .maxDepth = 1.0f
-    };
+// one pass over the scene, a null draw buffer only runs the pass for its load/store and layout changes.
+// the draw buffer holds the batches' draws in order: a render queue's, or the list's ranges followed by its blended runs.
+// the ranges the gpu culled are compacted when the device has draw indirect count, their counts follow the records.
+// a depth prepass draws the same batches with positions only first, in the same subpass so no barrier is needed between them
+agfx_result_t record_scene_pass(agfx_renderer_t *renderer, VkCommandBuffer command_buffer, VkRenderPass render_pass, uint32_t image_index, VkBuffer draw_buffer, VkDeviceSize draw_buffer_offset, size_t draws_capacity, uint32_t draws_count, const agfx_render_batch_t* batches, size_t batches_count, uint32_t gpu_culled)
+{
+    if (VK_NULL_HANDLE == draw_buffer)
+    {
+        begin_scene_pass(renderer, command_buffer, render_pass, image_index, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdEndRenderPass(command_buffer);
+        return AGFX_SUCCESS;
+    }
 
-    uint32_t viewport_count = 1;
-    
-    VkRect2D scissor = {
-        .extent = renderer->swapchain->swapchain_extent,
-        .offset = {0, 0}
-    };
+    // the gpu driven lists are a handful of ranges, with indirect count or multi draw they stay inline. the cpu render queue's
+    // draws are known here and any slice of them records on its own, so a big queue is spread over workers whatever the device has
+    uint32_t workers_count = 1;
+    uint32_t per_draw_calls = !renderer->context->draw_indirect_count_supported && !renderer->context->multi_draw_indirect_supported;
+    if (renderer->state->parallel_recording && (!gpu_culled || per_draw_calls))
+    {
+        workers_count = agfx_command_recorder_workers_for(&renderer->command_recorder, draws_count);
+    }
 
-    uint32_t scissor_count = 1;
+    agfx_scene_draws_t scene_draws = {
+        .renderer = renderer,
+        .draw_buffer = draw_buffer,
+        .draw_buffer_offset = draw_buffer_offset,
+        .draws_capacity = draws_capacity,
+        .batches = batches,
+        .batches_count = batches_count,
+        .compacted_batches_count = gpu_culled && renderer->context->draw_indirect_count_supported ? AGFX_DRAW_BUCKET_BLEND : 0,
+    };
 
-    vkCmdSetViewportWithCount(renderer->command_buffers[renderer->state->current_frame], viewport_count, &viewport);
-    vkCmdSetScissorWithCount(renderer->command_buffers[renderer->state->current_frame], scissor_count, &scissor);
-    vkCmdBindPipeline(renderer->command_buffers[renderer->state->current_frame], VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipeline);
-    
-    for (size_t i = 0; i < renderer->meshes_count; ++i)
+    if (workers_count > 1)
     {
-        agfx_mesh_t* mesh = &renderer->meshes[i];
-        vkCmdBindDescriptorSets(renderer->command_buffers[renderer->state->current_frame], VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipeline_layout, 0, 1, &mesh->descriptor_sets[renderer->state->current_frame], 0, NULL);
-        vkCmdBindVertexBuffers(renderer->command_buffers[renderer->state->current_frame], 0, 1, &mesh->vertex_buffer, &(VkDeviceSize){0});
-        vkCmdBindIndexBuffer(renderer->command_buffers[renderer->state->current_frame], mesh->index_buffer, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(renderer->command_buffers[renderer->state->current_frame], mesh->indices_count, 1, 0, 0, 0);
+        VkCommandBufferInheritanceInfo command_buffer_inheritance_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+            .renderPass = render_pass,
+            .subpass = 0,
+            .framebuffer = renderer->swapchain->framebuffers[image_index],
+        };
+
+        begin_scene_pass(renderer, command_buffer, render_pass, image_index, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        agfx_result_t result = AGFX_SUCCESS;
+        // each call executes its secondaries before returning, so every prepass draw lands ahead of the shading ones
+        if (renderer->state->depth_prepass)
+        {
+            scene_draws.depth_only = 1;
+            result = agfx_command_recorder_record_parallel(renderer->context, &renderer->command_recorder, renderer->job_system, &command_buffer_inheritance_info, draws_count, record_scene_draws, &scene_draws);
+            scene_draws.depth_only = 0;
+        }
+        if (AGFX_SUCCESS == result)
+        {
+            result = agfx_command_recorder_record_parallel(renderer->context, &renderer->command_recorder, renderer->job_system, &command_buffer_inheritance_info, draws_count, record_scene_draws, &scene_draws);
+        }
+        vkCmdEndRenderPass(command_buffer);
+        return result;
     }
 
+    begin_scene_pass(renderer, command_buffer, render_pass, image_index, VK_SUBPASS_CONTENTS_INLINE);
+    if (renderer->state->depth_prepass)
+    {
+        scene_draws.depth_only = 1;
+        record_scene_draws(command_buffer, &scene_draws, 0, draws_count);
+        scene_draws.depth_only = 0;
+    }
+    record_scene_draws(command_buffer, &scene_draws, 0, draws_count);
 
-    vkCmdEndRenderPass(renderer->command_buffers[renderer->state->current_frame]);
-    vkEndCommandBuffer(renderer->command_buffers[renderer->state->current_frame]);
-    
+    vkCmdEndRenderPass(command_buffer);
     return AGFX_SUCCESS;
 }
 
-agfx_result_t create_pipeline(agfx_renderer_t *renderer)
+// the clusters meshlet_culling.c let through for the phase it last ran, a handful of commands so never spread over workers.
+// blended objects are not split into clusters, the late pass draws them whole and back to front after everything else
+void record_meshlet_pass(agfx_renderer_t *renderer, VkCommandBuffer command_buffer, VkRenderPass render_pass, uint32_t image_index, uint32_t phase)
 {
-    const char* vertex_shader_file_path = "./shaders/vert.spv";
-    struct stat vertex_shader_stat;
-    stat(vertex_shader_file_path, &vertex_shader_stat);
-    char* vertex_shader_data = (char*)malloc(sizeof(char) * vertex_shader_stat.st_size);
-    FILE *vertex_shader_fd = fopen(vertex_shader_file_path, "rb");
-    fread(vertex_shader_data, vertex_shader_stat.st_size, 1, vertex_shader_fd);
-    fclose(vertex_shader_fd);
-
-    VkShaderModuleCreateInfo vert_shader_module_create_info = {
-        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .codeSize = vertex_shader_stat.st_size,
-        .pCode = (uint32_t*)vertex_shader_data
-    };
-
-    VkShaderModule vert_shader_module;
-    if (VK_SUCCESS != vkCreateShaderModule(renderer->context->device, &vert_shader_module_create_info, NULL, &vert_shader_module))
+    begin_scene_pass(renderer, command_buffer, render_pass, image_index, VK_SUBPASS_CONTENTS_INLINE);
+    agfx_cmd_draw_meshlets(renderer, command_buffer);
+    if (AGFX_CULL_PHASE_LATE == phase)
     {
-        free(vertex_shader_data);
-        return AGFX_PIPELINE_ERROR;
+        agfx_frame_t* frame = &renderer->frames[renderer->state->current_frame];
+        agfx_scene_draws_t scene_draws = {
+            .renderer = renderer,
+            .draw_buffer = renderer->gpu_culling.frames[renderer->state->current_frame].late_draw_buffer,
+            .draws_capacity = renderer->draw_list.draws_capacity,
+            .batches = &frame->scene_batches[AGFX_DRAW_BUCKET_BLEND],
+            .batches_count = frame->scene_batches_count - AGFX_DRAW_BUCKET_BLEND,
+        };
+        record_scene_draws(command_buffer, &scene_draws, 0, frame->draws_count);
     }
+    vkCmdEndRenderPass(command_buffer);
+}
 
-    const char* fragment_shader_file_path = "./shaders/frag.spv";
-    struct stat fragment_shader_stat;
-    stat(fragment_shader_file_path, &fragment_shader_stat);
-    char* fragment_shader_data = (char*)malloc(fragment_shader_stat.st_size);
-    FILE *fragment_shader_fd = fopen(fragment_shader_file_path, "rb");
-    fread(fragment_shader_data, fragment_shader_stat.st_size, 1, fragment_shader_fd);
-    fclose(fragment_shader_fd);
-
-    VkShaderModuleCreateInfo frag_shader_module_create_info = {
-        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .codeSize = fragment_shader_stat.st_size,
-        .pCode = (uint32_t*)fragment_shader_data
+// the last pass left the image ready to present, it goes back to that once it is copied out
+static void cmd_capture_swapchain_image(agfx_renderer_t *renderer, VkCommandBuffer command_buffer, uint32_t image_index)
+{
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = renderer->swapchain->swapchain_images[image_index],
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    };
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+    VkBufferImageCopy region = {
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        },
+        .imageExtent = {renderer->swapchain->swapchain_extent.width, renderer->swapchain->swapchain_extent.height, 1}
     };
+    vkCmdCopyImageToBuffer(command_buffer, barrier.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, renderer->capture_buffer, 1, &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+// anything recorded into a command buffer changed, cached ones are rerecorded the next time their frame slot comes up
+void agfx_invalidate_commands(agfx_renderer_t *renderer)
+{
+    renderer->commands_generation++;
+}
+
+// expects agfx_command_recorder_begin_frame to have reset this frame's pools
+agfx_result_t agfx_record_command_buffers(agfx_renderer_t *renderer, uint32_t image_index)
+{
+    agfx_result_t result = AGFX_SUCCESS;
+    uint64_t record_start = SDL_GetPerformanceCounter();
+    agfx_command_recorder_t* command_recorder = &renderer->command_recorder;
+    agfx_frame_t* frame = &renderer->frames[renderer->state->current_frame];
+    agfx_cull_frame_t* cull_frame = &renderer->gpu_culling.frames[renderer->state->current_frame];
 
-    VkShaderModule frag_shader_module;
-    if (VK_SUCCESS != vkCreateShaderModule(renderer->context->device, &frag_shader_module_create_info, NULL, &frag_shader_module))
+    // framebuffers, extent and the depth pyramid all come with a new depth image
+    if (renderer->commands_depth_generation != renderer->swapchain->depth_generation)
     {
-        free(vertex_shader_data);
-        free(fragment_shader_data);
-        return AGFX_PIPELINE_ERROR;
+        renderer->commands_depth_generation = renderer->swapchain->depth_generation;
+        agfx_invalidate_commands(renderer);
     }
 
-    free(vertex_shader_data);
-    free(fragment_shader_data);
+    // a pipeline finished compiling, commands recorded with its fallback or without its draws are rerecorded
+    uint32_t pipelines_completed = (uint32_t)SDL_AtomicGet(&renderer->pipeline_states->completed);
+    if (renderer->commands_pipelines_completed != pipelines_completed)
+    {
+        renderer->commands_pipelines_completed = pipelines_completed;
+        agfx_invalidate_commands(renderer);
+    }
 
-    VkPipelineShaderStageCreateInfo vert_shader_stage_create_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .stage = VK_SHADER_STAGE_VERTEX_BIT,
-        .module = vert_shader_module,
-        .pName = "main",
-    };
+    // the gpu driven and the full list paths only read per frame data through buffers, the cpu culled list is repacked every frame
+    uint32_t cacheable = renderer->state->cached_recording && (renderer->state->gpu_culling || VK_NULL_HANDLE == frame->cpu_draw_buffer);
+    if (cacheable)
+    {
+        uint32_t valid = 0;
+        result = agfx_command_recorder_use_cached(renderer->context, command_recorder, image_index, renderer->commands_generation, &valid);
+        if (AGFX_SUCCESS != result) return result;
 
-    VkPipelineShaderStageCreateInfo frag_shader_stage_create_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-        .module = frag_shader_module,
-        .pName = "main",
-    };
+        if (valid)
+        {
+            command_recorder->record_ms = (double)(SDL_GetPerformanceCounter() - record_start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+            return AGFX_SUCCESS;
+        }
+    }
 
-    VkPipelineShaderStageCreateInfo stages[] = {
-        vert_shader_stage_create_info,
-        frag_shader_stage_create_info
+    VkCommandBuffer command_buffer = agfx_command_recorder_primary(command_recorder);
+    VkCommandBufferBeginInfo command_buffer_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = cacheable ? 0 : VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
     };
 
-    VkPipelineVertexInputStateCreateInfo vertex_input_state_create_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .vertexBindingDescriptionCount = 1,
-        .pVertexBindingDescriptions = &agfx_vertex_input_binding_description,
-        .vertexAttributeDescriptionCount = AGFX_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_SIZE,
-        .pVertexAttributeDescriptions = agfx_vertex_input_attribute_description
-    };
+    if (VK_SUCCESS != vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info))
+    {
+        return AGFX_COMMAND_BUFFERS_ERROR;
+    }
 
-    VkPipelineInputAssemblyStateCreateInfo input_assembly_state_create_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-        .primitiveRestartEnable = VK_FALSE
-    };
+    agfx_cmd_gpu_timer_begin(renderer, command_buffer, image_index);
 
-    VkPipelineRasterizationStateCreateInfo rasterization_state_create_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-        .depthClampEnable = VK_FALSE,
-        .rasterizerDiscardEnable = VK_FALSE,
-        .polygonMode = VK_POLYGON_MODE_FILL, // FUN
-        .lineWidth = 1.0f,
-        .cullMode = VK_CULL_MODE_NONE,
-        .frontFace = VK_FRONT_FACE_CLOCKWISE,
-        .depthBiasEnable = VK_FALSE
-    };
+    if (agfx_visibility_buffer_enabled(renderer))
+    {
+        // the meshlet path's phases with ids in place of shading, every pixel is shaded once after the late pass
+        agfx_cmd_gpu_cull(renderer, command_buffer, AGFX_CULL_PHASE_EARLY);
+        agfx_cmd_meshlet_cull(renderer, command_buffer, AGFX_CULL_PHASE_EARLY);
+        agfx_cmd_visibility_geometry_pass(renderer, command_buffer, AGFX_CULL_PHASE_EARLY);
+        agfx_cmd_build_depth_pyramid(renderer, command_buffer);
+        agfx_cmd_gpu_cull(renderer, command_buffer, AGFX_CULL_PHASE_LATE);
+        agfx_cmd_meshlet_cull(renderer, command_buffer, AGFX_CULL_PHASE_LATE);
+        agfx_cmd_visibility_geometry_pass(renderer, command_buffer, AGFX_CULL_PHASE_LATE);
+        agfx_cmd_visibility_shade_pass(renderer, command_buffer, image_index);
+    } else if (agfx_meshlet_culling_enabled(renderer))
+    {
+        // the same two phases, each phase's objects are split into clusters and culled again one by one
+        agfx_cmd_gpu_cull(renderer, command_buffer, AGFX_CULL_PHASE_EARLY);
+        agfx_cmd_meshlet_cull(renderer, command_buffer, AGFX_CULL_PHASE_EARLY);
+        record_meshlet_pass(renderer, command_buffer, renderer->render_pass, image_index, AGFX_CULL_PHASE_EARLY);
+        agfx_cmd_build_depth_pyramid(renderer, command_buffer);
+        agfx_cmd_gpu_cull(renderer, command_buffer, AGFX_CULL_PHASE_LATE);
+        agfx_cmd_meshlet_cull(renderer, command_buffer, AGFX_CULL_PHASE_LATE);
+        record_meshlet_pass(renderer, command_buffer, renderer->late_render_pass, image_index, AGFX_CULL_PHASE_LATE);
+    } else if (renderer->state->gpu_culling)
+    {
+        // two phase occlusion: last frame's visible set fills depth, the pyramid is built from it
+        // and everything is tested against it, the late pass draws what the early one missed.
+        // blended draws are only culled in the late phase and go last, back to front
+        agfx_cmd_gpu_cull(renderer, command_buffer, AGFX_CULL_PHASE_EARLY);
+        result = record_scene_pass(renderer, command_buffer, renderer->render_pass, image_index, cull_frame->early_draw_buffer, 0, renderer->draw_list.draws_capacity, frame->draws_count, frame->scene_batches, AGFX_DRAW_BUCKET_BLEND, 1);
+        agfx_cmd_build_depth_pyramid(renderer, command_buffer);
+        agfx_cmd_gpu_cull(renderer, command_buffer, AGFX_CULL_PHASE_LATE);
+        if (AGFX_SUCCESS == result) result = record_scene_pass(renderer, command_buffer, renderer->late_render_pass, image_index, cull_frame->late_draw_buffer, 0, renderer->draw_list.draws_capacity, frame->draws_count, frame->scene_batches, frame->scene_batches_count, 1);
+    } else if (VK_NULL_HANDLE != frame->cpu_draw_buffer)
+    {
+        // only the draws that survived the cpu frustum test, packed into the frame arena
+        result = record_scene_pass(renderer, command_buffer, renderer->render_pass, image_index, frame->cpu_draw_buffer, frame->cpu_draw_offset, frame->cpu_draws_count, frame->cpu_draws_count, renderer->render_queue.batches, renderer->render_queue.batches_count, 0);
+        record_scene_pass(renderer, command_buffer, renderer->late_render_pass, image_index, VK_NULL_HANDLE, 0, 0, 0, NULL, 0, 0);
+    } else
+    {
+        result = record_scene_pass(renderer, command_buffer, renderer->render_pass, image_index, frame->draw_buffer, 0, renderer->draw_list.draws_capacity, frame->draws_count, frame->scene_batches, frame->scene_batches_count, 0);
+        record_scene_pass(renderer, command_buffer, renderer->late_render_pass, image_index, VK_NULL_HANDLE, 0, 0, 0, NULL, 0, 0);
+    }
 
-    VkPipelineMultisampleStateCreateInfo multisample_state_create_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-        .sampleShadingEnable = VK_FALSE,
-        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
-    };
+    if (VK_NULL_HANDLE != renderer->capture_buffer)
+    {
+        cmd_capture_swapchain_image(renderer, command_buffer, image_index);
+    }
+    agfx_cmd_gpu_timer_end(renderer, command_buffer, image_index);
 
-    VkPipelineColorBlendAttachmentState color_blend_attachment_state = {
-        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
-        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
-        .colorBlendOp = VK_BLEND_OP_ADD,
-        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
-        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-        .alphaBlendOp = VK_BLEND_OP_ADD,
-        .blendEnable = VK_TRUE, 
-    };
+    if (VK_SUCCESS != vkEndCommandBuffer(command_buffer) && AGFX_SUCCESS == result)
+    {
+        result = AGFX_COMMAND_BUFFERS_ERROR;
+    }
 
-    VkPipelineColorBlendStateCreateInfo color_blend_state_create_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-        .attachmentCount = 1,
-        .pAttachments = &color_blend_attachment_state,
-        .logicOpEnable = VK_FALSE,
-        .logicOp = VK_LOGIC_OP_COPY,
-        .blendConstants = {0.0f, 0.0f, 0.0f, 0.0f}
-    };
+    if (cacheable && AGFX_SUCCESS == result)
+    {
+        agfx_command_recorder_mark_cached(command_recorder, image_index, renderer->commands_generation);
+    }
+    command_recorder->recorded_frames++;
+    command_recorder->record_ms = (double)(SDL_GetPerformanceCounter() - record_start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    
+    return result;
+}
 
-    VkPipelineViewportStateCreateInfo viewport_state_create_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-        .pNext = NULL,
-        .viewportCount = 0,
-        .pViewports = NULL,
-        .scissorCount = 0, 
-        .pScissors = NULL,
+// the layout every scene pipeline shares. the pipelines themselves come out of the state cache once the materials say which
+// ones are needed
+agfx_result_t create_pipeline(agfx_renderer_t *renderer)
+{
+    VkDescriptorSetLayout set_layouts[] = {
+        renderer->descriptor_set_layout,
+        renderer->material_descriptor_set_layout
     };
 
     VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .setLayoutCount = 1,
-        .pSetLayouts = &renderer->descriptor_set_layout
+        .setLayoutCount = 2,
+        .pSetLayouts = set_layouts
     };
 
     if (VK_SUCCESS != vkCreatePipelineLayout(renderer->context->device, &pipeline_layout_create_info, NULL, &renderer->pipeline_layout))
     {
-        vkDestroyShaderModule(renderer->context->device, vert_shader_module, NULL);
-        vkDestroyShaderModule(renderer->context->device, frag_shader_module, NULL);
-        free(vertex_shader_data);
-        free(fragment_shader_data);
         return AGFX_PIPELINE_ERROR;
     }
 
-    #define AGFX_DYNAMIC_STATE_COUNT 2 
-    VkDynamicState dynamic_state[AGFX_DYNAMIC_STATE_COUNT] = {
-        VK_DYNAMIC_STATE_VIEWPORT_WITH_COUNT,
-        VK_DYNAMIC_STATE_SCISSOR_WITH_COUNT
-    };
-
-    VkPipelineDynamicStateCreateInfo pipeline_dynamic_create_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-        .dynamicStateCount = AGFX_DYNAMIC_STATE_COUNT,
-        .pDynamicStates = dynamic_state,
-    };
-
-    VkPipelineDepthStencilStateCreateInfo depth_stencil_state_create_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
-        .depthTestEnable = VK_TRUE,
-        .depthWriteEnable = VK_TRUE,
-        .depthCompareOp = VK_COMPARE_OP_LESS,
-        .depthBoundsTestEnable = VK_FALSE,
-        .stencilTestEnable = VK_FALSE,
-    };
-
-    VkGraphicsPipelineCreateInfo pipeline_create_info = {
-        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .stageCount = 2,
-        .pStages = stages,
-        .pVertexInputState = &vertex_input_state_create_info,
-        .pInputAssemblyState = &input_assembly_state_create_info,
-        .pRasterizationState = &rasterization_state_create_info,
-        .pMultisampleState = &multisample_state_create_info,
-        .pColorBlendState = &color_blend_state_create_info,
-        .layout = renderer->pipeline_layout,
-        .renderPass = renderer->render_pass,
-        .subpass = 0,
-        .pDynamicState = &pipeline_dynamic_create_info,
-        .pViewportState = &viewport_state_create_info,
-        .pDepthStencilState = &depth_stencil_state_create_info,
-    };
-
-    if (VK_SUCCESS != vkCreateGraphicsPipelines(renderer->context->device, 0, 1, &pipeline_create_info, NULL, &renderer->pipeline))
+    agfx_result_t result = agfx_create_pipeline_state_cache(renderer);
+    if (AGFX_SUCCESS != result)
     {
-        vkDestroyShaderModule(renderer->context->device, vert_shader_module, NULL);
-        vkDestroyShaderModule(renderer->context->device, frag_shader_module, NULL);
-        free(vertex_shader_data);
-        free(fragment_shader_data);
-        return AGFX_PIPELINE_ERROR;
+        vkDestroyPipelineLayout(renderer->context->device, renderer->pipeline_layout, NULL);
     }
 
-    vkDestroyShaderModule(renderer->context->device, vert_shader_module, NULL);
-    vkDestroyShaderModule(renderer->context->device, frag_shader_module, NULL);
-
-    return AGFX_SUCCESS;
+    return result;
 }
 
 agfx_result_t create_sync_objects(agfx_renderer_t *renderer)
@@ -425,120 +585,265 @@ agfx_result_t create_sync_objects(agfx_renderer_t *renderer)
     return AGFX_SUCCESS;
 }
 
-agfx_result_t create_vertex_buffer_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh)
+// all static geometry lives in one vertex and one index buffer, meshes only remember where their range starts.
+// a mesh's coarser levels follow its own indices and are moved to where they ended up
+agfx_result_t create_geometry_buffer(agfx_renderer_t *renderer)
 {
-    agfx_result_t result;
-    size_t vertex_buffer_size = sizeof(mesh->vertices[0]) * mesh->vertices_count;
+    agfx_result_t result = AGFX_SUCCESS;
+    agfx_geometry_buffer_t* geometry_buffer = &renderer->geometry_buffer;
 
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
+    geometry_buffer->vertices_count = 0;
+    geometry_buffer->indices_count = 0;
 
-    result = agfx_helper_create_buffer(renderer->context, vertex_buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging_buffer, &staging_buffer_memory);
-    if (AGFX_SUCCESS != result)
+    for (size_t mesh_index = 0; mesh_index < renderer->meshes_count; ++mesh_index)
     {
-        return result;
+        agfx_mesh_t* mesh = &renderer->meshes[mesh_index];
+        mesh->vertex_offset = (int32_t)geometry_buffer->vertices_count;
+        mesh->first_index = (uint32_t)geometry_buffer->indices_count;
+        geometry_buffer->vertices_count += mesh->vertices_count;
+        geometry_buffer->indices_count += mesh->indices_count;
+
+        uint32_t lod_first_index = (uint32_t)geometry_buffer->indices_count;
+        // the rest of the full level, its error and meshlet range, is already set or still zero
+        mesh->lods[0].first_index = mesh->first_index;
+        mesh->lods[0].indices_count = (uint32_t)mesh->indices_count;
+        if (0 == mesh->lods_count) mesh->lods_count = 1;
+        for (uint32_t lod = 1; lod < mesh->lods_count; ++lod)
+        {
+            mesh->lods[lod].first_index += lod_first_index;
+        }
+        geometry_buffer->indices_count += mesh->lod_indices_count;
     }
 
-    void* buffer;
-    if (VK_SUCCESS != vkMapMemory(renderer->context->device, staging_buffer_memory, 0, vertex_buffer_size, 0, &buffer))
+    agfx_vector3_t* positions = malloc(sizeof(agfx_vector3_t) * geometry_buffer->vertices_count);
+    agfx_vertex_attributes_t* attributes = malloc(sizeof(agfx_vertex_attributes_t) * geometry_buffer->vertices_count);
+    uint32_t* indices = malloc(sizeof(uint32_t) * geometry_buffer->indices_count);
+    if (NULL == positions || NULL == attributes || NULL == indices)
     {
-        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
-        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
+        free(positions);
+        free(attributes);
+        free(indices);
         return AGFX_VERTEX_BUFFER_ERROR;
     }
-    memcpy(buffer, mesh->vertices, vertex_buffer_size);
-    vkUnmapMemory(renderer->context->device, staging_buffer_memory);
-
-    result = agfx_helper_create_buffer(renderer->context, vertex_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mesh->vertex_buffer, &mesh->vertex_buffer_memory);
-    if (AGFX_SUCCESS != result)
-    {
-        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
-        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
-        return result;
-    }
 
-    result = agfx_helper_copy_buffer(renderer, staging_buffer, mesh->vertex_buffer, vertex_buffer_size);
-    if (AGFX_SUCCESS != result)
+    for (size_t mesh_index = 0; mesh_index < renderer->meshes_count; ++mesh_index)
     {
-        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
-        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
-        vkFreeMemory(renderer->context->device, mesh->vertex_buffer_memory, NULL);
-        vkDestroyBuffer(renderer->context->device, mesh->vertex_buffer, NULL);
-        return result;
+        agfx_mesh_t* mesh = &renderer->meshes[mesh_index];
+        for (size_t vertex_index = 0; vertex_index < mesh->vertices_count; ++vertex_index)
+        {
+            const agfx_vertex_t* vertex = &mesh->vertices[vertex_index];
+            positions[mesh->vertex_offset + vertex_index] = vertex->position;
+            attributes[mesh->vertex_offset + vertex_index] = (agfx_vertex_attributes_t) {
+                .color = vertex->color,
+                .texture_coordinate = vertex->texture_coordinate
+            };
+        }
+        memcpy(&indices[mesh->first_index], mesh->indices, sizeof(uint32_t) * mesh->indices_count);
+        if (mesh->lod_indices_count > 0)
+        {
+            memcpy(&indices[mesh->first_index + mesh->indices_count], mesh->lod_indices, sizeof(uint32_t) * mesh->lod_indices_count);
+        }
     }
 
-    vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
-    vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
-
-    return AGFX_SUCCESS;
+    // the mesh shader fetches vertices itself. depth only passes read just the tightly packed positions, 12 bytes a
+    // vertex instead of 32
+    result = agfx_helper_upload_buffer(renderer, positions, sizeof(agfx_vector3_t) * geometry_buffer->vertices_count, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &geometry_buffer->position_buffer, &geometry_buffer->position_buffer_memory);
+    if (AGFX_SUCCESS != result) goto free_host_copies;
+
+    result = agfx_helper_upload_buffer(renderer, attributes, sizeof(agfx_vertex_attributes_t) * geometry_buffer->vertices_count, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &geometry_buffer->attribute_buffer, &geometry_buffer->attribute_buffer_memory);
+    if (AGFX_SUCCESS != result) goto free_position_buffer;
+
+    // and the visibility buffer resolve fetches the indices of the triangle a pixel landed on
+    result = agfx_helper_upload_buffer(renderer, indices, sizeof(uint32_t) * geometry_buffer->indices_count, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &geometry_buffer->index_buffer, &geometry_buffer->index_buffer_memory);
+    if (AGFX_SUCCESS == result) goto free_host_copies;
+
+    agfx_helper_free_buffer(renderer->context, geometry_buffer->attribute_buffer, geometry_buffer->attribute_buffer_memory);
+free_position_buffer:
+    agfx_helper_free_buffer(renderer->context, geometry_buffer->position_buffer, geometry_buffer->position_buffer_memory);
+free_host_copies:
+    free(positions);
+    free(attributes);
+    free(indices);
+    return result;
 }
 
-agfx_result_t create_index_buffer_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh)
+// every mesh's meshlets back to back with their offsets made absolute: index ranges into the index buffer, vertices into the
+// vertex buffer and each level's range into the meshlet buffer, with the vertex offset its index range is drawn with.
+// the vertex and triangle lists only feed the mesh shader. runs between the geometry and the lod buffer, so the lod table
+// already holds the absolute meshlet ranges
+agfx_result_t create_meshlet_buffers(agfx_renderer_t *renderer)
 {
-    agfx_result_t result;
-    size_t index_buffer_size = sizeof(mesh->indices[0]) * mesh->indices_count;
+    agfx_result_t result = AGFX_SUCCESS;
+    size_t meshlet_vertices_count = 0;
+    size_t meshlet_triangles_count = 0;
 
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
+    renderer->meshlets_count = 0;
+    for (size_t mesh_index = 0; mesh_index < renderer->meshes_count; ++mesh_index)
+    {
+        renderer->meshlets_count += renderer->meshes[mesh_index].meshlets_count;
+        meshlet_vertices_count += renderer->meshes[mesh_index].meshlet_vertices_count;
+        meshlet_triangles_count += renderer->meshes[mesh_index].meshlet_triangles_count;
+    }
 
-    result = agfx_helper_create_buffer(renderer->context, index_buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging_buffer, &staging_buffer_memory);
-    if (AGFX_SUCCESS != result)
+    // a buffer is bound either way, so an empty table is still one meshlet long
+    agfx_meshlet_t* meshlets = calloc(renderer->meshlets_count > 0 ? renderer->meshlets_count : 1, sizeof(agfx_meshlet_t));
+    uint32_t* meshlet_vertices = malloc(sizeof(uint32_t) * (meshlet_vertices_count > 0 ? meshlet_vertices_count : 1));
+    if (NULL == meshlets || NULL == meshlet_vertices)
     {
-        return result;
+        result = AGFX_BUFFER_ERROR;
+        goto free_host_copies;
     }
 
-    void* buffer;
-    if (VK_SUCCESS != vkMapMemory(renderer->context->device, staging_buffer_memory, 0, index_buffer_size, 0, &buffer))
+    size_t first_meshlet = 0;
+    size_t first_vertex = 0;
+    size_t first_triangle = 0;
+    for (size_t mesh_index = 0; mesh_index < renderer->meshes_count; ++mesh_index)
     {
-        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
-        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
-        return AGFX_INDEX_BUFFER_ERROR;
+        agfx_mesh_t* mesh = &renderer->meshes[mesh_index];
+        if (0 == mesh->meshlets_count) continue;
+
+        for (uint32_t lod = 0; lod < mesh->lods_count; ++lod)
+        {
+            for (uint32_t i = 0; i < mesh->lods[lod].meshlets_count; ++i)
+            {
+                agfx_meshlet_t* meshlet = &meshlets[first_meshlet + mesh->lods[lod].first_meshlet + i];
+                *meshlet = mesh->meshlets[mesh->lods[lod].first_meshlet + i];
+                meshlet->first_index += mesh->lods[lod].first_index;
+                meshlet->vertex_offset = mesh->vertex_offset;
+                meshlet->first_vertex += (uint32_t)first_vertex;
+                meshlet->first_triangle += (uint32_t)first_triangle;
+            }
+            mesh->lods[lod].first_meshlet += (uint32_t)first_meshlet;
+        }
+
+        for (size_t i = 0; i < mesh->meshlet_vertices_count; ++i)
+        {
+            meshlet_vertices[first_vertex + i] = mesh->meshlet_vertices[i] + (uint32_t)mesh->vertex_offset;
+        }
+
+        first_meshlet += mesh->meshlets_count;
+        first_vertex += mesh->meshlet_vertices_count;
+        first_triangle += mesh->meshlet_triangles_count;
     }
-    memcpy(buffer, mesh->indices, index_buffer_size);
-    vkUnmapMemory(renderer->context->device, staging_buffer_memory);
 
-    result = agfx_helper_create_buffer(renderer->context, index_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mesh->index_buffer, &mesh->index_buffer_memory);
-    if (AGFX_SUCCESS != result)
+    result = agfx_helper_upload_buffer(renderer, meshlets, sizeof(agfx_meshlet_t) * (renderer->meshlets_count > 0 ? renderer->meshlets_count : 1), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &renderer->meshlet_buffer, &renderer->meshlet_buffer_memory);
+    if (AGFX_SUCCESS != result || !renderer->context->mesh_shader_supported) goto free_host_copies;
+
+    result = agfx_helper_upload_buffer(renderer, meshlet_vertices, sizeof(uint32_t) * (meshlet_vertices_count > 0 ? meshlet_vertices_count : 1), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &renderer->meshlet_vertex_buffer, &renderer->meshlet_vertex_buffer_memory);
+    if (AGFX_SUCCESS != result) goto free_meshlet_buffer;
+
+    // the packed triangles are already relative to their meshlet's vertices, they only need to go back to back
+    uint32_t* meshlet_triangles = malloc(sizeof(uint32_t) * (meshlet_triangles_count > 0 ? meshlet_triangles_count : 1));
+    if (NULL == meshlet_triangles)
     {
-        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
-        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
-        return result;
+        result = AGFX_BUFFER_ERROR;
+        goto free_meshlet_vertex_buffer;
     }
 
-    result = agfx_helper_copy_buffer(renderer, staging_buffer, mesh->index_buffer, index_buffer_size);
-    if (AGFX_SUCCESS != result)
+    first_triangle = 0;
+    for (size_t mesh_index = 0; mesh_index < renderer->meshes_count; ++mesh_index)
     {
-        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
-        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
-        vkFreeMemory(renderer->context->device, mesh->index_buffer_memory, NULL);
-        vkDestroyBuffer(renderer->context->device, mesh->index_buffer, NULL);
-        return result;
+        agfx_mesh_t* mesh = &renderer->meshes[mesh_index];
+        if (mesh->meshlet_triangles_count > 0)
+        {
+            memcpy(&meshlet_triangles[first_triangle], mesh->meshlet_triangles, sizeof(uint32_t) * mesh->meshlet_triangles_count);
+        }
+        first_triangle += mesh->meshlet_triangles_count;
     }
 
-    vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
-    vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
+    result = agfx_helper_upload_buffer(renderer, meshlet_triangles, sizeof(uint32_t) * (meshlet_triangles_count > 0 ? meshlet_triangles_count : 1), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &renderer->meshlet_triangle_buffer, &renderer->meshlet_triangle_buffer_memory);
+    free(meshlet_triangles);
+    if (AGFX_SUCCESS == result) goto free_host_copies;
+
+free_meshlet_vertex_buffer:
+    agfx_helper_free_buffer(renderer->context, renderer->meshlet_vertex_buffer, renderer->meshlet_vertex_buffer_memory);
+free_meshlet_buffer:
+    agfx_helper_free_buffer(renderer->context, renderer->meshlet_buffer, renderer->meshlet_buffer_memory);
+free_host_copies:
+    free(meshlets);
+    free(meshlet_vertices);
+    return result;
+}
 
-    return AGFX_SUCCESS;
+void free_meshlet_buffers(agfx_renderer_t *renderer)
+{
+    if (renderer->context->mesh_shader_supported)
+    {
+        agfx_helper_free_buffer(renderer->context, renderer->meshlet_triangle_buffer, renderer->meshlet_triangle_buffer_memory);
+        agfx_helper_free_buffer(renderer->context, renderer->meshlet_vertex_buffer, renderer->meshlet_vertex_buffer_memory);
+    }
+    agfx_helper_free_buffer(renderer->context, renderer->meshlet_buffer, renderer->meshlet_buffer_memory);
+    renderer->meshlets_count = 0;
 }
 
-agfx_result_t create_descriptor_set_layout(agfx_renderer_t *renderer)
+// every mesh's levels back to back, a draw record points at its mesh's first one. cull.comp picks from them, and the cpu
+// path reads the same table. a mesh without a chain still has its full level, so the table is never empty
+agfx_result_t create_lod_buffer(agfx_renderer_t *renderer)
 {
-    VkDescriptorSetLayoutBinding bindings[AGFX_DESCRIPTOR_COUNT] = {
-        {
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .descriptorCount = 1,
-            .binding = 0,
-            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
-        },
-        {
-            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount = 1,
-            .binding = 1,
-            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-            .pImmutableSamplers = NULL,
+    renderer->lods_count = 0;
+    for (size_t mesh_index = 0; mesh_index < renderer->meshes_count; ++mesh_index)
+    {
+        renderer->lods_count += renderer->meshes[mesh_index].lods_count > 0 ? renderer->meshes[mesh_index].lods_count : 1;
+    }
+
+    renderer->lods = calloc(renderer->lods_count > 0 ? renderer->lods_count : 1, sizeof(agfx_mesh_lod_t));
+    if (NULL == renderer->lods) return AGFX_BUFFER_ERROR;
+
+    uint32_t first_lod = 0;
+    for (size_t mesh_index = 0; mesh_index < renderer->meshes_count; ++mesh_index)
+    {
+        agfx_mesh_t* mesh = &renderer->meshes[mesh_index];
+        uint32_t lods_count = mesh->lods_count > 0 ? mesh->lods_count : 1;
+        mesh->first_lod = first_lod;
+        memcpy(&renderer->lods[first_lod], mesh->lods, sizeof(agfx_mesh_lod_t) * lods_count);
+        first_lod += lods_count;
+    }
+
+    agfx_result_t result = agfx_helper_upload_buffer(renderer, renderer->lods, sizeof(agfx_mesh_lod_t) * (renderer->lods_count > 0 ? renderer->lods_count : 1), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &renderer->lod_buffer, &renderer->lod_buffer_memory);
+    if (AGFX_SUCCESS != result)
+    {
+        free(renderer->lods);
+        renderer->lods = NULL;
+    }
+
+    return result;
+}
+
+agfx_result_t create_descriptor_set_layout(agfx_renderer_t *renderer)
+{
+    // set 0 is per frame: frame constants, the per-object transforms and the instance to object indirection
+    VkDescriptorSetLayoutBinding bindings[AGFX_DESCRIPTOR_COUNT] = {
+        {
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            .descriptorCount = 1,
+            .binding = 0,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
+        },
+        {
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .binding = 1,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
+        },
+        {
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .binding = 2,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
         }
     };
 
+    // the mesh shader path reads the constants and the objects through the same set
+    if (renderer->context->mesh_shader_supported)
+    {
+        bindings[0].stageFlags |= VK_SHADER_STAGE_MESH_BIT_EXT;
+        bindings[1].stageFlags |= VK_SHADER_STAGE_MESH_BIT_EXT;
+    }
+
+    // so does the visibility buffer's shade pass, per pixel
+    bindings[0].stageFlags |= VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[1].stageFlags |= VK_SHADER_STAGE_FRAGMENT_BIT;
+
     VkDescriptorSetLayoutCreateInfo layout_create_info = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
         .bindingCount = AGFX_DESCRIPTOR_COUNT,
@@ -550,22 +855,74 @@ agfx_result_t create_descriptor_set_layout(agfx_renderer_t *renderer)
         return AGFX_DESCRIPTOR_SET_LAYOUT_ERROR;
     }
 
+    // the texture array is sized once from the device limits, the shader indexes it with the material's texture index
+    VkPhysicalDeviceLimits* limits = &renderer->context->device_properties.limits;
+    renderer->textures_capacity = AGFX_MAX_TEXTURES;
+    if (renderer->textures_capacity > limits->maxPerStageDescriptorSamplers) renderer->textures_capacity = limits->maxPerStageDescriptorSamplers;
+    if (renderer->textures_capacity > limits->maxPerStageDescriptorSampledImages) renderer->textures_capacity = limits->maxPerStageDescriptorSampledImages;
+    if (renderer->textures_capacity > limits->maxDescriptorSetSamplers) renderer->textures_capacity = limits->maxDescriptorSetSamplers;
+    if (renderer->textures_capacity > limits->maxDescriptorSetSampledImages) renderer->textures_capacity = limits->maxDescriptorSetSampledImages;
+
+    // set 1 is global: the material table and every texture
+    VkDescriptorSetLayoutBinding material_bindings[AGFX_MATERIAL_DESCRIPTOR_COUNT] = {
+        {
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .binding = 0,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+        },
+        {
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = renderer->textures_capacity,
+            .binding = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = NULL,
+        }
+    };
+
+    // unused slots of the texture array are never written
+    VkDescriptorBindingFlags material_binding_flags[AGFX_MATERIAL_DESCRIPTOR_COUNT] = {
+        0,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+    };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo material_binding_flags_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount = AGFX_MATERIAL_DESCRIPTOR_COUNT,
+        .pBindingFlags = material_binding_flags
+    };
+
+    VkDescriptorSetLayoutCreateInfo material_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &material_binding_flags_create_info,
+        .bindingCount = AGFX_MATERIAL_DESCRIPTOR_COUNT,
+        .pBindings = material_bindings
+    };
+
+    if (VK_SUCCESS != vkCreateDescriptorSetLayout(renderer->context->device, &material_layout_create_info, NULL, &renderer->material_descriptor_set_layout))
+    {
+        vkDestroyDescriptorSetLayout(renderer->context->device, renderer->descriptor_set_layout, NULL);
+        return AGFX_DESCRIPTOR_SET_LAYOUT_ERROR;
+    }
+
     return AGFX_SUCCESS;
 }
 
 void free_descriptor_set_layout(agfx_renderer_t *renderer) 
 {
+    vkDestroyDescriptorSetLayout(renderer->context->device, renderer->material_descriptor_set_layout, NULL);
     vkDestroyDescriptorSetLayout(renderer->context->device, renderer->descriptor_set_layout, NULL);
 }
 
 void free_pipeline(agfx_renderer_t *renderer) 
 {
-    vkDestroyPipeline(renderer->context->device, renderer->pipeline, NULL);
+    agfx_free_pipeline_state_cache(renderer);
     vkDestroyPipelineLayout(renderer->context->device, renderer->pipeline_layout, NULL);
 }
 
 void free_render_pass(agfx_renderer_t *renderer)
 {
+    vkDestroyRenderPass(renderer->context->device, renderer->late_render_pass, NULL);
     vkDestroyRenderPass(renderer->context->device, renderer->render_pass, NULL);
 }
 
@@ -576,7 +933,7 @@ void free_command_pool(agfx_renderer_t *renderer)
 
 void free_command_buffers(agfx_renderer_t *renderer)
 {
-    vkFreeCommandBuffers(renderer->context->device, renderer->command_pool, AGFX_MAX_FRAMES_IN_FLIGHT, renderer->command_buffers);
+    agfx_free_command_recorder(renderer->context, &renderer->command_recorder);
 }
 
 void free_sync_objects(agfx_renderer_t *renderer)
@@ -589,26 +946,23 @@ void free_sync_objects(agfx_renderer_t *renderer)
     }
 }
 
-void free_vertex_buffer_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh)
-{
-    vkDestroyBuffer(renderer->context->device, mesh->vertex_buffer, NULL);
-    vkFreeMemory(renderer->context->device, mesh->vertex_buffer_memory, NULL);
-}
-
-void free_index_buffer_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh)
+void free_geometry_buffer(agfx_renderer_t *renderer)
 {
-    vkDestroyBuffer(renderer->context->device, mesh->index_buffer, NULL);
-    vkFreeMemory(renderer->context->device, mesh->index_buffer_memory, NULL);
+    agfx_helper_free_buffer(renderer->context, renderer->geometry_buffer.position_buffer, renderer->geometry_buffer.position_buffer_memory);
+    agfx_helper_free_buffer(renderer->context, renderer->geometry_buffer.attribute_buffer, renderer->geometry_buffer.attribute_buffer_memory);
+    agfx_helper_free_buffer(renderer->context, renderer->geometry_buffer.index_buffer, renderer->geometry_buffer.index_buffer_memory);
 }
 
-agfx_result_t agfx_create_renderer(agfx_context_t* context, agfx_swapchain_t* swapchain, agfx_state_t* state, agfx_renderer_t* out_renderer)
+agfx_result_t agfx_create_renderer(agfx_context_t* context, agfx_swapchain_t* swapchain, agfx_state_t* state, agfx_job_system_t* job_system, agfx_renderer_t* out_renderer)
 {
-    agfx_renderer_t renderer;
+    agfx_renderer_t renderer = {0};
     agfx_result_t result;
 
     renderer.context = context;
     renderer.swapchain = swapchain;
     renderer.state = state;
+    renderer.job_system = job_system;
+    renderer.capture_buffer = VK_NULL_HANDLE;
 
     result = create_descriptor_set_layout(&renderer);
     if (AGFX_SUCCESS != result) goto finish;
@@ -625,15 +979,30 @@ agfx_result_t agfx_create_renderer(agfx_context_t* context, agfx_swapchain_t* sw
     result = load_model(&renderer);
     if (AGFX_SUCCESS != result) goto free_command_pool;
 
-    result = create_descriptor_pool(&renderer);
+    result = create_frame_resources(&renderer);
     if (AGFX_SUCCESS != result) goto free_model;
 
+    result = create_descriptor_pool(&renderer);
+    if (AGFX_SUCCESS != result) goto free_frame_resources;
+
     result = create_descriptor_sets(&renderer);
     if (AGFX_SUCCESS != result) goto free_descriptor_pool;
 
-    result = create_command_buffers(&renderer);
+    result = agfx_create_gpu_culling(&renderer);
     if (AGFX_SUCCESS != result) goto free_descriptor_set;
 
+    result = agfx_create_meshlet_culling(&renderer);
+    if (AGFX_SUCCESS != result) goto free_gpu_culling;
+
+    result = agfx_create_visibility_buffer(&renderer);
+    if (AGFX_SUCCESS != result) goto free_meshlet_culling;
+
+    result = agfx_create_gpu_timer(&renderer);
+    if (AGFX_SUCCESS != result) goto free_visibility_buffer;
+
+    result = create_command_buffers(&renderer);
+    if (AGFX_SUCCESS != result) goto free_gpu_timer;
+
     result = create_sync_objects(&renderer);
     if (AGFX_SUCCESS != result) goto free_command_buffers;
 
@@ -643,10 +1012,22 @@ goto finish;
 //     free_sync_objects(&renderer);
 free_command_buffers:
     free_command_buffers(&renderer);
+free_gpu_timer:
+    agfx_free_gpu_timer(&renderer);
+free_visibility_buffer:
+    agfx_free_visibility_buffer(&renderer);
+free_meshlet_culling:
+    agfx_free_meshlet_culling(&renderer);
+free_gpu_culling:
+    agfx_free_gpu_culling(&renderer);
 free_descriptor_set:
     free_descriptor_sets(&renderer);
 free_descriptor_pool:
     free_descriptor_pool(&renderer);
+free_frame_resources:
+    free_frame_resources(&renderer);
+free_model:
+    free_model(&renderer);
 free_command_pool:
     free_command_pool(&renderer);
 free_pipeline:
@@ -655,328 +1036,952 @@ free_render_pass:
     free_render_pass(&renderer);
 free_descriptor_set_layout:
     free_descriptor_set_layout(&renderer);
-free_model:
-    free_model(&renderer);
 finish:
     *out_renderer = renderer;
     return result;
 }
 
+void free_lod_buffer(agfx_renderer_t *renderer)
+{
+    agfx_helper_free_buffer(renderer->context, renderer->lod_buffer, renderer->lod_buffer_memory);
+    free(renderer->lods);
+    renderer->lods = NULL;
+    renderer->lods_count = 0;
+}
+
 void agfx_free_renderer(agfx_renderer_t *renderer)
 {
     free_sync_objects(renderer);
     free_command_buffers(renderer);
+    agfx_free_gpu_timer(renderer);
+    agfx_free_visibility_buffer(renderer);
+    agfx_free_meshlet_culling(renderer);
+    agfx_free_gpu_culling(renderer);
     free_descriptor_sets(renderer);
     free_descriptor_pool(renderer);
     free_command_pool(renderer);
-    free_render_pass(renderer);
+    // compiles still running use the render pass
     free_pipeline(renderer);
+    free_render_pass(renderer);
     free_descriptor_set_layout(renderer);
+    free_frame_resources(renderer);
     free_model(renderer);
 }
 
-// todo: refactor
-// todo: malloc result checks
-agfx_result_t create_uniform_buffers_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh)
+agfx_result_t create_frame_buffers(agfx_renderer_t *renderer, agfx_frame_t* frame)
 {
     agfx_result_t result = AGFX_SUCCESS;
+    size_t object_buffer_size = sizeof(agfx_object_data_t) * (renderer->instances_count > 0 ? renderer->instances_count : 1);
+    size_t instance_buffer_size = sizeof(uint32_t) * AGFX_INSTANCE_BUFFER_HALVES * (renderer->instances_count > 0 ? renderer->instances_count : 1);
 
-    mesh->uniform_buffers = malloc(sizeof(VkBuffer) * AGFX_MAX_FRAMES_IN_FLIGHT);
-    mesh->uniform_buffer_memories = malloc(sizeof(VkDeviceMemory) * AGFX_MAX_FRAMES_IN_FLIGHT);
-    mesh->uniform_buffer_mapped = malloc(sizeof(void*) * AGFX_MAX_FRAMES_IN_FLIGHT);
+    result = agfx_helper_create_buffer(renderer->context, object_buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame->object_buffer, &frame->object_buffer_memory);
+    if (AGFX_SUCCESS != result) return result;
 
-    for (size_t i = 0; i < AGFX_MAX_FRAMES_IN_FLIGHT; ++i)
+    if (VK_SUCCESS != vkMapMemory(renderer->context->device, frame->object_buffer_memory, 0, object_buffer_size, 0, &frame->object_buffer_mapped))
     {
-        result = agfx_helper_create_buffer(
-            renderer->context, 
-            sizeof(agfx_uniform_buffer_object_t), 
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-            &mesh->uniform_buffers[i], 
-            &mesh->uniform_buffer_memories[i]
-        );
-
-        if (AGFX_SUCCESS != result)
-        {
-            goto free;
-        }
-
-        if (VK_SUCCESS != vkMapMemory(renderer->context->device, mesh->uniform_buffer_memories[i], 0, sizeof(agfx_uniform_buffer_object_t), 0, &mesh->uniform_buffer_mapped[i]))
-        {
-            result = AGFX_BUFFER_MAP_ERROR;
-        }
-
-        if (result == AGFX_SUCCESS) goto finish;
-
-        free:
-        if (i > 0) {
-            for (size_t j = 0; j < i; ++j)
-            {
-                vkDestroyBuffer(renderer->context->device, mesh->uniform_buffers[j], NULL);
-                vkFreeMemory(renderer->context->device, mesh->uniform_buffer_memories[j], NULL);
-            }
-        }
-        free(mesh->uniform_buffers);
-        free(mesh->uniform_buffer_memories);
-        free(mesh->uniform_buffer_mapped);
-        return result;
-
-        finish:
+        result = AGFX_BUFFER_MAP_ERROR;
+        goto free_object_buffer;
     }
 
-    return result;
-}
+    // the first half maps every instance to itself for the full and gpu culled lists, the second half is the cpu culled
+    // instances packed so each instanced draw reads its run
+    result = agfx_helper_create_buffer(renderer->context, instance_buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame->instance_buffer, &frame->instance_buffer_memory);
+    if (AGFX_SUCCESS != result) goto free_object_buffer;
 
-void free_uniform_buffers_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh)
-{
-    for (size_t i = 0; i < AGFX_MAX_FRAMES_IN_FLIGHT; ++i)
+    if (VK_SUCCESS != vkMapMemory(renderer->context->device, frame->instance_buffer_memory, 0, instance_buffer_size, 0, (void**)&frame->instance_buffer_mapped))
     {
-        vkDestroyBuffer(renderer->context->device, mesh->uniform_buffers[i], NULL);
-        vkFreeMemory(renderer->context->device, mesh->uniform_buffer_memories[i], NULL);
+        result = AGFX_BUFFER_MAP_ERROR;
+        goto free_instance_buffer;
     }
-
-    free(mesh->uniform_buffers);
-    free(mesh->uniform_buffer_memories);
-    free(mesh->uniform_buffer_mapped);
-}
-
-void agfx_update_uniform_buffer(agfx_renderer_t *renderer)
-{
-    for (size_t mesh_index = 0; mesh_index < renderer->meshes_count; ++mesh_index)
+    for (size_t instance_index = 0; instance_index < renderer->instances_count; ++instance_index)
     {
-        agfx_mesh_t* mesh = &renderer->meshes[mesh_index];
-        agfx_uniform_buffer_object_t ubo = {
-            .model = agfx_mat4x4_multiplied_by_mat4x4(agfx_mat4x4_multiplied_by_mat4x4(agfx_mat4x4_translation((agfx_vector3_t) {.x = 0.0f, .y = 0.0f, .z = 0.0f}), agfx_mat4x4_rotation_euler(renderer->state->rotation)), agfx_mat4x4_scale((agfx_vector3_t) {.x = 1.0f, .y = 1.0f, .z = 1.0f})),
-            .view = agfx_mat4x4_look_at((agfx_vector3_t) {.x = 2.0f, .y = 2.0f, .z = 3.0f}, (agfx_vector3_t) {.x = 0.0f, .y = 0.0f, .z = 1.9f}, (agfx_vector3_t) {.x = 0.0f, .y = 0.0f, .z = 1.0f}),
-            .projection = agfx_mat4x4_perspective(renderer->state->camera_fov * M_PI / 180.f, renderer->swapchain->swapchain_extent.width / (float) renderer->swapchain->swapchain_extent.height, 0.1f, 10.0f)
-        };
-
-        memcpy(mesh->uniform_buffer_mapped[renderer->state->current_frame], &ubo, sizeof(ubo));
+        frame->instance_buffer_mapped[instance_index] = (uint32_t)instance_index;
     }
 
-}
-
-agfx_result_t create_descriptor_pool(agfx_renderer_t *renderer)
-{
-    VkDescriptorPoolSize descriptor_pool_sizes[AGFX_DESCRIPTOR_COUNT] = {
-        {
-            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .descriptorCount = AGFX_MAX_FRAMES_IN_FLIGHT * renderer->meshes_count
-        },
-        {
-            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount = AGFX_MAX_FRAMES_IN_FLIGHT * renderer->meshes_count // so far 1 mesh = 1 texture. In the future imma do something about it. Right now I am desperate to see a bunch of textured cubes and pyramids ;-;
-        },
-    };
-
-    VkDescriptorPoolCreateInfo descriptor_pool_create_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .poolSizeCount = AGFX_DESCRIPTOR_COUNT,
-        .pPoolSizes = descriptor_pool_sizes,
-        .maxSets = AGFX_MAX_FRAMES_IN_FLIGHT * renderer->meshes_count 
-    };
+    VkDeviceSize draw_buffer_size = agfx_draw_list_buffer_size(renderer->draw_list.draws_capacity);
+    result = agfx_helper_create_buffer(renderer->context, draw_buffer_size, AGFX_DRAW_LIST_USAGE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame->draw_buffer, &frame->draw_buffer_memory);
+    if (AGFX_SUCCESS != result) goto free_instance_buffer;
 
-    if (VK_SUCCESS != vkCreateDescriptorPool(renderer->context->device, &descriptor_pool_create_info, NULL, &renderer->descriptor_pool))
+    if (VK_SUCCESS != vkMapMemory(renderer->context->device, frame->draw_buffer_memory, 0, draw_buffer_size, 0, &frame->draw_buffer_mapped))
     {
-        return AGFX_DESCRIPTOR_POOL_ERROR;
+        result = AGFX_BUFFER_MAP_ERROR;
+        goto free_draw_buffer;
     }
-
-    return AGFX_SUCCESS;
-}
-
-void free_descriptor_pool(agfx_renderer_t *renderer)
-{
-    vkDestroyDescriptorPool(renderer->context->device, renderer->descriptor_pool, NULL);
-}
-
-agfx_result_t create_descriptor_sets(agfx_renderer_t *renderer)
-{
-    VkDescriptorSetLayout descriptor_set_layouts[AGFX_MAX_FRAMES_IN_FLIGHT] = {
-        renderer->descriptor_set_layout,
-        renderer->descriptor_set_layout
-    };
-
-    VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-        .descriptorPool = renderer->descriptor_pool,
-        .descriptorSetCount = AGFX_MAX_FRAMES_IN_FLIGHT,
-        .pSetLayouts = descriptor_set_layouts
-    };
-
-    for (size_t mesh_index = 0; mesh_index < renderer->meshes_count; ++mesh_index)
+    // an empty count until the first update, in case something records before it
+    memset(frame->draw_buffer_mapped, 0, draw_buffer_size);
+    frame->draws_count = 0;
+    frame->cpu_draw_buffer = VK_NULL_HANDLE;
+    frame->cpu_draws_count = 0;
+
+    // the ranges are empty until the first update too. at worst every blended draw is a run of its own
+    frame->scene_batches = calloc(AGFX_DRAW_BUCKET_BLEND + renderer->draw_list.draws_capacity, sizeof(agfx_render_batch_t));
+    frame->blend_items = calloc(renderer->draw_list.draws_capacity > 0 ? renderer->draw_list.draws_capacity : 1, sizeof(agfx_render_item_t));
+    if (NULL == frame->scene_batches || NULL == frame->blend_items)
     {
-        agfx_mesh_t* mesh = &renderer->meshes[mesh_index];
-
-        mesh->descriptor_sets = malloc(sizeof(VkDescriptorSet) * AGFX_MAX_FRAMES_IN_FLIGHT);
-
-        if (VK_SUCCESS != vkAllocateDescriptorSets(renderer->context->device, &descriptor_set_allocate_info, mesh->descriptor_sets))
-        {
-            free(mesh->descriptor_sets);
-            return AGFX_DESCRIPTOR_SET_ERROR;
-        }
-
-        for (size_t i = 0; i < AGFX_MAX_FRAMES_IN_FLIGHT; i++) {
-            VkDescriptorBufferInfo descriptor_buffer_info = {
-                .buffer = mesh->uniform_buffers[i],
-                .offset = 0,
-                .range = sizeof(agfx_uniform_buffer_object_t)
-            };
+        result = AGFX_BUFFER_ERROR;
+        goto free_batches;
+    }
+    frame->scene_batches_count = AGFX_DRAW_BUCKET_BLEND;
 
-            VkDescriptorImageInfo descriptor_image_info = {
-                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                .imageView = mesh->texture_image_view,
-                .sampler = mesh->texture_sampler,
-            };
+    // never matches the renderer generation, so the first update fills the object buffer
+    frame->object_generation = 0;
+    frame->constants_offset = 0;
 
-            VkWriteDescriptorSet write_descriptor_sets[AGFX_DESCRIPTOR_COUNT] = {
-                {
-                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                    .dstSet = mesh->descriptor_sets[i],
-                    .dstBinding = 0,
-                    .dstArrayElement = 0,
-                    .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                    .descriptorCount = 1,
-                    .pBufferInfo = &descriptor_buffer_info,
-                },
-                {
-                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                    .dstSet = mesh->descriptor_sets[i],
-                    .dstBinding = 1,
-                    .dstArrayElement = 0,
-                    .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                    .descriptorCount = 1,
-                    .pImageInfo = &descriptor_image_info,
-                }
-            };
-            vkUpdateDescriptorSets(renderer->context->device, AGFX_DESCRIPTOR_COUNT, write_descriptor_sets, 0, NULL);
-        }
-    }
+goto finish;
 
-    return AGFX_SUCCESS;
+free_batches:
+    free(frame->scene_batches);
+    free(frame->blend_items);
+free_draw_buffer:
+    vkDestroyBuffer(renderer->context->device, frame->draw_buffer, NULL);
+    vkFreeMemory(renderer->context->device, frame->draw_buffer_memory, NULL);
+free_instance_buffer:
+    vkDestroyBuffer(renderer->context->device, frame->instance_buffer, NULL);
+    vkFreeMemory(renderer->context->device, frame->instance_buffer_memory, NULL);
+free_object_buffer:
+    vkDestroyBuffer(renderer->context->device, frame->object_buffer, NULL);
+    vkFreeMemory(renderer->context->device, frame->object_buffer_memory, NULL);
+finish:
+    return result;
 }
 
-void free_descriptor_sets(agfx_renderer_t *renderer)
+void free_frame_buffers(agfx_renderer_t *renderer, agfx_frame_t* frame)
 {
-    for (size_t mesh_index = 0; mesh_index < renderer->meshes_count; ++mesh_index)
-    {
-        agfx_mesh_t* mesh = &renderer->meshes[mesh_index];
-        free(mesh->descriptor_sets);
-    }
+    free(frame->scene_batches);
+    free(frame->blend_items);
+    vkDestroyBuffer(renderer->context->device, frame->draw_buffer, NULL);
+    vkFreeMemory(renderer->context->device, frame->draw_buffer_memory, NULL);
+    vkDestroyBuffer(renderer->context->device, frame->instance_buffer, NULL);
+    vkFreeMemory(renderer->context->device, frame->instance_buffer_memory, NULL);
+    vkDestroyBuffer(renderer->context->device, frame->object_buffer, NULL);
+    vkFreeMemory(renderer->context->device, frame->object_buffer_memory, NULL);
 }
 
-// this file is becoming a mess, gotta refactor the crap out of this soon ._.
-// but so far i am kinda following the vulkan-tutorial, so imma think about this later
-
-agfx_result_t create_texture_image_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh, void* raw_image_data, size_t raw_image_data_size)
+agfx_result_t create_frame_resources(agfx_renderer_t *renderer)
 {
     agfx_result_t result = AGFX_SUCCESS;
-    SDL_Surface* original_image_surface = IMG_Load_RW(SDL_RWFromConstMem(raw_image_data, raw_image_data_size), 1);
-    if (NULL == original_image_surface)
+
+    renderer->frames = calloc(AGFX_MAX_FRAMES_IN_FLIGHT, sizeof(agfx_frame_t));
+    if (NULL == renderer->frames)
     {
-        result = AGFX_IMAGE_LOAD_ERROR;
-        return result;
+        return AGFX_BUFFER_ERROR;
     }
 
-    SDL_Surface* image_surface = SDL_ConvertSurfaceFormat(original_image_surface, SDL_PIXELFORMAT_ABGR8888 , 0);
-    SDL_FreeSurface(original_image_surface);
-    if (NULL == image_surface)
+    renderer->object_generation = 1;
+
+    // one draw per instance, the cpu path merges the visible ones back into instanced draws
+    result = agfx_create_draw_list(renderer->instances_count, &renderer->draw_list);
+    if (AGFX_SUCCESS != result)
     {
-        result = AGFX_IMAGE_LOAD_ERROR;
+        free(renderer->frames);
         return result;
     }
 
-    VkDeviceSize image_size = image_surface->w * image_surface->h * image_surface->format->BytesPerPixel;
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
-    result = agfx_helper_create_buffer(renderer->context, image_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging_buffer, &staging_buffer_memory);
+    result = agfx_create_cpu_culling(renderer->instances_count, &renderer->cpu_culling);
     if (AGFX_SUCCESS != result)
     {
-        SDL_FreeSurface(image_surface);
+        agfx_free_draw_list(&renderer->draw_list);
+        free(renderer->frames);
         return result;
     }
-    void* data;
-    result = vkMapMemory(renderer->context->device, staging_buffer_memory, 0, image_size, 0, &data);
+
+    result = agfx_create_bvh(renderer->instances_count, &renderer->scene_bvh);
     if (AGFX_SUCCESS != result)
     {
-        SDL_FreeSurface(image_surface);
-        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
-        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
+        agfx_free_cpu_culling(&renderer->cpu_culling);
+        agfx_free_draw_list(&renderer->draw_list);
+        free(renderer->frames);
         return result;
     }
-    memcpy(data, image_surface->pixels, image_size);
-    vkUnmapMemory(renderer->context->device, staging_buffer_memory);
 
-    result = agfx_helper_create_image(renderer->context, image_surface->w, image_surface->h, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mesh->texture_image, &mesh->texture_image_memory);
+    result = create_occluders(renderer);
     if (AGFX_SUCCESS != result)
     {
-        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
-        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
-        vkFreeMemory(renderer->context->device, mesh->texture_image_memory, NULL);
+        agfx_free_bvh(&renderer->scene_bvh);
+        agfx_free_cpu_culling(&renderer->cpu_culling);
+        agfx_free_draw_list(&renderer->draw_list);
+        free(renderer->frames);
         return result;
     }
 
-    result = agfx_helper_transition_image_layout(renderer, mesh->texture_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    result = agfx_create_render_queue(renderer->instances_count, &renderer->render_queue);
     if (AGFX_SUCCESS != result)
     {
-        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
-        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
-        vkFreeMemory(renderer->context->device, mesh->texture_image_memory, NULL);
+        agfx_free_software_occlusion(&renderer->software_occlusion);
+        agfx_free_bvh(&renderer->scene_bvh);
+        agfx_free_cpu_culling(&renderer->cpu_culling);
+        agfx_free_draw_list(&renderer->draw_list);
+        free(renderer->frames);
         return result;
     }
 
-    result = agfx_helper_copy_buffer_to_image(renderer, staging_buffer, mesh->texture_image, image_surface->w, image_surface->h);
+    result = agfx_create_frame_arena(renderer->context, AGFX_MAX_FRAMES_IN_FLIGHT, &renderer->frame_arena);
     if (AGFX_SUCCESS != result)
     {
-        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
-        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
-        vkFreeMemory(renderer->context->device, mesh->texture_image_memory, NULL);
+        agfx_free_render_queue(&renderer->render_queue);
+        agfx_free_software_occlusion(&renderer->software_occlusion);
+        agfx_free_bvh(&renderer->scene_bvh);
+        agfx_free_cpu_culling(&renderer->cpu_culling);
+        agfx_free_draw_list(&renderer->draw_list);
+        free(renderer->frames);
         return result;
     }
 
-    result = agfx_helper_transition_image_layout(renderer, mesh->texture_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    if (AGFX_SUCCESS != result)
+    for (size_t i = 0; i < AGFX_MAX_FRAMES_IN_FLIGHT; ++i)
     {
-        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
-        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
-        vkFreeMemory(renderer->context->device, mesh->texture_image_memory, NULL);
-        return result;
+        result = create_frame_buffers(renderer, &renderer->frames[i]);
+        if (AGFX_SUCCESS != result)
+        {
+            for (size_t j = 0; j < i; ++j)
+            {
+                free_frame_buffers(renderer, &renderer->frames[j]);
+            }
+            agfx_free_frame_arena(renderer->context, &renderer->frame_arena);
+            agfx_free_render_queue(&renderer->render_queue);
+            agfx_free_software_occlusion(&renderer->software_occlusion);
+            agfx_free_bvh(&renderer->scene_bvh);
+            agfx_free_cpu_culling(&renderer->cpu_culling);
+            agfx_free_draw_list(&renderer->draw_list);
+            free(renderer->frames);
+            return result;
+        }
     }
-    
-    SDL_FreeSurface(image_surface);
-    vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
-    vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
+
     return result;
 }
 
-void free_texture_image_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh)
+void free_frame_resources(agfx_renderer_t *renderer)
 {
-    vkDestroyImage(renderer->context->device, mesh->texture_image, NULL);
-    vkFreeMemory(renderer->context->device, mesh->texture_image_memory, NULL);
+    for (size_t i = 0; i < AGFX_MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        free_frame_buffers(renderer, &renderer->frames[i]);
+    }
+
+    agfx_free_frame_arena(renderer->context, &renderer->frame_arena);
+    agfx_free_render_queue(&renderer->render_queue);
+    agfx_free_software_occlusion(&renderer->software_occlusion);
+    agfx_free_bvh(&renderer->scene_bvh);
+    agfx_free_cpu_culling(&renderer->cpu_culling);
+    agfx_free_draw_list(&renderer->draw_list);
+    free(renderer->frames);
 }
 
-agfx_result_t create_texture_image_view_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh)
+// large opaque meshes with few triangles make the occluders, the rest either hide too little or cost too much to rasterize
+// every frame. alpha tested and blended surfaces let what is behind them show through, so they never occlude
+agfx_result_t create_occluders(agfx_renderer_t *renderer)
 {
-    return agfx_helper_create_image_view(renderer->context, mesh->texture_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, &mesh->texture_image_view);
+    agfx_result_t result = agfx_create_software_occlusion(AGFX_OCCLUSION_WIDTH, AGFX_OCCLUSION_HEIGHT, AGFX_OCCLUSION_MAX_TRIANGLES, renderer->instances_count, &renderer->software_occlusion);
+    if (AGFX_SUCCESS != result) return result;
+
+    float largest_radius = 0.0f;
+    for (size_t mesh_index = 0; mesh_index < renderer->meshes_count; ++mesh_index)
+    {
+        largest_radius = fmaxf(largest_radius, renderer->meshes[mesh_index].bounding_sphere.w);
+    }
+
+    for (size_t mesh_index = 0; mesh_index < renderer->meshes_count; ++mesh_index)
+    {
+        agfx_mesh_t* mesh = &renderer->meshes[mesh_index];
+        if (0 == mesh->instances_count || mesh->indices_count / 3 > AGFX_OCCLUDER_MAX_TRIANGLES || mesh->bounding_sphere.w < largest_radius * AGFX_OCCLUDER_MIN_RELATIVE_RADIUS ||
+            !agfx_pipeline_key_is_opaque(renderer->material_pipeline_keys[mesh->material_index]))
+        {
+            continue;
+        }
+
+        result = agfx_software_occlusion_add_occluder_proxy(&renderer->software_occlusion, (uint32_t)mesh_index, mesh->vertices, mesh->vertices_count, mesh->indices, mesh->indices_count);
+        if (AGFX_SUCCESS != result)
+        {
+            agfx_free_software_occlusion(&renderer->software_occlusion);
+            return result;
+        }
+    }
+
+    return result;
 }
 
-void free_texture_image_view_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh)
+// occluders go into the cpu depth buffer with this frame's camera, then the frustum survivors are tested against it.
+// a proxy is shared by every instance of its mesh, the triangle budget caps how many of them make it in
+void cull_occluded_on_cpu(agfx_renderer_t *renderer, agfx_mat4x4_t view_projection)
 {
-    vkDestroyImageView(renderer->context->device, mesh->texture_image_view, NULL);
+    agfx_software_occlusion_t* software_occlusion = &renderer->software_occlusion;
+    agfx_cpu_culling_t* cpu_culling = &renderer->cpu_culling;
+
+    agfx_software_occlusion_clear(software_occlusion);
+    for (size_t i = 0; i < software_occlusion->occluders_count; ++i)
+    {
+        agfx_occluder_t* occluder = &software_occlusion->occluders[i];
+        agfx_mesh_t* mesh = &renderer->meshes[occluder->mesh_index];
+        for (uint32_t instance_index = mesh->first_instance; instance_index < mesh->first_instance + mesh->instances_count; ++instance_index)
+        {
+            agfx_mat4x4_t model_view_projection = agfx_mat4x4_multiplied_by_mat4x4(view_projection, renderer->instances[instance_index].transform);
+            agfx_software_occlusion_add_triangles(software_occlusion, occluder->positions, occluder->indices, occluder->indices_count, model_view_projection);
+        }
+    }
+    agfx_software_occlusion_rasterize(software_occlusion, renderer->job_system);
+
+    cpu_culling->visible_count = agfx_software_occlusion_filter(software_occlusion, renderer->job_system, view_projection, renderer->scene_bvh.primitive_bounds, cpu_culling->visible_indices, cpu_culling->visible_count);
 }
 
-agfx_result_t create_texture_sampler_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh)
+// only runs when the scene changed, the frames pick the new list up through the object generation.
+// the draws are grouped into the ranges of their material's pipeline bucket, in instance order inside each
+agfx_result_t build_draw_list(agfx_renderer_t *renderer)
 {
-    VkPhysicalDeviceProperties device_properties = {};
-    vkGetPhysicalDeviceProperties(renderer->context->physical_device, &device_properties);
-    VkSamplerCreateInfo sampler_create_info = {
-        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
-        .magFilter = VK_FILTER_LINEAR,
-        .minFilter = VK_FILTER_LINEAR,
+    agfx_result_t result = AGFX_SUCCESS;
+    agfx_draw_list_t* draw_list = &renderer->draw_list;
+
+    agfx_draw_list_clear(draw_list);
+    for (uint32_t range = 0; range < AGFX_DRAW_RANGES_COUNT; ++range)
+    {
+        draw_list->range_first_draws[range] = (uint32_t)draw_list->draws_count;
+        for (size_t instance_index = 0; instance_index < renderer->instances_count; ++instance_index)
+        {
+            agfx_mesh_t* mesh = &renderer->meshes[renderer->instances[instance_index].mesh_index];
+            if (agfx_pipeline_key_draw_range(renderer->material_pipeline_keys[mesh->material_index]) != range)
+            {
+                continue;
+            }
+
+            result = agfx_draw_list_push(draw_list, mesh->indices_count, mesh->first_index, mesh->vertex_offset, (uint32_t)instance_index, mesh->material_index, mesh->first_lod, mesh->lods_count > 0 ? mesh->lods_count : 1);
+            if (AGFX_SUCCESS != result) return result;
+        }
+    }
+    draw_list->range_first_draws[AGFX_DRAW_RANGES_COUNT] = (uint32_t)draw_list->draws_count;
+
+    renderer->draw_list.generation = renderer->object_generation;
+    agfx_invalidate_commands(renderer);
+    return result;
+}
+
+// cull bounds and the scene bvh are indexed like the draw list, each draw's first instance is the instance it came from.
+// moved objects only refit the bvh, it is rebuilt when the draw count changes or refits made it too loose
+void update_cull_bounds(agfx_renderer_t *renderer)
+{
+    agfx_cpu_culling_t* cpu_culling = &renderer->cpu_culling;
+    agfx_cull_bounds_t* bounds = &cpu_culling->bounds;
+
+    agfx_cull_bounds_set_count(bounds, renderer->draw_list.draws_count);
+    // the draws may have been reordered, every one starts over at its full mesh
+    memset(cpu_culling->draw_lods, 0, sizeof(uint8_t) * bounds->count);
+    for (size_t draw_index = 0; draw_index < bounds->count; ++draw_index)
+    {
+        agfx_instance_t* instance = &renderer->instances[renderer->draw_list.draws[draw_index].command.firstInstance];
+        agfx_mesh_t* mesh = &renderer->meshes[instance->mesh_index];
+        agfx_cull_bounds_set_transformed(bounds, draw_index, instance->transform, mesh->bounding_sphere, mesh->bounds_min, mesh->bounds_max);
+
+        agfx_aabb_t aabb = {
+            .min = {bounds->box_center_x[draw_index] - bounds->box_extent_x[draw_index], bounds->box_center_y[draw_index] - bounds->box_extent_y[draw_index], bounds->box_center_z[draw_index] - bounds->box_extent_z[draw_index]},
+            .max = {bounds->box_center_x[draw_index] + bounds->box_extent_x[draw_index], bounds->box_center_y[draw_index] + bounds->box_extent_y[draw_index], bounds->box_center_z[draw_index] + bounds->box_extent_z[draw_index]}
+        };
+        agfx_bvh_set_primitive(&renderer->scene_bvh, draw_index, aabb);
+    }
+
+    if (renderer->scene_bvh.primitives_count != bounds->count || 0 == SDL_AtomicGet(&renderer->scene_bvh.nodes_count))
+    {
+        agfx_bvh_build(&renderer->scene_bvh, renderer->job_system, bounds->count);
+    } else
+    {
+        agfx_bvh_refit(&renderer->scene_bvh);
+        if (agfx_bvh_needs_rebuild(&renderer->scene_bvh))
+        {
+            agfx_bvh_build(&renderer->scene_bvh, renderer->job_system, bounds->count);
+        }
+    }
+
+    cpu_culling->generation = renderer->draw_list.generation;
+}
+
+// opaque and masked draws go nearest first inside each pipeline, so early depth rejects as much as it can.
+// meshes placed more than once sort by mesh and level instead of depth, so their visible instances end up next to each other.
+// blended draws come after all of them, farthest first by their own depth so they composite in order.
+// the level is picked here from the sphere's nearest view depth, a mesh's error grows with its instance's scale
+void queue_visible_draws(agfx_renderer_t *renderer, agfx_frame_t* frame, agfx_mat4x4_t view_projection)
+{
+    agfx_cpu_culling_t* cpu_culling = &renderer->cpu_culling;
+    agfx_cull_bounds_t* bounds = &cpu_culling->bounds;
+    agfx_render_queue_t* render_queue = &renderer->render_queue;
+    agfx_lod_stats_t* lod_stats = &renderer->lod_stats;
+
+    lod_stats->full_triangles_count = 0;
+    lod_stats->drawn_triangles_count = 0;
+    agfx_render_queue_clear(render_queue);
+    for (size_t i = 0; i < cpu_culling->visible_count; ++i)
+    {
+        uint32_t draw_index = cpu_culling->visible_indices[i];
+        agfx_draw_record_t* draw = &renderer->draw_list.draws[draw_index];
+        uint32_t mesh_index = renderer->instances[draw->command.firstInstance].mesh_index;
+        agfx_mesh_t* mesh = &renderer->meshes[mesh_index];
+
+        uint32_t lod = 0;
+        if (draw->lods_count > 1 && frame->lod_scale > 0.0f && mesh->bounding_sphere.w > 0.0f)
+        {
+            float sphere_depth = view_projection.mat[0].w * bounds->sphere_x[draw_index] + view_projection.mat[1].w * bounds->sphere_y[draw_index]
+                + view_projection.mat[2].w * bounds->sphere_z[draw_index] + view_projection.mat[3].w;
+            float distance = fmaxf(sphere_depth - bounds->sphere_radius[draw_index], 0.0f);
+            float error_scale = bounds->sphere_radius[draw_index] / mesh->bounding_sphere.w * frame->lod_scale;
+            lod = agfx_select_lod(&renderer->lods[draw->first_lod], draw->lods_count, cpu_culling->draw_lods[draw_index], distance, error_scale);
+        }
+        cpu_culling->draw_lods[draw_index] = (uint8_t)lod;
+        lod_stats->full_triangles_count += draw->command.indexCount / 3;
+        lod_stats->drawn_triangles_count += renderer->lods[draw->first_lod + lod].indices_count / 3;
+
+        uint32_t pipeline_key = renderer->material_pipeline_keys[draw->material_index];
+        uint32_t blended = pipeline_key & AGFX_PIPELINE_ALPHA_BLEND;
+        uint32_t depth_bucket = mesh_index * AGFX_MESH_MAX_LODS + lod;
+        if (mesh->instances_count < 2 || blended)
+        {
+            // clip w is the view depth of the box center
+            float view_depth = view_projection.mat[0].w * bounds->box_center_x[draw_index] + view_projection.mat[1].w * bounds->box_center_y[draw_index]
+                + view_projection.mat[2].w * bounds->box_center_z[draw_index] + view_projection.mat[3].w;
+            depth_bucket = agfx_render_depth_bucket(view_depth);
+        }
+
+        uint64_t key = blended ? agfx_render_key_transparent(pipeline_key, draw->material_index, depth_bucket) : agfx_render_key_opaque(pipeline_key, draw->material_index, depth_bucket);
+        agfx_render_queue_push(render_queue, key, draw_index);
+    }
+
+    agfx_render_queue_sort(render_queue, renderer->job_system);
+    agfx_render_queue_encode(render_queue);
+}
+
+static uint32_t is_same_draw(const agfx_draw_record_t* a, const agfx_draw_record_t* b)
+{
+    return a->command.indexCount == b->command.indexCount && a->command.firstIndex == b->command.firstIndex
+        && a->command.vertexOffset == b->command.vertexOffset && a->material_index == b->material_index;
+}
+
+// the draw with the level the cpu picked for it this frame
+static agfx_draw_record_t lod_draw(agfx_renderer_t *renderer, uint32_t draw_index)
+{
+    agfx_draw_record_t draw = renderer->draw_list.draws[draw_index];
+    const agfx_mesh_lod_t* lod = &renderer->lods[draw.first_lod + renderer->cpu_culling.draw_lods[draw_index]];
+    draw.command.firstIndex = lod->first_index;
+    draw.command.indexCount = lod->indices_count;
+    return draw;
+}
+
+// the records go out in queue order, and a run of draws with the same mesh, level and material becomes one instanced draw.
+// the visible instances are written to the second half of the instance buffer in queue order, so each run is a range of it.
+// the batches are rewritten to index the merged draws
+uint32_t pack_instanced_draws(agfx_renderer_t *renderer, agfx_frame_t* frame, agfx_draw_record_t* draws)
+{
+    agfx_render_queue_t* render_queue = &renderer->render_queue;
+    uint32_t* visible_instances = &frame->instance_buffer_mapped[renderer->instances_count];
+    uint32_t draws_count = 0;
+
+    for (size_t batch_index = 0; batch_index < render_queue->batches_count; ++batch_index)
+    {
+        agfx_render_batch_t* batch = &render_queue->batches[batch_index];
+        uint32_t batch_first_draw = draws_count;
+        size_t batch_end = batch->first_draw + batch->draws_count;
+
+        size_t run_end = batch->first_draw;
+        for (size_t run_begin = batch->first_draw; run_begin < batch_end; run_begin = run_end)
+        {
+            agfx_draw_record_t run_draw = lod_draw(renderer, render_queue->items[run_begin].draw_index);
+            for (run_end = run_begin; run_end < batch_end; ++run_end)
+            {
+                agfx_draw_record_t draw = lod_draw(renderer, render_queue->items[run_end].draw_index);
+                if (!is_same_draw(&run_draw, &draw)) break;
+                visible_instances[run_end] = draw.command.firstInstance;
+            }
+
+            agfx_draw_record_t instanced_draw = run_draw;
+            instanced_draw.command.instanceCount = (uint32_t)(run_end - run_begin);
+            instanced_draw.command.firstInstance = (uint32_t)(renderer->instances_count + run_begin);
+            draws[draws_count++] = instanced_draw;
+        }
+
+        batch->first_draw = batch_first_draw;
+        batch->draws_count = draws_count - batch_first_draw;
+    }
+
+    return draws_count;
+}
+
+// the visible draws are packed into the frame arena every frame, the frame's own draw buffer keeps the full list for the gpu path.
+// if the arena is full the frame falls back to drawing everything
+void cull_draws_on_cpu(agfx_renderer_t *renderer, agfx_frame_t* frame, agfx_mat4x4_t view_projection)
+{
+    agfx_cpu_culling_t* cpu_culling = &renderer->cpu_culling;
+
+    if (cpu_culling->generation != renderer->draw_list.generation)
+    {
+        update_cull_bounds(renderer);
+    }
+
+    // small scenes are faster to test flat than to walk a tree for
+    if (cpu_culling->bounds.count >= AGFX_BVH_CULL_MIN_OBJECTS)
+    {
+        agfx_frustum_t frustum = agfx_frustum_from_view_projection(view_projection);
+        cpu_culling->visible_count = agfx_bvh_cull_frustum(&renderer->scene_bvh, &frustum, cpu_culling->visible_indices);
+    } else
+    {
+        agfx_cpu_cull(cpu_culling, view_projection);
+    }
+
+    if (renderer->state->software_occlusion && renderer->software_occlusion.occluders_count > 0)
+    {
+        cull_occluded_on_cpu(renderer, view_projection);
+    } else
+    {
+        renderer->software_occlusion.culled_count = 0;
+    }
+
+    queue_visible_draws(renderer, frame, view_projection);
+
+    agfx_frame_allocation_t draws_allocation;
+    if (AGFX_SUCCESS != agfx_frame_arena_allocate(&renderer->frame_arena, agfx_draw_list_buffer_size(renderer->render_queue.items_count), AGFX_DRAW_LIST_COUNT_ALIGNMENT, &draws_allocation))
+    {
+        return;
+    }
+
+    uint32_t draws_count = pack_instanced_draws(renderer, frame, (agfx_draw_record_t*)draws_allocation.mapped);
+    memcpy((uint8_t*)draws_allocation.mapped + agfx_draw_list_count_offset(draws_count), &draws_count, sizeof(draws_count));
+
+    frame->cpu_draw_buffer = draws_allocation.buffer;
+    frame->cpu_draw_offset = draws_allocation.offset;
+    frame->cpu_draws_count = draws_count;
+}
+
+static int compare_render_items(const void* a, const void* b)
+{
+    const agfx_render_item_t* item_a = (const agfx_render_item_t*)a;
+    const agfx_render_item_t* item_b = (const agfx_render_item_t*)b;
+    if (item_a->key != item_b->key) return item_a->key < item_b->key ? -1 : 1;
+    return item_a->draw_index < item_b->draw_index ? -1 : (item_a->draw_index > item_b->draw_index ? 1 : 0);
+}
+
+static uint32_t blended_draw_pipeline_key(agfx_renderer_t *renderer, const agfx_draw_record_t* draw)
+{
+    return renderer->bucket_pipeline_keys[agfx_pipeline_key_bucket(renderer->material_pipeline_keys[draw->material_index])];
+}
+
+// the frame's full list for the gpu paths: its ranges as batches, and its blended draws back to front with the keys the cpu
+// path sorts them by. only the frame's copy is reordered, the draw list keeps the order the cpu culling indexes it by.
+// runs of blended draws that share a pipeline are batches too, commands are rerecorded when the runs change
+static void sort_blended_draws(agfx_renderer_t *renderer, agfx_frame_t* frame, agfx_mat4x4_t view_projection)
+{
+    agfx_draw_list_t* draw_list = &renderer->draw_list;
+    agfx_draw_record_t* draws = (agfx_draw_record_t*)frame->draw_buffer_mapped;
+    uint32_t first_blended = draw_list->range_first_draws[AGFX_DRAW_BUCKET_BLEND];
+    uint32_t blended_count = draw_list->range_first_draws[AGFX_DRAW_RANGES_COUNT] - first_blended;
+
+    for (uint32_t range = 0; range < AGFX_DRAW_BUCKET_BLEND; ++range)
+    {
+        frame->scene_batches[range] = (agfx_render_batch_t) {
+            .pipeline_index = renderer->bucket_pipeline_keys[range],
+            .first_draw = draw_list->range_first_draws[range],
+            .draws_count = draw_list->range_first_draws[range + 1] - draw_list->range_first_draws[range]
+        };
+    }
+
+    for (uint32_t i = 0; i < blended_count; ++i)
+    {
+        const agfx_draw_record_t* draw = &draw_list->draws[first_blended + i];
+        agfx_instance_t* instance = &renderer->instances[draw->command.firstInstance];
+        agfx_vector4_t sphere = renderer->meshes[instance->mesh_index].bounding_sphere;
+        // clip w is the view depth of the sphere's center
+        agfx_mat4x4_t model_view_projection = agfx_mat4x4_multiplied_by_mat4x4(view_projection, instance->transform);
+        float view_depth = model_view_projection.mat[0].w * sphere.x + model_view_projection.mat[1].w * sphere.y
+            + model_view_projection.mat[2].w * sphere.z + model_view_projection.mat[3].w;
+        frame->blend_items[i] = (agfx_render_item_t) {
+            .key = agfx_render_key_transparent(renderer->material_pipeline_keys[draw->material_index], draw->material_index, agfx_render_depth_bucket(view_depth)),
+            .draw_index = first_blended + i
+        };
+    }
+    qsort(frame->blend_items, blended_count, sizeof(agfx_render_item_t), compare_render_items);
+
+    uint32_t runs_changed = 0;
+    size_t batches_count = AGFX_DRAW_BUCKET_BLEND;
+    for (uint32_t i = 0; i < blended_count; ++i)
+    {
+        uint32_t draw_index = first_blended + i;
+        agfx_draw_record_t draw = draw_list->draws[frame->blend_items[i].draw_index];
+        uint32_t pipeline_index = blended_draw_pipeline_key(renderer, &draw);
+        // the slot held this frame's last order, a different pipeline anywhere means different runs
+        runs_changed |= pipeline_index != blended_draw_pipeline_key(renderer, &draws[draw_index]);
+        draws[draw_index] = draw;
+
+        if (batches_count > AGFX_DRAW_BUCKET_BLEND && frame->scene_batches[batches_count - 1].pipeline_index == pipeline_index)
+        {
+            frame->scene_batches[batches_count - 1].draws_count++;
+            continue;
+        }
+        frame->scene_batches[batches_count++] = (agfx_render_batch_t) {
+            .pipeline_index = pipeline_index,
+            .first_draw = draw_index,
+            .draws_count = 1
+        };
+    }
+
+    if (runs_changed || batches_count != frame->scene_batches_count)
+    {
+        agfx_invalidate_commands(renderer);
+    }
+    frame->scene_batches_count = batches_count;
+}
+
+// the fixed camera turned by the state's rotation
+agfx_frame_constants_t agfx_camera_constants(agfx_renderer_t *renderer)
+{
+    agfx_frame_constants_t constants = {
+        .view = agfx_mat4x4_multiplied_by_mat4x4(
+            agfx_mat4x4_look_at((agfx_vector3_t) {.x = 2.0f, .y = 2.0f, .z = 3.0f}, (agfx_vector3_t) {.x = 0.0f, .y = 0.0f, .z = 1.9f}, (agfx_vector3_t) {.x = 0.0f, .y = 0.0f, .z = 1.0f}),
+            agfx_mat4x4_rotation_euler(renderer->state->rotation)
+        ),
+        .projection = agfx_mat4x4_perspective(renderer->state->camera_fov * M_PI / 180.f, renderer->swapchain->swapchain_extent.width / (float) renderer->swapchain->swapchain_extent.height, 0.1f, 10.0f)
+    };
+    constants.view_projection = agfx_mat4x4_multiplied_by_mat4x4(constants.projection, constants.view);
+    return constants;
+}
+
+// view and projection are shared by every object, so they are computed once per frame and handed out of the frame arena.
+// object transforms and draw records are only copied into a frame's buffers when they changed since that frame was last written
+void agfx_update_uniform_buffer(agfx_renderer_t *renderer)
+{
+    agfx_frame_t* frame = &renderer->frames[renderer->state->current_frame];
+    // the arena was reset for this frame, whatever was culled into it last time is gone
+    frame->cpu_draw_buffer = VK_NULL_HANDLE;
+
+    agfx_frame_allocation_t constants_allocation;
+    if (AGFX_SUCCESS != agfx_frame_arena_allocate(&renderer->frame_arena, sizeof(agfx_frame_constants_t), 0, &constants_allocation))
+    {
+        return;
+    }
+    frame->constants_offset = (uint32_t)constants_allocation.offset;
+
+    agfx_frame_constants_t constants = agfx_camera_constants(renderer);
+
+    // an error of 1 at distance 1 covers this many pixels, divided by what a level may cost
+    frame->lod_scale = 0.0f;
+    if (renderer->state->lod_selection)
+    {
+        frame->lod_scale = renderer->swapchain->swapchain_extent.height * 0.5f * fabsf(constants.projection.mat[1].y) / AGFX_LOD_PIXEL_ERROR;
+    }
+
+    memcpy(constants_allocation.mapped, &constants, sizeof(constants));
+
+    if (renderer->draw_list.generation != renderer->object_generation)
+    {
+        build_draw_list(renderer);
+    }
+
+    if (frame->object_generation != renderer->object_generation)
+    {
+        agfx_object_data_t* objects = (agfx_object_data_t*)frame->object_buffer_mapped;
+        for (size_t instance_index = 0; instance_index < renderer->instances_count; ++instance_index)
+        {
+            agfx_mesh_t* mesh = &renderer->meshes[renderer->instances[instance_index].mesh_index];
+            objects[instance_index].model = renderer->instances[instance_index].transform;
+            objects[instance_index].bounding_sphere = mesh->bounding_sphere;
+            objects[instance_index].material_index = mesh->material_index;
+        }
+        agfx_draw_list_write(&renderer->draw_list, frame->draw_buffer_mapped);
+        frame->draws_count = (uint32_t)renderer->draw_list.draws_count;
+        frame->object_generation = renderer->object_generation;
+    }
+
+    if (!renderer->state->gpu_culling)
+    {
+        cull_draws_on_cpu(renderer, frame, constants.view_projection);
+    }
+
+    // the gpu paths and the cpu path's fallback draw the full list
+    if (VK_NULL_HANDLE == frame->cpu_draw_buffer)
+    {
+        sort_blended_draws(renderer, frame, constants.view_projection);
+    }
+}
+
+agfx_result_t create_descriptor_pool(agfx_renderer_t *renderer)
+{
+    VkDescriptorPoolSize descriptor_pool_sizes[AGFX_DESCRIPTOR_POOL_SIZE_COUNT] = {
+        {
+            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            .descriptorCount = AGFX_MAX_FRAMES_IN_FLIGHT
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = AGFX_MAX_FRAMES_IN_FLIGHT * 2 + 1
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = renderer->textures_capacity
+        },
+    };
+
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = AGFX_DESCRIPTOR_POOL_SIZE_COUNT,
+        .pPoolSizes = descriptor_pool_sizes,
+        .maxSets = AGFX_MAX_FRAMES_IN_FLIGHT + 1
+    };
+
+    if (VK_SUCCESS != vkCreateDescriptorPool(renderer->context->device, &descriptor_pool_create_info, NULL, &renderer->descriptor_pool))
+    {
+        return AGFX_DESCRIPTOR_POOL_ERROR;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+void free_descriptor_pool(agfx_renderer_t *renderer)
+{
+    vkDestroyDescriptorPool(renderer->context->device, renderer->descriptor_pool, NULL);
+}
+
+agfx_result_t create_descriptor_sets(agfx_renderer_t *renderer)
+{
+    VkDescriptorSetLayout descriptor_set_layouts[AGFX_MAX_FRAMES_IN_FLIGHT] = {
+        renderer->descriptor_set_layout,
+        renderer->descriptor_set_layout
+    };
+
+    VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = renderer->descriptor_pool,
+        .descriptorSetCount = AGFX_MAX_FRAMES_IN_FLIGHT,
+        .pSetLayouts = descriptor_set_layouts
+    };
+
+    VkDescriptorSet frame_descriptor_sets[AGFX_MAX_FRAMES_IN_FLIGHT];
+    if (VK_SUCCESS != vkAllocateDescriptorSets(renderer->context->device, &descriptor_set_allocate_info, frame_descriptor_sets))
+    {
+        return AGFX_DESCRIPTOR_SET_ERROR;
+    }
+
+    for (size_t i = 0; i < AGFX_MAX_FRAMES_IN_FLIGHT; i++) {
+        agfx_frame_t* frame = &renderer->frames[i];
+        frame->descriptor_set = frame_descriptor_sets[i];
+
+        VkDescriptorBufferInfo constants_buffer_info = {
+            .buffer = renderer->frame_arena.buffer,
+            .offset = 0,
+            .range = sizeof(agfx_frame_constants_t)
+        };
+
+        VkDescriptorBufferInfo object_buffer_info = {
+            .buffer = frame->object_buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE
+        };
+
+        VkDescriptorBufferInfo instance_buffer_info = {
+            .buffer = frame->instance_buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE
+        };
+
+        VkWriteDescriptorSet write_descriptor_sets[AGFX_DESCRIPTOR_COUNT] = {
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = frame->descriptor_set,
+                .dstBinding = 0,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                .descriptorCount = 1,
+                .pBufferInfo = &constants_buffer_info,
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = frame->descriptor_set,
+                .dstBinding = 1,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .pBufferInfo = &object_buffer_info,
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = frame->descriptor_set,
+                .dstBinding = 2,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .pBufferInfo = &instance_buffer_info,
+            }
+        };
+        vkUpdateDescriptorSets(renderer->context->device, AGFX_DESCRIPTOR_COUNT, write_descriptor_sets, 0, NULL);
+    }
+
+    VkDescriptorSetAllocateInfo material_descriptor_set_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = renderer->descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &renderer->material_descriptor_set_layout
+    };
+
+    if (VK_SUCCESS != vkAllocateDescriptorSets(renderer->context->device, &material_descriptor_set_allocate_info, &renderer->material_descriptor_set))
+    {
+        return AGFX_DESCRIPTOR_SET_ERROR;
+    }
+
+    VkDescriptorBufferInfo material_buffer_info = {
+        .buffer = renderer->material_buffer,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE
+    };
+
+    VkWriteDescriptorSet material_write_descriptor_set = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = renderer->material_descriptor_set,
+        .dstBinding = 0,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .pBufferInfo = &material_buffer_info,
+    };
+    vkUpdateDescriptorSets(renderer->context->device, 1, &material_write_descriptor_set, 0, NULL);
+
+    if (renderer->textures_count == 0)
+    {
+        return AGFX_SUCCESS;
+    }
+
+    VkDescriptorImageInfo* descriptor_image_infos = calloc(renderer->textures_count, sizeof(VkDescriptorImageInfo));
+    if (NULL == descriptor_image_infos)
+    {
+        return AGFX_DESCRIPTOR_SET_ERROR;
+    }
+
+    for (size_t texture_index = 0; texture_index < renderer->textures_count; ++texture_index)
+    {
+        descriptor_image_infos[texture_index].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        descriptor_image_infos[texture_index].imageView = renderer->textures[texture_index].image_view;
+        descriptor_image_infos[texture_index].sampler = renderer->texture_sampler;
+    }
+
+    VkWriteDescriptorSet texture_write_descriptor_set = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = renderer->material_descriptor_set,
+        .dstBinding = 1,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = (uint32_t)renderer->textures_count,
+        .pImageInfo = descriptor_image_infos,
+    };
+    vkUpdateDescriptorSets(renderer->context->device, 1, &texture_write_descriptor_set, 0, NULL);
+
+    free(descriptor_image_infos);
+    return AGFX_SUCCESS;
+}
+
+void free_descriptor_sets(agfx_renderer_t *renderer)
+{
+    // sets go away with the descriptor pool
+}
+
+// this file is becoming a mess, gotta refactor the crap out of this soon ._.
+// but so far i am kinda following the vulkan-tutorial, so imma think about this later
+
+agfx_result_t create_texture_image(agfx_renderer_t *renderer, agfx_texture_t* texture, void* raw_image_data, size_t raw_image_data_size)
+{
+    agfx_result_t result = AGFX_SUCCESS;
+    SDL_Surface* original_image_surface = IMG_Load_RW(SDL_RWFromConstMem(raw_image_data, raw_image_data_size), 1);
+    if (NULL == original_image_surface)
+    {
+        result = AGFX_IMAGE_LOAD_ERROR;
+        return result;
+    }
+
+    SDL_Surface* image_surface = SDL_ConvertSurfaceFormat(original_image_surface, SDL_PIXELFORMAT_ABGR8888 , 0);
+    SDL_FreeSurface(original_image_surface);
+    if (NULL == image_surface)
+    {
+        result = AGFX_IMAGE_LOAD_ERROR;
+        return result;
+    }
+
+    VkDeviceSize image_size = image_surface->w * image_surface->h * image_surface->format->BytesPerPixel;
+    VkBuffer staging_buffer;
+    VkDeviceMemory staging_buffer_memory;
+    result = agfx_helper_create_buffer(renderer->context, image_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging_buffer, &staging_buffer_memory);
+    if (AGFX_SUCCESS != result)
+    {
+        SDL_FreeSurface(image_surface);
+        return result;
+    }
+    void* data;
+    result = vkMapMemory(renderer->context->device, staging_buffer_memory, 0, image_size, 0, &data);
+    if (AGFX_SUCCESS != result)
+    {
+        SDL_FreeSurface(image_surface);
+        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
+        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
+        return result;
+    }
+    agfx_helper_stream_copy(data, image_surface->pixels, image_size);
+    vkUnmapMemory(renderer->context->device, staging_buffer_memory);
+
+    result = agfx_helper_create_image(renderer->context, image_surface->w, image_surface->h, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture->image, &texture->image_memory);
+    if (AGFX_SUCCESS != result)
+    {
+        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
+        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
+        vkFreeMemory(renderer->context->device, texture->image_memory, NULL);
+        return result;
+    }
+
+    result = agfx_helper_transition_image_layout(renderer, texture->image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    if (AGFX_SUCCESS != result)
+    {
+        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
+        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
+        vkFreeMemory(renderer->context->device, texture->image_memory, NULL);
+        return result;
+    }
+
+    result = agfx_helper_copy_buffer_to_image(renderer, staging_buffer, texture->image, image_surface->w, image_surface->h);
+    if (AGFX_SUCCESS != result)
+    {
+        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
+        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
+        vkFreeMemory(renderer->context->device, texture->image_memory, NULL);
+        return result;
+    }
+
+    result = agfx_helper_transition_image_layout(renderer, texture->image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    if (AGFX_SUCCESS != result)
+    {
+        vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
+        vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
+        vkFreeMemory(renderer->context->device, texture->image_memory, NULL);
+        return result;
+    }
+    
+    SDL_FreeSurface(image_surface);
+    vkDestroyBuffer(renderer->context->device, staging_buffer, NULL);
+    vkFreeMemory(renderer->context->device, staging_buffer_memory, NULL);
+    return result;
+}
+
+void free_texture_image(agfx_renderer_t *renderer, agfx_texture_t* texture)
+{
+    vkDestroyImage(renderer->context->device, texture->image, NULL);
+    vkFreeMemory(renderer->context->device, texture->image_memory, NULL);
+}
+
+agfx_result_t create_texture_image_view(agfx_renderer_t *renderer, agfx_texture_t* texture)
+{
+    return agfx_helper_create_image_view(renderer->context, texture->image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, &texture->image_view);
+}
+
+void free_texture_image_view(agfx_renderer_t *renderer, agfx_texture_t* texture)
+{
+    vkDestroyImageView(renderer->context->device, texture->image_view, NULL);
+}
+
+agfx_result_t create_texture_sampler(agfx_renderer_t *renderer)
+{
+    VkSamplerCreateInfo sampler_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
         .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
         .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
         .addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
         .anisotropyEnable = VK_TRUE,
-        .maxAnisotropy = device_properties.limits.maxSamplerAnisotropy,
+        .maxAnisotropy = renderer->context->device_properties.limits.maxSamplerAnisotropy,
         .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
         .unnormalizedCoordinates = VK_FALSE,
         .compareEnable = VK_FALSE,
@@ -987,126 +1992,1135 @@ agfx_result_t create_texture_sampler_for_mesh(agfx_renderer_t *renderer, agfx_me
         .maxLod = 0.0f
     };
 
-    if (VK_SUCCESS != vkCreateSampler(renderer->context->device, &sampler_create_info, NULL, &mesh->texture_sampler))
+    if (VK_SUCCESS != vkCreateSampler(renderer->context->device, &sampler_create_info, NULL, &renderer->texture_sampler))
+    {
+        return AGFX_SAMPLER_CREATE_ERROR;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+void free_texture_sampler(agfx_renderer_t *renderer)
+{
+    vkDestroySampler(renderer->context->device, renderer->texture_sampler, NULL);
+}
+
+// one texture per gltf image, materials that share an image share the slot.
+// the slot index is the image index, so materials can look it up directly
+agfx_result_t create_texture_table(agfx_renderer_t *renderer, agltf_glb_t* model)
+{
+    agfx_result_t result = AGFX_SUCCESS;
+
+    renderer->textures_count = 0;
+    renderer->textures = NULL;
+
+    if (model->images_count > renderer->textures_capacity)
+    {
+        return AGFX_TEXTURE_TABLE_FULL_ERROR;
+    }
+
+    result = create_texture_sampler(renderer);
+    if (AGFX_SUCCESS != result) return result;
+
+    if (model->images_count == 0)
+    {
+        return AGFX_SUCCESS;
+    }
+
+    renderer->textures = calloc(model->images_count, sizeof(agfx_texture_t));
+    if (NULL == renderer->textures)
+    {
+        free_texture_sampler(renderer);
+        return AGFX_IMAGE_CREATE_ERROR;
+    }
+
+    for (size_t image_index = 0; image_index < model->images_count; ++image_index)
+    {
+        agfx_texture_t* texture = &renderer->textures[image_index];
+        agltf_json_image_t* image = &model->images[image_index];
+
+        result = create_texture_image(renderer, texture, image->data.data, image->data.size);
+        if (AGFX_SUCCESS != result) goto free_textures;
+
+        result = create_texture_image_view(renderer, texture);
+        if (AGFX_SUCCESS != result)
+        {
+            free_texture_image(renderer, texture);
+            goto free_textures;
+        }
+
+        renderer->textures_count++;
+    }
+
+goto finish;
+
+free_textures:
+    free_texture_table(renderer);
+finish:
+    return result;
+}
+
+void free_texture_table(agfx_renderer_t *renderer)
+{
+    for (size_t i = 0; i < renderer->textures_count; ++i)
+    {
+        free_texture_image_view(renderer, &renderer->textures[i]);
+        free_texture_image(renderer, &renderer->textures[i]);
+    }
+
+    free(renderer->textures);
+    renderer->textures = NULL;
+    renderer->textures_count = 0;
+    free_texture_sampler(renderer);
+}
+
+// blended surfaces test depth but leave it to the opaque ones behind them
+static uint32_t material_pipeline_key(const agltf_json_material_t* material)
+{
+    uint32_t key = material->double_sided ? AGFX_PIPELINE_DOUBLE_SIDED : 0;
+    if (AGLTF_JSON_ALPHA_MODE_MASK == material->alpha_mode) key |= AGFX_PIPELINE_ALPHA_TEST;
+    if (AGLTF_JSON_ALPHA_MODE_BLEND == material->alpha_mode) key |= AGFX_PIPELINE_ALPHA_BLEND | AGFX_PIPELINE_DEPTH_READ_ONLY;
+    return key;
+}
+
+// vertex colors come with primitives, not materials. a material gets the feature when any primitive drawn with it has them,
+// the rest of its primitives are loaded with white. only materials some primitive is drawn with are marked as used, the
+// default one only when a primitive has no material
+static void mark_primitive_materials(agfx_renderer_t *renderer, agltf_glb_t* model, uint8_t* is_used)
+{
+    for (size_t mesh_index = 0; mesh_index < model->meshes_count; ++mesh_index)
+    {
+        agltf_json_mesh_t* mesh = &model->meshes[mesh_index];
+        for (size_t primitive_index = 0; primitive_index < mesh->primitives_count; ++primitive_index)
+        {
+            agltf_json_mesh_primitive_t* primitive = &mesh->primitives[primitive_index];
+            size_t material_index = NULL != primitive->material ? (size_t)primitive->material->index : renderer->materials_count - 1;
+            if (material_index < renderer->materials_count)
+            {
+                is_used[material_index] = 1;
+            }
+            for (size_t attribute_index = 0; attribute_index < primitive->attribute_count; ++attribute_index)
+            {
+                if (0 == strcmp("COLOR_0", primitive->attributes[attribute_index].name) && material_index < renderer->materials_count)
+                {
+                    renderer->material_pipeline_keys[material_index] |= AGFX_PIPELINE_VERTEX_COLOR;
+                }
+            }
+        }
+    }
+}
+
+// gpu copy of every material, the last entry is the default one for primitives without a material.
+// each material's pipeline key is kept on the cpu, and every pipeline the used ones or their buckets can ask for is created here
+agfx_result_t create_material_table(agfx_renderer_t *renderer, agltf_glb_t* model)
+{
+    agfx_result_t result = AGFX_SUCCESS;
+
+    renderer->materials_count = model->materials_count + 1;
+    renderer->materials = calloc(renderer->materials_count, sizeof(agfx_material_data_t));
+    renderer->material_pipeline_keys = calloc(renderer->materials_count, sizeof(uint32_t));
+    uint8_t* is_used = calloc(renderer->materials_count, sizeof(uint8_t));
+    if (NULL == renderer->materials || NULL == renderer->material_pipeline_keys || NULL == is_used)
+    {
+        result = AGFX_BUFFER_ERROR;
+        goto free_host_tables;
+    }
+
+    for (size_t material_index = 0; material_index < model->materials_count; ++material_index)
+    {
+        agltf_json_material_t* material = &model->materials[material_index];
+        agfx_material_data_t* material_data = &renderer->materials[material_index];
+
+        material_data->base_color_factor = (agfx_vector4_t) {
+            .x = material->pbr.base_color_factor[0],
+            .y = material->pbr.base_color_factor[1],
+            .z = material->pbr.base_color_factor[2],
+            .w = material->pbr.base_color_factor[3]
+        };
+        material_data->metallic_factor = material->pbr.metallic_factor;
+        material_data->roughness_factor = material->pbr.roughness_factor;
+        material_data->base_color_texture_index = AGFX_NO_TEXTURE;
+        material_data->alpha_cutoff = AGLTF_JSON_ALPHA_MODE_MASK == material->alpha_mode ? material->alpha_cutoff : 0.0f;
+        renderer->material_pipeline_keys[material_index] = material_pipeline_key(material);
+
+        agltf_json_texture_t* texture = material->pbr.base_color_texture.texture;
+        if (NULL != texture && NULL != texture->source && texture->source->index < renderer->textures_count)
+        {
+            material_data->base_color_texture_index = (uint32_t)texture->source->index;
+            renderer->material_pipeline_keys[material_index] |= AGFX_PIPELINE_HAS_TEXTURE;
+        }
+    }
+
+    agfx_material_data_t* default_material = &renderer->materials[renderer->materials_count - 1];
+    default_material->base_color_factor = (agfx_vector4_t) {.x = 1.0f, .y = 1.0f, .z = 1.0f, .w = 1.0f};
+    default_material->metallic_factor = 1.0f;
+    default_material->roughness_factor = 1.0f;
+    default_material->base_color_texture_index = AGFX_NO_TEXTURE;
+    mark_primitive_materials(renderer, model, is_used);
+
+    // the gpu driven paths draw a whole range of the list through one pipeline, it has to shade as much as any material in
+    // its bucket does. culling, alpha and depth state are the bucket's own, so no draw gets a state its material lacks.
+    // materials nothing is drawn with are left out, or an unused one would make a bucket look mixed
+    uint32_t bucket_materials_count[AGFX_DRAW_BUCKETS_COUNT] = {0};
+    uint32_t bucket_textured_count[AGFX_DRAW_BUCKETS_COUNT] = {0};
+    for (uint32_t bucket = 0; bucket < AGFX_DRAW_BUCKETS_COUNT; ++bucket)
+    {
+        renderer->bucket_pipeline_keys[bucket] = agfx_pipeline_bucket_key(bucket);
+    }
+    for (size_t material_index = 0; material_index < renderer->materials_count; ++material_index)
+    {
+        if (!is_used[material_index]) continue;
+
+        uint32_t key = renderer->material_pipeline_keys[material_index];
+        uint32_t bucket = agfx_pipeline_key_bucket(key);
+        renderer->bucket_pipeline_keys[bucket] |= key & AGFX_PIPELINE_FEATURE_MASK;
+        bucket_materials_count[bucket]++;
+        bucket_textured_count[bucket] += (key & AGFX_PIPELINE_HAS_TEXTURE) ? 1 : 0;
+        // keys with the same bits share one pipeline, only the combinations some material uses are ever compiled
+        result = agfx_pipeline_state_cache_prepare(renderer, key);
+        if (AGFX_SUCCESS != result) goto free_host_tables;
+    }
+    for (uint32_t bucket = 0; bucket < AGFX_DRAW_BUCKETS_COUNT; ++bucket)
+    {
+        if (0 == bucket_materials_count[bucket]) continue;
+
+        if (bucket_textured_count[bucket] > 0 && bucket_textured_count[bucket] < bucket_materials_count[bucket])
+        {
+            renderer->bucket_pipeline_keys[bucket] |= AGFX_PIPELINE_MIXED_MATERIALS;
+        }
+        result = agfx_pipeline_state_cache_prepare(renderer, renderer->bucket_pipeline_keys[bucket]);
+        if (AGFX_SUCCESS != result) goto free_host_tables;
+    }
+
+    result = agfx_helper_upload_buffer(renderer, renderer->materials, sizeof(agfx_material_data_t) * renderer->materials_count, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &renderer->material_buffer, &renderer->material_buffer_memory);
+    if (AGFX_SUCCESS == result)
+    {
+        free(is_used);
+        return result;
+    }
+
+free_host_tables:
+    free(is_used);
+    free(renderer->materials);
+    free(renderer->material_pipeline_keys);
+    renderer->materials = NULL;
+    renderer->material_pipeline_keys = NULL;
+    renderer->materials_count = 0;
+    return result;
+}
+
+void free_material_table(agfx_renderer_t *renderer)
+{
+    agfx_helper_free_buffer(renderer->context, renderer->material_buffer, renderer->material_buffer_memory);
+    free(renderer->materials);
+    free(renderer->material_pipeline_keys);
+    renderer->materials = NULL;
+    renderer->material_pipeline_keys = NULL;
+    renderer->materials_count = 0;
+}
+
+// model space aabb and a sphere around it, the culling shader and the cpu culling move them to world space with the object's transform
+void compute_mesh_bounds(agfx_mesh_t* mesh)
+{
+    if (mesh->vertices_count == 0)
+    {
+        mesh->bounding_sphere = (agfx_vector4_t) {0};
+        mesh->bounds_min = (agfx_vector3_t) {0};
+        mesh->bounds_max = (agfx_vector3_t) {0};
+        return;
+    }
+
+    agfx_vector3_t min = mesh->vertices[0].position;
+    agfx_vector3_t max = mesh->vertices[0].position;
+    for (size_t i = 1; i < mesh->vertices_count; ++i)
+    {
+        agfx_vector3_t position = mesh->vertices[i].position;
+        min.x = fminf(min.x, position.x); max.x = fmaxf(max.x, position.x);
+        min.y = fminf(min.y, position.y); max.y = fmaxf(max.y, position.y);
+        min.z = fminf(min.z, position.z); max.z = fmaxf(max.z, position.z);
+    }
+
+    agfx_vector3_t center = {
+        .x = (min.x + max.x) * 0.5f,
+        .y = (min.y + max.y) * 0.5f,
+        .z = (min.z + max.z) * 0.5f
+    };
+
+    float radius_squared = 0.0f;
+    for (size_t i = 0; i < mesh->vertices_count; ++i)
+    {
+        float dx = mesh->vertices[i].position.x - center.x;
+        float dy = mesh->vertices[i].position.y - center.y;
+        float dz = mesh->vertices[i].position.z - center.z;
+        radius_squared = fmaxf(radius_squared, dx * dx + dy * dy + dz * dz);
+    }
+
+    mesh->bounding_sphere = (agfx_vector4_t) {.x = center.x, .y = center.y, .z = center.z, .w = sqrtf(radius_squared)};
+    mesh->bounds_min = min;
+    mesh->bounds_max = max;
+}
+
+typedef struct agfx_model_loader_t {
+    agltf_glb_t* model;
+    // every glTF primitive in mesh order, mesh_first_primitive says where each glTF mesh starts
+    uint32_t* primitive_meshes;
+    size_t* mesh_first_primitive;
+    size_t instances_capacity;
+    size_t meshes_capacity;
+    // each loaded mesh's copy with the winding turned around, made the first time a mirroring transform places it
+    uint32_t* mirrored_meshes;
+} agfx_model_loader_t;
+
+// two primitives are the same mesh if they read the same accessors with the same material
+static uint32_t find_loaded_primitive(agltf_json_mesh_primitive_t** loaded_primitives, size_t loaded_count, agltf_json_mesh_primitive_t* primitive)
+{
+    for (size_t i = 0; i < loaded_count; ++i)
+    {
+        agltf_json_mesh_primitive_t* loaded = loaded_primitives[i];
+        if (loaded->indices != primitive->indices || loaded->material != primitive->material || loaded->attribute_count != primitive->attribute_count)
+        {
+            continue;
+        }
+
+        size_t attribute_index = 0;
+        while (attribute_index < primitive->attribute_count
+            && loaded->attributes[attribute_index].accessor == primitive->attributes[attribute_index].accessor
+            && strcmp(loaded->attributes[attribute_index].name, primitive->attributes[attribute_index].name) == 0)
+        {
+            attribute_index++;
+        }
+        if (attribute_index == primitive->attribute_count)
+        {
+            return (uint32_t)i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+// texture coordinates and colors may also come quantized to bytes or shorts, they are widened back to floats here so the
+// vertex streams and the shaders only ever see one format. a primitive with any other type fails to load
+static uint32_t is_vertex_component_type_supported(agltf_json_accessor_t* accessor)
+{
+    switch (accessor->component_type)
+    {
+        case AGLTF_JSON_COMPONENT_TYPE_FLOAT:
+        case AGLTF_JSON_COMPONENT_TYPE_SIGNED_BYTE:
+        case AGLTF_JSON_COMPONENT_TYPE_UNSIGNED_BYTE:
+        case AGLTF_JSON_COMPONENT_TYPE_SIGNED_SHORT:
+        case AGLTF_JSON_COMPONENT_TYPE_UNSIGNED_SHORT: return 1;
+        default: return 0;
+    }
+}
+
+// only normalized integers map to [0, 1] or [-1, 1], the rest keep their value. the most negative signed one clamps to -1
+static float read_vertex_component(agltf_json_accessor_t* accessor, uint32_t vertex_index, uint32_t component)
+{
+    size_t index = (size_t)vertex_index * accessor->data.number_of_components + component;
+    switch (accessor->component_type)
+    {
+        case AGLTF_JSON_COMPONENT_TYPE_SIGNED_BYTE:
+        {
+            float value = ((int8_t*)accessor->data.data)[index];
+            return accessor->normalized ? fmaxf(value / 127.0f, -1.0f) : value;
+        }
+        case AGLTF_JSON_COMPONENT_TYPE_UNSIGNED_BYTE:
+        {
+            float value = ((uint8_t*)accessor->data.data)[index];
+            return accessor->normalized ? value / 255.0f : value;
+        }
+        case AGLTF_JSON_COMPONENT_TYPE_SIGNED_SHORT:
+        {
+            float value = ((int16_t*)accessor->data.data)[index];
+            return accessor->normalized ? fmaxf(value / 32767.0f, -1.0f) : value;
+        }
+        case AGLTF_JSON_COMPONENT_TYPE_UNSIGNED_SHORT:
+        {
+            float value = ((uint16_t*)accessor->data.data)[index];
+            return accessor->normalized ? value / 65535.0f : value;
+        }
+        default: return ((float*)accessor->data.data)[index];
+    }
+}
+
+agfx_result_t load_mesh_primitive(agfx_renderer_t *renderer, agltf_json_mesh_primitive_t* primitive, agfx_mesh_t* engine_mesh)
+{
+    // non indexed primitives are not supported yet
+    if (NULL == primitive->indices)
+    {
+        return AGFX_MODEL_LOAD_ERROR;
+    }
+
+    engine_mesh->indices_count = primitive->indices->count;
+    engine_mesh->indices = calloc(engine_mesh->indices_count, sizeof(uint32_t));
+
+    void* starting_point = primitive->indices->data.data;
+    void* ending_point = starting_point + primitive->indices->data.size;
+    for (void* current = starting_point; current != ending_point; current += primitive->indices->data.size_of_element)
+    {
+        size_t index = (current - starting_point) / primitive->indices->data.size_of_element;
+        switch (primitive->indices->component_type)
+        {
+            case AGLTF_JSON_COMPONENT_TYPE_UNSIGNED_BYTE: engine_mesh->indices[index] = *(uint8_t*)current; goto after_component_type_switch;
+            case AGLTF_JSON_COMPONENT_TYPE_UNSIGNED_SHORT: engine_mesh->indices[index] = *(uint16_t*)current; goto after_component_type_switch;
+            case AGLTF_JSON_COMPONENT_TYPE_UNSIGNED_INT: engine_mesh->indices[index] = *(uint32_t*)current; goto after_component_type_switch;
+        }
+        after_component_type_switch:
+    }
+
+    for (size_t attribute_index = 0; attribute_index < primitive->attribute_count; ++attribute_index)
+    {
+        agltf_json_mesh_primitive_attribute_t* attribute = &primitive->attributes[attribute_index];
+        if (strcmp("POSITION", attribute->name) == 0)
+        {
+            if (attribute->accessor->data.number_of_components != 3)
+            {
+                return AGFX_MODEL_LOAD_ERROR;
+            }
+            engine_mesh->vertices_count = attribute->accessor->count;
+            engine_mesh->vertices = calloc(engine_mesh->vertices_count, sizeof(agfx_vertex_t));
+
+            float* starting_point = (float*)attribute->accessor->data.data;
+            float* ending_point = starting_point + (attribute->accessor->data.size / sizeof(float));
+            for (float* current = starting_point; current != ending_point; current += attribute->accessor->data.number_of_components)
+            {
+                int vertex_index = (current - starting_point) / attribute->accessor->data.number_of_components;
+                engine_mesh->vertices[vertex_index].position.x = *current;
+                engine_mesh->vertices[vertex_index].position.y = *(current + 1);
+                engine_mesh->vertices[vertex_index].position.z = *(current + 2);
+            }
+        }
+    }
+
+    if (NULL == engine_mesh->vertices)
+    {
+        return AGFX_MODEL_LOAD_ERROR;
+    }
+
+    // white unless the primitive has colors of its own, a material with vertex colors multiplies by them either way
+    for (size_t vertex_index = 0; vertex_index < engine_mesh->vertices_count; ++vertex_index)
+    {
+        engine_mesh->vertices[vertex_index].color = (agfx_vector4_t) {.x = 1.0f, .y = 1.0f, .z = 1.0f, .w = 1.0f};
+    }
+
+    // after the positions, whichever order the attributes come in
+    for (size_t attribute_index = 0; attribute_index < primitive->attribute_count; ++attribute_index)
+    {
+        agltf_json_mesh_primitive_attribute_t* attribute = &primitive->attributes[attribute_index];
+        agltf_json_accessor_t* accessor = attribute->accessor;
+        if (strcmp("TEXCOORD_0", attribute->name) == 0)
+        {
+            if (accessor->data.number_of_components != 2 || accessor->count != engine_mesh->vertices_count || !is_vertex_component_type_supported(accessor))
+            {
+                return AGFX_MODEL_LOAD_ERROR;
+            }
+            for (uint32_t vertex_index = 0; vertex_index < accessor->count; ++vertex_index)
+            {
+                engine_mesh->vertices[vertex_index].texture_coordinate.x = read_vertex_component(accessor, vertex_index, 0);
+                engine_mesh->vertices[vertex_index].texture_coordinate.y = read_vertex_component(accessor, vertex_index, 1);
+            }
+        }
+        if (strcmp("COLOR_0", attribute->name) == 0)
+        {
+            if (accessor->data.number_of_components < 3 || accessor->count != engine_mesh->vertices_count || !is_vertex_component_type_supported(accessor))
+            {
+                return AGFX_MODEL_LOAD_ERROR;
+            }
+            // a vec4 color's alpha multiplies the base color's alpha like its rgb does the rest
+            for (uint32_t vertex_index = 0; vertex_index < accessor->count; ++vertex_index)
+            {
+                engine_mesh->vertices[vertex_index].color.x = read_vertex_component(accessor, vertex_index, 0);
+                engine_mesh->vertices[vertex_index].color.y = read_vertex_component(accessor, vertex_index, 1);
+                engine_mesh->vertices[vertex_index].color.z = read_vertex_component(accessor, vertex_index, 2);
+                if (4 == accessor->data.number_of_components)
+                {
+                    engine_mesh->vertices[vertex_index].color.w = read_vertex_component(accessor, vertex_index, 3);
+                }
+            }
+        }
+    }
+
+    engine_mesh->material_index = NULL != primitive->material ? (uint32_t)primitive->material->index : (uint32_t)(renderer->materials_count - 1);
+    compute_mesh_bounds(engine_mesh);
+    return AGFX_SUCCESS;
+}
+
+// a negative determinant turns the triangles' winding around on screen along with the mesh
+static uint32_t transform_is_mirrored(agfx_mat4x4_t transform)
+{
+    agfx_vector3_t x = {transform.mat[0].x, transform.mat[0].y, transform.mat[0].z};
+    agfx_vector3_t y = {transform.mat[1].x, transform.mat[1].y, transform.mat[1].z};
+    agfx_vector3_t z = {transform.mat[2].x, transform.mat[2].y, transform.mat[2].z};
+    return agfx_vector3_dot(agfx_vector3_cross(x, y), z) < 0.0f;
+}
+
+// the mesh with two indices of every triangle swapped, so a mirrored placement still faces out under back face culling.
+// it runs before lods and meshlets are built, those come from the copy's own indices
+static agfx_result_t mirrored_mesh(agfx_renderer_t *renderer, agfx_model_loader_t* loader, uint32_t mesh_index, uint32_t* out_mesh_index)
+{
+    if (UINT32_MAX != loader->mirrored_meshes[mesh_index])
+    {
+        *out_mesh_index = loader->mirrored_meshes[mesh_index];
+        return AGFX_SUCCESS;
+    }
+
+    if (renderer->meshes_count == loader->meshes_capacity)
+    {
+        agfx_mesh_t* meshes = realloc(renderer->meshes, sizeof(agfx_mesh_t) * loader->meshes_capacity * 2);
+        if (NULL == meshes)
+        {
+            return AGFX_MODEL_LOAD_ERROR;
+        }
+        renderer->meshes = meshes;
+        loader->meshes_capacity *= 2;
+    }
+
+    agfx_mesh_t* mesh = &renderer->meshes[mesh_index];
+    agfx_mesh_t mirrored = *mesh;
+    mirrored.vertices = malloc(sizeof(agfx_vertex_t) * (mesh->vertices_count > 0 ? mesh->vertices_count : 1));
+    mirrored.indices = malloc(sizeof(uint32_t) * (mesh->indices_count > 0 ? mesh->indices_count : 1));
+    if (NULL == mirrored.vertices || NULL == mirrored.indices)
+    {
+        free(mirrored.vertices);
+        free(mirrored.indices);
+        return AGFX_MODEL_LOAD_ERROR;
+    }
+
+    memcpy(mirrored.vertices, mesh->vertices, sizeof(agfx_vertex_t) * mesh->vertices_count);
+    memcpy(mirrored.indices, mesh->indices, sizeof(uint32_t) * mesh->indices_count);
+    for (size_t index = 0; index + 2 < mesh->indices_count; index += 3)
+    {
+        mirrored.indices[index + 1] = mesh->indices[index + 2];
+        mirrored.indices[index + 2] = mesh->indices[index + 1];
+    }
+
+    *out_mesh_index = (uint32_t)renderer->meshes_count;
+    loader->mirrored_meshes[mesh_index] = *out_mesh_index;
+    renderer->meshes[renderer->meshes_count++] = mirrored;
+    return AGFX_SUCCESS;
+}
+
+static agfx_result_t push_instance(agfx_renderer_t *renderer, agfx_model_loader_t* loader, agfx_mat4x4_t transform, uint32_t mesh_index)
+{
+    if (transform_is_mirrored(transform))
+    {
+        agfx_result_t result = mirrored_mesh(renderer, loader, mesh_index, &mesh_index);
+        if (AGFX_SUCCESS != result) return result;
+    }
+
+    if (renderer->instances_count == loader->instances_capacity)
+    {
+        size_t instances_capacity = loader->instances_capacity > 0 ? loader->instances_capacity * 2 : renderer->meshes_count + 1;
+        agfx_instance_t* instances = realloc(renderer->instances, sizeof(agfx_instance_t) * instances_capacity);
+        if (NULL == instances)
+        {
+            return AGFX_MODEL_LOAD_ERROR;
+        }
+        renderer->instances = instances;
+        loader->instances_capacity = instances_capacity;
+    }
+
+    renderer->instances[renderer->instances_count++] = (agfx_instance_t) {
+        .transform = transform,
+        .mesh_index = mesh_index
+    };
+    return AGFX_SUCCESS;
+}
+
+// instancing rotations may also come as normalized bytes or shorts
+static float read_instancing_component(agltf_json_accessor_t* accessor, uint32_t instance_index, uint32_t component)
+{
+    size_t index = (size_t)instance_index * accessor->data.number_of_components + component;
+    switch (accessor->component_type)
     {
-        return AGFX_SAMPLER_CREATE_ERROR;
+        case AGLTF_JSON_COMPONENT_TYPE_FLOAT: return ((float*)accessor->data.data)[index];
+        case AGLTF_JSON_COMPONENT_TYPE_SIGNED_BYTE: return fmaxf(((int8_t*)accessor->data.data)[index] / 127.0f, -1.0f);
+        case AGLTF_JSON_COMPONENT_TYPE_SIGNED_SHORT: return fmaxf(((int16_t*)accessor->data.data)[index] / 32767.0f, -1.0f);
+        default: return 0.0f;
+    }
+}
+
+static agfx_mat4x4_t translation_rotation_scale(agfx_vector3_t translation, agfx_vector4_t rotation, agfx_vector3_t scale)
+{
+    return agfx_mat4x4_multiplied_by_mat4x4(agfx_mat4x4_translation(translation), agfx_mat4x4_multiplied_by_mat4x4(agfx_mat4x4_rotation_quaternion(rotation), agfx_mat4x4_scale(scale)));
+}
+
+static agfx_mat4x4_t node_local_transform(agltf_json_node_t* node)
+{
+    if (node->has_matrix)
+    {
+        agfx_mat4x4_t matrix;
+        for (int column = 0; column < 4; ++column)
+        {
+            matrix.mat[column] = (agfx_vector4_t) {node->matrix[column * 4], node->matrix[column * 4 + 1], node->matrix[column * 4 + 2], node->matrix[column * 4 + 3]};
+        }
+        return matrix;
+    }
+
+    return translation_rotation_scale(
+        (agfx_vector3_t) {node->translation[0], node->translation[1], node->translation[2]},
+        (agfx_vector4_t) {node->rotation[0], node->rotation[1], node->rotation[2], node->rotation[3]},
+        (agfx_vector3_t) {node->scale[0], node->scale[1], node->scale[2]}
+    );
+}
+
+// EXT_mesh_gpu_instancing transforms are relative to the node, a missing attribute is its identity part
+static agfx_mat4x4_t node_instance_transform(agltf_json_node_instancing_t* instancing, uint32_t instance_index)
+{
+    agfx_vector3_t translation = {0.0f, 0.0f, 0.0f};
+    agfx_vector4_t rotation = {0.0f, 0.0f, 0.0f, 1.0f};
+    agfx_vector3_t scale = {1.0f, 1.0f, 1.0f};
+
+    if (NULL != instancing->translation)
+    {
+        translation = (agfx_vector3_t) {read_instancing_component(instancing->translation, instance_index, 0), read_instancing_component(instancing->translation, instance_index, 1), read_instancing_component(instancing->translation, instance_index, 2)};
+    }
+    if (NULL != instancing->rotation)
+    {
+        rotation = (agfx_vector4_t) {read_instancing_component(instancing->rotation, instance_index, 0), read_instancing_component(instancing->rotation, instance_index, 1), read_instancing_component(instancing->rotation, instance_index, 2), read_instancing_component(instancing->rotation, instance_index, 3)};
+    }
+    if (NULL != instancing->scale)
+    {
+        scale = (agfx_vector3_t) {read_instancing_component(instancing->scale, instance_index, 0), read_instancing_component(instancing->scale, instance_index, 1), read_instancing_component(instancing->scale, instance_index, 2)};
+    }
+
+    return translation_rotation_scale(translation, rotation, scale);
+}
+
+// every primitive of the node's mesh gets an instance per placement, the extension turns one node into many placements
+static agfx_result_t add_node_instances(agfx_renderer_t *renderer, agfx_model_loader_t* loader, size_t node_index, agfx_mat4x4_t parent_transform, uint32_t depth)
+{
+    if (node_index >= loader->model->nodes_count || depth > AGFX_MODEL_MAX_NODE_DEPTH)
+    {
+        return AGFX_MODEL_LOAD_ERROR;
+    }
+
+    agltf_json_node_t* node = &loader->model->nodes[node_index];
+    agfx_mat4x4_t transform = agfx_mat4x4_multiplied_by_mat4x4(parent_transform, node_local_transform(node));
+
+    if (NULL != node->mesh)
+    {
+        size_t first_primitive = loader->mesh_first_primitive[node->mesh - loader->model->meshes];
+        uint32_t placements_count = node->instancing.count > 0 ? node->instancing.count : 1;
+        for (uint32_t placement = 0; placement < placements_count; ++placement)
+        {
+            agfx_mat4x4_t placement_transform = node->instancing.count > 0 ? agfx_mat4x4_multiplied_by_mat4x4(transform, node_instance_transform(&node->instancing, placement)) : transform;
+            for (size_t primitive_index = 0; primitive_index < node->mesh->primitives_count; ++primitive_index)
+            {
+                agfx_result_t result = push_instance(renderer, loader, placement_transform, loader->primitive_meshes[first_primitive + primitive_index]);
+                if (AGFX_SUCCESS != result) return result;
+            }
+        }
+    }
+
+    for (size_t child_index = 0; child_index < node->children_count; ++child_index)
+    {
+        agfx_result_t result = add_node_instances(renderer, loader, node->children[child_index], transform, depth + 1);
+        if (AGFX_SUCCESS != result) return result;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+// the roots are the nodes nobody lists as a child. a file without nodes places every primitive once where it is
+static agfx_result_t create_instances(agfx_renderer_t *renderer, agfx_model_loader_t* loader)
+{
+    agfx_result_t result = AGFX_SUCCESS;
+    agltf_glb_t* model = loader->model;
+    agfx_mat4x4_t identity = agfx_mat4x4_create_diagonal(1.0f);
+
+    renderer->instances_count = 0;
+    renderer->instances = NULL;
+
+    if (0 == model->nodes_count)
+    {
+        size_t primitives_count = loader->mesh_first_primitive[model->meshes_count];
+        for (size_t primitive_index = 0; primitive_index < primitives_count && AGFX_SUCCESS == result; ++primitive_index)
+        {
+            result = push_instance(renderer, loader, identity, loader->primitive_meshes[primitive_index]);
+        }
+        return result;
+    }
+
+    uint8_t* is_child = calloc(model->nodes_count, sizeof(uint8_t));
+    if (NULL == is_child)
+    {
+        return AGFX_MODEL_LOAD_ERROR;
+    }
+
+    for (size_t node_index = 0; node_index < model->nodes_count; ++node_index)
+    {
+        agltf_json_node_t* node = &model->nodes[node_index];
+        for (size_t child_index = 0; child_index < node->children_count; ++child_index)
+        {
+            if (node->children[child_index] < model->nodes_count) is_child[node->children[child_index]] = 1;
+        }
+    }
+
+    for (size_t node_index = 0; node_index < model->nodes_count && AGFX_SUCCESS == result; ++node_index)
+    {
+        if (!is_child[node_index])
+        {
+            result = add_node_instances(renderer, loader, node_index, identity, 0);
+        }
+    }
+
+    free(is_child);
+    return result;
+}
+
+// a counting sort by mesh, so every mesh's instances are one range of the object buffer
+agfx_result_t group_instances_by_mesh(agfx_renderer_t *renderer)
+{
+    agfx_instance_t* grouped = malloc(sizeof(agfx_instance_t) * (renderer->instances_count > 0 ? renderer->instances_count : 1));
+    if (NULL == grouped)
+    {
+        return AGFX_MODEL_LOAD_ERROR;
+    }
+
+    for (size_t mesh_index = 0; mesh_index < renderer->meshes_count; ++mesh_index)
+    {
+        renderer->meshes[mesh_index].instances_count = 0;
+    }
+    for (size_t instance_index = 0; instance_index < renderer->instances_count; ++instance_index)
+    {
+        renderer->meshes[renderer->instances[instance_index].mesh_index].instances_count++;
+    }
+
+    uint32_t first_instance = 0;
+    for (size_t mesh_index = 0; mesh_index < renderer->meshes_count; ++mesh_index)
+    {
+        agfx_mesh_t* mesh = &renderer->meshes[mesh_index];
+        mesh->first_instance = first_instance;
+        first_instance += mesh->instances_count;
+        mesh->instances_count = 0;
+    }
+
+    for (size_t instance_index = 0; instance_index < renderer->instances_count; ++instance_index)
+    {
+        agfx_mesh_t* mesh = &renderer->meshes[renderer->instances[instance_index].mesh_index];
+        grouped[mesh->first_instance + mesh->instances_count++] = renderer->instances[instance_index];
+    }
+
+    free(renderer->instances);
+    renderer->instances = grouped;
+    return AGFX_SUCCESS;
+}
+
+typedef struct agfx_static_batch_item_t {
+    uint64_t key;
+    agfx_vector3_t center;
+    uint32_t instance_index;
+} agfx_static_batch_item_t;
+
+// material first, then along the morton curve. the instance index keeps equal keys in load order
+static int compare_static_batch_items(const void* a, const void* b)
+{
+    const agfx_static_batch_item_t* item_a = (const agfx_static_batch_item_t*)a;
+    const agfx_static_batch_item_t* item_b = (const agfx_static_batch_item_t*)b;
+    if (item_a->key != item_b->key) return item_a->key < item_b->key ? -1 : 1;
+    return item_a->instance_index < item_b->instance_index ? -1 : (item_a->instance_index > item_b->instance_index ? 1 : 0);
+}
+
+// spreads the low 10 bits of a cell coordinate three apart, so x, y and z interleave into a 30 bit morton code
+static uint32_t spread_morton_bits(uint32_t value)
+{
+    value &= (1u << AGFX_STATIC_BATCH_MORTON_BITS) - 1;
+    value = (value | (value << 16)) & 0x030000ff;
+    value = (value | (value << 8)) & 0x0300f00f;
+    value = (value | (value << 4)) & 0x030c30c3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+}
+
+static uint32_t morton_cell(float value, float min, float extent)
+{
+    float cell = (value - min) / extent * (float)((1u << AGFX_STATIC_BATCH_MORTON_BITS) - 1);
+    return cell > 0.0f ? (uint32_t)cell : 0;
+}
+
+// the chunk's vertices are baked into world space, so the merged mesh is drawn with an identity transform. a mirroring
+// transform already placed the copy with the turned around winding, so its baked triangles still face out
+static agfx_result_t merge_static_chunk(agfx_renderer_t *renderer, agfx_static_batch_item_t* items, size_t items_count, agfx_mesh_t* out_mesh)
+{
+    agfx_mesh_t merged = {0};
+
+    for (size_t i = 0; i < items_count; ++i)
+    {
+        agfx_mesh_t* mesh = &renderer->meshes[renderer->instances[items[i].instance_index].mesh_index];
+        merged.vertices_count += mesh->vertices_count;
+        merged.indices_count += mesh->indices_count;
+    }
+
+    merged.vertices = malloc(sizeof(agfx_vertex_t) * (merged.vertices_count > 0 ? merged.vertices_count : 1));
+    merged.indices = malloc(sizeof(uint32_t) * (merged.indices_count > 0 ? merged.indices_count : 1));
+    if (NULL == merged.vertices || NULL == merged.indices)
+    {
+        free(merged.vertices);
+        free(merged.indices);
+        return AGFX_MODEL_LOAD_ERROR;
     }
 
+    size_t vertices_count = 0;
+    size_t indices_count = 0;
+    for (size_t i = 0; i < items_count; ++i)
+    {
+        agfx_instance_t* instance = &renderer->instances[items[i].instance_index];
+        agfx_mesh_t* mesh = &renderer->meshes[instance->mesh_index];
+        for (size_t vertex_index = 0; vertex_index < mesh->vertices_count; ++vertex_index)
+        {
+            agfx_vertex_t vertex = mesh->vertices[vertex_index];
+            agfx_vector4_t position = agfx_mat4x4_multiplied_by_vector4(instance->transform, (agfx_vector4_t) {.x = vertex.position.x, .y = vertex.position.y, .z = vertex.position.z, .w = 1.0f});
+            vertex.position = (agfx_vector3_t) {position.x, position.y, position.z};
+            merged.vertices[vertices_count + vertex_index] = vertex;
+        }
+        for (size_t index = 0; index < mesh->indices_count; ++index)
+        {
+            merged.indices[indices_count + index] = mesh->indices[index] + (uint32_t)vertices_count;
+        }
+        vertices_count += mesh->vertices_count;
+        indices_count += mesh->indices_count;
+    }
+
+    merged.material_index = renderer->meshes[renderer->instances[items[0].instance_index].mesh_index].material_index;
+    compute_mesh_bounds(&merged);
+
+    *out_mesh = merged;
     return AGFX_SUCCESS;
 }
 
-void free_texture_sampler_for_mesh(agfx_renderer_t *renderer, agfx_mesh_t* mesh)
+// small primitives placed once and sharing a material are merged at load, so a CAD export of thousands of tiny parts
+// becomes a handful of draws. candidates are sorted by material and then along a morton curve through the scene, and a
+// chunk closes when its vertex budget is spent, which keeps every merged mesh compact enough for culling to still work.
+// meshes placed more than once stay instanced, they already collapse into one draw
+agfx_result_t batch_static_meshes(agfx_renderer_t *renderer)
+{
+    agfx_result_t result = AGFX_SUCCESS;
+    agfx_static_batch_stats_t* stats = &renderer->static_batch_stats;
+
+    agfx_static_batch_item_t* items = malloc(sizeof(agfx_static_batch_item_t) * (renderer->instances_count > 0 ? renderer->instances_count : 1));
+    if (NULL == items)
+    {
+        return AGFX_MODEL_LOAD_ERROR;
+    }
+
+    size_t items_count = 0;
+    agfx_vector3_t scene_min = {FLT_MAX, FLT_MAX, FLT_MAX};
+    agfx_vector3_t scene_max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (size_t instance_index = 0; instance_index < renderer->instances_count; ++instance_index)
+    {
+        agfx_instance_t* instance = &renderer->instances[instance_index];
+        agfx_mesh_t* mesh = &renderer->meshes[instance->mesh_index];
+        if (1 != mesh->instances_count || mesh->vertices_count > AGFX_STATIC_BATCH_MAX_MESH_VERTICES)
+        {
+            continue;
+        }
+
+        agfx_vector4_t center = agfx_mat4x4_multiplied_by_vector4(instance->transform, (agfx_vector4_t) {.x = mesh->bounding_sphere.x, .y = mesh->bounding_sphere.y, .z = mesh->bounding_sphere.z, .w = 1.0f});
+        scene_min = (agfx_vector3_t) {fminf(scene_min.x, center.x), fminf(scene_min.y, center.y), fminf(scene_min.z, center.z)};
+        scene_max = (agfx_vector3_t) {fmaxf(scene_max.x, center.x), fmaxf(scene_max.y, center.y), fmaxf(scene_max.z, center.z)};
+        items[items_count++] = (agfx_static_batch_item_t) {
+            .center = {center.x, center.y, center.z},
+            .instance_index = (uint32_t)instance_index
+        };
+    }
+
+    if (items_count < 2)
+    {
+        free(items);
+        return AGFX_SUCCESS;
+    }
+
+    agfx_vector3_t extent = {
+        .x = fmaxf(scene_max.x - scene_min.x, FLT_MIN),
+        .y = fmaxf(scene_max.y - scene_min.y, FLT_MIN),
+        .z = fmaxf(scene_max.z - scene_min.z, FLT_MIN)
+    };
+    for (size_t i = 0; i < items_count; ++i)
+    {
+        agfx_static_batch_item_t* item = &items[i];
+        uint32_t morton = spread_morton_bits(morton_cell(item->center.x, scene_min.x, extent.x))
+            | (spread_morton_bits(morton_cell(item->center.y, scene_min.y, extent.y)) << 1)
+            | (spread_morton_bits(morton_cell(item->center.z, scene_min.z, extent.z)) << 2);
+        uint64_t material_index = renderer->meshes[renderer->instances[item->instance_index].mesh_index].material_index;
+        item->key = (material_index << (3 * AGFX_STATIC_BATCH_MORTON_BITS)) | morton;
+    }
+    qsort(items, items_count, sizeof(agfx_static_batch_item_t), compare_static_batch_items);
+
+    // every batch takes at least two meshes, so there are never more batches than half the candidates
+    agfx_mesh_t* batches = calloc(items_count / 2, sizeof(agfx_mesh_t));
+    uint8_t* is_batched = calloc(renderer->meshes_count, sizeof(uint8_t));
+    size_t batches_count = 0;
+    if (NULL == batches || NULL == is_batched)
+    {
+        result = AGFX_MODEL_LOAD_ERROR;
+        goto free_batches;
+    }
+
+    size_t chunk_end = 0;
+    for (size_t chunk_begin = 0; chunk_begin < items_count; chunk_begin = chunk_end)
+    {
+        uint32_t material_index = renderer->meshes[renderer->instances[items[chunk_begin].instance_index].mesh_index].material_index;
+        size_t chunk_vertices_count = 0;
+        for (chunk_end = chunk_begin; chunk_end < items_count; ++chunk_end)
+        {
+            agfx_mesh_t* mesh = &renderer->meshes[renderer->instances[items[chunk_end].instance_index].mesh_index];
+            if (mesh->material_index != material_index || (chunk_end > chunk_begin && chunk_vertices_count + mesh->vertices_count > AGFX_STATIC_BATCH_MAX_VERTICES))
+            {
+                break;
+            }
+            chunk_vertices_count += mesh->vertices_count;
+        }
+
+        if (chunk_end - chunk_begin < 2)
+        {
+            continue;
+        }
+
+        result = merge_static_chunk(renderer, &items[chunk_begin], chunk_end - chunk_begin, &batches[batches_count]);
+        if (AGFX_SUCCESS != result) goto free_batches;
+        batches_count++;
+
+        for (size_t i = chunk_begin; i < chunk_end; ++i)
+        {
+            is_batched[renderer->instances[items[i].instance_index].mesh_index] = 1;
+        }
+        stats->merged_primitives_count += (uint32_t)(chunk_end - chunk_begin);
+    }
+
+    // the merged meshes and their single instances drop out, the batches take their place at the end. both arrays only
+    // shrink, so everything is compacted where it is
+    uint32_t* mesh_remap = malloc(sizeof(uint32_t) * (renderer->meshes_count > 0 ? renderer->meshes_count : 1));
+    if (NULL == mesh_remap)
+    {
+        result = AGFX_MODEL_LOAD_ERROR;
+        goto free_batches;
+    }
+
+    size_t meshes_count = 0;
+    for (size_t mesh_index = 0; mesh_index < renderer->meshes_count; ++mesh_index)
+    {
+        agfx_mesh_t* mesh = &renderer->meshes[mesh_index];
+        if (is_batched[mesh_index])
+        {
+            free(mesh->vertices);
+            free(mesh->indices);
+            mesh_remap[mesh_index] = UINT32_MAX;
+            continue;
+        }
+        mesh_remap[mesh_index] = (uint32_t)meshes_count;
+        renderer->meshes[meshes_count++] = *mesh;
+    }
+
+    size_t instances_count = 0;
+    for (size_t instance_index = 0; instance_index < renderer->instances_count; ++instance_index)
+    {
+        agfx_instance_t instance = renderer->instances[instance_index];
+        if (UINT32_MAX == mesh_remap[instance.mesh_index])
+        {
+            continue;
+        }
+        instance.mesh_index = mesh_remap[instance.mesh_index];
+        renderer->instances[instances_count++] = instance;
+    }
+
+    for (size_t batch_index = 0; batch_index < batches_count; ++batch_index)
+    {
+        renderer->instances[instances_count++] = (agfx_instance_t) {
+            .transform = agfx_mat4x4_create_diagonal(1.0f),
+            .mesh_index = (uint32_t)meshes_count
+        };
+        renderer->meshes[meshes_count++] = batches[batch_index];
+    }
+
+    renderer->meshes_count = meshes_count;
+    renderer->instances_count = instances_count;
+    stats->batches_count = (uint32_t)batches_count;
+    batches_count = 0;
+
+    free(mesh_remap);
+    result = group_instances_by_mesh(renderer);
+
+free_batches:
+    for (size_t batch_index = 0; batch_index < batches_count; ++batch_index)
+    {
+        free(batches[batch_index].vertices);
+        free(batches[batch_index].indices);
+    }
+    free(is_batched);
+    free(batches);
+    free(items);
+    return result;
+}
+
+// every host copy a loaded mesh holds and the mesh table itself. never loaded pointers are null, the table comes from calloc
+static void free_meshes(agfx_renderer_t *renderer)
 {
-    vkDestroySampler(renderer->context->device, mesh->texture_sampler, NULL);
+    for (size_t mesh_index = 0; mesh_index < renderer->meshes_count; ++mesh_index)
+    {
+        agfx_mesh_t* mesh = &renderer->meshes[mesh_index];
+        free(mesh->vertices);
+        free(mesh->indices);
+        free(mesh->lod_indices);
+        free(mesh->meshlets);
+        free(mesh->meshlet_vertices);
+        free(mesh->meshlet_triangles);
+    }
+    free(renderer->meshes);
+    renderer->meshes = NULL;
+    renderer->meshes_count = 0;
 }
 
+// identical primitives load once however many glTF meshes or nodes use them, every use becomes an instance of that one mesh
 agfx_result_t load_model(agfx_renderer_t *renderer)
 {
     agfx_result_t result = AGFX_SUCCESS;
 
     agltf_glb_t model;
 
-    agltf_result_t model_result = agltf_create_glb("./models/test.glb", &model);
+    agltf_result_t model_result = agltf_create_glb(renderer->state->model_path, &model);
     if (model_result != AGLTF_SUCCESS) return AGFX_MODEL_LOAD_ERROR;
 
-    renderer->meshes_count = 0;
+    result = create_texture_table(renderer, &model);
+    if (AGFX_SUCCESS != result) goto free_model_file;
+
+    result = create_material_table(renderer, &model);
+    if (AGFX_SUCCESS != result) goto free_texture_table;
+
+    agfx_model_loader_t loader = {
+        .model = &model,
+        .mesh_first_primitive = calloc(model.meshes_count + 1, sizeof(size_t))
+    };
+    if (NULL == loader.mesh_first_primitive)
+    {
+        result = AGFX_MODEL_LOAD_ERROR;
+        goto free_material_table;
+    }
 
     for (size_t mesh_index = 0; mesh_index < model.meshes_count; ++mesh_index)
     {
-        renderer->meshes_count += model.meshes[mesh_index].primitives_count;
+        loader.mesh_first_primitive[mesh_index + 1] = loader.mesh_first_primitive[mesh_index] + model.meshes[mesh_index].primitives_count;
     }
+    size_t primitives_count = loader.mesh_first_primitive[model.meshes_count];
 
-    renderer->meshes = calloc(renderer->meshes_count, sizeof(agfx_mesh_t));
+    loader.primitive_meshes = calloc(primitives_count > 0 ? primitives_count : 1, sizeof(uint32_t));
+    agltf_json_mesh_primitive_t** loaded_primitives = calloc(primitives_count > 0 ? primitives_count : 1, sizeof(agltf_json_mesh_primitive_t*));
+    loader.mirrored_meshes = malloc(sizeof(uint32_t) * (primitives_count > 0 ? primitives_count : 1));
+    loader.meshes_capacity = primitives_count > 0 ? primitives_count : 1;
+    renderer->meshes = calloc(loader.meshes_capacity, sizeof(agfx_mesh_t));
+    renderer->meshes_count = 0;
+    if (NULL == loader.primitive_meshes || NULL == loaded_primitives || NULL == loader.mirrored_meshes || NULL == renderer->meshes)
+    {
+        result = AGFX_MODEL_LOAD_ERROR;
+        goto free_meshes;
+    }
+    memset(loader.mirrored_meshes, 0xFF, sizeof(uint32_t) * loader.meshes_capacity);
 
-    size_t engine_mesh_index = 0;
     for (size_t mesh_index = 0; mesh_index < model.meshes_count; ++mesh_index)
     {
         agltf_json_mesh_t* mesh = &model.meshes[mesh_index];
         for (size_t primitive_index = 0; primitive_index < mesh->primitives_count; ++primitive_index)
         {
-            agfx_mesh_t* engine_mesh = &renderer->meshes[engine_mesh_index];
             agltf_json_mesh_primitive_t* primitive = &mesh->primitives[primitive_index];
-            
-            engine_mesh->indices_count = primitive->indices->count;
-            engine_mesh->indices = calloc(engine_mesh->indices_count, sizeof(uint32_t));
-
-            void* starting_point = primitive->indices->data.data;
-            void* ending_point = starting_point + primitive->indices->data.size;
-            for (void* current = starting_point; current != ending_point; current += primitive->indices->data.size_of_element)
+            uint32_t engine_mesh_index = find_loaded_primitive(loaded_primitives, renderer->meshes_count, primitive);
+            if (UINT32_MAX == engine_mesh_index)
             {
-                size_t index = (current - starting_point) / primitive->indices->data.size_of_element;
-                switch (primitive->indices->component_type)
+                engine_mesh_index = (uint32_t)renderer->meshes_count;
+                result = load_mesh_primitive(renderer, primitive, &renderer->meshes[engine_mesh_index]);
+                if (AGFX_SUCCESS != result)
                 {
-                    case AGLTF_JSON_COMPONENT_TYPE_UNSIGNED_BYTE: engine_mesh->indices[index] = *(uint8_t*)current; goto after_component_type_switch;
-                    case AGLTF_JSON_COMPONENT_TYPE_UNSIGNED_SHORT: engine_mesh->indices[index] = *(uint16_t*)current; goto after_component_type_switch;
-                    case AGLTF_JSON_COMPONENT_TYPE_UNSIGNED_INT: engine_mesh->indices[index] = *(uint32_t*)current; goto after_component_type_switch;
+                    // whatever the primitive got to allocate is freed with the rest
+                    renderer->meshes_count++;
+                    goto free_meshes;
                 }
-                after_component_type_switch:
-            }
 
-            for (size_t attribute_index = 0; attribute_index < primitive->attribute_count; ++attribute_index)
-            {
-                agltf_json_mesh_primitive_attribute_t* attribute = &primitive->attributes[attribute_index];
-                if (strcmp("POSITION", attribute->name) == 0)
-                {
-                    if (attribute->accessor->data.number_of_components != 3)
-                    {
-                        return AGFX_MODEL_LOAD_ERROR;
-                    }
-                    engine_mesh->vertices_count = attribute->accessor->count;
-                    engine_mesh->vertices = calloc(engine_mesh->vertices_count, sizeof(agfx_vertex_t));
-
-                    float* starting_point = (float*)attribute->accessor->data.data;
-                    float* ending_point = starting_point + (attribute->accessor->data.size / sizeof(float));
-                    for (float* current = starting_point; current != ending_point; current += attribute->accessor->data.number_of_components)
-                    {
-                        int vertex_index = (current - starting_point) / attribute->accessor->data.number_of_components;
-                        engine_mesh->vertices[vertex_index].position.x = *current;
-                        engine_mesh->vertices[vertex_index].position.y = *(current + 1);
-                        engine_mesh->vertices[vertex_index].position.z = *(current + 2);
-                    }
-                }
-                if (strcmp("TEXCOORD_0", attribute->name) == 0)
-                {
-                    if (attribute->accessor->data.number_of_components != 2)
-                    {
-                        return AGFX_MODEL_LOAD_ERROR;
-                    }
-                    float* starting_point = (float*)attribute->accessor->data.data;
-                    float* ending_point = starting_point + (attribute->accessor->data.size / sizeof(float));
-                    for (float* current = starting_point; current != ending_point; current += attribute->accessor->data.number_of_components)
-                    {
-                        int vertex_index = (current - starting_point) / attribute->accessor->data.number_of_components;
-                        engine_mesh->vertices[vertex_index].texture_coordinate.x = *current;
-                        engine_mesh->vertices[vertex_index].texture_coordinate.y = *(current + 1);
-                    }
-                }
+                loaded_primitives[renderer->meshes_count++] = primitive;
             }
-
-            create_index_buffer_for_mesh(renderer, engine_mesh);
-            create_vertex_buffer_for_mesh(renderer, engine_mesh);
-            create_texture_image_for_mesh(renderer, engine_mesh, mesh->primitives->material->pbr.base_color_texture.texture->source->data.data, mesh->primitives->material->pbr.base_color_texture.texture->source->data.size);
-            create_texture_image_view_for_mesh(renderer, engine_mesh);
-            create_texture_sampler_for_mesh(renderer, engine_mesh);
-            create_uniform_buffers_for_mesh(renderer, engine_mesh);
-            engine_mesh_index++;
+            loader.primitive_meshes[loader.mesh_first_primitive[mesh_index] + primitive_index] = engine_mesh_index;
         }
     }
 
+    // per primitive and before batching, so merged meshes are made of already optimized pieces
+    renderer->mesh_optimizer_stats = (agfx_mesh_optimizer_stats_t) {0};
+    if (renderer->state->mesh_optimization)
+    {
+        agfx_optimize_meshes(renderer->job_system, renderer->meshes, renderer->meshes_count, &renderer->mesh_optimizer_stats);
+    }
+
+    result = create_instances(renderer, &loader);
+    if (AGFX_SUCCESS == result) result = group_instances_by_mesh(renderer);
+    renderer->static_batch_stats = (agfx_static_batch_stats_t) {0};
+    if (AGFX_SUCCESS == result && renderer->state->static_batching) result = batch_static_meshes(renderer);
+    if (AGFX_SUCCESS != result) goto free_instances;
+
+    // after batching, so a merged chunk simplifies as one piece and its seams between primitives stay locked
+    renderer->lod_stats = (agfx_lod_stats_t) {0};
+    if (renderer->state->lod_generation)
+    {
+        agfx_build_lods(renderer->job_system, renderer->meshes, renderer->meshes_count, &renderer->lod_stats);
+    }
+
+    // after the chain, every level gets its own meshlets cut from the order it already has, so the cache order stays
+    renderer->meshlet_stats = (agfx_meshlet_stats_t) {0};
+    if (renderer->state->meshlet_generation)
+    {
+        agfx_build_meshlets(renderer->job_system, renderer->meshes, renderer->meshes_count, &renderer->meshlet_stats);
+    }
+
+    free(loaded_primitives);
+    free(loader.primitive_meshes);
+    free(loader.mirrored_meshes);
+    free(loader.mesh_first_primitive);
     agltf_free_glb(&model);
 
+    result = create_geometry_buffer(renderer);
+    if (AGFX_SUCCESS == result)
+    {
+        result = create_meshlet_buffers(renderer);
+        if (AGFX_SUCCESS != result) free_geometry_buffer(renderer);
+    }
+    if (AGFX_SUCCESS == result)
+    {
+        result = create_lod_buffer(renderer);
+        if (AGFX_SUCCESS != result)
+        {
+            free_meshlet_buffers(renderer);
+            free_geometry_buffer(renderer);
+        }
+    }
+    if (AGFX_SUCCESS != result)
+    {
+        free(renderer->instances);
+        free_meshes(renderer);
+        free_material_table(renderer);
+        free_texture_table(renderer);
+    }
+
+    return result;
+
+free_instances:
+    free(renderer->instances);
+free_meshes:
+    free_meshes(renderer);
+    free(loaded_primitives);
+    free(loader.primitive_meshes);
+    free(loader.mirrored_meshes);
+    free(loader.mesh_first_primitive);
+free_material_table:
+    free_material_table(renderer);
+free_texture_table:
+    free_texture_table(renderer);
+free_model_file:
+    agltf_free_glb(&model);
     return result;
 }
 
 void free_model(agfx_renderer_t *renderer)
 {
-    for (size_t i = 0; i < renderer->meshes_count; ++i)
-    {
-        free_index_buffer_for_mesh(renderer, &renderer->meshes[i]);
-        free_vertex_buffer_for_mesh(renderer, &renderer->meshes[i]);
-        free_texture_image_for_mesh(renderer, &renderer->meshes[i]);
-        free_texture_image_view_for_mesh(renderer, &renderer->meshes[i]);
-        free_texture_sampler_for_mesh(renderer, &renderer->meshes[i]);
-        free_uniform_buffers_for_mesh(renderer, &renderer->meshes[i]);
-    }
+    free_material_table(renderer);
+    free_texture_table(renderer);
+    free_lod_buffer(renderer);
+    free_meshlet_buffers(renderer);
+    free_geometry_buffer(renderer);
+    free(renderer->instances);
+    free_meshes(renderer);
 }
\ No newline at end of file
@@ -0,0 +1,435 @@
+#include "software_occlusion.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// anything closer than this to the camera plane is treated as crossing the near plane
+#define AGFX_OCCLUSION_MIN_W 1e-5f
+
+agfx_result_t agfx_create_software_occlusion(uint32_t width, uint32_t height, size_t triangles_capacity, size_t objects_capacity, agfx_software_occlusion_t* out_software_occlusion)
+{
+    agfx_software_occlusion_t software_occlusion = {0};
+
+    software_occlusion.tiles_x = (width + AGFX_OCCLUSION_TILE_WIDTH - 1) / AGFX_OCCLUSION_TILE_WIDTH;
+    software_occlusion.tiles_y = (height + AGFX_OCCLUSION_TILE_HEIGHT - 1) / AGFX_OCCLUSION_TILE_HEIGHT;
+    software_occlusion.width = software_occlusion.tiles_x * AGFX_OCCLUSION_TILE_WIDTH;
+    software_occlusion.height = software_occlusion.tiles_y * AGFX_OCCLUSION_TILE_HEIGHT;
+    software_occlusion.triangles_capacity = triangles_capacity;
+    software_occlusion.objects_capacity = objects_capacity > 0 ? objects_capacity : 1;
+
+    software_occlusion.tiles = calloc((size_t)software_occlusion.tiles_x * software_occlusion.tiles_y, sizeof(agfx_occlusion_tile_t));
+    software_occlusion.triangles = calloc(triangles_capacity > 0 ? triangles_capacity : 1, sizeof(agfx_occlusion_triangle_t));
+    software_occlusion.visibility = calloc(software_occlusion.objects_capacity, sizeof(uint8_t));
+    if (NULL == software_occlusion.tiles || NULL == software_occlusion.triangles || NULL == software_occlusion.visibility)
+    {
+        agfx_free_software_occlusion(&software_occlusion);
+        return AGFX_BUFFER_ERROR;
+    }
+
+    agfx_software_occlusion_clear(&software_occlusion);
+
+    *out_software_occlusion = software_occlusion;
+    return AGFX_SUCCESS;
+}
+
+void agfx_free_software_occlusion(agfx_software_occlusion_t* software_occlusion)
+{
+    for (size_t i = 0; i < software_occlusion->occluders_count; ++i)
+    {
+        free(software_occlusion->occluders[i].positions);
+        free(software_occlusion->occluders[i].indices);
+    }
+    free(software_occlusion->occluders);
+    free(software_occlusion->visibility);
+    free(software_occlusion->triangles);
+    free(software_occlusion->tiles);
+    *software_occlusion = (agfx_software_occlusion_t) {0};
+}
+
+// keeps only the positions the indices reference, so a proxy of a big mesh stays small
+agfx_result_t agfx_software_occlusion_add_occluder_proxy(agfx_software_occlusion_t* software_occlusion, uint32_t mesh_index, const agfx_vertex_t* vertices, size_t vertices_count, const uint32_t* indices, size_t indices_count)
+{
+    agfx_occluder_t occluder = {
+        .mesh_index = mesh_index,
+        .indices_count = indices_count
+    };
+
+    uint32_t* remap = malloc(sizeof(uint32_t) * (vertices_count > 0 ? vertices_count : 1));
+    occluder.positions = malloc(sizeof(agfx_vector3_t) * (indices_count > 0 ? indices_count : 1));
+    occluder.indices = malloc(sizeof(uint32_t) * (indices_count > 0 ? indices_count : 1));
+    agfx_occluder_t* occluders = realloc(software_occlusion->occluders, sizeof(agfx_occluder_t) * (software_occlusion->occluders_count + 1));
+    if (NULL != occluders)
+    {
+        software_occlusion->occluders = occluders;
+    }
+    if (NULL == remap || NULL == occluder.positions || NULL == occluder.indices || NULL == occluders)
+    {
+        free(remap);
+        free(occluder.positions);
+        free(occluder.indices);
+        return AGFX_BUFFER_ERROR;
+    }
+
+    memset(remap, 0xff, sizeof(uint32_t) * vertices_count);
+    for (size_t i = 0; i < indices_count; ++i)
+    {
+        uint32_t index = indices[i];
+        if (UINT32_MAX == remap[index])
+        {
+            remap[index] = (uint32_t)occluder.positions_count;
+            occluder.positions[occluder.positions_count++] = vertices[index].position;
+        }
+        occluder.indices[i] = remap[index];
+    }
+    free(remap);
+
+    software_occlusion->occluders[software_occlusion->occluders_count++] = occluder;
+    return AGFX_SUCCESS;
+}
+
+// nothing drawn yet: every tile is as far as it gets and has an empty working layer
+void agfx_software_occlusion_clear(agfx_software_occlusion_t* software_occlusion)
+{
+    size_t tiles_count = (size_t)software_occlusion->tiles_x * software_occlusion->tiles_y;
+    for (size_t i = 0; i < tiles_count; ++i)
+    {
+        software_occlusion->tiles[i] = (agfx_occlusion_tile_t) {
+            .mask = 0,
+            .z_max0 = 1.0f,
+            .z_max1 = 0.0f
+        };
+    }
+    software_occlusion->triangles_count = 0;
+    software_occlusion->culled_count = 0;
+}
+
+static agfx_vector4_t to_clip(agfx_mat4x4_t model_view_projection, agfx_vector3_t position)
+{
+    return agfx_mat4x4_multiplied_by_vector4(model_view_projection, (agfx_vector4_t) {position.x, position.y, position.z, 1.0f});
+}
+
+// triangles that reach through the near plane are dropped instead of clipped, an occluder may only ever hide too little.
+// both windings are kept, a back face is behind its front face and never hides anything the front face does not
+void agfx_software_occlusion_add_triangles(agfx_software_occlusion_t* software_occlusion, const agfx_vector3_t* positions, const uint32_t* indices, size_t indices_count, agfx_mat4x4_t model_view_projection)
+{
+    float width = (float)software_occlusion->width;
+    float height = (float)software_occlusion->height;
+
+    for (size_t i = 0; i + 2 < indices_count; i += 3)
+    {
+        if (software_occlusion->triangles_count == software_occlusion->triangles_capacity)
+        {
+            return;
+        }
+
+        float x[3], y[3], z[3];
+        int rejected = 0;
+        for (int v = 0; v < 3; ++v)
+        {
+            agfx_vector4_t clip = to_clip(model_view_projection, positions[indices[i + v]]);
+            if (clip.w < AGFX_OCCLUSION_MIN_W || clip.z < 0.0f)
+            {
+                rejected = 1;
+                break;
+            }
+            x[v] = (clip.x / clip.w * 0.5f + 0.5f) * width;
+            y[v] = (clip.y / clip.w * 0.5f + 0.5f) * height;
+            z[v] = clip.z / clip.w;
+        }
+        if (rejected)
+        {
+            continue;
+        }
+
+        agfx_occlusion_triangle_t triangle;
+        float area = 0.0f;
+        for (int edge = 0; edge < 3; ++edge)
+        {
+            int from = edge;
+            int to = (edge + 1) % 3;
+            triangle.edge_a[edge] = y[from] - y[to];
+            triangle.edge_b[edge] = x[to] - x[from];
+            triangle.edge_c[edge] = -(triangle.edge_a[edge] * x[from] + triangle.edge_b[edge] * y[from]);
+        }
+        area = triangle.edge_a[0] * x[2] + triangle.edge_b[0] * y[2] + triangle.edge_c[0];
+        if (fabsf(area) < 1e-6f)
+        {
+            continue;
+        }
+        if (area < 0.0f)
+        {
+            for (int edge = 0; edge < 3; ++edge)
+            {
+                triangle.edge_a[edge] = -triangle.edge_a[edge];
+                triangle.edge_b[edge] = -triangle.edge_b[edge];
+                triangle.edge_c[edge] = -triangle.edge_c[edge];
+            }
+        }
+
+        float min_x = fminf(x[0], fminf(x[1], x[2]));
+        float max_x = fmaxf(x[0], fmaxf(x[1], x[2]));
+        float min_y = fminf(y[0], fminf(y[1], y[2]));
+        float max_y = fmaxf(y[0], fmaxf(y[1], y[2]));
+        triangle.min_x = (int32_t)fmaxf(floorf(min_x), 0.0f);
+        triangle.min_y = (int32_t)fmaxf(floorf(min_y), 0.0f);
+        triangle.max_x = (int32_t)fminf(ceilf(max_x), width - 1.0f);
+        triangle.max_y = (int32_t)fminf(ceilf(max_y), height - 1.0f);
+        if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y)
+        {
+            continue;
+        }
+
+        // depth is linear in screen space after the divide
+        float dx1 = x[1] - x[0], dy1 = y[1] - y[0], dz1 = z[1] - z[0];
+        float dx2 = x[2] - x[0], dy2 = y[2] - y[0], dz2 = z[2] - z[0];
+        float determinant = dx1 * dy2 - dx2 * dy1;
+        triangle.depth_a = (dz1 * dy2 - dz2 * dy1) / determinant;
+        triangle.depth_b = (dx1 * dz2 - dx2 * dz1) / determinant;
+        triangle.depth_c = z[0] - triangle.depth_a * x[0] - triangle.depth_b * y[0];
+        triangle.depth_min = fminf(z[0], fminf(z[1], z[2]));
+        triangle.depth_max = fmaxf(z[0], fmaxf(z[1], z[2]));
+
+        software_occlusion->triangles[software_occlusion->triangles_count++] = triangle;
+    }
+}
+
+// bit row * 8 + column is set for every pixel center inside all three edges
+static uint32_t tile_coverage(const agfx_occlusion_triangle_t* triangle, float tile_x, float tile_y)
+{
+    uint32_t coverage = AGFX_OCCLUSION_FULL_MASK;
+
+#if defined(__SSE2__)
+    __m128 steps = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 zero = _mm_setzero_ps();
+    for (int edge = 0; edge < 3; ++edge)
+    {
+        float a = triangle->edge_a[edge];
+        float b = triangle->edge_b[edge];
+        float start = a * (tile_x + 0.5f) + b * (tile_y + 0.5f) + triangle->edge_c[edge];
+        __m128 left = _mm_add_ps(_mm_set1_ps(start), _mm_mul_ps(_mm_set1_ps(a), steps));
+        __m128 right = _mm_add_ps(left, _mm_set1_ps(4.0f * a));
+        __m128 row_step = _mm_set1_ps(b);
+
+        uint32_t edge_coverage = 0;
+        for (int row = 0; row < AGFX_OCCLUSION_TILE_HEIGHT; ++row)
+        {
+            uint32_t left_bits = (uint32_t)_mm_movemask_ps(_mm_cmpge_ps(left, zero));
+            uint32_t right_bits = (uint32_t)_mm_movemask_ps(_mm_cmpge_ps(right, zero));
+            edge_coverage |= (left_bits | right_bits << 4) << (row * AGFX_OCCLUSION_TILE_WIDTH);
+            left = _mm_add_ps(left, row_step);
+            right = _mm_add_ps(right, row_step);
+        }
+        coverage &= edge_coverage;
+    }
+#else
+    for (int edge = 0; edge < 3; ++edge)
+    {
+        uint32_t edge_coverage = 0;
+        for (int row = 0; row < AGFX_OCCLUSION_TILE_HEIGHT; ++row)
+        {
+            for (int column = 0; column < AGFX_OCCLUSION_TILE_WIDTH; ++column)
+            {
+                float value = triangle->edge_a[edge] * (tile_x + column + 0.5f) + triangle->edge_b[edge] * (tile_y + row + 0.5f) + triangle->edge_c[edge];
+                edge_coverage |= (uint32_t)(value >= 0.0f) << (row * AGFX_OCCLUSION_TILE_WIDTH + column);
+            }
+        }
+        coverage &= edge_coverage;
+    }
+#endif
+
+    return coverage;
+}
+
+// the plane's largest value over the tile corners, no more than the triangle itself reaches
+static float tile_depth_max(const agfx_occlusion_triangle_t* triangle, float tile_x, float tile_y)
+{
+    float x0 = tile_x, x1 = tile_x + AGFX_OCCLUSION_TILE_WIDTH;
+    float y0 = tile_y, y1 = tile_y + AGFX_OCCLUSION_TILE_HEIGHT;
+    float depth = triangle->depth_a * (triangle->depth_a > 0.0f ? x1 : x0) + triangle->depth_b * (triangle->depth_b > 0.0f ? y1 : y0) + triangle->depth_c;
+    return fminf(depth, triangle->depth_max);
+}
+
+// masked occlusion culling's merge: a triangle far in front of the working layer throws the layer away and starts a new one,
+// and once a layer covers the whole tile its farthest depth becomes the tile's depth
+static void update_tile(agfx_occlusion_tile_t* tile, uint32_t coverage, float depth_max)
+{
+    float distance_to_layer = tile->z_max1 - depth_max;
+    float layer_distance = tile->z_max0 - tile->z_max1;
+    if (distance_to_layer > layer_distance)
+    {
+        tile->z_max1 = 0.0f;
+        tile->mask = 0;
+    }
+
+    tile->z_max1 = fmaxf(tile->z_max1, depth_max);
+    tile->mask |= coverage;
+
+    if (AGFX_OCCLUSION_FULL_MASK == tile->mask)
+    {
+        tile->z_max0 = fminf(tile->z_max0, tile->z_max1);
+        tile->z_max1 = 0.0f;
+        tile->mask = 0;
+    }
+}
+
+// each job owns a band of tile rows, so no two jobs ever touch the same tile
+static void rasterize_rows(void* data, size_t begin, size_t end)
+{
+    agfx_software_occlusion_t* software_occlusion = (agfx_software_occlusion_t*)data;
+    int32_t band_min_y = (int32_t)(begin * AGFX_OCCLUSION_TILE_HEIGHT);
+    int32_t band_max_y = (int32_t)(end * AGFX_OCCLUSION_TILE_HEIGHT) - 1;
+
+    for (size_t i = 0; i < software_occlusion->triangles_count; ++i)
+    {
+        const agfx_occlusion_triangle_t* triangle = &software_occlusion->triangles[i];
+        if (triangle->max_y < band_min_y || triangle->min_y > band_max_y)
+        {
+            continue;
+        }
+
+        uint32_t tile_min_x = (uint32_t)triangle->min_x / AGFX_OCCLUSION_TILE_WIDTH;
+        uint32_t tile_max_x = (uint32_t)triangle->max_x / AGFX_OCCLUSION_TILE_WIDTH;
+        uint32_t tile_min_y = (uint32_t)(triangle->min_y > band_min_y ? triangle->min_y : band_min_y) / AGFX_OCCLUSION_TILE_HEIGHT;
+        uint32_t tile_max_y = (uint32_t)(triangle->max_y < band_max_y ? triangle->max_y : band_max_y) / AGFX_OCCLUSION_TILE_HEIGHT;
+
+        for (uint32_t tile_y = tile_min_y; tile_y <= tile_max_y; ++tile_y)
+        {
+            for (uint32_t tile_x = tile_min_x; tile_x <= tile_max_x; ++tile_x)
+            {
+                agfx_occlusion_tile_t* tile = &software_occlusion->tiles[tile_y * software_occlusion->tiles_x + tile_x];
+                if (triangle->depth_min >= tile->z_max0)
+                {
+                    continue;
+                }
+
+                float pixel_x = (float)(tile_x * AGFX_OCCLUSION_TILE_WIDTH);
+                float pixel_y = (float)(tile_y * AGFX_OCCLUSION_TILE_HEIGHT);
+                uint32_t coverage = tile_coverage(triangle, pixel_x, pixel_y);
+                if (0 == coverage)
+                {
+                    continue;
+                }
+
+                update_tile(tile, coverage, tile_depth_max(triangle, pixel_x, pixel_y));
+            }
+        }
+    }
+}
+
+void agfx_software_occlusion_rasterize(agfx_software_occlusion_t* software_occlusion, agfx_job_system_t* job_system)
+{
+    agfx_job_system_parallel_for(job_system, software_occlusion->tiles_y, AGFX_OCCLUSION_ROWS_PER_JOB, rasterize_rows, software_occlusion);
+}
+
+// the box's nearest depth against the farthest depth of every tile under its screen rectangle.
+// boxes reaching through the near plane or off screen are always visible
+uint32_t agfx_software_occlusion_test_aabb(const agfx_software_occlusion_t* software_occlusion, agfx_aabb_t bounds, agfx_mat4x4_t view_projection)
+{
+    float min_x = FLT_MAX, min_y = FLT_MAX, max_x = -FLT_MAX, max_y = -FLT_MAX;
+    float depth_min = FLT_MAX;
+
+    // the min corner is transformed once, the others add the matrix columns scaled by the box size
+    agfx_vector4_t base = to_clip(view_projection, bounds.min);
+    agfx_vector4_t axes[3];
+    float sizes[3] = {bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y, bounds.max.z - bounds.min.z};
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        agfx_vector4_t column = view_projection.mat[axis];
+        axes[axis] = (agfx_vector4_t) {column.x * sizes[axis], column.y * sizes[axis], column.z * sizes[axis], column.w * sizes[axis]};
+    }
+
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        agfx_vector4_t clip = base;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (corner & (1 << axis))
+            {
+                clip = (agfx_vector4_t) {clip.x + axes[axis].x, clip.y + axes[axis].y, clip.z + axes[axis].z, clip.w + axes[axis].w};
+            }
+        }
+        if (clip.w < AGFX_OCCLUSION_MIN_W || clip.z < 0.0f)
+        {
+            return 1;
+        }
+
+        float x = (clip.x / clip.w * 0.5f + 0.5f) * software_occlusion->width;
+        float y = (clip.y / clip.w * 0.5f + 0.5f) * software_occlusion->height;
+        float depth = clip.z / clip.w;
+        min_x = x < min_x ? x : min_x;
+        max_x = x > max_x ? x : max_x;
+        min_y = y < min_y ? y : min_y;
+        max_y = y > max_y ? y : max_y;
+        depth_min = depth < depth_min ? depth : depth_min;
+    }
+
+    // off screen is the frustum test's call, not this one's
+    if (max_x < 0.0f || max_y < 0.0f || min_x >= software_occlusion->width || min_y >= software_occlusion->height)
+    {
+        return 1;
+    }
+
+    uint32_t tile_min_x = (uint32_t)fmaxf(min_x, 0.0f) / AGFX_OCCLUSION_TILE_WIDTH;
+    uint32_t tile_min_y = (uint32_t)fmaxf(min_y, 0.0f) / AGFX_OCCLUSION_TILE_HEIGHT;
+    uint32_t tile_max_x = (uint32_t)fminf(max_x, software_occlusion->width - 1.0f) / AGFX_OCCLUSION_TILE_WIDTH;
+    uint32_t tile_max_y = (uint32_t)fminf(max_y, software_occlusion->height - 1.0f) / AGFX_OCCLUSION_TILE_HEIGHT;
+
+    for (uint32_t tile_y = tile_min_y; tile_y <= tile_max_y; ++tile_y)
+    {
+        for (uint32_t tile_x = tile_min_x; tile_x <= tile_max_x; ++tile_x)
+        {
+            if (depth_min <= software_occlusion->tiles[tile_y * software_occlusion->tiles_x + tile_x].z_max0)
+            {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+typedef struct agfx_occlusion_filter_t {
+    agfx_software_occlusion_t* software_occlusion;
+    agfx_mat4x4_t view_projection;
+    const agfx_aabb_t* bounds;
+    const uint32_t* indices;
+} agfx_occlusion_filter_t;
+
+static void test_objects(void* data, size_t begin, size_t end)
+{
+    agfx_occlusion_filter_t* filter = (agfx_occlusion_filter_t*)data;
+    for (size_t i = begin; i < end; ++i)
+    {
+        filter->software_occlusion->visibility[i] = (uint8_t)agfx_software_occlusion_test_aabb(filter->software_occlusion, filter->bounds[filter->indices[i]], filter->view_projection);
+    }
+}
+
+// drops the occluded entries of indices in place and keeps the order, bounds is indexed by the values in indices
+size_t agfx_software_occlusion_filter(agfx_software_occlusion_t* software_occlusion, agfx_job_system_t* job_system, agfx_mat4x4_t view_projection, const agfx_aabb_t* bounds, uint32_t* indices, size_t indices_count)
+{
+    if (indices_count > software_occlusion->objects_capacity)
+    {
+        return indices_count;
+    }
+
+    agfx_occlusion_filter_t filter = {
+        .software_occlusion = software_occlusion,
+        .view_projection = view_projection,
+        .bounds = bounds,
+        .indices = indices
+    };
+    agfx_job_system_parallel_for(job_system, indices_count, AGFX_OCCLUSION_OBJECTS_PER_JOB, test_objects, &filter);
+
+    size_t visible_count = 0;
+    for (size_t i = 0; i < indices_count; ++i)
+    {
+        if (software_occlusion->visibility[i])
+        {
+            indices[visible_count++] = indices[i];
+        }
+    }
+
+    software_occlusion->culled_count = indices_count - visible_count;
+    return visible_count;
+}
\ No newline at end of file
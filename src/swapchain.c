@@ -85,6 +85,13 @@ agfx_result_t create_swapchain(agfx_swapchain_t *swapchain)
         queue_family_indices_count = 2;
     }
 
+    // transfer source lets a frame be copied out and checked, not every surface offers it
+    VkImageUsageFlags image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (swapchain->swapchain_info.surface_capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+    {
+        image_usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+
     VkSwapchainCreateInfoKHR swapchain_create_info = {
         .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
         .surface = swapchain->context->surface,
@@ -93,7 +100,7 @@ agfx_result_t create_swapchain(agfx_swapchain_t *swapchain)
         .imageColorSpace = surface_format.colorSpace,
         .imageExtent = extent,
         .imageArrayLayers = 1,
-        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .imageUsage = image_usage,
         .pQueueFamilyIndices = queue_family_indices,
         .queueFamilyIndexCount = queue_family_indices_count,
         .preTransform = swapchain->swapchain_info.surface_capabilities.currentTransform,
@@ -230,6 +237,7 @@ agfx_result_t agfx_create_swapchain(agfx_context_t* context, agfx_present_t* pre
     
     swapchain.context = context;
     swapchain.present = present;
+    swapchain.depth_generation = 0;
 
     result = populate_swapchain_info(&swapchain);
     if (AGFX_SUCCESS != result) goto finish;
@@ -323,7 +331,7 @@ agfx_result_t create_depth_resources(agfx_swapchain_t *swapchain)
 {
     agfx_result_t result = AGFX_SUCCESS;
 
-    result = agfx_helper_create_image(swapchain->context, swapchain->swapchain_extent.width, swapchain->swapchain_extent.height, VK_FORMAT_D32_SFLOAT, VK_IMAGE_TILING_OPTIMAL,VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &swapchain->depth_image, &swapchain->depth_image_memory);
+    result = agfx_helper_create_image(swapchain->context, swapchain->swapchain_extent.width, swapchain->swapchain_extent.height, VK_FORMAT_D32_SFLOAT, VK_IMAGE_TILING_OPTIMAL,VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &swapchain->depth_image, &swapchain->depth_image_memory);
     if (AGFX_SUCCESS != result) return result;
 
     result = agfx_helper_create_image_view(swapchain->context, swapchain->depth_image, VK_FORMAT_D32_SFLOAT, VK_IMAGE_ASPECT_DEPTH_BIT, &swapchain->depth_image_view);
@@ -334,6 +342,9 @@ agfx_result_t create_depth_resources(agfx_swapchain_t *swapchain)
         return result;
     }
 
+    // the depth pyramid is rebuilt against the new depth image when this changes
+    swapchain->depth_generation++;
+
     return result;
 }
 
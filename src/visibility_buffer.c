@@ -0,0 +1,783 @@
+#include "visibility_buffer.h"
+#include "renderer.h"
+
+// the same two passes as the scene's with the ids in place of color: the early one clears and leaves depth readable by
+// the pyramid build, the late one loads both and leaves the ids readable by the shade pass
+static agfx_result_t create_visibility_render_pass(agfx_renderer_t* renderer, uint32_t is_late_pass, VkRenderPass* render_pass)
+{
+    VkAttachmentDescription attachment_descriptions[AGFX_VISIBILITY_ATTACHMENT_COUNT] = {
+        {
+            .format = AGFX_VISIBILITY_FORMAT,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = is_late_pass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = is_late_pass ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+            .finalLayout = is_late_pass ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+        },
+        {
+            .format = VK_FORMAT_D32_SFLOAT,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = is_late_pass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = is_late_pass ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = is_late_pass ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+            .finalLayout = is_late_pass ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+        }
+    };
+
+    VkAttachmentReference visibility_attachment_ref = {
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+    };
+
+    VkAttachmentReference depth_attachment_ref = {
+        .attachment = 1,
+        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+    };
+
+    VkSubpassDescription subpass_description = {
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .pColorAttachments = &visibility_attachment_ref,
+        .colorAttachmentCount = 1,
+        .pDepthStencilAttachment = &depth_attachment_ref
+    };
+
+    // besides the pyramid build, the last frame's shade pass still read the ids the early pass clears
+    VkSubpassDependency subpass_dependencies[AGFX_SUBPASS_DEPENDENCY_COUNT] = {
+        {
+            .srcSubpass = VK_SUBPASS_EXTERNAL,
+            .dstSubpass = 0,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        },
+        {
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        }
+    };
+
+    VkRenderPassCreateInfo render_pass_create_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = AGFX_VISIBILITY_ATTACHMENT_COUNT,
+        .pAttachments = attachment_descriptions,
+        .subpassCount = 1,
+        .pSubpasses = &subpass_description,
+        .dependencyCount = AGFX_SUBPASS_DEPENDENCY_COUNT,
+        .pDependencies = subpass_dependencies
+    };
+
+    if (VK_SUCCESS != vkCreateRenderPass(renderer->context->device, &render_pass_create_info, NULL, render_pass))
+    {
+        return AGFX_RENDER_PASS_ERROR;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+// every pixel is written, so the swapchain image is neither cleared nor loaded
+static agfx_result_t create_shade_render_pass(agfx_renderer_t* renderer)
+{
+    VkAttachmentDescription swapchain_attachment_description = {
+        .format = renderer->swapchain->swapchain_format,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+    };
+
+    VkAttachmentReference swapchain_attachment_ref = {
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+    };
+
+    VkSubpassDescription subpass_description = {
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .pColorAttachments = &swapchain_attachment_ref,
+        .colorAttachmentCount = 1
+    };
+
+    // the image is only ours once the acquire semaphore waited at color output
+    VkSubpassDependency subpass_dependency = {
+        .srcSubpass = VK_SUBPASS_EXTERNAL,
+        .dstSubpass = 0,
+        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .srcAccessMask = 0,
+        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+    };
+
+    VkRenderPassCreateInfo render_pass_create_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &swapchain_attachment_description,
+        .subpassCount = 1,
+        .pSubpasses = &subpass_description,
+        .dependencyCount = 1,
+        .pDependencies = &subpass_dependency
+    };
+
+    if (VK_SUCCESS != vkCreateRenderPass(renderer->context->device, &render_pass_create_info, NULL, &renderer->visibility_buffer.shade_render_pass))
+    {
+        return AGFX_RENDER_PASS_ERROR;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+static agfx_result_t create_visibility_render_passes(agfx_renderer_t* renderer)
+{
+    agfx_visibility_buffer_t* visibility = &renderer->visibility_buffer;
+    VkDevice device = renderer->context->device;
+
+    agfx_result_t result = create_visibility_render_pass(renderer, 0, &visibility->render_pass);
+    if (AGFX_SUCCESS != result) return result;
+
+    result = create_visibility_render_pass(renderer, 1, &visibility->late_render_pass);
+    if (AGFX_SUCCESS != result) goto free_render_pass;
+
+    result = create_shade_render_pass(renderer);
+    if (AGFX_SUCCESS == result) return result;
+
+    vkDestroyRenderPass(device, visibility->late_render_pass, NULL);
+free_render_pass:
+    vkDestroyRenderPass(device, visibility->render_pass, NULL);
+    return result;
+}
+
+static void free_visibility_render_passes(agfx_renderer_t* renderer)
+{
+    agfx_visibility_buffer_t* visibility = &renderer->visibility_buffer;
+
+    vkDestroyRenderPass(renderer->context->device, visibility->shade_render_pass, NULL);
+    vkDestroyRenderPass(renderer->context->device, visibility->late_render_pass, NULL);
+    vkDestroyRenderPass(renderer->context->device, visibility->render_pass, NULL);
+}
+
+// sets 0 and 1 are the scene's, set 2 is everything the shade pass needs to find a pixel's triangle again
+static agfx_result_t create_visibility_pipeline_layout(agfx_renderer_t* renderer)
+{
+    agfx_visibility_buffer_t* visibility = &renderer->visibility_buffer;
+    VkDevice device = renderer->context->device;
+
+    VkDescriptorSetLayoutBinding bindings[AGFX_VISIBILITY_DESCRIPTOR_COUNT];
+    for (uint32_t i = 0; i < AGFX_VISIBILITY_DESCRIPTOR_COUNT; ++i)
+    {
+        bindings[i] = (VkDescriptorSetLayoutBinding) {
+            .binding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+        };
+    }
+    bindings[AGFX_VISIBILITY_IMAGE_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    // the geometry pass finds a cluster's object through its pair
+    bindings[1].stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = AGFX_VISIBILITY_DESCRIPTOR_COUNT,
+        .pBindings = bindings
+    };
+
+    if (VK_SUCCESS != vkCreateDescriptorSetLayout(device, &layout_create_info, NULL, &visibility->descriptor_set_layout))
+    {
+        return AGFX_DESCRIPTOR_SET_LAYOUT_ERROR;
+    }
+
+    VkDescriptorSetLayout set_layouts[] = {
+        renderer->descriptor_set_layout,
+        renderer->material_descriptor_set_layout,
+        visibility->descriptor_set_layout
+    };
+
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 3,
+        .pSetLayouts = set_layouts
+    };
+
+    if (VK_SUCCESS != vkCreatePipelineLayout(device, &pipeline_layout_create_info, NULL, &visibility->pipeline_layout))
+    {
+        vkDestroyDescriptorSetLayout(device, visibility->descriptor_set_layout, NULL);
+        return AGFX_PIPELINE_ERROR;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+// none of the pipelines blend, the ids are integers and the shade pass covers every pixel once
+static agfx_result_t create_visibility_pipeline(agfx_renderer_t* renderer, const char* vertex_shader_path, const char* fragment_shader_path, const VkPipelineVertexInputStateCreateInfo* vertex_input_state_create_info, const VkPipelineDepthStencilStateCreateInfo* depth_stencil_state_create_info, VkCullModeFlags cull_mode, VkRenderPass render_pass, VkPipeline* pipeline)
+{
+    VkDevice device = renderer->context->device;
+    agfx_result_t result = AGFX_SUCCESS;
+
+    VkShaderModule vert_shader_module;
+    result = agfx_helper_create_shader_module(renderer->context, vertex_shader_path, &vert_shader_module);
+    if (AGFX_SUCCESS != result) return result;
+
+    VkShaderModule frag_shader_module;
+    result = agfx_helper_create_shader_module(renderer->context, fragment_shader_path, &frag_shader_module);
+    if (AGFX_SUCCESS != result)
+    {
+        vkDestroyShaderModule(device, vert_shader_module, NULL);
+        return result;
+    }
+
+    VkPipelineShaderStageCreateInfo stages[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vert_shader_module,
+            .pName = "main",
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = frag_shader_module,
+            .pName = "main",
+        }
+    };
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly_state_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .primitiveRestartEnable = VK_FALSE
+    };
+
+    VkPipelineRasterizationStateCreateInfo rasterization_state_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .lineWidth = 1.0f,
+        .cullMode = cull_mode,
+        .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+        .depthBiasEnable = VK_FALSE
+    };
+
+    VkPipelineMultisampleStateCreateInfo multisample_state_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .sampleShadingEnable = VK_FALSE,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+    };
+
+    VkPipelineColorBlendAttachmentState color_blend_attachment_state = {
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+        .blendEnable = VK_FALSE,
+    };
+
+    VkPipelineColorBlendStateCreateInfo color_blend_state_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &color_blend_attachment_state,
+        .logicOpEnable = VK_FALSE,
+        .logicOp = VK_LOGIC_OP_COPY,
+        .blendConstants = {0.0f, 0.0f, 0.0f, 0.0f}
+    };
+
+    VkPipelineViewportStateCreateInfo viewport_state_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 0,
+        .scissorCount = 0,
+    };
+
+    VkDynamicState dynamic_state[] = {
+        VK_DYNAMIC_STATE_VIEWPORT_WITH_COUNT,
+        VK_DYNAMIC_STATE_SCISSOR_WITH_COUNT
+    };
+
+    VkPipelineDynamicStateCreateInfo pipeline_dynamic_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamic_state,
+    };
+
+    VkGraphicsPipelineCreateInfo pipeline_create_info = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stageCount = 2,
+        .pStages = stages,
+        .pVertexInputState = vertex_input_state_create_info,
+        .pInputAssemblyState = &input_assembly_state_create_info,
+        .pRasterizationState = &rasterization_state_create_info,
+        .pMultisampleState = &multisample_state_create_info,
+        .pColorBlendState = &color_blend_state_create_info,
+        .layout = renderer->visibility_buffer.pipeline_layout,
+        .renderPass = render_pass,
+        .subpass = 0,
+        .pDynamicState = &pipeline_dynamic_create_info,
+        .pViewportState = &viewport_state_create_info,
+        .pDepthStencilState = depth_stencil_state_create_info,
+    };
+
+    if (VK_SUCCESS != vkCreateGraphicsPipelines(device, renderer->context->pipeline_cache, 1, &pipeline_create_info, NULL, pipeline))
+    {
+        result = AGFX_PIPELINE_ERROR;
+    }
+
+    vkDestroyShaderModule(device, vert_shader_module, NULL);
+    vkDestroyShaderModule(device, frag_shader_module, NULL);
+    return result;
+}
+
+static agfx_result_t create_visibility_pipelines(agfx_renderer_t* renderer)
+{
+    agfx_visibility_buffer_t* visibility = &renderer->visibility_buffer;
+    agfx_result_t result = AGFX_SUCCESS;
+
+    result = create_visibility_pipeline_layout(renderer);
+    if (AGFX_SUCCESS != result) return result;
+
+    // the geometry pass only rasterizes, position is all it reads of a vertex
+    VkPipelineVertexInputStateCreateInfo geometry_vertex_input_state_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = agfx_vertex_input_binding_descriptions,
+        .vertexAttributeDescriptionCount = 1,
+        .pVertexAttributeDescriptions = agfx_vertex_input_attribute_description
+    };
+
+    VkPipelineDepthStencilStateCreateInfo geometry_depth_stencil_state_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_TRUE,
+        .depthWriteEnable = VK_TRUE,
+        .depthCompareOp = VK_COMPARE_OP_LESS,
+        .depthBoundsTestEnable = VK_FALSE,
+        .stencilTestEnable = VK_FALSE,
+    };
+
+    result = create_visibility_pipeline(renderer, "./shaders/visibility_vert.spv", "./shaders/visibility_frag.spv", &geometry_vertex_input_state_create_info, &geometry_depth_stencil_state_create_info, VK_CULL_MODE_BACK_BIT, visibility->render_pass, &visibility->geometry_pipeline);
+    if (AGFX_SUCCESS != result) goto free_pipeline_layout;
+
+    result = create_visibility_pipeline(renderer, "./shaders/visibility_vert.spv", "./shaders/visibility_frag.spv", &geometry_vertex_input_state_create_info, &geometry_depth_stencil_state_create_info, VK_CULL_MODE_NONE, visibility->render_pass, &visibility->double_sided_geometry_pipeline);
+    if (AGFX_SUCCESS != result) goto free_geometry_pipeline;
+
+    // a full screen triangle made up from the vertex index
+    VkPipelineVertexInputStateCreateInfo shade_vertex_input_state_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO
+    };
+
+    result = create_visibility_pipeline(renderer, "./shaders/visibility_resolve.spv", "./shaders/visibility_shade.spv", &shade_vertex_input_state_create_info, NULL, VK_CULL_MODE_NONE, visibility->shade_render_pass, &visibility->shade_pipeline);
+    if (AGFX_SUCCESS == result) return result;
+
+    vkDestroyPipeline(renderer->context->device, visibility->double_sided_geometry_pipeline, NULL);
+free_geometry_pipeline:
+    vkDestroyPipeline(renderer->context->device, visibility->geometry_pipeline, NULL);
+free_pipeline_layout:
+    vkDestroyPipelineLayout(renderer->context->device, visibility->pipeline_layout, NULL);
+    vkDestroyDescriptorSetLayout(renderer->context->device, visibility->descriptor_set_layout, NULL);
+    return result;
+}
+
+static void free_visibility_pipelines(agfx_renderer_t* renderer)
+{
+    agfx_visibility_buffer_t* visibility = &renderer->visibility_buffer;
+    VkDevice device = renderer->context->device;
+
+    vkDestroyPipeline(device, visibility->shade_pipeline, NULL);
+    vkDestroyPipeline(device, visibility->geometry_pipeline, NULL);
+    vkDestroyPipeline(device, visibility->double_sided_geometry_pipeline, NULL);
+    vkDestroyPipelineLayout(device, visibility->pipeline_layout, NULL);
+    vkDestroyDescriptorSetLayout(device, visibility->descriptor_set_layout, NULL);
+}
+
+// ids are fetched texel by texel, the sampler only has to exist
+static agfx_result_t create_visibility_sampler(agfx_renderer_t* renderer)
+{
+    VkSamplerCreateInfo sampler_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .anisotropyEnable = VK_FALSE,
+        .compareEnable = VK_FALSE,
+        .minLod = 0.0f,
+        .maxLod = 0.0f,
+        .unnormalizedCoordinates = VK_FALSE
+    };
+
+    if (VK_SUCCESS != vkCreateSampler(renderer->context->device, &sampler_create_info, NULL, &renderer->visibility_buffer.sampler))
+    {
+        return AGFX_SAMPLER_CREATE_ERROR;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+static agfx_result_t create_visibility_descriptor_pool(agfx_renderer_t* renderer)
+{
+    VkDescriptorPoolSize descriptor_pool_sizes[AGFX_VISIBILITY_DESCRIPTOR_POOL_SIZE_COUNT] = {
+        {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = AGFX_MAX_FRAMES_IN_FLIGHT
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = AGFX_MAX_FRAMES_IN_FLIGHT * (AGFX_VISIBILITY_DESCRIPTOR_COUNT - 1)
+        }
+    };
+
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = AGFX_VISIBILITY_DESCRIPTOR_POOL_SIZE_COUNT,
+        .pPoolSizes = descriptor_pool_sizes,
+        .maxSets = AGFX_MAX_FRAMES_IN_FLIGHT
+    };
+
+    if (VK_SUCCESS != vkCreateDescriptorPool(renderer->context->device, &descriptor_pool_create_info, NULL, &renderer->visibility_buffer.descriptor_pool))
+    {
+        return AGFX_DESCRIPTOR_POOL_ERROR;
+    }
+
+    return AGFX_SUCCESS;
+}
+
+// a set per frame for that frame's cluster pairs, the image is written once the targets exist
+static agfx_result_t allocate_visibility_descriptor_sets(agfx_renderer_t* renderer)
+{
+    agfx_visibility_buffer_t* visibility = &renderer->visibility_buffer;
+    VkDescriptorSetLayout set_layouts[AGFX_MAX_FRAMES_IN_FLIGHT];
+
+    for (size_t i = 0; i < AGFX_MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        set_layouts[i] = visibility->descriptor_set_layout;
+    }
+
+    VkDescriptorSetAllocateInfo set_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = visibility->descriptor_pool,
+        .descriptorSetCount = AGFX_MAX_FRAMES_IN_FLIGHT,
+        .pSetLayouts = set_layouts
+    };
+
+    if (VK_SUCCESS != vkAllocateDescriptorSets(renderer->context->device, &set_allocate_info, visibility->descriptor_sets))
+    {
+        return AGFX_DESCRIPTOR_SET_ERROR;
+    }
+
+    for (size_t i = 0; i < AGFX_MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        VkDescriptorBufferInfo buffer_infos[AGFX_VISIBILITY_DESCRIPTOR_COUNT] = {
+            {0},
+            {.buffer = renderer->meshlet_culling.frames[i].cluster_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = renderer->meshlet_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = renderer->geometry_buffer.index_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = renderer->geometry_buffer.position_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = renderer->geometry_buffer.attribute_buffer, .offset = 0, .range = VK_WHOLE_SIZE}
+        };
+
+        VkWriteDescriptorSet write_descriptor_sets[AGFX_VISIBILITY_DESCRIPTOR_COUNT - 1];
+        for (uint32_t binding = 1; binding < AGFX_VISIBILITY_DESCRIPTOR_COUNT; ++binding)
+        {
+            write_descriptor_sets[binding - 1] = (VkWriteDescriptorSet) {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = visibility->descriptor_sets[i],
+                .dstBinding = binding,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .pBufferInfo = &buffer_infos[binding]
+            };
+        }
+        vkUpdateDescriptorSets(renderer->context->device, AGFX_VISIBILITY_DESCRIPTOR_COUNT - 1, write_descriptor_sets, 0, NULL);
+    }
+
+    return AGFX_SUCCESS;
+}
+
+static void free_visibility_targets(agfx_renderer_t* renderer)
+{
+    agfx_visibility_buffer_t* visibility = &renderer->visibility_buffer;
+    VkDevice device = renderer->context->device;
+
+    if (0 == visibility->shade_framebuffers_count) return;
+
+    for (uint32_t i = 0; i < visibility->shade_framebuffers_count; ++i)
+    {
+        vkDestroyFramebuffer(device, visibility->shade_framebuffers[i], NULL);
+    }
+    free(visibility->shade_framebuffers);
+    visibility->shade_framebuffers = NULL;
+    vkDestroyFramebuffer(device, visibility->framebuffer, NULL);
+    vkDestroyImageView(device, visibility->image_view, NULL);
+    vkDestroyImage(device, visibility->image, NULL);
+    vkFreeMemory(device, visibility->image_memory, NULL);
+
+    visibility->shade_framebuffers_count = 0;
+}
+
+// sized like and sharing the depth image, so they are rebuilt whenever it is
+static agfx_result_t create_visibility_targets(agfx_renderer_t* renderer)
+{
+    agfx_visibility_buffer_t* visibility = &renderer->visibility_buffer;
+    agfx_swapchain_t* swapchain = renderer->swapchain;
+    agfx_context_t* context = renderer->context;
+    agfx_result_t result = AGFX_SUCCESS;
+    uint32_t created_framebuffers = 0;
+
+    result = agfx_helper_create_image(context, swapchain->swapchain_extent.width, swapchain->swapchain_extent.height, AGFX_VISIBILITY_FORMAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &visibility->image, &visibility->image_memory);
+    if (AGFX_SUCCESS != result) return result;
+
+    result = agfx_helper_create_image_view(context, visibility->image, AGFX_VISIBILITY_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, &visibility->image_view);
+    if (AGFX_SUCCESS != result) goto free_image;
+
+    // the late pass is compatible with the early one, the framebuffer serves both
+    VkImageView attachments[AGFX_VISIBILITY_ATTACHMENT_COUNT] = {
+        visibility->image_view,
+        swapchain->depth_image_view
+    };
+
+    VkFramebufferCreateInfo framebuffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .renderPass = visibility->render_pass,
+        .width = swapchain->swapchain_extent.width,
+        .height = swapchain->swapchain_extent.height,
+        .layers = 1,
+        .attachmentCount = AGFX_VISIBILITY_ATTACHMENT_COUNT,
+        .pAttachments = attachments
+    };
+
+    if (VK_SUCCESS != vkCreateFramebuffer(context->device, &framebuffer_create_info, NULL, &visibility->framebuffer))
+    {
+        result = AGFX_FRAMEBUFFER_ERROR;
+        goto free_image_view;
+    }
+
+    visibility->shade_framebuffers = malloc(sizeof(VkFramebuffer) * swapchain->swapchain_images_count);
+    if (NULL == visibility->shade_framebuffers)
+    {
+        result = AGFX_FRAMEBUFFER_ERROR;
+        goto free_framebuffer;
+    }
+
+    for (; created_framebuffers < swapchain->swapchain_images_count; ++created_framebuffers)
+    {
+        VkFramebufferCreateInfo shade_framebuffer_create_info = {
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .renderPass = visibility->shade_render_pass,
+            .width = swapchain->swapchain_extent.width,
+            .height = swapchain->swapchain_extent.height,
+            .layers = 1,
+            .attachmentCount = 1,
+            .pAttachments = &swapchain->swapchain_image_views[created_framebuffers]
+        };
+
+        if (VK_SUCCESS != vkCreateFramebuffer(context->device, &shade_framebuffer_create_info, NULL, &visibility->shade_framebuffers[created_framebuffers]))
+        {
+            result = AGFX_FRAMEBUFFER_ERROR;
+            goto free_shade_framebuffers;
+        }
+    }
+
+    VkDescriptorImageInfo visibility_image_info = {
+        .sampler = visibility->sampler,
+        .imageView = visibility->image_view,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+
+    for (size_t i = 0; i < AGFX_MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        VkWriteDescriptorSet write_descriptor_set = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = visibility->descriptor_sets[i],
+            .dstBinding = AGFX_VISIBILITY_IMAGE_BINDING,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .pImageInfo = &visibility_image_info
+        };
+        vkUpdateDescriptorSets(context->device, 1, &write_descriptor_set, 0, NULL);
+    }
+
+    visibility->shade_framebuffers_count = swapchain->swapchain_images_count;
+    visibility->depth_generation = swapchain->depth_generation;
+    return result;
+
+free_shade_framebuffers:
+    for (uint32_t i = 0; i < created_framebuffers; ++i)
+    {
+        vkDestroyFramebuffer(context->device, visibility->shade_framebuffers[i], NULL);
+    }
+    free(visibility->shade_framebuffers);
+    visibility->shade_framebuffers = NULL;
+free_framebuffer:
+    vkDestroyFramebuffer(context->device, visibility->framebuffer, NULL);
+free_image_view:
+    vkDestroyImageView(context->device, visibility->image_view, NULL);
+free_image:
+    vkDestroyImage(context->device, visibility->image, NULL);
+    vkFreeMemory(context->device, visibility->image_memory, NULL);
+    return result;
+}
+
+// rides on meshlet culling: the ids name clusters, so every mesh needs its meshlets. without them the scene stays forward
+// and nothing is created
+agfx_result_t agfx_create_visibility_buffer(agfx_renderer_t* renderer)
+{
+    agfx_visibility_buffer_t* visibility = &renderer->visibility_buffer;
+    agfx_result_t result = AGFX_SUCCESS;
+
+    memset(visibility, 0, sizeof(agfx_visibility_buffer_t));
+
+    if (!renderer->meshlet_culling.available || !renderer->meshlet_culling.all_meshes_clustered)
+    {
+        return AGFX_SUCCESS;
+    }
+
+    result = create_visibility_render_passes(renderer);
+    if (AGFX_SUCCESS != result) return result;
+
+    result = create_visibility_pipelines(renderer);
+    if (AGFX_SUCCESS != result) goto free_render_passes;
+
+    result = create_visibility_sampler(renderer);
+    if (AGFX_SUCCESS != result) goto free_pipelines;
+
+    result = create_visibility_descriptor_pool(renderer);
+    if (AGFX_SUCCESS != result) goto free_sampler;
+
+    visibility->descriptor_sets = calloc(AGFX_MAX_FRAMES_IN_FLIGHT, sizeof(VkDescriptorSet));
+    if (NULL == visibility->descriptor_sets)
+    {
+        result = AGFX_DESCRIPTOR_SET_ERROR;
+        goto free_descriptor_pool;
+    }
+
+    result = allocate_visibility_descriptor_sets(renderer);
+    if (AGFX_SUCCESS != result) goto free_descriptor_sets;
+
+    visibility->available = 1;
+    return result;
+
+free_descriptor_sets:
+    free(visibility->descriptor_sets);
+    visibility->descriptor_sets = NULL;
+free_descriptor_pool:
+    vkDestroyDescriptorPool(renderer->context->device, visibility->descriptor_pool, NULL);
+free_sampler:
+    vkDestroySampler(renderer->context->device, visibility->sampler, NULL);
+free_pipelines:
+    free_visibility_pipelines(renderer);
+free_render_passes:
+    free_visibility_render_passes(renderer);
+    return result;
+}
+
+void agfx_free_visibility_buffer(agfx_renderer_t* renderer)
+{
+    agfx_visibility_buffer_t* visibility = &renderer->visibility_buffer;
+
+    if (!visibility->available) return;
+
+    free_visibility_targets(renderer);
+    free(visibility->descriptor_sets);
+    vkDestroyDescriptorPool(renderer->context->device, visibility->descriptor_pool, NULL);
+    vkDestroySampler(renderer->context->device, visibility->sampler, NULL);
+    free_visibility_pipelines(renderer);
+    free_visibility_render_passes(renderer);
+    visibility->available = 0;
+}
+
+uint32_t agfx_visibility_buffer_enabled(agfx_renderer_t* renderer)
+{
+    return renderer->visibility_buffer.available && renderer->state->visibility_buffer && agfx_meshlet_culling_enabled(renderer);
+}
+
+agfx_result_t agfx_visibility_buffer_begin_frame(agfx_renderer_t* renderer)
+{
+    agfx_visibility_buffer_t* visibility = &renderer->visibility_buffer;
+
+    if (!visibility->available || (0 != visibility->shade_framebuffers_count && visibility->depth_generation == renderer->swapchain->depth_generation))
+    {
+        return AGFX_SUCCESS;
+    }
+
+    vkDeviceWaitIdle(renderer->context->device);
+    free_visibility_targets(renderer);
+    return create_visibility_targets(renderer);
+}
+
+// the clusters agfx_cmd_meshlet_cull let through for the phase, as indexed draws that write their ids
+void agfx_cmd_visibility_geometry_pass(agfx_renderer_t* renderer, VkCommandBuffer command_buffer, uint32_t phase)
+{
+    agfx_visibility_buffer_t* visibility = &renderer->visibility_buffer;
+    agfx_meshlet_culling_t* culling = &renderer->meshlet_culling;
+    agfx_meshlet_cull_frame_t* cull_frame = &culling->frames[renderer->state->current_frame];
+
+    VkClearValue clear_values[AGFX_VISIBILITY_ATTACHMENT_COUNT] = {
+        {
+            .color = {
+                .uint32 = {AGFX_VISIBILITY_EMPTY, 0, 0, 0}
+            }
+        },
+        {
+            .depthStencil = {
+                .depth = 1.0f,
+                .stencil = 0
+            }
+        }
+    };
+
+    VkRenderPassBeginInfo render_pass_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = phase == AGFX_CULL_PHASE_EARLY ? visibility->render_pass : visibility->late_render_pass,
+        .framebuffer = visibility->framebuffer,
+        .renderArea = {
+            .offset = {0, 0},
+            .extent = renderer->swapchain->swapchain_extent
+        },
+        .clearValueCount = AGFX_VISIBILITY_ATTACHMENT_COUNT,
+        .pClearValues = clear_values
+    };
+
+    vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    // viewport, geometry and sets 0 and 1 are the scene's, the layouts agree on those sets
+    bind_scene_state(renderer, command_buffer);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, visibility->pipeline_layout, 2, 1, &visibility->descriptor_sets[renderer->state->current_frame], 0, NULL);
+    // ids only, so the ranges only differ in what they cull. the blended range holds both kinds and culls nothing
+    for (uint32_t range = 0; range < AGFX_DRAW_RANGES_COUNT; ++range)
+    {
+        uint32_t double_sided = AGFX_DRAW_BUCKET_BLEND == range || (renderer->bucket_pipeline_keys[range] & AGFX_PIPELINE_DOUBLE_SIDED);
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, double_sided ? visibility->double_sided_geometry_pipeline : visibility->geometry_pipeline);
+        uint32_t first_cluster = culling->range_first_clusters[range];
+        agfx_cmd_draw_list(renderer->context, command_buffer, cull_frame->draw_buffer, 0, culling->clusters_capacity, range, first_cluster, culling->range_first_clusters[range + 1] - first_cluster);
+    }
+    vkCmdEndRenderPass(command_buffer);
+}
+
+// one triangle over the whole screen, each pixel rebuilds its triangle from the id and shades it
+void agfx_cmd_visibility_shade_pass(agfx_renderer_t* renderer, VkCommandBuffer command_buffer, uint32_t image_index)
+{
+    agfx_visibility_buffer_t* visibility = &renderer->visibility_buffer;
+
+    VkRenderPassBeginInfo render_pass_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = visibility->shade_render_pass,
+        .framebuffer = visibility->shade_framebuffers[image_index],
+        .renderArea = {
+            .offset = {0, 0},
+            .extent = renderer->swapchain->swapchain_extent
+        },
+        .clearValueCount = 0
+    };
+
+    vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    bind_scene_state(renderer, command_buffer);
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, visibility->shade_pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, visibility->pipeline_layout, 2, 1, &visibility->descriptor_sets[renderer->state->current_frame], 0, NULL);
+    vkCmdDraw(command_buffer, 3, 1, 0, 0);
+    vkCmdEndRenderPass(command_buffer);
+}
\ No newline at end of file